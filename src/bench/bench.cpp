@@ -5,8 +5,13 @@
 #include "bench.h"
 #include "perf.h"
 
+#include <univalue.h>
+
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <iomanip>
+#include <regex>
 #include <sys/time.h>
 
 benchmark::BenchRunner::BenchmarkMap &benchmark::BenchRunner::benchmarks() {
@@ -25,18 +30,42 @@ benchmark::BenchRunner::BenchRunner(std::string name, benchmark::BenchFunction f
     benchmarks().insert(std::make_pair(name, func));
 }
 
-void
-benchmark::BenchRunner::RunAll(double elapsedTimeForOne)
+std::vector<std::string>
+benchmark::BenchRunner::List(const std::string& filter)
 {
+    std::regex reFilter(filter);
+    std::vector<std::string> names;
+    for (const auto &p: benchmarks()) {
+        if (std::regex_search(p.first, reFilter)) {
+            names.push_back(p.first);
+        }
+    }
+    return names;
+}
+
+std::vector<benchmark::Result>
+benchmark::BenchRunner::RunAll(Printer& printer, std::ostream& os, double elapsedTimeForOne,
+                               const std::string& filter, uint64_t countForOne)
+{
+    std::vector<Result> results;
     perf_init();
-    std::cout << "#Benchmark" << "," << "count" << "," << "min" << "," << "max" << "," << "average" << ","
-              << "min_cycles" << "," << "max_cycles" << "," << "average_cycles" << "\n";
+    printer.Header(os);
 
-    for (const auto &p: benchmarks()) {
-        State state(p.first, elapsedTimeForOne);
-        p.second(state);
+    for (const std::string& name : List(filter)) {
+        State state(name, elapsedTimeForOne, countForOne);
+        benchmarks()[name](state);
+        if (!state.IsFinished()) {
+            std::cerr << "Benchmark " << name << " stopped before it was finished, skipping it" << std::endl;
+            continue;
+        }
+        printer.Print(os, state.GetResult());
+        os.flush();
+        results.push_back(state.GetResult());
     }
+
+    printer.Footer(os);
     perf_fini();
+    return results;
 }
 
 bool benchmark::State::KeepRunning()
@@ -57,6 +86,7 @@ bool benchmark::State::KeepRunning()
         double elapsedOne = elapsed * countMaskInv;
         if (elapsedOne < minTime) minTime = elapsedOne;
         if (elapsedOne > maxTime) maxTime = elapsedOne;
+        samples.push_back(elapsedOne);
 
         // We only use relative values, so don't have to handle 64-bit wrap-around specially
         nowCycles = perf_cpucycles();
@@ -64,7 +94,9 @@ bool benchmark::State::KeepRunning()
         if (elapsedOneCycles < minCycles) minCycles = elapsedOneCycles;
         if (elapsedOneCycles > maxCycles) maxCycles = elapsedOneCycles;
 
-        if (elapsed*128 < maxElapsed) {
+        // with a fixed count, windows must not get bigger than the whole run
+        bool canGrow = maxCount == 0 || (countMask + 1) * 8 <= maxCount;
+        if (elapsed*128 < maxElapsed && canGrow) {
           // If the execution was much too fast (1/128th of maxElapsed), increase the count mask by 8x and restart timing.
           // The restart avoids including the overhead of this code in the measurement.
           countMask = ((countMask<<3)|7) & ((1LL<<60)-1);
@@ -74,9 +106,10 @@ bool benchmark::State::KeepRunning()
           maxTime = std::numeric_limits<double>::min();
           minCycles = std::numeric_limits<uint64_t>::max();
           maxCycles = std::numeric_limits<uint64_t>::min();
+          samples.clear();
           return true;
         }
-        if (elapsed*16 < maxElapsed) {
+        if (elapsed*16 < maxElapsed && canGrow) {
           uint64_t newCountMask = ((countMask<<1)|1) & ((1LL<<60)-1);
           if ((count & newCountMask)==0) {
               countMask = newCountMask;
@@ -88,15 +121,121 @@ bool benchmark::State::KeepRunning()
     lastCycles = nowCycles;
     ++count;
 
-    if (now - beginTime < maxElapsed) return true; // Keep going
+    // count already includes the iteration we are about to allow
+    if (maxCount != 0 ? count <= maxCount : now - beginTime < maxElapsed) return true; // Keep going
 
     --count;
+    Finish(now, nowCycles);
+    return false;
+}
+
+// nearest-rank percentile of sorted values
+static double Percentile(const std::vector<double>& sorted, double percent)
+{
+    if (sorted.empty()) return 0;
+    size_t rank = (size_t)std::ceil(percent / 100 * sorted.size());
+    return sorted[std::max<size_t>(rank, 1) - 1];
+}
 
-    // Output results
-    double average = (now-beginTime)/count;
-    int64_t averageCycles = (nowCycles-beginCycles)/count;
-    std::cout << std::fixed << std::setprecision(15) << name << "," << count << "," << minTime << "," << maxTime << "," << average << ","
-              << minCycles << "," << maxCycles << "," << averageCycles << "\n";
+void benchmark::State::Finish(double now, uint64_t nowCycles)
+{
+    std::sort(samples.begin(), samples.end());
 
-    return false;
+    result.name = name;
+    result.count = count;
+    result.minNs = minTime * 1e9;
+    result.maxNs = maxTime * 1e9;
+    result.averageNs = (now-beginTime) / count * 1e9;
+    result.medianNs = Percentile(samples, 50) * 1e9;
+    result.p90Ns = Percentile(samples, 90) * 1e9;
+    result.p99Ns = Percentile(samples, 99) * 1e9;
+    result.minCycles = minCycles;
+    result.maxCycles = maxCycles;
+    result.averageCycles = (nowCycles-beginCycles) / count;
+    finished = true;
+}
+
+void benchmark::CsvPrinter::Header(std::ostream& os)
+{
+    os << "#Benchmark" << "," << "count" << "," << "min_ns" << "," << "max_ns" << "," << "average_ns" << ","
+       << "median_ns" << "," << "p90_ns" << "," << "p99_ns" << ","
+       << "min_cycles" << "," << "max_cycles" << "," << "average_cycles" << "\n";
+}
+
+void benchmark::CsvPrinter::Print(std::ostream& os, const Result& result)
+{
+    os << std::fixed << std::setprecision(3) << result.name << "," << result.count << ","
+       << result.minNs << "," << result.maxNs << "," << result.averageNs << ","
+       << result.medianNs << "," << result.p90Ns << "," << result.p99Ns << ","
+       << result.minCycles << "," << result.maxCycles << "," << result.averageCycles << "\n";
+}
+
+void benchmark::JsonPrinter::Header(std::ostream& os)
+{
+    os << "{\"benchmarks\": [\n";
+    first = true;
+}
+
+void benchmark::JsonPrinter::Print(std::ostream& os, const Result& result)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("name", result.name));
+    obj.push_back(Pair("count", result.count));
+    obj.push_back(Pair("min_ns", result.minNs));
+    obj.push_back(Pair("max_ns", result.maxNs));
+    obj.push_back(Pair("average_ns", result.averageNs));
+    obj.push_back(Pair("median_ns", result.medianNs));
+    obj.push_back(Pair("p90_ns", result.p90Ns));
+    obj.push_back(Pair("p99_ns", result.p99Ns));
+    obj.push_back(Pair("min_cycles", result.minCycles));
+    obj.push_back(Pair("max_cycles", result.maxCycles));
+    obj.push_back(Pair("average_cycles", result.averageCycles));
+
+    if (!first) os << ",\n";
+    os << "  " << obj.write();
+    first = false;
+}
+
+void benchmark::JsonPrinter::Footer(std::ostream& os)
+{
+    os << "\n]}\n";
+}
+
+int benchmark::CompareWithBaseline(const std::vector<Result>& results, const std::string& baselineJson,
+                                   double thresholdPercent, std::ostream& os)
+{
+    UniValue baseline;
+    if (!baseline.read(baselineJson) || !baseline.isObject() || !find_value(baseline, "benchmarks").isArray()) {
+        return -1;
+    }
+
+    std::map<std::string, double> mapBaseline;
+    for (const UniValue& entry : find_value(baseline, "benchmarks").getValues()) {
+        const UniValue& name = find_value(entry, "name");
+        const UniValue& median = find_value(entry, "median_ns");
+        if (!name.isStr() || !median.isNum()) return -1;
+        mapBaseline[name.get_str()] = median.get_real();
+    }
+
+    int regressions = 0;
+    os << "#Benchmark,baseline_median_ns,median_ns,change_percent,status\n";
+    for (const Result& result : results) {
+        auto it = mapBaseline.find(result.name);
+        if (it == mapBaseline.end()) {
+            os << std::fixed << std::setprecision(3) << result.name << ",," << result.medianNs << ",,new\n";
+            continue;
+        }
+        double change = it->second > 0 ? (result.medianNs / it->second - 1) * 100 : 0;
+        const char* status = "ok";
+        if (change > thresholdPercent) {
+            status = "REGRESSION";
+            regressions++;
+        } else if (change < -thresholdPercent) {
+            status = "improved";
+        }
+        os << std::fixed << std::setprecision(3) << result.name << "," << it->second << "," << result.medianNs << ","
+           << std::setprecision(1) << change << "," << status << "\n";
+    }
+    os << "# " << regressions << " regression(s) above " << thresholdPercent << "%\n";
+    return regressions;
 }
@@ -5,8 +5,12 @@
 #ifndef BITCOIN_BENCH_BENCH_H
 #define BITCOIN_BENCH_BENCH_H
 
+#include <limits>
 #include <map>
+#include <ostream>
+#include <stdint.h>
 #include <string>
+#include <vector>
 
 #include <boost/function.hpp>
 #include <boost/preprocessor/cat.hpp>
@@ -36,9 +40,22 @@ BENCHMARK(CODE_TO_TIME);
  
 namespace benchmark {
 
+    /** Timings of one benchmark, all per iteration */
+    struct Result {
+        std::string name;
+        uint64_t count;
+        // wall clock time in nanoseconds, the percentiles are taken over the timed windows
+        double minNs, maxNs, averageNs, medianNs, p90Ns, p99Ns;
+        uint64_t minCycles, maxCycles, averageCycles;
+
+        Result() : count(0), minNs(0), maxNs(0), averageNs(0), medianNs(0), p90Ns(0), p99Ns(0),
+                   minCycles(0), maxCycles(0), averageCycles(0) {}
+    };
+
     class State {
         std::string name;
         double maxElapsed;
+        uint64_t maxCount;
         double beginTime;
         double lastTime, minTime, maxTime, countMaskInv;
         uint64_t count;
@@ -47,8 +64,16 @@ namespace benchmark {
         uint64_t lastCycles;
         uint64_t minCycles;
         uint64_t maxCycles;
+        // time per iteration of every timed window
+        std::vector<double> samples;
+        bool finished;
+        Result result;
+
+        void Finish(double now, uint64_t nowCycles);
     public:
-        State(std::string _name, double _maxElapsed) : name(_name), maxElapsed(_maxElapsed), count(0) {
+        /** Runs for maxElapsed seconds, or for at least _maxCount iterations if that is not 0 */
+        State(std::string _name, double _maxElapsed, uint64_t _maxCount = 0) :
+            name(_name), maxElapsed(_maxElapsed), maxCount(_maxCount), count(0), finished(false) {
             minTime = std::numeric_limits<double>::max();
             maxTime = std::numeric_limits<double>::min();
             minCycles = std::numeric_limits<uint64_t>::max();
@@ -57,10 +82,43 @@ namespace benchmark {
             countMaskInv = 1./(countMask + 1);
         }
         bool KeepRunning();
+
+        /** Whether the benchmark ran until KeepRunning() returned false */
+        bool IsFinished() const { return finished; }
+        const Result& GetResult() const { return result; }
     };
 
     typedef boost::function<void(State&)> BenchFunction;
 
+    /** Writes the results of a run, Header() and Footer() are called once around all Print() calls */
+    class Printer
+    {
+    public:
+        virtual ~Printer() {}
+        virtual void Header(std::ostream& os) = 0;
+        virtual void Print(std::ostream& os, const Result& result) = 0;
+        virtual void Footer(std::ostream& os) = 0;
+    };
+
+    class CsvPrinter : public Printer
+    {
+    public:
+        void Header(std::ostream& os) override;
+        void Print(std::ostream& os, const Result& result) override;
+        void Footer(std::ostream& os) override {}
+    };
+
+    /** The output of this printer is what -compare expects as baseline */
+    class JsonPrinter : public Printer
+    {
+        bool first;
+    public:
+        JsonPrinter() : first(true) {}
+        void Header(std::ostream& os) override;
+        void Print(std::ostream& os, const Result& result) override;
+        void Footer(std::ostream& os) override;
+    };
+
     class BenchRunner
     {
         typedef std::map<std::string, BenchFunction> BenchmarkMap;
@@ -69,8 +127,24 @@ namespace benchmark {
     public:
         BenchRunner(std::string name, BenchFunction func);
 
-        static void RunAll(double elapsedTimeForOne=1.0);
+        /** Names of all benchmarks matching the (ECMAScript) regular expression filter */
+        static std::vector<std::string> List(const std::string& filter);
+
+        /**
+         * Runs all benchmarks matching filter, each for elapsedTimeForOne seconds or for at least
+         * countForOne iterations if that is not 0. Results are written to os as they come in.
+         */
+        static std::vector<Result> RunAll(Printer& printer, std::ostream& os, double elapsedTimeForOne = 1.0,
+                                          const std::string& filter = ".*", uint64_t countForOne = 0);
     };
+
+    /**
+     * Compares the median time of every result with the same benchmark in a baseline written by
+     * JsonPrinter and writes a report to os. A benchmark regressed if it got slower by more than
+     * thresholdPercent. Returns the number of regressions, or -1 if the baseline can't be parsed.
+     */
+    int CompareWithBaseline(const std::vector<Result>& results, const std::string& baselineJson,
+                            double thresholdPercent, std::ostream& os);
 }
 
 // BENCHMARK(foo) expands to:  benchmark::BenchRunner bench_11foo("foo", foo);
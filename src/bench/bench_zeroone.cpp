@@ -7,12 +7,126 @@
 #include "key.h"
 #include "validation.h"
 #include "util.h"
+#include "utilstrencodings.h"
 
 #include "bls/bls.h"
 
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <regex>
+#include <sstream>
+
 void CleanupBLSTests();
 void CleanupBLSDkgTests();
 
+static const char* DEFAULT_BENCH_FILTER = ".*";
+static const char* DEFAULT_BENCH_PRINTER = "csv";
+static const std::string DEFAULT_BENCH_TIME = "1.0";
+static const std::string DEFAULT_BENCH_THRESHOLD = "10";
+
+static std::string HelpMessage()
+{
+    std::string strUsage = HelpMessageGroup("Options:");
+    strUsage += HelpMessageOpt("-?", "Print this help message and exit");
+    strUsage += HelpMessageOpt("-list", "List the benchmarks matching -filter and exit");
+    strUsage += HelpMessageOpt("-filter=<regex>", strprintf("Only run benchmarks whose name matches the regular expression (default: %s)", DEFAULT_BENCH_FILTER));
+    strUsage += HelpMessageOpt("-time=<n>", strprintf("Run every benchmark for <n> seconds (default: %s)", DEFAULT_BENCH_TIME));
+    strUsage += HelpMessageOpt("-iterations=<n>", "Run every benchmark for at least <n> iterations instead of a fixed time");
+    strUsage += HelpMessageOpt("-printer=<csv|json>", strprintf("Output format of the results (default: %s)", DEFAULT_BENCH_PRINTER));
+    strUsage += HelpMessageOpt("-output=<file>", "Write the results to <file> instead of stdout");
+    strUsage += HelpMessageOpt("-compare=<file>", "Compare the results with a baseline written with -printer=json, exit with 1 if any benchmark regressed");
+    strUsage += HelpMessageOpt("-threshold=<n>", strprintf("Percentage the median time may grow over the baseline before it is a regression (default: %s)", DEFAULT_BENCH_THRESHOLD));
+    return strUsage;
+}
+
+static int RunBenchmarks()
+{
+    if (IsArgSet("-?") || IsArgSet("-h") || IsArgSet("-help")) {
+        std::cout << "Usage:  bench_zeroone [options]\n\n" << HelpMessage();
+        return 0;
+    }
+
+    std::string strFilter = GetArg("-filter", DEFAULT_BENCH_FILTER);
+    try {
+        std::regex reFilter(strFilter);
+    } catch (const std::regex_error& e) {
+        std::cerr << "Error: invalid -filter '" << strFilter << "': " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (IsArgSet("-list")) {
+        for (const std::string& name : benchmark::BenchRunner::List(strFilter)) {
+            std::cout << name << "\n";
+        }
+        return 0;
+    }
+
+    double nTime;
+    double nThreshold;
+    if (!ParseDouble(GetArg("-time", DEFAULT_BENCH_TIME), &nTime) || nTime <= 0) {
+        std::cerr << "Error: invalid -time" << std::endl;
+        return 1;
+    }
+    if (!ParseDouble(GetArg("-threshold", DEFAULT_BENCH_THRESHOLD), &nThreshold) || nThreshold < 0) {
+        std::cerr << "Error: invalid -threshold" << std::endl;
+        return 1;
+    }
+    int64_t nIterations = GetArg("-iterations", (int64_t)0);
+    if (nIterations < 0) {
+        std::cerr << "Error: invalid -iterations" << std::endl;
+        return 1;
+    }
+
+    // read the baseline first, no point in running everything if it is missing
+    bool fCompare = IsArgSet("-compare");
+    std::string strBaseline;
+    if (fCompare) {
+        std::ifstream file(GetArg("-compare", ""));
+        if (!file.is_open()) {
+            std::cerr << "Error: can't open baseline " << GetArg("-compare", "") << std::endl;
+            return 1;
+        }
+        std::stringstream ss;
+        ss << file.rdbuf();
+        strBaseline = ss.str();
+    }
+
+    std::unique_ptr<benchmark::Printer> printer;
+    std::string strPrinter = GetArg("-printer", DEFAULT_BENCH_PRINTER);
+    if (strPrinter == "csv") {
+        printer.reset(new benchmark::CsvPrinter());
+    } else if (strPrinter == "json") {
+        printer.reset(new benchmark::JsonPrinter());
+    } else {
+        std::cerr << "Error: unknown -printer " << strPrinter << std::endl;
+        return 1;
+    }
+
+    // diagnostics of benchmarks go to stderr, only the results are written here
+    std::ofstream fileOutput;
+    if (IsArgSet("-output")) {
+        fileOutput.open(GetArg("-output", ""));
+        if (!fileOutput.is_open()) {
+            std::cerr << "Error: can't open " << GetArg("-output", "") << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& os = fileOutput.is_open() ? fileOutput : std::cout;
+
+    std::vector<benchmark::Result> results = benchmark::BenchRunner::RunAll(*printer, os, nTime, strFilter, nIterations);
+
+    if (fCompare) {
+        int nRegressions = benchmark::CompareWithBaseline(results, strBaseline, nThreshold, std::cerr);
+        if (nRegressions < 0) {
+            std::cerr << "Error: can't parse baseline " << GetArg("-compare", "") << std::endl;
+            return 1;
+        }
+        if (nRegressions > 0) return 1;
+    }
+    return 0;
+}
+
 int
 main(int argc, char** argv)
 {
@@ -21,13 +135,15 @@ main(int argc, char** argv)
 
     BLSInit();
     SetupEnvironment();
+    ParseParameters(argc, argv);
     fPrintToDebugLog = false; // don't want to write to debug.log file
 
-    benchmark::BenchRunner::RunAll();
+    int nRet = RunBenchmarks();
 
     // need to be called before global destructors kick in (PoolAllocator is needed due to many BLSSecretKeys)
     CleanupBLSDkgTests();
     CleanupBLSTests();
 
     ECC_Stop();
+    return nRet;
 }
@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "bench.h"
+#include "crypto/sha256.h"
 #include "util.h"
 #include "validation.h"
 #include "checkqueue.h"
@@ -99,5 +100,58 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
     tg.interrupt_all();
     tg.join_all();
 }
+
+// This Benchmark tests how the CheckQueue scales with the number of threads, using checks
+// which cost about as much as a signature verification. A block of checks is added a few at
+// a time, like ConnectBlock does for small transactions. Without enough cores the numbers
+// only show the overhead of the additional threads.
+static const size_t SCALING_CHECKS = 4000;
+static const size_t SCALING_CHECKS_PER_ADD = 2;
+static void CCheckQueueScaling(benchmark::State& state, int nThreads)
+{
+    struct HashingJob {
+        bool operator()()
+        {
+            unsigned char hash[CSHA256::OUTPUT_SIZE] = {};
+            for (int i = 0; i < 200; i++) {
+                CSHA256().Write(hash, sizeof(hash)).Finalize(hash);
+            }
+            return hash[0] != 0 || hash[1] != 0 || hash[2] != 0 || hash[3] != 0;
+        }
+        void swap(HashingJob& x){};
+    };
+    CCheckQueue<HashingJob> queue {QUEUE_BATCH_SIZE};
+    boost::thread_group tg;
+    // the thread calling Wait() is one of them
+    for (auto x = 0; x < nThreads - 1; ++x) {
+       tg.create_thread([&]{queue.Thread();});
+    }
+    while (state.KeepRunning()) {
+        CCheckQueueControl<HashingJob> control(&queue);
+        for (size_t i = 0; i < SCALING_CHECKS; i += SCALING_CHECKS_PER_ADD) {
+            std::vector<HashingJob> vChecks(SCALING_CHECKS_PER_ADD);
+            control.Add(vChecks);
+        }
+        control.Wait();
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+static void CCheckQueueScaling_1(benchmark::State& state) { CCheckQueueScaling(state, 1); }
+static void CCheckQueueScaling_2(benchmark::State& state) { CCheckQueueScaling(state, 2); }
+static void CCheckQueueScaling_4(benchmark::State& state) { CCheckQueueScaling(state, 4); }
+static void CCheckQueueScaling_8(benchmark::State& state) { CCheckQueueScaling(state, 8); }
+static void CCheckQueueScaling_16(benchmark::State& state) { CCheckQueueScaling(state, 16); }
+static void CCheckQueueScaling_32(benchmark::State& state) { CCheckQueueScaling(state, 32); }
+static void CCheckQueueScaling_64(benchmark::State& state) { CCheckQueueScaling(state, 64); }
+
 BENCHMARK(CCheckQueueSpeed);
 BENCHMARK(CCheckQueueSpeedPrevectorJob);
+BENCHMARK(CCheckQueueScaling_1);
+BENCHMARK(CCheckQueueScaling_2);
+BENCHMARK(CCheckQueueScaling_4);
+BENCHMARK(CCheckQueueScaling_8);
+BENCHMARK(CCheckQueueScaling_16);
+BENCHMARK(CCheckQueueScaling_32);
+BENCHMARK(CCheckQueueScaling_64);
@@ -0,0 +1,64 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "hash.h"
+#include "random.h"
+
+#include "evo/deterministicmns.h"
+
+static const size_t QUORUM_SIZE = 50;
+
+static CDeterministicMNList BuildMNList(size_t nCount)
+{
+    FastRandomContext insecure_rand(true);
+
+    CDeterministicMNList mnList(uint256(), 1000);
+    for (size_t i = 0; i < nCount; i++) {
+        auto dmn = std::make_shared<CDeterministicMN>();
+        dmn->proTxHash = GetRandHash();
+        dmn->collateralOutpoint = COutPoint(GetRandHash(), 0);
+        dmn->nOperatorReward = 0;
+
+        auto dmnState = std::make_shared<CDeterministicMNState>();
+        dmnState->nRegisteredHeight = insecure_rand(1000);
+        dmnState->nLastPaidHeight = insecure_rand(1000);
+        dmnState->keyIDOwner = CKeyID(Hash160(dmn->proTxHash.begin(), dmn->proTxHash.end()));
+        dmnState->UpdateConfirmedHash(dmn->proTxHash, GetRandHash());
+        dmn->pdmnState = dmnState;
+
+        mnList.AddMN(dmn);
+    }
+    return mnList;
+}
+
+static void CalculateQuorum(benchmark::State& state, size_t nCount)
+{
+    CDeterministicMNList mnList = BuildMNList(nCount);
+    uint256 modifier;
+    while (state.KeepRunning()) {
+        modifier = ::SerializeHash(modifier);
+        mnList.CalculateQuorum(QUORUM_SIZE, modifier);
+    }
+}
+
+static void GetProjectedMNPayees(benchmark::State& state, size_t nCount)
+{
+    CDeterministicMNList mnList = BuildMNList(nCount);
+    while (state.KeepRunning()) {
+        mnList.GetProjectedMNPayees(nCount);
+    }
+}
+
+static void DMN_CalculateQuorum_1000(benchmark::State& state) { CalculateQuorum(state, 1000); }
+static void DMN_CalculateQuorum_10000(benchmark::State& state) { CalculateQuorum(state, 10000); }
+static void DMN_CalculateQuorum_50000(benchmark::State& state) { CalculateQuorum(state, 50000); }
+static void DMN_GetProjectedMNPayees_1000(benchmark::State& state) { GetProjectedMNPayees(state, 1000); }
+static void DMN_GetProjectedMNPayees_10000(benchmark::State& state) { GetProjectedMNPayees(state, 10000); }
+
+BENCHMARK(DMN_CalculateQuorum_1000);
+BENCHMARK(DMN_CalculateQuorum_10000);
+BENCHMARK(DMN_CalculateQuorum_50000);
+BENCHMARK(DMN_GetProjectedMNPayees_1000);
+BENCHMARK(DMN_GetProjectedMNPayees_10000);
@@ -0,0 +1,98 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "bloom.h"
+#include "governance-object.h"
+#include "hash.h"
+#include "iblt.h"
+#include "random.h"
+#include "streams.h"
+
+#include <iostream>
+
+// mainnet consensus.nGovernanceFilterElements
+static const unsigned int FILTER_ELEMENTS = 20000;
+// a vote inventory entry on the wire
+static const size_t INV_SIZE = 36;
+
+// The requesting node knows all but nMissing of the nVotes votes the other node has for an object.
+// Both benchmarks time one full round (building the request and selecting the votes to announce)
+// and print the bytes on the wire for the request and the announced votes to stderr, which keeps
+// the results on stdout machine readable.
+
+static void GovernanceSyncBloom(benchmark::State& state, size_t nVotes, size_t nMissing)
+{
+    std::vector<uint256> vecVotes(nVotes);
+    for (auto& hash : vecVotes) {
+        hash = GetRandHash();
+    }
+
+    size_t nRequestBytes = 0;
+    size_t nAnnounced = 0;
+    while (state.KeepRunning()) {
+        CBloomFilter filter(FILTER_ELEMENTS, GOVERNANCE_FILTER_FP_RATE, GetRandInt(999999), BLOOM_UPDATE_ALL);
+        for (size_t i = nMissing; i < nVotes; i++) {
+            filter.insert(vecVotes[i]);
+        }
+        nRequestBytes = ::GetSerializeSize(filter, SER_NETWORK, PROTOCOL_VERSION);
+
+        nAnnounced = 0;
+        for (const auto& hash : vecVotes) {
+            if (!filter.contains(hash)) {
+                nAnnounced++;
+            }
+        }
+    }
+    std::cerr << "# bloom  votes=" << nVotes << " missing=" << nMissing << " request=" << nRequestBytes
+              << " announced=" << nAnnounced << " (" << nAnnounced * INV_SIZE << " bytes)\n";
+}
+
+static void GovernanceSyncSketch(benchmark::State& state, size_t nVotes, size_t nMissing)
+{
+    std::vector<uint256> vecVotes(nVotes);
+    for (auto& hash : vecVotes) {
+        hash = GetRandHash();
+    }
+
+    size_t nRequestBytes = 0;
+    size_t nAnnounced = 0;
+    bool fDecoded = false;
+    while (state.KeepRunning()) {
+        uint64_t nSalt0 = GetRand(std::numeric_limits<uint64_t>::max());
+        uint64_t nSalt1 = GetRand(std::numeric_limits<uint64_t>::max());
+        // same sizing as CGovernanceManager::RequestGovernanceObjectBySketch
+        size_t nExpectedDiff = std::max(GOVERNANCE_RECON_MIN_DIFF, (nVotes - nMissing) / GOVERNANCE_RECON_DIFF_RATIO);
+        CIBLT sketch(std::min(nExpectedDiff * 2, GOVERNANCE_RECON_MAX_CELLS));
+        for (size_t i = nMissing; i < nVotes; i++) {
+            sketch.Insert(SipHashUint256(nSalt0, nSalt1, vecVotes[i]));
+        }
+        nRequestBytes = ::GetSerializeSize(sketch, SER_NETWORK, PROTOCOL_VERSION) + 32 + 16;
+
+        for (const auto& hash : vecVotes) {
+            sketch.Erase(SipHashUint256(nSalt0, nSalt1, hash));
+        }
+        std::set<uint64_t> setPeerOnly;
+        std::set<uint64_t> setOursOnly;
+        fDecoded = sketch.Decode(setPeerOnly, setOursOnly);
+        nAnnounced = setOursOnly.size();
+    }
+    std::cerr << "# sketch votes=" << nVotes << " missing=" << nMissing << " request=" << nRequestBytes
+              << " announced=" << nAnnounced << " (" << nAnnounced * INV_SIZE << " bytes)"
+              << (fDecoded ? "" : " decode failed, falls back to bloom") << "\n";
+}
+
+static void GovernanceSync_Bloom_1000_10(benchmark::State& state) { GovernanceSyncBloom(state, 1000, 10); }
+static void GovernanceSync_Bloom_20000_200(benchmark::State& state) { GovernanceSyncBloom(state, 20000, 200); }
+static void GovernanceSync_Bloom_100000_1000(benchmark::State& state) { GovernanceSyncBloom(state, 100000, 1000); }
+static void GovernanceSync_Sketch_1000_10(benchmark::State& state) { GovernanceSyncSketch(state, 1000, 10); }
+static void GovernanceSync_Sketch_20000_200(benchmark::State& state) { GovernanceSyncSketch(state, 20000, 200); }
+static void GovernanceSync_Sketch_100000_1000(benchmark::State& state) { GovernanceSyncSketch(state, 100000, 1000); }
+
+BENCHMARK(GovernanceSync_Bloom_1000_10);
+BENCHMARK(GovernanceSync_Bloom_20000_200);
+BENCHMARK(GovernanceSync_Bloom_100000_1000);
+BENCHMARK(GovernanceSync_Sketch_1000_10);
+BENCHMARK(GovernanceSync_Sketch_20000_200);
+BENCHMARK(GovernanceSync_Sketch_100000_1000);
@@ -0,0 +1,78 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "bench/masternode_setup.h"
+#include "base58.h"
+#include "governance.h"
+#include "governance-classes.h"
+#include "governance-vote.h"
+#include "masternodeman.h"
+#include "streams.h"
+#include "timedata.h"
+#include "utilstrencodings.h"
+
+#include <univalue.h>
+
+// one vote of every masternode
+static const size_t VOTE_COUNT = 1000;
+
+// One iteration handles one incoming vote for a known object with CGovernanceManager::ProcessVoteAndRelay(),
+// after deserializing it: dedup, masternode lookup, signature check and storing it with the object
+// and the masternode. The object is a trigger, which needs no collateral transaction. The votes of
+// all masternodes are used up after VOTE_COUNT iterations, then governance starts over with a fresh
+// copy of the object.
+static void GovernanceVote_Process(benchmark::State& state)
+{
+    CMasternodeBenchSetup setup(VOTE_COUNT, 100);
+
+    int nLastSuperblock, nNextSuperblock;
+    CSuperblock::GetNearestSuperblocksHeights(chainActive.Height(), nLastSuperblock, nNextSuperblock);
+    UniValue objData(UniValue::VOBJ);
+    objData.push_back(Pair("type", GOVERNANCE_OBJECT_TRIGGER));
+    objData.push_back(Pair("event_block_height", nNextSuperblock));
+    objData.push_back(Pair("payment_addresses", CBitcoinAddress(setup.vecKeys[0].GetPubKey().GetID()).ToString()));
+    objData.push_back(Pair("payment_amounts", "1"));
+    std::string strData = objData.write();
+
+    CGovernanceObject govobj(uint256(), 1, GetAdjustedTime(), uint256(), HexStr(strData.begin(), strData.end()));
+    govobj.SetMasternodeOutpoint(setup.vecOutpoints[0]);
+    bool fSigned = govobj.Sign(setup.vecKeys[0], setup.vecKeys[0].GetPubKey().GetID());
+    assert(fSigned);
+    uint256 nHash = govobj.GetHash();
+
+    std::vector<CDataStream> vecMessages;
+    for (size_t i = 0; i < VOTE_COUNT; i++) {
+        CGovernanceVote vote(setup.vecOutpoints[i], nHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES);
+        fSigned = vote.Sign(setup.vecKeys[i], setup.vecKeys[i].GetPubKey().GetID());
+        assert(fSigned);
+        vecMessages.emplace_back(SER_NETWORK, PROTOCOL_VERSION);
+        vecMessages.back() << vote;
+    }
+
+    size_t i = VOTE_COUNT;
+    while (state.KeepRunning()) {
+        if (i == VOTE_COUNT) {
+            // the cleanup drops the trigger, so that the same object can be added again
+            governance.Clear();
+            governance.UpdateCachesAndClean();
+            CGovernanceObject govobjCopy(govobj);
+            governance.AddGovernanceObject(govobjCopy, *setup.connman);
+            assert(governance.HaveObjectForHash(nHash));
+            i = 0;
+        }
+        CDataStream ss(vecMessages[i]);
+        CGovernanceVote vote;
+        ss >> vote;
+        CGovernanceException exception;
+        bool fProcessed = governance.ProcessVoteAndRelay(vote, exception, *setup.connman);
+        assert(fProcessed);
+        i++;
+    }
+
+    governance.Clear();
+    governance.UpdateCachesAndClean();
+}
+
+BENCHMARK(GovernanceVote_Process);
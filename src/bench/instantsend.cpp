@@ -0,0 +1,87 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "bench/masternode_setup.h"
+#include "activemasternode.h"
+#include "chainparams.h"
+#include "instantx.h"
+#include "masternode-payments.h"
+#include "masternodeman.h"
+#include "protocol.h"
+#include "random.h"
+#include "streams.h"
+#include "validation.h"
+
+#include <algorithm>
+
+static const size_t MASTERNODE_COUNT = 1000;
+static const int LOCK_INPUTS = 4;
+
+// One iteration locks a transaction with LOCK_INPUTS inputs: the lock request goes through
+// CInstantSend::ProcessTxLockRequest(), then all SIGNATURES_TOTAL votes for every input arrive as
+// TXLOCKVOTE messages through CInstantSend::ProcessMessage(), i.e. they are deserialized, deduplicated,
+// checked against the rank of their masternode in the legacy list, verified and counted until the
+// lock is complete. All state of the previous iteration is cleared first.
+static void InstantSend_VoteHandling(benchmark::State& state)
+{
+    CMasternodeBenchSetup setup(MASTERNODE_COUNT, 100);
+
+    // inputs are confirmed just enough to be locked
+    int nConfirmationsRequired = Params().GetConsensus().nInstantSendConfirmationsRequired;
+    int nCoinHeight = chainActive.Height() - nConfirmationsRequired + 1;
+    CMutableTransaction mtx;
+    for (int i = 0; i < LOCK_INPUTS; i++) {
+        COutPoint outpoint(GetRandHash(), 0);
+        setup.AddCoin(outpoint, COIN, nCoinHeight);
+        mtx.vin.emplace_back(outpoint);
+    }
+    mtx.vout.emplace_back(LOCK_INPUTS * COIN - COIN / 100, CScript() << OP_TRUE);
+    CTxLockRequest txLockRequest(mtx);
+    uint256 txHash = txLockRequest.GetHash();
+
+    // same quorum as the one CTxLockVote::IsValid() expects
+    int nLockInputHeight = nCoinHeight + nConfirmationsRequired - 2;
+    int nMinProtocol = std::max(MIN_INSTANTSEND_PROTO_VERSION, mnpayments.GetMinMasternodePaymentsProto());
+    CMasternodeMan::rank_pair_vec_t vecRanks;
+    bool fRanked = mnodeman.GetMasternodeRanks(vecRanks, nLockInputHeight, nMinProtocol);
+    assert(fRanked);
+
+    std::vector<CDataStream> vecMessages;
+    for (const auto& rankPair : vecRanks) {
+        if (rankPair.first > COutPointLock::SIGNATURES_TOTAL) continue;
+        const COutPoint& outpointMasternode = rankPair.second.outpoint;
+        activeMasternodeInfo.legacyKeyOperator = setup.GetKey(outpointMasternode);
+        activeMasternodeInfo.legacyKeyIDOperator = activeMasternodeInfo.legacyKeyOperator.GetPubKey().GetID();
+        for (const auto& txin : mtx.vin) {
+            CTxLockVote vote(txHash, txin.prevout, outpointMasternode, uint256(), uint256());
+            bool fSigned = vote.Sign();
+            assert(fSigned);
+            vecMessages.emplace_back(SER_NETWORK, PROTOCOL_VERSION);
+            vecMessages.back() << vote;
+        }
+    }
+    activeMasternodeInfo.legacyKeyOperator = CKey();
+    activeMasternodeInfo.legacyKeyIDOperator = CKeyID();
+    assert(vecMessages.size() == size_t(LOCK_INPUTS * COutPointLock::SIGNATURES_TOTAL));
+
+    CNode node(0, NODE_NETWORK, 0, INVALID_SOCKET, CAddress(CService(), NODE_NETWORK), 0, 0, "", true);
+    node.nVersion = PROTOCOL_VERSION;
+
+    while (state.KeepRunning()) {
+        instantsend.Clear();
+        bool fAccepted = instantsend.ProcessTxLockRequest(txLockRequest, *setup.connman);
+        assert(fAccepted);
+
+        for (const auto& message : vecMessages) {
+            CDataStream ss(message);
+            instantsend.ProcessMessage(&node, NetMsgType::TXLOCKVOTE, ss, *setup.connman);
+        }
+        assert(instantsend.IsLockedInstantSendTransaction(txHash));
+    }
+
+    instantsend.Clear();
+}
+
+BENCHMARK(InstantSend_VoteHandling);
@@ -0,0 +1,31 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "bench/masternode_setup.h"
+#include "masternodeman.h"
+
+static const int BLOCK_COUNT = 1000;
+
+// One rank lookup of the legacy masternode list as done for every InstantSend vote and PoSe check:
+// CMasternodeMan::GetMasternodeRank() scores and sorts all masternodes for the block hash at the
+// requested height, which is a different one every time.
+static void MasternodeRanking(benchmark::State& state, size_t nCount)
+{
+    CMasternodeBenchSetup setup(nCount, BLOCK_COUNT);
+
+    int nHeight = 0;
+    int nRank;
+    while (state.KeepRunning()) {
+        nHeight = (nHeight + 1) % BLOCK_COUNT;
+        bool fFound = mnodeman.GetMasternodeRank(setup.vecOutpoints[0], nRank, nHeight);
+        assert(fFound);
+    }
+}
+
+static void MasternodeRanking_1000(benchmark::State& state) { MasternodeRanking(state, 1000); }
+static void MasternodeRanking_5000(benchmark::State& state) { MasternodeRanking(state, 5000); }
+
+BENCHMARK(MasternodeRanking_1000);
+BENCHMARK(MasternodeRanking_5000);
@@ -0,0 +1,90 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench/masternode_setup.h"
+
+#include "chainparams.h"
+#include "masternode-sync.h"
+#include "masternodeman.h"
+#include "netbase.h"
+#include "random.h"
+#include "tinyformat.h"
+#include "validation.h"
+
+#include "evo/deterministicmns.h"
+#include "evo/evodb.h"
+
+#include <algorithm>
+#include <assert.h>
+
+CMasternodeBenchSetup::CMasternodeBenchSetup(size_t nMasternodes, int nHeight)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+
+    evoDb.reset(new CEvoDB(1 << 20, true, true));
+    deterministicMNManager = new CDeterministicMNManager(*evoDb);
+    connman.reset(new CConnman(0x1337, 0x1337));
+
+    vecBlockHashes.resize(nHeight + 1);
+    vecBlocks.resize(nHeight + 1);
+    for (int i = 0; i <= nHeight; i++) {
+        vecBlockHashes[i] = GetRandHash();
+        CBlockIndex& index = vecBlocks[i];
+        index.phashBlock = &vecBlockHashes[i];
+        index.pprev = i > 0 ? &vecBlocks[i - 1] : nullptr;
+        index.nHeight = i;
+        index.BuildSkip();
+    }
+    coins.reset(new CCoinsViewCache(&coinsDummy));
+    {
+        LOCK(cs_main);
+        chainActive.SetTip(&vecBlocks.back());
+        pcoinsTip = coins.get();
+    }
+
+    // legacy list, the DIP3 spork is off
+    for (size_t i = 0; i < nMasternodes; i++) {
+        CKey key;
+        key.MakeNewKey(true);
+        COutPoint outpoint(GetRandHash(), 0);
+        CService addr = LookupNumeric(strprintf("10.%d.%d.%d", (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff).c_str(), Params().GetDefaultPort());
+        CMasternode mn(addr, outpoint, key.GetPubKey(), key.GetPubKey(), PROTOCOL_VERSION);
+        bool fAdded = mnodeman.Add(mn);
+        assert(fAdded);
+        vecKeys.push_back(key);
+        vecOutpoints.push_back(outpoint);
+    }
+
+    // initial -> waiting -> list -> payments, nothing in between needs the network
+    masternodeSync.Reset();
+    while (!masternodeSync.IsMasternodeListSynced()) {
+        masternodeSync.SwitchToNextAsset(*connman);
+    }
+}
+
+CMasternodeBenchSetup::~CMasternodeBenchSetup()
+{
+    masternodeSync.Reset();
+    mnodeman.Clear();
+    {
+        LOCK(cs_main);
+        pcoinsTip = nullptr;
+        chainActive.SetTip(nullptr);
+    }
+    connman.reset();
+    delete deterministicMNManager;
+    deterministicMNManager = nullptr;
+}
+
+void CMasternodeBenchSetup::AddCoin(const COutPoint& outpoint, CAmount nValue, int nHeight)
+{
+    LOCK(cs_main);
+    coins->AddCoin(outpoint, Coin(CTxOut(nValue, CScript() << OP_TRUE), nHeight, false), false);
+}
+
+const CKey& CMasternodeBenchSetup::GetKey(const COutPoint& outpoint) const
+{
+    auto it = std::find(vecOutpoints.begin(), vecOutpoints.end(), outpoint);
+    return vecKeys.at(it - vecOutpoints.begin());
+}
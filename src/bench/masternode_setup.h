@@ -0,0 +1,47 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BENCH_MASTERNODE_SETUP_H
+#define BITCOIN_BENCH_MASTERNODE_SETUP_H
+
+#include "amount.h"
+#include "chain.h"
+#include "coins.h"
+#include "key.h"
+#include "net.h"
+
+#include <memory>
+#include <vector>
+
+class CEvoDB;
+
+/**
+ * Global state the masternode benchmarks run against, so that they can use the real entry points:
+ * regtest parameters, a chain of nHeight empty blocks in chainActive, an in-memory pcoinsTip,
+ * nMasternodes legacy masternodes in mnodeman and masternodeSync past the masternode list.
+ * The destructor resets all of it.
+ */
+class CMasternodeBenchSetup
+{
+public:
+    CMasternodeBenchSetup(size_t nMasternodes, int nHeight);
+    ~CMasternodeBenchSetup();
+
+    std::unique_ptr<CConnman> connman;
+    // operator keys, same order as vecOutpoints
+    std::vector<CKey> vecKeys;
+    std::vector<COutPoint> vecOutpoints;
+
+    void AddCoin(const COutPoint& outpoint, CAmount nValue, int nHeight);
+    const CKey& GetKey(const COutPoint& outpoint) const;
+
+private:
+    std::unique_ptr<CEvoDB> evoDb;
+    std::vector<uint256> vecBlockHashes;
+    std::vector<CBlockIndex> vecBlocks;
+    CCoinsView coinsDummy;
+    std::unique_ptr<CCoinsViewCache> coins;
+};
+
+#endif // BITCOIN_BENCH_MASTERNODE_SETUP_H
@@ -0,0 +1,32 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "arith_uint256.h"
+#include "primitives/block.h"
+#include "random.h"
+
+// What a miner or a node checking headers does for every header: hash it with NeoScrypt
+// and compare the result with the target.
+static void NeoScrypt_BlockHeader(benchmark::State& state)
+{
+    CBlockHeader header;
+    header.nVersion = 0x20000000;
+    header.hashPrevBlock = GetRandHash();
+    header.hashMerkleRoot = GetRandHash();
+    header.nTime = 1546300800;
+    header.nBits = 0x1e0ffff0;
+    header.nNonce = 0;
+
+    arith_uint256 target;
+    target.SetCompact(header.nBits);
+    bool fFound = false;
+    while (state.KeepRunning()) {
+        header.nNonce++;
+        fFound |= UintToArith256(header.GetHash()) <= target;
+    }
+    (void)fFound;
+}
+
+BENCHMARK(NeoScrypt_BlockHeader);
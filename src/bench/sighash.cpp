@@ -0,0 +1,61 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "pubkey.h"
+#include "random.h"
+#include "script/interpreter.h"
+#include "script/standard.h"
+
+// Signature hashes of all inputs of a P2PKH spending transaction, one iteration covers the whole
+// transaction just like CheckInputs does. The cached variants include building the cache.
+
+static CTransaction BuildSpend(size_t nInputs)
+{
+    CMutableTransaction mtx;
+    mtx.vin.resize(nInputs);
+    for (auto& txin : mtx.vin) {
+        txin.prevout = COutPoint(GetRandHash(), 0);
+        // typical signature and compressed pubkey sizes
+        txin.scriptSig << std::vector<unsigned char>(72, 0x30) << std::vector<unsigned char>(33, 0x02);
+    }
+    mtx.vout.resize(2);
+    for (auto& txout : mtx.vout) {
+        txout.nValue = COIN;
+        txout.scriptPubKey = GetScriptForDestination(CKeyID(uint160(std::vector<unsigned char>(20, 0x01))));
+    }
+    return CTransaction(mtx);
+}
+
+static void SignatureHashAll(benchmark::State& state, size_t nInputs, bool fCache)
+{
+    const CTransaction tx = BuildSpend(nInputs);
+    const CScript scriptCode = GetScriptForDestination(CKeyID(uint160(std::vector<unsigned char>(20, 0x02))));
+    while (state.KeepRunning()) {
+        if (fCache) {
+            const PrecomputedTransactionData txdata(tx);
+            for (size_t i = 0; i < nInputs; i++) {
+                SignatureHash(scriptCode, tx, i, SIGHASH_ALL, &txdata);
+            }
+        } else {
+            for (size_t i = 0; i < nInputs; i++) {
+                SignatureHash(scriptCode, tx, i, SIGHASH_ALL);
+            }
+        }
+    }
+}
+
+static void SignatureHash_100(benchmark::State& state) { SignatureHashAll(state, 100, false); }
+static void SignatureHash_500(benchmark::State& state) { SignatureHashAll(state, 500, false); }
+static void SignatureHash_2000(benchmark::State& state) { SignatureHashAll(state, 2000, false); }
+static void SignatureHash_Cached_100(benchmark::State& state) { SignatureHashAll(state, 100, true); }
+static void SignatureHash_Cached_500(benchmark::State& state) { SignatureHashAll(state, 500, true); }
+static void SignatureHash_Cached_2000(benchmark::State& state) { SignatureHashAll(state, 2000, true); }
+
+BENCHMARK(SignatureHash_100);
+BENCHMARK(SignatureHash_500);
+BENCHMARK(SignatureHash_2000);
+BENCHMARK(SignatureHash_Cached_100);
+BENCHMARK(SignatureHash_Cached_500);
+BENCHMARK(SignatureHash_Cached_2000);
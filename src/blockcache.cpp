@@ -0,0 +1,271 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockcache.h"
+
+#include "clientversion.h"
+#include "core_memusage.h"
+#include "crypto/common.h"
+#include "memusage.h"
+#include "serialize.h"
+#include "util.h"
+
+#include <errno.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+CBlockCache blockCache;
+
+namespace {
+
+/** Deserializes from memory without copying it first */
+class CMemoryReader
+{
+private:
+    const int nType;
+    const int nVersion;
+    const unsigned char* pbegin;
+    const unsigned char* pend;
+
+public:
+    CMemoryReader(int nTypeIn, int nVersionIn, const unsigned char* pbeginIn, const unsigned char* pendIn) :
+        nType(nTypeIn), nVersion(nVersionIn), pbegin(pbeginIn), pend(pendIn) {}
+
+    int GetType() const { return nType; }
+    int GetVersion() const { return nVersion; }
+
+    void read(char* pch, size_t nSize)
+    {
+        if (nSize > (size_t)(pend - pbegin)) {
+            throw std::ios_base::failure("CMemoryReader::read(): end of data");
+        }
+        memcpy(pch, pbegin, nSize);
+        pbegin += nSize;
+    }
+
+    template<typename T>
+    CMemoryReader& operator>>(T& obj)
+    {
+        ::Unserialize(*this, obj);
+        return *this;
+    }
+};
+
+} // namespace
+
+CMappedBlockFile::~CMappedBlockFile()
+{
+#ifndef WIN32
+    munmap((void*)pdata, nSize);
+#endif
+}
+
+std::shared_ptr<CMappedBlockFile> CMappedBlockFile::Map(const boost::filesystem::path& path, size_t nSizeIn)
+{
+#ifndef WIN32
+    if (nSizeIn == 0) return nullptr;
+
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd == -1) {
+        LogPrintf("%s: Unable to open file %s\n", __func__, path.string());
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < nSizeIn) {
+        // truncated or still being written, reading it through the file is safer
+        close(fd);
+        return nullptr;
+    }
+    void* p = mmap(nullptr, nSizeIn, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping stays valid after closing the file descriptor
+    close(fd);
+    if (p == MAP_FAILED) {
+        LogPrintf("%s: Unable to map file %s: %s\n", __func__, path.string(), strerror(errno));
+        return nullptr;
+    }
+    // blocks are looked up all over the file
+    madvise(p, nSizeIn, MADV_RANDOM);
+    return std::shared_ptr<CMappedBlockFile>(new CMappedBlockFile((const unsigned char*)p, nSizeIn));
+#else
+    return nullptr;
+#endif
+}
+
+const unsigned char* CMappedBlockFile::FindBlock(unsigned int nPos, const CMessageHeader::MessageStartChars& messageStart, uint32_t& nBlockSizeRet) const
+{
+    // WriteBlockToDisk puts the message start and the size of the block in front of it
+    if (nPos < CMessageHeader::MESSAGE_START_SIZE + sizeof(uint32_t) || nPos > nSize) return nullptr;
+    const unsigned char* pheader = pdata + nPos - CMessageHeader::MESSAGE_START_SIZE - sizeof(uint32_t);
+    if (memcmp(pheader, messageStart, CMessageHeader::MESSAGE_START_SIZE) != 0) return nullptr;
+    nBlockSizeRet = ReadLE32(pheader + CMessageHeader::MESSAGE_START_SIZE);
+    if (nBlockSizeRet > nSize - nPos) return nullptr;
+    return pdata + nPos;
+}
+
+bool CMappedBlockFile::ReadBlock(unsigned int nPos, const CMessageHeader::MessageStartChars& messageStart, CBlock& block) const
+{
+    uint32_t nBlockSize;
+    const unsigned char* pblock = FindBlock(nPos, messageStart, nBlockSize);
+    if (!pblock) return false;
+
+    CMemoryReader reader(SER_DISK, CLIENT_VERSION, pblock, pblock + nBlockSize);
+    reader >> block;
+    return true;
+}
+
+bool CMappedBlockFile::ReadRawBlock(unsigned int nPos, const CMessageHeader::MessageStartChars& messageStart, std::vector<unsigned char>& vchBlock) const
+{
+    uint32_t nBlockSize;
+    const unsigned char* pblock = FindBlock(nPos, messageStart, nBlockSize);
+    if (!pblock) return false;
+
+    vchBlock.assign(pblock, pblock + nBlockSize);
+    return true;
+}
+
+CBlockCache::CBlockCache() :
+    nUsage(0),
+    nMaxUsage(0),
+    mappedFiles(MAX_MAPPED_BLOCK_FILES),
+    fMmap(false),
+    nHits(0),
+    nMisses(0),
+    nMappedReads(0),
+    nFileReads(0)
+{
+}
+
+void CBlockCache::EvictBlocks(size_t nTargetUsage)
+{
+    AssertLockHeld(cs);
+    while (nUsage > nTargetUsage) {
+        const CCachedBlock& entry = blocks.back();
+        nUsage -= entry.nUsage;
+        mapBlocks.erase(entry.hash);
+        blocks.pop_back();
+    }
+}
+
+void CBlockCache::Init(size_t nMaxUsageIn, bool fMmapIn)
+{
+    LOCK(cs);
+    nMaxUsage = nMaxUsageIn;
+    EvictBlocks(nMaxUsage);
+#ifndef WIN32
+    fMmap = fMmapIn;
+#else
+    fMmap = false;
+#endif
+    mappedFiles.clear();
+}
+
+std::shared_ptr<const CBlock> CBlockCache::Get(const uint256& hash)
+{
+    LOCK(cs);
+    if (nMaxUsage == 0) return nullptr;
+    auto it = mapBlocks.find(hash);
+    if (it == mapBlocks.end()) {
+        nMisses++;
+        return nullptr;
+    }
+    nHits++;
+    blocks.splice(blocks.begin(), blocks, it->second);
+    return it->second->pblock;
+}
+
+bool CBlockCache::Get(const uint256& hash, CBlock& blockRet)
+{
+    std::shared_ptr<const CBlock> pblock = Get(hash);
+    if (!pblock) return false;
+    // copying only copies the header and the transaction pointers
+    blockRet = *pblock;
+    return true;
+}
+
+void CBlockCache::Insert(const uint256& hash, const std::shared_ptr<const CBlock>& pblock)
+{
+    {
+        LOCK(cs);
+        if (nMaxUsage == 0) return;
+    }
+
+    // transactions can be shared with the mempool or other blocks, they are counted nevertheless
+    size_t nBlockUsage = memusage::DynamicUsage(pblock) + RecursiveDynamicUsage(*pblock);
+
+    LOCK(cs);
+    if (nBlockUsage > nMaxUsage) return;
+    auto it = mapBlocks.find(hash);
+    if (it != mapBlocks.end()) {
+        // blocks never change, it only becomes the most recently used one
+        blocks.splice(blocks.begin(), blocks, it->second);
+        return;
+    }
+    EvictBlocks(nMaxUsage - nBlockUsage);
+    blocks.push_front(CCachedBlock{hash, pblock, nBlockUsage});
+    mapBlocks.emplace(hash, blocks.begin());
+    nUsage += nBlockUsage;
+}
+
+void CBlockCache::Clear()
+{
+    LOCK(cs);
+    EvictBlocks(0);
+    mappedFiles.clear();
+}
+
+bool CBlockCache::IsMmapEnabled() const
+{
+    LOCK(cs);
+    return fMmap;
+}
+
+std::shared_ptr<CMappedBlockFile> CBlockCache::GetMappedFile(int nFile, size_t nFileSize, const boost::filesystem::path& path)
+{
+    LOCK(cs);
+    if (!fMmap) return nullptr;
+
+    std::shared_ptr<CMappedBlockFile> file;
+    // a file which was written to again (e.g. while reindexing) has to be mapped again
+    if (mappedFiles.get(nFile, file) && file->GetSize() >= nFileSize) {
+        return file;
+    }
+    file = CMappedBlockFile::Map(path, nFileSize);
+    if (file) {
+        mappedFiles.insert(nFile, file);
+    } else {
+        mappedFiles.erase(nFile);
+    }
+    return file;
+}
+
+void CBlockCache::RecordRead(bool fMapped)
+{
+    LOCK(cs);
+    if (fMapped) {
+        nMappedReads++;
+    } else {
+        nFileReads++;
+    }
+}
+
+CBlockCacheStats CBlockCache::GetStats() const
+{
+    LOCK(cs);
+    CBlockCacheStats stats;
+    stats.nBlocks = blocks.size();
+    stats.nUsage = nUsage;
+    stats.nMaxUsage = nMaxUsage;
+    stats.nHits = nHits;
+    stats.nMisses = nMisses;
+    stats.nMappedFiles = mappedFiles.size();
+    stats.nMappedReads = nMappedReads;
+    stats.nFileReads = nFileReads;
+    return stats;
+}
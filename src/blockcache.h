@@ -0,0 +1,137 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BLOCKCACHE_H
+#define BLOCKCACHE_H
+
+#include "primitives/block.h"
+#include "protocol.h"
+#include "saltedhasher.h"
+#include "sync.h"
+#include "unordered_lru_cache.h"
+
+#include <list>
+#include <memory>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+/** Default for -blockcache, the memory in MiB used by recently read or written blocks */
+static const unsigned int DEFAULT_BLOCK_CACHE_SIZE = 64;
+/** Default for -blockmmap */
+static const bool DEFAULT_BLOCK_MMAP = false;
+/** Maximum number of block files which are mapped at the same time */
+static const size_t MAX_MAPPED_BLOCK_FILES = 8;
+
+struct CBlockCacheStats
+{
+    size_t nBlocks;
+    size_t nUsage;
+    size_t nMaxUsage;
+    uint64_t nHits;
+    uint64_t nMisses;
+    size_t nMappedFiles;
+    uint64_t nMappedReads;
+    uint64_t nFileReads;
+};
+
+/**
+ * Read-only mapping of a block file which isn't written to anymore.
+ * Only the part which was in use when it was mapped is mapped.
+ */
+class CMappedBlockFile
+{
+private:
+    const unsigned char* pdata;
+    size_t nSize;
+
+    CMappedBlockFile(const unsigned char* pdataIn, size_t nSizeIn) : pdata(pdataIn), nSize(nSizeIn) {}
+
+    /** Returns the start of the block stored at nPos and its size, or nullptr if it isn't valid */
+    const unsigned char* FindBlock(unsigned int nPos, const CMessageHeader::MessageStartChars& messageStart, uint32_t& nBlockSizeRet) const;
+
+public:
+    ~CMappedBlockFile();
+    CMappedBlockFile(const CMappedBlockFile&) = delete;
+    CMappedBlockFile& operator=(const CMappedBlockFile&) = delete;
+
+    /** Maps the first nSizeIn bytes of the file, returns nullptr if that fails or isn't supported */
+    static std::shared_ptr<CMappedBlockFile> Map(const boost::filesystem::path& path, size_t nSizeIn);
+
+    size_t GetSize() const { return nSize; }
+
+    /**
+     * Deserializes the block stored at nPos. Returns false if nPos isn't preceded by a valid
+     * index header (see WriteBlockToDisk) or the block doesn't fit into the mapped part, callers
+     * should fall back to reading the file then. Throws if the block can't be deserialized.
+     */
+    bool ReadBlock(unsigned int nPos, const CMessageHeader::MessageStartChars& messageStart, CBlock& block) const;
+    /** Same as ReadBlock, but copies the serialized block */
+    bool ReadRawBlock(unsigned int nPos, const CMessageHeader::MessageStartChars& messageStart, std::vector<unsigned char>& vchBlock) const;
+};
+
+/**
+ * Recently read and written blocks by hash, so that serving the same few blocks to many peers,
+ * explorers and RPC clients doesn't open and parse the block file every time. Blocks on disk never
+ * change, only Clear() has to be called before block files are deleted.
+ * Also keeps the mappings of the most recently used block files if -blockmmap is enabled.
+ */
+class CBlockCache
+{
+private:
+    struct CCachedBlock
+    {
+        uint256 hash;
+        std::shared_ptr<const CBlock> pblock;
+        size_t nUsage;
+    };
+    typedef std::list<CCachedBlock> block_list_t;
+
+    mutable CCriticalSection cs;
+    // most recently used block at the front
+    block_list_t blocks;
+    std::unordered_map<uint256, block_list_t::iterator, StaticSaltedHasher> mapBlocks;
+    size_t nUsage;
+    // 0 if the cache is disabled
+    size_t nMaxUsage;
+    unordered_lru_cache<int, std::shared_ptr<CMappedBlockFile>> mappedFiles;
+    bool fMmap;
+
+    uint64_t nHits;
+    uint64_t nMisses;
+    uint64_t nMappedReads;
+    uint64_t nFileReads;
+
+    /** Drops the least recently used blocks until at most nTargetUsage bytes are used */
+    void EvictBlocks(size_t nTargetUsage);
+
+public:
+    CBlockCache();
+
+    /** nMaxUsageIn is in bytes, 0 disables the cache */
+    void Init(size_t nMaxUsageIn, bool fMmapIn);
+
+    /** Returns the cached block or null */
+    std::shared_ptr<const CBlock> Get(const uint256& hash);
+    bool Get(const uint256& hash, CBlock& blockRet);
+    /**
+     * Evicts the least recently used blocks until pblock fits, blocks larger than the whole cache aren't kept.
+     * hash has to be the hash of pblock, callers know it already and it is expensive to compute.
+     */
+    void Insert(const uint256& hash, const std::shared_ptr<const CBlock>& pblock);
+    void Clear();
+
+    bool IsMmapEnabled() const;
+    /** Returns the mapping of block file nFile, mapping its first nFileSize bytes if it isn't mapped yet */
+    std::shared_ptr<CMappedBlockFile> GetMappedFile(int nFile, size_t nFileSize, const boost::filesystem::path& path);
+    void RecordRead(bool fMapped);
+
+    CBlockCacheStats GetStats() const;
+};
+
+extern CBlockCache blockCache;
+
+#endif // BLOCKCACHE_H
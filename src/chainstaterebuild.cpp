@@ -0,0 +1,196 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainstaterebuild.h"
+
+#include "blockcache.h"
+#include "chain.h"
+#include "coins.h"
+#include "consensus/consensus.h"
+#include "evo/evodb.h"
+#include "txdb.h"
+#include "util.h"
+#include "utiltime.h"
+#include "validation.h"
+
+#include <algorithm>
+#include <functional>
+
+CChainStateRebuild chainStateRebuild;
+
+CChainStateRebuild::CChainStateRebuild() :
+    fActive(false),
+    fInterrupt(false),
+    pcoinsview(nullptr),
+    pconsensus(nullptr),
+    nNextPrefetch(0),
+    nPrefetch(0),
+    nStartHeight(0),
+    nHeight(0),
+    nTargetHeight(0),
+    nStartChainTx(0),
+    nChainTx(0),
+    nTargetChainTx(0),
+    nStartTime(0)
+{
+}
+
+CChainStateRebuild::~CChainStateRebuild()
+{
+    Stop();
+}
+
+void CChainStateRebuild::Start(const CBlockIndex* pindexTip, const CBlockIndex* pindexTarget, const CCoinsView* pcoinsviewIn,
+                               const Consensus::Params& consensus, unsigned int nPrefetchIn, int nThreads)
+{
+    Stop();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    pcoinsview = pcoinsviewIn;
+    pconsensus = &consensus;
+    nStartHeight = nHeight = pindexTip ? pindexTip->nHeight : -1;
+    nStartChainTx = nChainTx = pindexTip ? pindexTip->nChainTx : 0;
+    if (!pindexTarget || pindexTarget->nHeight < nStartHeight) {
+        pindexTarget = pindexTip;
+    }
+    nTargetHeight = pindexTarget ? pindexTarget->nHeight : -1;
+    nTargetChainTx = pindexTarget ? pindexTarget->nChainTx : 0;
+    nStartTime = GetTimeMillis();
+
+    vBlocks.clear();
+    for (const CBlockIndex* pindex = pindexTarget; pindex && pindex->nHeight > nStartHeight; pindex = pindex->pprev) {
+        vBlocks.push_back(pindex);
+    }
+    std::reverse(vBlocks.begin(), vBlocks.end());
+    nNextPrefetch = 0;
+
+    // read blocks are only useful as long as they are still cached when they get connected,
+    // others read from the cache as well, so at most half of it is filled assuming full blocks
+    size_t nMaxUsage = blockCache.GetStats().nMaxUsage;
+    nPrefetch = nMaxUsage > 0 ? std::min<size_t>(nPrefetchIn, nMaxUsage / 2 / MaxBlockSize(true)) : nPrefetchIn;
+    if (nPrefetch == 0 || vBlocks.empty()) {
+        nThreads = 0;
+    }
+
+    LogPrintf("Rebuilding the chain state from height %d to %d, reading up to %u blocks ahead with %d threads\n",
+              nStartHeight, nTargetHeight, nPrefetch, nThreads);
+
+    fInterrupt = false;
+    fActive = true;
+    for (int i = 0; i < nThreads; i++) {
+        threads.emplace_back(&TraceThread<std::function<void()> >, "rebuildpref", std::function<void()>(std::bind(&CChainStateRebuild::ThreadPrefetch, this)));
+    }
+}
+
+void CChainStateRebuild::Stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        fInterrupt = true;
+    }
+    cond.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    vBlocks.clear();
+    pcoinsview = nullptr;
+    fActive = false;
+}
+
+void CChainStateRebuild::UpdatedTip(const CBlockIndex* pindex)
+{
+    if (!fActive) return;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        nHeight = pindex->nHeight;
+        nChainTx = pindex->nChainTx;
+    }
+    cond.notify_all();
+}
+
+bool CChainStateRebuild::GetProgress(CChainStateRebuildProgress& progress)
+{
+    if (!fActive) return false;
+    std::unique_lock<std::mutex> lock(mutex);
+    progress.nStartHeight = nStartHeight;
+    progress.nHeight = nHeight;
+    progress.nTargetHeight = nTargetHeight;
+    progress.dProgress = nTargetChainTx > 0 ? std::min(1.0, (double)nChainTx / nTargetChainTx) : 1.0;
+
+    // transactions rather than blocks are what takes time, so the estimate is based on them
+    double dSeconds = (GetTimeMillis() - nStartTime) / 1000.0;
+    progress.dBlocksPerSecond = dSeconds > 0 ? (nHeight - nStartHeight) / dSeconds : 0;
+    double dTxPerSecond = dSeconds > 0 ? (nChainTx - nStartChainTx) / dSeconds : 0;
+    if (nChainTx >= nTargetChainTx) {
+        progress.nETA = 0;
+    } else if (dTxPerSecond > 0) {
+        progress.nETA = (int64_t)((nTargetChainTx - nChainTx) / dTxPerSecond);
+    } else {
+        progress.nETA = -1;
+    }
+    return true;
+}
+
+void CChainStateRebuild::ThreadPrefetch()
+{
+    while (true) {
+        const CBlockIndex* pindex;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                if (fInterrupt) return;
+                // blocks which were connected in the meantime don't need to be read anymore
+                nNextPrefetch = std::max<size_t>(nNextPrefetch, std::max(nHeight - nStartHeight, 0));
+                if (nNextPrefetch >= vBlocks.size()) return;
+                if (vBlocks[nNextPrefetch]->nHeight <= nHeight + (int)nPrefetch) break;
+                cond.wait(lock);
+            }
+            pindex = vBlocks[nNextPrefetch++];
+        }
+
+        // puts the block into the block cache for ConnectTip
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, *pconsensus)) {
+            continue;
+        }
+        // The coins cache can only be used under cs_main, but the database can be read from any
+        // thread. Looking the inputs up pulls them into the database and OS caches, so that the
+        // coins cache doesn't have to wait for the disk when the block is connected.
+        for (const auto& tx : block.vtx) {
+            if (tx->IsCoinBase()) continue;
+            for (const auto& txin : tx->vin) {
+                pcoinsview->HaveCoin(txin.prevout);
+            }
+        }
+    }
+}
+
+bool CanResumeChainStateRebuild(CBlockTreeDB& blocktree)
+{
+    bool fRebuilding = false;
+    if (!blocktree.ReadFlag("reindexchainstate", fRebuilding) || !fRebuilding) {
+        return false;
+    }
+
+    uint256 hashCoinsBestBlock;
+    uint256 hashEvoBestBlock;
+    {
+        CCoinsViewDB coinsdb(1 << 20);
+        hashCoinsBestBlock = coinsdb.GetBestBlock();
+    }
+    {
+        CEvoDB evodb(1 << 20);
+        evodb.Read(EVODB_BEST_BLOCK, hashEvoBestBlock);
+    }
+    if (hashCoinsBestBlock.IsNull() || hashCoinsBestBlock != hashEvoBestBlock) {
+        // EvoDB is written after every block, the coins only when their cache is flushed
+        LogPrintf("%s: Chain state (%s) and EvoDB (%s) don't match, the node wasn't shut down cleanly\n",
+                  __func__, hashCoinsBestBlock.ToString(), hashEvoBestBlock.ToString());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,101 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef CHAINSTATEREBUILD_H
+#define CHAINSTATEREBUILD_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+class CBlockIndex;
+class CBlockTreeDB;
+class CCoinsView;
+
+namespace Consensus {
+struct Params;
+}
+
+/** Default for -reindexprefetch, the number of blocks read ahead of the tip while the chain state is rebuilt */
+static const unsigned int DEFAULT_REINDEX_PREFETCH = 64;
+/** Maximum number of threads which read ahead */
+static const int MAX_REINDEX_PREFETCH_THREADS = 4;
+
+struct CChainStateRebuildProgress
+{
+    int nStartHeight;
+    int nHeight;
+    int nTargetHeight;
+    // share of the transactions up to the target which are connected
+    double dProgress;
+    double dBlocksPerSecond;
+    // estimated seconds until the target is reached, -1 if unknown
+    int64_t nETA;
+};
+
+/**
+ * Keeps -reindex-chainstate busy. ActivateBestChain still connects the blocks one after another,
+ * but threads read the upcoming blocks into the block cache and look up their inputs in the coins
+ * database ahead of it, so that connecting them doesn't wait for the disk. A rebuild which was
+ * stopped by a clean shutdown continues where it stopped (see CanResumeChainStateRebuild).
+ */
+class CChainStateRebuild
+{
+private:
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::vector<std::thread> threads;
+    std::atomic<bool> fActive;
+    bool fInterrupt;
+
+    const CCoinsView* pcoinsview;
+    const Consensus::Params* pconsensus;
+    // the blocks above the tip the rebuild started from, up to the target
+    std::vector<const CBlockIndex*> vBlocks;
+    size_t nNextPrefetch;
+    unsigned int nPrefetch;
+
+    int nStartHeight;
+    int nHeight;
+    int nTargetHeight;
+    unsigned int nStartChainTx;
+    unsigned int nChainTx;
+    unsigned int nTargetChainTx;
+    int64_t nStartTime;
+
+    void ThreadPrefetch();
+
+public:
+    CChainStateRebuild();
+    ~CChainStateRebuild();
+
+    /**
+     * Starts reading ahead from pindexTip towards pindexTarget with nThreads threads.
+     * pcoinsviewIn has to be safe to read from other threads (i.e. the database) and stay around until Stop().
+     * Has to be called with cs_main held.
+     */
+    void Start(const CBlockIndex* pindexTip, const CBlockIndex* pindexTarget, const CCoinsView* pcoinsviewIn,
+               const Consensus::Params& consensus, unsigned int nPrefetchIn, int nThreads);
+    void Stop();
+    bool IsActive() const { return fActive; }
+
+    void UpdatedTip(const CBlockIndex* pindex);
+
+    bool GetProgress(CChainStateRebuildProgress& progress);
+};
+
+/**
+ * Whether an unfinished -reindex-chainstate can continue where it stopped. This is only the case
+ * if the coins database and the EvoDB are at the same block, i.e. after a clean shutdown. EvoDB
+ * is written for every block but the coins only when their cache is flushed, so after a crash
+ * the rebuild starts over.
+ */
+bool CanResumeChainStateRebuild(CBlockTreeDB& blocktree);
+
+extern CChainStateRebuild chainStateRebuild;
+
+#endif // CHAINSTATEREBUILD_H
@@ -6,9 +6,13 @@
 #define BITCOIN_CHECKQUEUE_H
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <stdint.h>
 #include <vector>
 
-#include <boost/foreach.hpp>
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/locks.hpp>
 #include <boost/thread/mutex.hpp>
@@ -16,6 +20,27 @@
 template <typename T>
 class CCheckQueueControl;
 
+/** Counters of one CCheckQueue worker */
+struct CCheckQueueWorkerStats
+{
+    uint64_t nChecks;
+    //! batches taken from the worker's own queue
+    uint64_t nBatches;
+    //! batches taken from the queues of other workers
+    uint64_t nSteals;
+    //! time spent waiting for work
+    int64_t nIdleMicros;
+};
+
+/** Counters of a CCheckQueue, workers[0] is the master */
+struct CCheckQueueStats
+{
+    //! checks which are queued right now and the most seen at any time
+    uint64_t nQueued;
+    uint64_t nMaxQueued;
+    std::vector<CCheckQueueWorkerStats> workers;
+};
+
 /** 
  * Queue for verifications that have to be performed.
   * The verifications are represented by a type T, which must provide an
@@ -25,12 +50,38 @@ class CCheckQueueControl;
   * onto the queue, where they are processed by N-1 worker threads. When
   * the master is done adding work, it temporarily joins the worker pool
   * as an N'th worker, until all jobs are done.
+  *
+  * Every worker has its own queue, the master spreads added verifications
+  * over them. Workers take batches from the back of their own queue and
+  * steal from the front of the others once theirs is empty, so they only
+  * meet on a shared lock when they run out of work.
   */
 template <typename T>
 class CCheckQueue
 {
 private:
-    //! Mutex to protect the inner state
+    //! Workers beyond this share queues
+    static const int MAX_QUEUES = 128;
+    //! Fewest checks Add() puts into one queue
+    static const unsigned int MIN_CHUNK_SIZE = 8;
+
+    struct WorkerQueue
+    {
+        boost::mutex mutex;
+        std::deque<T> queue;
+        //! queue.size(), readable without the lock so thieves can skip empty queues
+        std::atomic<unsigned int> nSize{0};
+
+        std::atomic<uint64_t> nChecks{0};
+        std::atomic<uint64_t> nBatches{0};
+        std::atomic<uint64_t> nSteals{0};
+        std::atomic<int64_t> nIdleMicros{0};
+    };
+
+    //! The master owns the first queue, workers the others. Never resized.
+    std::vector<std::unique_ptr<WorkerQueue>> vQueues;
+
+    //! Mutex for idling workers and the master waiting for completion
     boost::mutex mutex;
 
     //! Worker threads block on this when out of work
@@ -39,90 +90,132 @@ private:
     //! Master thread blocks on this when out of work
     boost::condition_variable condMaster;
 
-    //! The queue of elements to be processed.
-    //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
-    std::vector<T> queue;
-
-    //! The number of workers (including the master) that are idle.
-    int nIdle;
+    //! The number of workers (excluding the master) that are idle, only changed with mutex held.
+    std::atomic<int> nIdle;
 
-    //! The total number of workers (including the master).
-    int nTotal;
+    //! The number of worker threads which ever joined, excluding the master.
+    std::atomic<int> nWorkers;
 
     //! The temporary evaluation result.
-    bool fAllOk;
+    std::atomic<bool> fAllOk;
 
     /**
      * Number of verifications that haven't completed yet.
      * This includes elements that are no longer queued, but still in the
      * worker's own batches.
      */
-    unsigned int nTodo;
+    std::atomic<unsigned int> nTodo;
 
-    //! Whether we're shutting down.
-    bool fQuit;
+    //! Number of verifications in the queues. Can briefly be negative while Add() is still distributing.
+    std::atomic<int64_t> nQueued;
+    std::atomic<int64_t> nMaxQueued;
+
+    //! The queue the next added verifications start at
+    std::atomic<unsigned int> nNextQueue;
 
     //! The maximum number of elements to be processed in one batch
     unsigned int nBatchSize;
 
+    int GetQueueCount() const
+    {
+        return 1 + std::min(nWorkers.load(), MAX_QUEUES - 1);
+    }
+
+    /**
+     * Fills vChecks with the next batch, from the own queue if possible.
+     * Batches get smaller as a queue runs empty, so all workers finish at about the same time.
+     */
+    bool TakeBatch(int nOwn, std::vector<T>& vChecks)
+    {
+        WorkerQueue& own = *vQueues[nOwn];
+        if (own.nSize.load() != 0) {
+            boost::unique_lock<boost::mutex> lock(own.mutex);
+            if (!own.queue.empty()) {
+                unsigned int nNow = std::max(1U, std::min(nBatchSize, (unsigned int)own.queue.size() / 2));
+                vChecks.resize(nNow);
+                for (unsigned int i = 0; i < nNow; i++) {
+                    vChecks[i].swap(own.queue.back());
+                    own.queue.pop_back();
+                }
+                own.nSize = own.queue.size();
+                own.nBatches++;
+                nQueued -= nNow;
+                return true;
+            }
+        }
+
+        if (nQueued.load() <= 0) return false;
+
+        const int nQueues = GetQueueCount();
+        for (int i = 1; i < nQueues; i++) {
+            WorkerQueue& victim = *vQueues[(nOwn + i) % nQueues];
+            if (victim.nSize.load() == 0) continue;
+            boost::unique_lock<boost::mutex> lock(victim.mutex);
+            if (victim.queue.empty()) continue;
+            // take half of what is left, the victim works on the other end
+            unsigned int nNow = std::max(1U, std::min(nBatchSize, ((unsigned int)victim.queue.size() + 1) / 2));
+            vChecks.resize(nNow);
+            for (unsigned int j = 0; j < nNow; j++) {
+                vChecks[j].swap(victim.queue.front());
+                victim.queue.pop_front();
+            }
+            victim.nSize = victim.queue.size();
+            own.nSteals++;
+            nQueued -= nNow;
+            return true;
+        }
+        return false;
+    }
+
     /** Internal function that does bulk of the verification work. */
     bool Loop(bool fMaster = false)
     {
-        boost::condition_variable& cond = fMaster ? condMaster : condWorker;
+        const int nOwn = fMaster ? 0 : 1 + nWorkers++ % (MAX_QUEUES - 1);
+        WorkerQueue& own = *vQueues[nOwn];
         std::vector<T> vChecks;
         vChecks.reserve(nBatchSize);
-        unsigned int nNow = 0;
-        bool fOk = true;
         do {
-            {
+            if (!TakeBatch(nOwn, vChecks)) {
                 boost::unique_lock<boost::mutex> lock(mutex);
-                // first do the clean-up of the previous loop run (allowing us to do it in the same critsect)
-                if (nNow) {
-                    fAllOk &= fOk;
-                    nTodo -= nNow;
-                    if (nTodo == 0 && !fMaster)
-                        // We processed the last element; inform the master it can exit and return the result
-                        condMaster.notify_one();
-                } else {
-                    // first iteration
-                    nTotal++;
-                }
-                // logically, the do loop starts here
-                while (queue.empty()) {
-                    if ((fMaster || fQuit) && nTodo == 0) {
-                        nTotal--;
-                        bool fRet = fAllOk;
-                        // reset the status for new work later
-                        if (fMaster)
-                            fAllOk = true;
-                        // return the current status
-                        return fRet;
+                if (fMaster) {
+                    // only the master adds work, so all that is left is waiting for the other workers
+                    auto nStart = std::chrono::steady_clock::now();
+                    while (nTodo.load() != 0) {
+                        condMaster.wait(lock);
                     }
-                    nIdle++;
-                    cond.wait(lock); // wait
-                    nIdle--;
+                    own.nIdleMicros += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - nStart).count();
+                    // return the current status and reset it for new work later
+                    return fAllOk.exchange(true);
                 }
-                // Decide how many work units to process now.
-                // * Do not try to do everything at once, but aim for increasingly smaller batches so
-                //   all workers finish approximately simultaneously.
-                // * Try to account for idle jobs which will instantly start helping.
-                // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
-                nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.size() / (nTotal + nIdle + 1)));
-                vChecks.resize(nNow);
-                for (unsigned int i = 0; i < nNow; i++) {
-                    // We want the lock on the mutex to be as short as possible, so swap jobs from the global
-                    // queue to the local batch vector instead of copying.
-                    vChecks[i].swap(queue.back());
-                    queue.pop_back();
+                // announce being idle before the last look at nQueued, Add() checks them the other way round
+                nIdle++;
+                if (nQueued.load() <= 0) {
+                    auto nStart = std::chrono::steady_clock::now();
+                    do {
+                        condWorker.wait(lock); // wait
+                    } while (nQueued.load() <= 0);
+                    own.nIdleMicros += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - nStart).count();
                 }
-                // Check whether we need to do work at all
-                fOk = fAllOk;
+                nIdle--;
+                continue;
             }
+            // Check whether we need to do work at all
+            bool fOk = fAllOk.load();
             // execute work
-            BOOST_FOREACH (T& check, vChecks)
+            for (T& check : vChecks)
                 if (fOk)
                     fOk = check();
+            const unsigned int nNow = vChecks.size();
+            own.nChecks += nNow;
+            // the checks have to be gone before the master learns they are done
             vChecks.clear();
+            if (!fOk)
+                fAllOk = false;
+            if (nTodo.fetch_sub(nNow) == nNow && !fMaster) {
+                // We processed the last element; inform the master it can exit and return the result
+                boost::unique_lock<boost::mutex> lock(mutex);
+                condMaster.notify_one();
+            }
         } while (true);
     }
 
@@ -131,7 +224,13 @@ public:
     boost::mutex ControlMutex;
 
     //! Create a new check queue
-    CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), fQuit(false), nBatchSize(nBatchSizeIn) {}
+    CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nWorkers(0), fAllOk(true), nTodo(0), nQueued(0), nMaxQueued(0), nNextQueue(0), nBatchSize(nBatchSizeIn)
+    {
+        vQueues.reserve(MAX_QUEUES);
+        for (int i = 0; i < MAX_QUEUES; i++) {
+            vQueues.emplace_back(new WorkerQueue());
+        }
+    }
 
     //! Worker thread
     void Thread()
@@ -148,16 +247,62 @@ public:
     //! Add a batch of checks to the queue
     void Add(std::vector<T>& vChecks)
     {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        BOOST_FOREACH (T& check, vChecks) {
-            queue.push_back(T());
-            check.swap(queue.back());
+        const unsigned int nChecks = vChecks.size();
+        if (nChecks == 0)
+            return;
+        nTodo += nChecks;
+
+        // spread the checks evenly over the workers, the master only gets some if there are none.
+        // Small additions go to a single worker, the next one gets the next addition.
+        const int nQueues = GetQueueCount();
+        const unsigned int nTargets = nQueues > 1 ? nQueues - 1 : 1;
+        const unsigned int nChunk = std::max(MIN_CHUNK_SIZE, (nChecks + nTargets - 1) / nTargets);
+        unsigned int nPos = 0;
+        while (nPos < nChecks) {
+            WorkerQueue& target = *vQueues[nQueues > 1 ? 1 + nNextQueue++ % nTargets : 0];
+            const unsigned int nEnd = std::min(nChecks, nPos + nChunk);
+            boost::unique_lock<boost::mutex> lock(target.mutex);
+            for (; nPos < nEnd; nPos++) {
+                target.queue.emplace_back();
+                vChecks[nPos].swap(target.queue.back());
+            }
+            target.nSize = target.queue.size();
         }
-        nTodo += vChecks.size();
-        if (vChecks.size() == 1)
-            condWorker.notify_one();
-        else if (vChecks.size() > 1)
+
+        int64_t nNewQueued = (nQueued += nChecks);
+        int64_t nMax = nMaxQueued.load();
+        while (nNewQueued > nMax && !nMaxQueued.compare_exchange_weak(nMax, nNewQueued)) {}
+
+        if (nIdle.load() == 0)
+            return;
+        // Workers which are awake steal the new checks anyway, only wake up more of them once
+        // there is enough queued work to keep them busy. Someone has to be awake though.
+        boost::unique_lock<boost::mutex> lock(mutex);
+        const int nAwake = std::max(0, std::min(nWorkers.load(), MAX_QUEUES - 1) - nIdle.load());
+        const int64_t nWanted = (nNewQueued + MIN_CHUNK_SIZE - 1) / MIN_CHUNK_SIZE;
+        const int nWake = std::min<int64_t>(nIdle.load(), std::max<int64_t>(nWanted - nAwake, nAwake == 0 ? 1 : 0));
+        if (nWake >= nIdle.load()) {
             condWorker.notify_all();
+        } else {
+            for (int i = 0; i < nWake; i++)
+                condWorker.notify_one();
+        }
+    }
+
+    CCheckQueueStats GetStats() const
+    {
+        CCheckQueueStats stats;
+        stats.nQueued = std::max(nQueued.load(), (int64_t)0);
+        stats.nMaxQueued = nMaxQueued.load();
+        const int nQueues = GetQueueCount();
+        stats.workers.resize(nQueues);
+        for (int i = 0; i < nQueues; i++) {
+            stats.workers[i].nChecks = vQueues[i]->nChecks.load();
+            stats.workers[i].nBatches = vQueues[i]->nBatches.load();
+            stats.workers[i].nSteals = vQueues[i]->nSteals.load();
+            stats.workers[i].nIdleMicros = vQueues[i]->nIdleMicros.load();
+        }
+        return stats;
     }
 
     ~CCheckQueue()
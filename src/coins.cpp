@@ -86,6 +86,17 @@ void CCoinsViewCache::AddCoin(const COutPoint &outpoint, Coin&& coin, bool possi
     cachedCoinsUsage += it->second.coin.DynamicMemoryUsage();
 }
 
+void CCoinsViewCache::AddFetchedCoin(const COutPoint& outpoint, Coin&& coin) {
+    if (coin.IsSpent()) return;
+    CCoinsMap::iterator it;
+    bool inserted;
+    // neither dirty nor fresh, the base view has the same coin
+    std::tie(it, inserted) = cacheCoins.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::forward_as_tuple(std::move(coin)));
+    if (inserted) {
+        cachedCoinsUsage += it->second.coin.DynamicMemoryUsage();
+    }
+}
+
 void AddCoins(CCoinsViewCache& cache, const CTransaction &tx, int nHeight) {
     bool fCoinbase = tx.IsCoinBase();
     const uint256& txid = tx.GetHash();
@@ -241,6 +241,12 @@ public:
      */
     void AddCoin(const COutPoint& outpoint, Coin&& coin, bool potential_overwrite);
 
+    /**
+     * Add an unspent coin which was read from the base view elsewhere (e.g. by another thread), as
+     * if this cache had fetched it itself. Has no effect if the outpoint is in the cache already.
+     */
+    void AddFetchedCoin(const COutPoint& outpoint, Coin&& coin);
+
     /**
      * Spend a coin. Pass moveto in order to get the deleted data.
      * If no unspent output exists for the passed outpoint, this call
@@ -0,0 +1,132 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coinsprefetch.h"
+
+#include "coins.h"
+#include "ctpl.h"
+#include "primitives/block.h"
+#include "saltedhasher.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <future>
+#include <unordered_set>
+#include <vector>
+
+CCoinsPrefetcher coinsPrefetcher;
+
+CCoinsPrefetcher::CCoinsPrefetcher() :
+    nThreads(0),
+    nBlocks(0),
+    nLookups(0),
+    nFound(0)
+{
+}
+
+CCoinsPrefetcher::~CCoinsPrefetcher()
+{
+    Stop();
+}
+
+void CCoinsPrefetcher::Start(int nThreadsIn)
+{
+    Stop();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    nThreads = std::max(0, std::min(nThreadsIn, MAX_COINS_PREFETCH_THREADS));
+    if (nThreads > 0) {
+        pool.reset(new ctpl::thread_pool(nThreads));
+        RenameThreadPool(*pool, "coinsprefetch");
+    }
+}
+
+void CCoinsPrefetcher::Stop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (pool) {
+        pool->clear_queue();
+        pool->stop(true);
+        pool.reset();
+    }
+    nThreads = 0;
+}
+
+size_t CCoinsPrefetcher::Prefetch(const CBlock& block, CCoinsViewCache& view, const CCoinsView& base)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!pool) return 0;
+
+    int64_t nStart = GetTimeMicros();
+
+    // coins created by the block itself aren't in the database yet
+    std::unordered_set<uint256, StaticSaltedHasher> setTxids;
+    for (const auto& tx : block.vtx) {
+        setTxids.emplace(tx->GetHash());
+    }
+    std::vector<COutPoint> vOutpoints;
+    for (const auto& tx : block.vtx) {
+        if (tx->IsCoinBase()) continue;
+        for (const auto& txin : tx->vin) {
+            if (setTxids.count(txin.prevout.hash) || view.HaveCoinInCache(txin.prevout)) continue;
+            vOutpoints.push_back(txin.prevout);
+        }
+    }
+    if (vOutpoints.size() < MIN_COINS_PREFETCH) return 0;
+
+    // every job reads a slice of the outpoints into its own staging area, view is only touched once all are done
+    size_t nJobs = std::min<size_t>(nThreads, vOutpoints.size() / MIN_COINS_PREFETCH);
+    size_t nPerJob = (vOutpoints.size() + nJobs - 1) / nJobs;
+    std::vector<std::vector<std::pair<COutPoint, Coin>>> vStaged(nJobs);
+    std::vector<std::future<void>> vFutures;
+    vFutures.reserve(nJobs);
+    for (size_t i = 0; i < nJobs; i++) {
+        size_t nBegin = i * nPerJob;
+        size_t nEnd = std::min(nBegin + nPerJob, vOutpoints.size());
+        std::vector<std::pair<COutPoint, Coin>>& staged = vStaged[i];
+        vFutures.emplace_back(pool->push([&base, &vOutpoints, &staged, nBegin, nEnd](int threadId) {
+            staged.reserve(nEnd - nBegin);
+            try {
+                for (size_t j = nBegin; j < nEnd; j++) {
+                    Coin coin;
+                    if (base.GetCoin(vOutpoints[j], coin)) {
+                        staged.emplace_back(vOutpoints[j], std::move(coin));
+                    }
+                }
+            } catch (const std::exception& e) {
+                // ConnectBlock runs into the same error and handles it
+                LogPrintf("CCoinsPrefetcher::Prefetch -- error reading coins: %s\n", e.what());
+            }
+        }));
+    }
+    for (auto& future : vFutures) {
+        future.wait();
+    }
+
+    size_t nAdded = 0;
+    for (auto& staged : vStaged) {
+        for (auto& entry : staged) {
+            view.AddFetchedCoin(entry.first, std::move(entry.second));
+            nAdded++;
+        }
+    }
+
+    nBlocks++;
+    nLookups += vOutpoints.size();
+    nFound += nAdded;
+    LogPrint("bench", "    - Prefetch coins: %u of %u found with %u threads: %.2fms\n",
+             nAdded, vOutpoints.size(), nJobs, (GetTimeMicros() - nStart) * 0.001);
+    return nAdded;
+}
+
+CCoinsPrefetchStats CCoinsPrefetcher::GetStats() const
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    CCoinsPrefetchStats stats;
+    stats.nThreads = nThreads;
+    stats.nBlocks = nBlocks;
+    stats.nLookups = nLookups;
+    stats.nFound = nFound;
+    return stats;
+}
@@ -0,0 +1,72 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef COINSPREFETCH_H
+#define COINSPREFETCH_H
+
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+
+class CBlock;
+class CCoinsView;
+class CCoinsViewCache;
+
+namespace ctpl {
+    class thread_pool;
+}
+
+/** Default for -coinsprefetch, the number of threads looking up the coins spent by a block before it is connected */
+static const int DEFAULT_COINS_PREFETCH_THREADS = 4;
+static const int MAX_COINS_PREFETCH_THREADS = 16;
+/** Blocks which spend fewer coins that aren't cached are connected without looking them up first */
+static const size_t MIN_COINS_PREFETCH = 16;
+
+struct CCoinsPrefetchStats
+{
+    int nThreads;
+    uint64_t nBlocks;
+    uint64_t nLookups;
+    uint64_t nFound;
+};
+
+/**
+ * ConnectBlock looks up the spent coins one after another, every one which isn't cached yet makes
+ * it wait for the database. Before a block is connected, Prefetch looks up all of them in parallel
+ * in the view the cache is based on, each thread into its own staging area, and then adds what was
+ * found to the cache, so that ConnectBlock finds all of them there.
+ */
+class CCoinsPrefetcher
+{
+private:
+    mutable std::mutex mutex;
+    std::unique_ptr<ctpl::thread_pool> pool;
+    int nThreads;
+
+    uint64_t nBlocks;
+    uint64_t nLookups;
+    uint64_t nFound;
+
+public:
+    CCoinsPrefetcher();
+    ~CCoinsPrefetcher();
+
+    /** nThreadsIn == 0 disables prefetching */
+    void Start(int nThreadsIn);
+    void Stop();
+
+    /**
+     * Looks up the coins spent by block which aren't in view yet in base and adds them to view.
+     * base has to be the view which view is based on (or on top of the same data) and safe to be
+     * read from several threads, view must not be used by anyone else meanwhile (i.e. cs_main is
+     * held for pcoinsTip). Returns the number of coins added.
+     */
+    size_t Prefetch(const CBlock& block, CCoinsViewCache& view, const CCoinsView& base);
+
+    CCoinsPrefetchStats GetStats() const;
+};
+
+extern CCoinsPrefetcher coinsPrefetcher;
+
+#endif // COINSPREFETCH_H
@@ -127,6 +127,68 @@ void Transform(uint32_t* s, const unsigned char* chunk)
     s[7] += h;
 }
 
+/** Round constants, only used by the table driven transformation below. */
+const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+/** Message schedule of the padding block of a 64-byte message, with the round constants already added. */
+struct PaddingSchedule64
+{
+    uint32_t kw[64];
+
+    PaddingSchedule64()
+    {
+        uint32_t w[64] = {0x80000000ul};
+        w[15] = 64 << 3;
+        for (int i = 16; i < 64; i++) {
+            w[i] = sigma1(w[i - 2]) + w[i - 7] + sigma0(w[i - 15]) + w[i - 16];
+        }
+        for (int i = 0; i < 64; i++) {
+            kw[i] = K[i] + w[i];
+        }
+    }
+};
+
+/**
+ * Process the padding block which follows a 64-byte message. The block is the same for all such
+ * messages, so its message schedule is computed only once.
+ */
+void TransformPadding64(uint32_t* s)
+{
+    static const PaddingSchedule64 schedule;
+
+    uint32_t a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + Sigma1(e) + Ch(e, f, g) + schedule.kw[i];
+        uint32_t t2 = Sigma0(a) + Maj(a, b, c);
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    s[0] += a;
+    s[1] += b;
+    s[2] += c;
+    s[3] += d;
+    s[4] += e;
+    s[5] += f;
+    s[6] += g;
+    s[7] += h;
+}
+
 } // namespace sha256
 } // namespace
 
@@ -187,3 +249,18 @@ CSHA256& CSHA256::Reset()
     sha256::Initialize(s);
     return *this;
 }
+
+void SHA256Batch64(unsigned char* out, const unsigned char* in, size_t blocks)
+{
+    uint32_t s[8];
+    for (size_t i = 0; i < blocks; i++) {
+        sha256::Initialize(s);
+        sha256::Transform(s, in);
+        sha256::TransformPadding64(s);
+        for (int j = 0; j < 8; j++) {
+            WriteBE32(out + 4 * j, s[j]);
+        }
+        in += 64;
+        out += 32;
+    }
+}
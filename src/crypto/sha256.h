@@ -25,4 +25,7 @@ public:
     CSHA256& Reset();
 };
 
+/** Compute the single SHA-256 hash of 'blocks' independent 64-byte inputs, writing 32 bytes per input to 'out'. */
+void SHA256Batch64(unsigned char* out, const unsigned char* in, size_t blocks);
+
 #endif // BITCOIN_CRYPTO_SHA256_H
@@ -37,8 +37,34 @@ bool CheckCbTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidatio
     return true;
 }
 
+// Merkle tree of the simplified MN list of the last block which passed CheckCbTxMerkleRootMNList, so that the
+// next block only has to rehash the entries it touched. Protected by deterministicMNManager->cs
+static CSimplifiedMNListMerkleTree smlTreeCached;
+static uint256 smlTreeCachedBlockHash;
+
+static bool CalcCbTxMerkleTreeMNList(const CBlock& block, const CBlockIndex* pindexPrev, CSimplifiedMNListMerkleTree& smlTreeRet, CValidationState& state)
+{
+    AssertLockHeld(deterministicMNManager->cs);
+
+    CDeterministicMNList tmpMNList;
+    if (!deterministicMNManager->BuildNewListFromBlock(block, pindexPrev, state, tmpMNList, false)) {
+        return false;
+    }
+
+    CDeterministicMNList prevMNList = deterministicMNManager->GetListForBlock(pindexPrev->GetBlockHash());
+    if (smlTreeCachedBlockHash != pindexPrev->GetBlockHash()) {
+        smlTreeCached = CSimplifiedMNListMerkleTree(CSimplifiedMNList(prevMNList));
+        smlTreeCachedBlockHash = pindexPrev->GetBlockHash();
+    }
+
+    smlTreeRet = smlTreeCached;
+    smlTreeRet.ApplyDiff(tmpMNList, prevMNList.BuildDiff(tmpMNList));
+    // same as the "mutated" check of CalcMerkleRoot
+    return !smlTreeRet.IsMutated();
+}
+
 // This can only be done after the block has been fully processed, as otherwise we won't have the finished MN list
-bool CheckCbTxMerkleRootMNList(const CBlock& block, const CBlockIndex* pindex, CValidationState& state)
+bool CheckCbTxMerkleRootMNList(const CBlock& block, const CBlockIndex* pindex, CValidationState& state, bool fJustCheck)
 {
     if (block.vtx[0]->nType != TRANSACTION_COINBASE) {
         return true;
@@ -50,13 +76,22 @@ bool CheckCbTxMerkleRootMNList(const CBlock& block, const CBlockIndex* pindex, C
     }
 
     if (pindex) {
-        uint256 calculatedMerkleRoot;
-        if (!CalcCbTxMerkleRootMNList(block, pindex->pprev, calculatedMerkleRoot, state)) {
+        LOCK(deterministicMNManager->cs);
+
+        CSimplifiedMNListMerkleTree smlTree;
+        if (!CalcCbTxMerkleTreeMNList(block, pindex->pprev, smlTree, state)) {
             return state.DoS(100, false, REJECT_INVALID, "bad-cbtx-mnmerkleroot");
         }
-        if (calculatedMerkleRoot != cbTx.merkleRootMNList) {
+        if (smlTree.GetRoot() != cbTx.merkleRootMNList) {
             return state.DoS(100, false, REJECT_INVALID, "bad-cbtx-mnmerkleroot");
         }
+
+        // this block's list is the base for the next one, unless it's only checked (the dummy index of
+        // TestBlockValidity doesn't even have a hash)
+        if (!fJustCheck) {
+            smlTreeCached = std::move(smlTree);
+            smlTreeCachedBlockHash = pindex->GetBlockHash();
+        }
     }
 
     return true;
@@ -66,16 +101,24 @@ bool CalcCbTxMerkleRootMNList(const CBlock& block, const CBlockIndex* pindexPrev
 {
     LOCK(deterministicMNManager->cs);
 
-    CDeterministicMNList tmpMNList;
-    if (!deterministicMNManager->BuildNewListFromBlock(block, pindexPrev, state, tmpMNList, false)) {
+    CSimplifiedMNListMerkleTree smlTree;
+    if (!CalcCbTxMerkleTreeMNList(block, pindexPrev, smlTree, state)) {
         return false;
     }
 
-    CSimplifiedMNList sml(tmpMNList);
+    merkleRootRet = smlTree.GetRoot();
+    return true;
+}
 
-    bool mutated = false;
-    merkleRootRet = sml.CalcMerkleRoot(&mutated);
-    return !mutated;
+bool GetCachedMNListMerkleRoot(uint256& blockHashRet, uint256& merkleRootRet)
+{
+    LOCK(deterministicMNManager->cs);
+    if (smlTreeCachedBlockHash.IsNull()) {
+        return false;
+    }
+    blockHashRet = smlTreeCachedBlockHash;
+    merkleRootRet = smlTreeCached.GetRoot();
+    return true;
 }
 
 std::string CCbTx::ToString() const
@@ -40,7 +40,10 @@ public:
 
 bool CheckCbTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state);
 
-bool CheckCbTxMerkleRootMNList(const CBlock& block, const CBlockIndex* pindex, CValidationState& state);
+// fJustCheck is set for blocks which aren't connected, e.g. templates, the tree of those is not kept for the next block
+bool CheckCbTxMerkleRootMNList(const CBlock& block, const CBlockIndex* pindex, CValidationState& state, bool fJustCheck);
 bool CalcCbTxMerkleRootMNList(const CBlock& block, const CBlockIndex* pindexPrev, uint256& merkleRootRet, CValidationState& state);
+// Returns the block whose simplified MN list tree is kept for the next block and the root of that tree
+bool GetCachedMNListMerkleRoot(uint256& blockHashRet, uint256& merkleRootRet);
 
 #endif //DASH_CBTX_H
@@ -8,6 +8,7 @@
 #include "base58.h"
 #include "chainparams.h"
 #include "core_io.h"
+#include "crypto/sha256.h"
 #include "script/standard.h"
 #include "spork.h"
 #include "validation.h"
@@ -18,6 +19,9 @@
 
 #include <univalue.h>
 
+#include <set>
+#include <tuple>
+
 static const std::string DB_LIST_SNAPSHOT = "dmn_S";
 static const std::string DB_LIST_DIFF = "dmn_D";
 
@@ -197,17 +201,24 @@ std::vector<CDeterministicMNCPtr> CDeterministicMNList::GetProjectedMNPayees(int
     std::vector<CDeterministicMNCPtr> result;
     result.reserve(nCount);
 
-    CDeterministicMNList tmpMNList = *this;
-    for (int h = nHeight; h < nHeight + nCount; h++) {
-        tmpMNList.SetHeight(h);
+    // walk the MNs once and keep them ordered the same way GetMNPayee() picks them. A projected payment only
+    // changes the last paid height of the payee, so re-inserting it with that height is all that's needed
+    std::set<std::tuple<int, uint256, CDeterministicMNCPtr>> setQueue;
+    ForEachMN(true, [&](const CDeterministicMNCPtr& dmn) {
+        setQueue.emplace(CompareByLastPaid_GetHeight(*dmn), dmn->proTxHash, dmn);
+    });
 
-        CDeterministicMNCPtr payee = tmpMNList.GetMNPayee();
-        // push the original MN object instead of the one from the temporary list
-        result.push_back(GetMN(payee->proTxHash));
+    for (int h = nHeight; h < nHeight + nCount && !setQueue.empty(); h++) {
+        auto it = setQueue.begin();
+        CDeterministicMNCPtr payee = std::get<2>(*it);
+        setQueue.erase(it);
+        result.push_back(payee);
 
-        CDeterministicMNStatePtr newState = std::make_shared<CDeterministicMNState>(*payee->pdmnState);
-        newState->nLastPaidHeight = h;
-        tmpMNList.UpdateMN(payee->proTxHash, newState);
+        CDeterministicMNState newState(*payee->pdmnState);
+        newState.nLastPaidHeight = h;
+        CDeterministicMN tmpMN(*payee);
+        tmpMN.pdmnState = std::make_shared<CDeterministicMNState>(newState);
+        setQueue.emplace(CompareByLastPaid_GetHeight(tmpMN), payee->proTxHash, payee);
     }
 
     return result;
@@ -217,18 +228,19 @@ std::vector<CDeterministicMNCPtr> CDeterministicMNList::CalculateQuorum(size_t m
 {
     auto scores = CalculateScores(modifier);
 
-    // sort is descending order
-    std::sort(scores.rbegin(), scores.rend(), [](const std::pair<arith_uint256, CDeterministicMNCPtr>& a, std::pair<arith_uint256, CDeterministicMNCPtr>& b) {
+    // only the top maxSize entries are needed, sort them in descending order and leave the rest alone
+    size_t nSize = std::min(maxSize, scores.size());
+    std::partial_sort(scores.begin(), scores.begin() + nSize, scores.end(), [](const std::pair<arith_uint256, CDeterministicMNCPtr>& a, const std::pair<arith_uint256, CDeterministicMNCPtr>& b) {
         if (a.first == b.first) {
             // this should actually never happen, but we should stay compatible with how the non deterministic MNs did the sorting
-            return a.second->collateralOutpoint < b.second->collateralOutpoint;
+            return b.second->collateralOutpoint < a.second->collateralOutpoint;
         }
-        return a.first < b.first;
+        return b.first < a.first;
     });
 
     // take top maxSize entries and return it
     std::vector<CDeterministicMNCPtr> result;
-    result.resize(std::min(maxSize, scores.size()));
+    result.resize(nSize);
     for (size_t i = 0; i < result.size(); i++) {
         result[i] = std::move(scores[i].second);
     }
@@ -237,27 +249,38 @@ std::vector<CDeterministicMNCPtr> CDeterministicMNList::CalculateQuorum(size_t m
 
 std::vector<std::pair<arith_uint256, CDeterministicMNCPtr>> CDeterministicMNList::CalculateScores(const uint256& modifier) const
 {
-    std::vector<std::pair<arith_uint256, CDeterministicMNCPtr>> scores;
-    scores.reserve(GetAllMNsCount());
+    std::vector<CDeterministicMNCPtr> vecMNs;
+    vecMNs.reserve(GetAllMNsCount());
     ForEachMN(true, [&](const CDeterministicMNCPtr& dmn) {
         if (dmn->pdmnState->confirmedHash.IsNull()) {
             // we only take confirmed MNs into account to avoid hash grinding on the ProRegTxHash to sneak MNs into a
             // future quorums
             return;
         }
-        // calculate sha256(sha256(proTxHash, confirmedHash), modifier) per MN
-        // Please note that this is not a double-sha256 but a single-sha256
-        // The first part is already precalculated (confirmedHashWithProRegTxHash)
-        // TODO When https://github.com/bitcoin/bitcoin/pull/13191 gets backported, implement something that is similar but for single-sha256
-        uint256 h;
-        CSHA256 sha256;
-        sha256.Write(dmn->pdmnState->confirmedHashWithProRegTxHash.begin(), dmn->pdmnState->confirmedHashWithProRegTxHash.size());
-        sha256.Write(modifier.begin(), modifier.size());
-        sha256.Finalize(h.begin());
-
-        scores.emplace_back(UintToArith256(h), dmn);
+        vecMNs.emplace_back(dmn);
     });
 
+    // calculate sha256(sha256(proTxHash, confirmedHash), modifier) per MN
+    // Please note that this is not a double-sha256 but a single-sha256
+    // The first part is already precalculated (confirmedHashWithProRegTxHash), so every input is exactly 64 bytes
+    // and all of them are hashed in one batch
+    std::vector<unsigned char> vecInput(vecMNs.size() * 64);
+    for (size_t i = 0; i < vecMNs.size(); i++) {
+        const uint256& confirmedHashWithProRegTxHash = vecMNs[i]->pdmnState->confirmedHashWithProRegTxHash;
+        memcpy(&vecInput[i * 64], confirmedHashWithProRegTxHash.begin(), 32);
+        memcpy(&vecInput[i * 64 + 32], modifier.begin(), 32);
+    }
+    std::vector<unsigned char> vecOutput(vecMNs.size() * 32);
+    SHA256Batch64(vecOutput.data(), vecInput.data(), vecMNs.size());
+
+    std::vector<std::pair<arith_uint256, CDeterministicMNCPtr>> scores;
+    scores.reserve(vecMNs.size());
+    for (size_t i = 0; i < vecMNs.size(); i++) {
+        uint256 h;
+        memcpy(h.begin(), &vecOutput[i * 32], 32);
+        scores.emplace_back(UintToArith256(h), std::move(vecMNs[i]));
+    }
+
     return scores;
 }
 
@@ -431,8 +454,11 @@ void CDeterministicMNList::RemoveMN(const uint256& proTxHash)
     mnMap = mnMap.erase(proTxHash);
 }
 
-CDeterministicMNManager::CDeterministicMNManager(CEvoDB& _evoDb) :
-    evoDb(_evoDb)
+CDeterministicMNManager::CDeterministicMNManager(CEvoDB& _evoDb, int _nSnapshotInterval, size_t nListsCacheSize, size_t nDiffsCacheSize) :
+    evoDb(_evoDb),
+    nSnapshotInterval(std::max(_nSnapshotInterval, 1)),
+    mnListsCache(std::max(nListsCacheSize, (size_t)1)),
+    mnListDiffsCache(std::max(nDiffsCacheSize, (size_t)1))
 {
 }
 
@@ -457,7 +483,7 @@ bool CDeterministicMNManager::ProcessBlock(const CBlock& block, const CBlockInde
     CDeterministicMNListDiff diff = oldList.BuildDiff(newList);
 
     evoDb.Write(std::make_pair(DB_LIST_DIFF, diff.blockHash), diff);
-    if ((nHeight % SNAPSHOT_LIST_PERIOD) == 0) {
+    if ((nHeight % nSnapshotInterval) == 0) {
         evoDb.Write(std::make_pair(DB_LIST_SNAPSHOT, diff.blockHash), newList);
         LogPrintf("CDeterministicMNManager::%s -- Wrote snapshot. nHeight=%d, mapCurMNs.allMNsCount=%d\n",
             __func__, nHeight, newList.GetAllMNsCount());
@@ -467,7 +493,8 @@ bool CDeterministicMNManager::ProcessBlock(const CBlock& block, const CBlockInde
         LogPrintf("CDeterministicMNManager::%s -- spork15 is active now. nHeight=%d\n", __func__, nHeight);
     }
 
-    CleanupCache(nHeight);
+    mnListsCache.insert(diff.blockHash, newList);
+    mnListDiffsCache.insert(diff.blockHash, diff);
 
     return true;
 }
@@ -482,6 +509,7 @@ bool CDeterministicMNManager::UndoBlock(const CBlock& block, const CBlockIndex*
     evoDb.Erase(std::make_pair(DB_LIST_DIFF, blockHash));
     evoDb.Erase(std::make_pair(DB_LIST_SNAPSHOT, blockHash));
     mnListsCache.erase(blockHash);
+    mnListDiffsCache.erase(blockHash);
 
     if (nHeight == GetSpork15Value()) {
         LogPrintf("CDeterministicMNManager::%s -- spork15 is not active anymore. nHeight=%d\n", __func__, nHeight);
@@ -768,35 +796,38 @@ CDeterministicMNList CDeterministicMNManager::GetListForBlock(const uint256& blo
 {
     LOCK(cs);
 
-    auto it = mnListsCache.find(blockHash);
-    if (it != mnListsCache.end()) {
-        return it->second;
+    CDeterministicMNList snapshot;
+    if (mnListsCache.get(blockHash, snapshot)) {
+        nCacheHits++;
+        return snapshot;
     }
+    nCacheMisses++;
 
     uint256 blockHashTmp = blockHash;
-    CDeterministicMNList snapshot;
     std::list<CDeterministicMNListDiff> listDiff;
 
     while (true) {
         // try using cache before reading from disk
-        it = mnListsCache.find(blockHashTmp);
-        if (it != mnListsCache.end()) {
-            snapshot = it->second;
+        if (mnListsCache.get(blockHashTmp, snapshot)) {
             break;
         }
 
         if (evoDb.Read(std::make_pair(DB_LIST_SNAPSHOT, blockHashTmp), snapshot)) {
+            mnListsCache.insert(blockHashTmp, snapshot);
             break;
         }
 
         CDeterministicMNListDiff diff;
-        if (!evoDb.Read(std::make_pair(DB_LIST_DIFF, blockHashTmp), diff)) {
-            snapshot = CDeterministicMNList(blockHashTmp, -1);
-            break;
+        if (!mnListDiffsCache.get(blockHashTmp, diff)) {
+            if (!evoDb.Read(std::make_pair(DB_LIST_DIFF, blockHashTmp), diff)) {
+                snapshot = CDeterministicMNList(blockHashTmp, -1);
+                break;
+            }
+            mnListDiffsCache.insert(blockHashTmp, diff);
         }
 
-        listDiff.emplace_front(diff);
-        blockHashTmp = diff.prevBlockHash;
+        listDiff.emplace_front(std::move(diff));
+        blockHashTmp = listDiff.front().prevBlockHash;
     }
 
     for (const auto& diff : listDiff) {
@@ -806,9 +837,16 @@ CDeterministicMNList CDeterministicMNManager::GetListForBlock(const uint256& blo
             snapshot.SetBlockHash(diff.blockHash);
             snapshot.SetHeight(diff.nHeight);
         }
+        nDiffsApplied++;
+
+        // keep the intermediate lists at snapshot heights, so that queries for other historical blocks
+        // close to this one don't have to replay the same diffs again
+        if ((diff.nHeight % nSnapshotInterval) == 0) {
+            mnListsCache.insert(diff.blockHash, snapshot);
+        }
     }
 
-    mnListsCache.emplace(blockHash, snapshot);
+    mnListsCache.insert(blockHash, snapshot);
     return snapshot;
 }
 
@@ -871,17 +909,17 @@ bool CDeterministicMNManager::IsDeterministicMNsSporkActive(int nHeight)
     return nHeight >= spork15Value;
 }
 
-void CDeterministicMNManager::CleanupCache(int nHeight)
+CDeterministicMNListsCacheStats CDeterministicMNManager::GetCacheStats()
 {
-    AssertLockHeld(cs);
+    LOCK(cs);
 
-    std::vector<uint256> toDelete;
-    for (const auto& p : mnListsCache) {
-        if (p.second.GetHeight() + LISTS_CACHE_SIZE < nHeight) {
-            toDelete.emplace_back(p.first);
-        }
-    }
-    for (const auto& h : toDelete) {
-        mnListsCache.erase(h);
-    }
+    CDeterministicMNListsCacheStats stats;
+    stats.nLists = mnListsCache.size();
+    stats.nMaxLists = mnListsCache.max_size();
+    stats.nDiffs = mnListDiffsCache.size();
+    stats.nMaxDiffs = mnListDiffsCache.max_size();
+    stats.nHits = nCacheHits;
+    stats.nMisses = nCacheMisses;
+    stats.nDiffsApplied = nDiffsApplied;
+    return stats;
 }
@@ -11,7 +11,9 @@
 #include "evodb.h"
 #include "providertx.h"
 #include "simplifiedmns.h"
+#include "saltedhasher.h"
 #include "sync.h"
+#include "unordered_lru_cache.h"
 
 #include "immer/map.hpp"
 #include "immer/map_transient.hpp"
@@ -448,23 +450,44 @@ public:
     }
 };
 
-class CDeterministicMNManager
+static const int DEFAULT_DMN_SNAPSHOT_INTERVAL = 576; // once per day
+static const int DEFAULT_DMN_LISTS_CACHE_SIZE = 1152;
+static const int DEFAULT_DMN_DIFFS_CACHE_SIZE = 4608;
+
+struct CDeterministicMNListsCacheStats
 {
-    static const int SNAPSHOT_LIST_PERIOD = 576; // once per day
-    static const int LISTS_CACHE_SIZE = 576;
+    size_t nLists;
+    size_t nMaxLists;
+    size_t nDiffs;
+    size_t nMaxDiffs;
+    uint64_t nHits;
+    uint64_t nMisses;
+    uint64_t nDiffsApplied;
+};
 
+class CDeterministicMNManager
+{
 public:
     CCriticalSection cs;
 
 private:
     CEvoDB& evoDb;
 
-    std::map<uint256, CDeterministicMNList> mnListsCache;
+    // a full list snapshot is written to evoDb every nSnapshotInterval blocks, diffs otherwise
+    int nSnapshotInterval;
+
+    unordered_lru_cache<uint256, CDeterministicMNList, StaticSaltedHasher> mnListsCache;
+    unordered_lru_cache<uint256, CDeterministicMNListDiff, StaticSaltedHasher> mnListDiffsCache;
+    uint64_t nCacheHits{0};
+    uint64_t nCacheMisses{0};
+    uint64_t nDiffsApplied{0};
+
     int tipHeight{-1};
     uint256 tipBlockHash;
 
 public:
-    CDeterministicMNManager(CEvoDB& _evoDb);
+    CDeterministicMNManager(CEvoDB& _evoDb, int _nSnapshotInterval = DEFAULT_DMN_SNAPSHOT_INTERVAL,
+                            size_t nListsCacheSize = DEFAULT_DMN_LISTS_CACHE_SIZE, size_t nDiffsCacheSize = DEFAULT_DMN_DIFFS_CACHE_SIZE);
 
     bool ProcessBlock(const CBlock& block, const CBlockIndex* pindex, CValidationState& state);
     bool UndoBlock(const CBlock& block, const CBlockIndex* pindex);
@@ -488,9 +511,10 @@ public:
 
     bool IsDeterministicMNsSporkActive(int nHeight = -1);
 
+    CDeterministicMNListsCacheStats GetCacheStats();
+
 private:
     int64_t GetSpork15Value();
-    void CleanupCache(int nHeight);
 };
 
 extern CDeterministicMNManager* deterministicMNManager;
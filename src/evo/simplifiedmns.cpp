@@ -81,6 +81,152 @@ uint256 CSimplifiedMNList::CalcMerkleRoot(bool* pmutated) const
     return ComputeMerkleRoot(leaves, pmutated);
 }
 
+static uint256 HashMerkleNodes(const uint256& left, const uint256& right)
+{
+    uint256 hash;
+    CHash256().Write(left.begin(), 32).Write(right.begin(), 32).Finalize(hash.begin());
+    return hash;
+}
+
+CSimplifiedMNListMerkleTree::CSimplifiedMNListMerkleTree(const CSimplifiedMNList& sml)
+{
+    vProRegTxHashes.reserve(sml.mnList.size());
+    vLevels.resize(1);
+    vLevels[0].reserve(sml.mnList.size());
+    for (const auto& e : sml.mnList) {
+        vProRegTxHashes.emplace_back(e.proRegTxHash);
+        vLevels[0].emplace_back(e.CalcHash());
+    }
+    RebuildInnerLevels();
+}
+
+void CSimplifiedMNListMerkleTree::ApplyDiff(const CDeterministicMNList& newList, const CDeterministicMNListDiff& diff)
+{
+    if (vLevels.empty()) {
+        vLevels.resize(1);
+    }
+    auto& leaves = vLevels[0];
+    bool fStructureChanged = false;
+    size_t nPos;
+
+    for (const auto& proTxHash : diff.removedMns) {
+        if (!FindLeaf(proTxHash, nPos)) {
+            continue;
+        }
+        vProRegTxHashes.erase(vProRegTxHashes.begin() + nPos);
+        leaves.erase(leaves.begin() + nPos);
+        fStructureChanged = true;
+    }
+    for (const auto& p : diff.addedMNs) {
+        if (FindLeaf(p.first, nPos)) {
+            leaves[nPos] = CSimplifiedMNListEntry(*p.second).CalcHash();
+        } else {
+            vProRegTxHashes.emplace(vProRegTxHashes.begin() + nPos, p.first);
+            leaves.emplace(leaves.begin() + nPos, CSimplifiedMNListEntry(*p.second).CalcHash());
+        }
+        fStructureChanged = true;
+    }
+
+    // most state updates (e.g. nLastPaidHeight) don't touch the simplified entry, so only
+    // walk up the tree for leaves whose hash actually changed
+    std::vector<size_t> vChangedLeaves;
+    for (const auto& p : diff.updatedMNs) {
+        auto dmn = newList.GetMN(p.first);
+        if (!dmn || !FindLeaf(p.first, nPos)) {
+            continue;
+        }
+        uint256 hash = CSimplifiedMNListEntry(*dmn).CalcHash();
+        if (hash != leaves[nPos]) {
+            leaves[nPos] = hash;
+            vChangedLeaves.emplace_back(nPos);
+        }
+    }
+
+    if (fStructureChanged) {
+        // positions have shifted, rebuild the inner nodes from the (mostly cached) leaf hashes
+        RebuildInnerLevels();
+    } else {
+        for (size_t nChanged : vChangedLeaves) {
+            UpdatePath(nChanged);
+        }
+    }
+}
+
+uint256 CSimplifiedMNListMerkleTree::GetRoot() const
+{
+    if (vLevels.empty() || vLevels.back().empty()) {
+        return uint256();
+    }
+    return vLevels.back()[0];
+}
+
+bool CSimplifiedMNListMerkleTree::IsMutated() const
+{
+    for (size_t i = 0; i + 1 < vLevels.size(); i++) {
+        const auto& level = vLevels[i];
+        for (size_t j = 0; j + 1 < level.size(); j += 2) {
+            if (level[j] == level[j + 1]) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool CSimplifiedMNListMerkleTree::GetMerkleProof(const uint256& proRegTxHash, std::vector<uint256>& branchRet, uint32_t& nPosRet) const
+{
+    size_t nPos;
+    if (!FindLeaf(proRegTxHash, nPos)) {
+        return false;
+    }
+
+    nPosRet = (uint32_t)nPos;
+    branchRet.clear();
+    for (size_t i = 0; i + 1 < vLevels.size(); i++) {
+        const auto& level = vLevels[i];
+        size_t nSibling = nPos ^ 1;
+        // odd levels pair the last node with itself
+        branchRet.emplace_back(nSibling < level.size() ? level[nSibling] : level[nPos]);
+        nPos >>= 1;
+    }
+    return true;
+}
+
+// returns the position of proRegTxHash or, if not found, the position where it would have to be inserted
+bool CSimplifiedMNListMerkleTree::FindLeaf(const uint256& proRegTxHash, size_t& nPosRet) const
+{
+    auto it = std::lower_bound(vProRegTxHashes.begin(), vProRegTxHashes.end(), proRegTxHash);
+    nPosRet = it - vProRegTxHashes.begin();
+    return it != vProRegTxHashes.end() && *it == proRegTxHash;
+}
+
+void CSimplifiedMNListMerkleTree::RebuildInnerLevels()
+{
+    vLevels.resize(1);
+    while (vLevels.back().size() > 1) {
+        const auto& below = vLevels.back();
+        std::vector<uint256> level((below.size() + 1) / 2);
+        for (size_t i = 0; i < level.size(); i++) {
+            const uint256& left = below[i * 2];
+            const uint256& right = i * 2 + 1 < below.size() ? below[i * 2 + 1] : left;
+            level[i] = HashMerkleNodes(left, right);
+        }
+        vLevels.emplace_back(std::move(level));
+    }
+}
+
+void CSimplifiedMNListMerkleTree::UpdatePath(size_t nPos)
+{
+    for (size_t i = 1; i < vLevels.size(); i++) {
+        const auto& below = vLevels[i - 1];
+        size_t nLeft = nPos & ~(size_t)1;
+        const uint256& left = below[nLeft];
+        const uint256& right = nLeft + 1 < below.size() ? below[nLeft + 1] : left;
+        nPos >>= 1;
+        vLevels[i][nPos] = HashMerkleNodes(left, right);
+    }
+}
+
 void CSimplifiedMNListDiff::ToJson(UniValue& obj) const
 {
     obj.setObject();
@@ -13,6 +13,7 @@
 
 class UniValue;
 class CDeterministicMNList;
+class CDeterministicMNListDiff;
 class CDeterministicMN;
 
 class CSimplifiedMNListEntry
@@ -78,6 +79,39 @@ public:
     uint256 CalcMerkleRoot(bool* pmutated = NULL) const;
 };
 
+/**
+ * Merkle tree over the hashes of the simplified MN list entries (ordered by proRegTxHash) which keeps
+ * all inner nodes. Applying a CDeterministicMNListDiff only rehashes the entries touched by the diff,
+ * and the tree can serve Merkle proofs for single entries. The root always matches
+ * CSimplifiedMNList::CalcMerkleRoot for the same list.
+ */
+class CSimplifiedMNListMerkleTree
+{
+private:
+    std::vector<uint256> vProRegTxHashes;
+    // vLevels[0] holds the leaf hashes, vLevels.back() the root
+    std::vector<std::vector<uint256>> vLevels;
+
+public:
+    CSimplifiedMNListMerkleTree() {}
+    explicit CSimplifiedMNListMerkleTree(const CSimplifiedMNList& sml);
+
+    // newList must be the list which results from applying diff to the list this tree currently represents
+    void ApplyDiff(const CDeterministicMNList& newList, const CDeterministicMNListDiff& diff);
+
+    uint256 GetRoot() const;
+    // true if two paired nodes are equal, see the "mutated" flag of ComputeMerkleRoot
+    bool IsMutated() const;
+    size_t GetLeafCount() const { return vProRegTxHashes.size(); }
+    // the returned branch can be verified with ComputeMerkleRootFromBranch
+    bool GetMerkleProof(const uint256& proRegTxHash, std::vector<uint256>& branchRet, uint32_t& nPosRet) const;
+
+private:
+    bool FindLeaf(const uint256& proRegTxHash, size_t& nPosRet) const;
+    void RebuildInnerLevels();
+    void UpdatePath(size_t nPos);
+};
+
 /// P2P messages
 
 class CGetSimplifiedMNListDiff
@@ -0,0 +1,314 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef EXPIRINGMAP_H_
+#define EXPIRINGMAP_H_
+
+#include "serialize.h"
+#include "memusage.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+/** Memory statistics of a CExpiringMap */
+struct CExpiringMapStats
+{
+    size_t nEntries;
+    size_t nUsage;
+};
+
+/** Value type for CExpiringMap instances which are used as a set, serializes to nothing */
+struct CExpiringMapNoValue
+{
+    template<typename Stream>
+    void Serialize(Stream& s) const {}
+
+    template<typename Stream>
+    void Unserialize(Stream& s) {}
+};
+
+/**
+ * Hash map where every entry carries a deadline, entries are dropped by Expire()
+ * once the deadline has passed. Deadlines are plain int64_t ticks, so callers can
+ * use timestamps or block heights as long as they don't mix both in one map.
+ *
+ * Entries are scheduled on a hierarchical timing wheel (WHEEL_LEVELS levels of
+ * WHEEL_SLOTS slots, level N slots cover WHEEL_SLOTS^N ticks). Advancing the wheel
+ * only visits the slots the elapsed ticks cover, entries are cascaded down a level
+ * when their slot is reached, so each entry is touched at most WHEEL_LEVELS times
+ * before it expires instead of on every periodic full scan.
+ */
+template<typename Key, typename Value, typename Hasher = std::hash<Key>>
+class CExpiringMap
+{
+private:
+    static const int WHEEL_BITS = 6;
+    static const size_t WHEEL_SLOTS = size_t(1) << WHEEL_BITS;
+    // 11 * 6 bits cover the whole int64_t range
+    static const int WHEEL_LEVELS = 11;
+
+    typedef std::list<Key> slot_t;
+
+    struct entry_t
+    {
+        Value value;
+        int64_t nDeadline;
+        typename slot_t::iterator itSlot;
+        slot_t* pSlot;
+
+        entry_t(const Value& valueIn, int64_t nDeadlineIn) :
+            value(valueIn),
+            nDeadline(nDeadlineIn),
+            pSlot(nullptr)
+        {}
+    };
+
+    typedef std::unordered_map<Key, entry_t, Hasher> map_t;
+
+    map_t mapEntries;
+    slot_t wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+    // entries with a deadline which already passed when they were scheduled
+    slot_t listDue;
+    // all ticks up to (and including) this one were processed
+    int64_t nCurrentTick;
+
+public:
+    CExpiringMap() :
+        nCurrentTick(0)
+    {}
+
+    CExpiringMap(const CExpiringMap& other) :
+        nCurrentTick(0)
+    {
+        *this = other;
+    }
+
+    CExpiringMap& operator=(const CExpiringMap& other)
+    {
+        if (this == &other) return *this;
+        Clear();
+        nCurrentTick = other.nCurrentTick;
+        for (const auto& pair : other.mapEntries) {
+            Insert(pair.first, pair.second.value, pair.second.nDeadline);
+        }
+        return *this;
+    }
+
+    size_t Size() const { return mapEntries.size(); }
+
+    bool Empty() const { return mapEntries.empty(); }
+
+    bool Has(const Key& key) const { return mapEntries.count(key) != 0; }
+
+    /// Returns nullptr if there is no entry for this key
+    Value* Find(const Key& key)
+    {
+        auto it = mapEntries.find(key);
+        return it == mapEntries.end() ? nullptr : &it->second.value;
+    }
+
+    const Value* Find(const Key& key) const
+    {
+        auto it = mapEntries.find(key);
+        return it == mapEntries.end() ? nullptr : &it->second.value;
+    }
+
+    bool Get(const Key& key, Value& valueRet) const
+    {
+        const Value* pvalue = Find(key);
+        if (!pvalue) return false;
+        valueRet = *pvalue;
+        return true;
+    }
+
+    /// Returns false and leaves the existing entry untouched if the key is already known
+    bool Insert(const Key& key, const Value& value, int64_t nDeadline)
+    {
+        auto ret = mapEntries.emplace(key, entry_t(value, std::max(nDeadline, int64_t(0))));
+        if (!ret.second) return false;
+        entry_t& entry = ret.first->second;
+        listDue.push_back(key);
+        entry.pSlot = &listDue;
+        entry.itSlot = std::prev(listDue.end());
+        Schedule(entry);
+        return true;
+    }
+
+    bool Insert(const Key& key, int64_t nDeadline)
+    {
+        return Insert(key, Value(), nDeadline);
+    }
+
+    bool GetDeadline(const Key& key, int64_t& nDeadlineRet) const
+    {
+        auto it = mapEntries.find(key);
+        if (it == mapEntries.end()) return false;
+        nDeadlineRet = it->second.nDeadline;
+        return true;
+    }
+
+    bool SetDeadline(const Key& key, int64_t nDeadline)
+    {
+        auto it = mapEntries.find(key);
+        if (it == mapEntries.end()) return false;
+        it->second.nDeadline = std::max(nDeadline, int64_t(0));
+        Schedule(it->second);
+        return true;
+    }
+
+    void Erase(const Key& key)
+    {
+        auto it = mapEntries.find(key);
+        if (it == mapEntries.end()) return;
+        it->second.pSlot->erase(it->second.itSlot);
+        mapEntries.erase(it);
+    }
+
+    void Clear()
+    {
+        mapEntries.clear();
+        listDue.clear();
+        for (auto& level : wheel) {
+            for (auto& slot : level) {
+                slot.clear();
+            }
+        }
+    }
+
+    /**
+     * Calls fn(key, value, nDeadline) for every entry with a deadline before nNow.
+     * The entry is removed afterwards, unless fn moved nDeadline to nNow or later.
+     * fn must not modify the map itself. Returns the number of removed entries.
+     */
+    template<typename Callback>
+    size_t Expire(int64_t nNow, Callback&& fn)
+    {
+        const int64_t nTarget = nNow - 1;
+        slot_t listPending;
+        listPending.splice(listPending.end(), listDue);
+        if (nTarget > nCurrentTick) {
+            Advance(nTarget, listPending);
+        }
+
+        size_t nRemoved = 0;
+        while (!listPending.empty()) {
+            auto itKey = listPending.begin();
+            auto it = mapEntries.find(*itKey);
+            assert(it != mapEntries.end());
+            entry_t& entry = it->second;
+            entry.pSlot = &listPending;
+            entry.itSlot = itKey;
+            if (entry.nDeadline <= nTarget) {
+                fn(it->first, entry.value, entry.nDeadline);
+                if (entry.nDeadline <= nTarget) {
+                    listPending.erase(itKey);
+                    mapEntries.erase(it);
+                    nRemoved++;
+                    continue;
+                }
+                entry.nDeadline = std::max(entry.nDeadline, int64_t(0));
+            }
+            Schedule(entry);
+        }
+        return nRemoved;
+    }
+
+    size_t Expire(int64_t nNow)
+    {
+        return Expire(nNow, [](const Key&, Value&, int64_t&) {});
+    }
+
+    /// Usage of the index and the wheel, memory owned by the values themselves is not included
+    size_t DynamicMemoryUsage() const
+    {
+        // std::list node: two pointers and the key
+        return memusage::DynamicUsage(mapEntries) +
+               mapEntries.size() * memusage::MallocUsage(sizeof(Key) + 2 * sizeof(void*));
+    }
+
+    CExpiringMapStats GetStats() const
+    {
+        CExpiringMapStats stats;
+        stats.nEntries = Size();
+        stats.nUsage = DynamicMemoryUsage();
+        return stats;
+    }
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        WriteCompactSize(s, mapEntries.size());
+        for (const auto& pair : mapEntries) {
+            s << pair.first;
+            s << pair.second.nDeadline;
+            s << pair.second.value;
+        }
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        Clear();
+        uint64_t nSize = ReadCompactSize(s);
+        for (uint64_t i = 0; i < nSize; i++) {
+            Key key;
+            int64_t nDeadline;
+            Value value;
+            s >> key;
+            s >> nDeadline;
+            s >> value;
+            Insert(key, value, nDeadline);
+        }
+    }
+
+private:
+    /// Moves the entry into the slot matching its deadline relative to nCurrentTick
+    void Schedule(entry_t& entry)
+    {
+        slot_t* pSlotNew = &listDue;
+        if (entry.nDeadline > nCurrentTick) {
+            uint64_t nDiff = uint64_t(entry.nDeadline) ^ uint64_t(nCurrentTick);
+            int nLevel = 0;
+            while (nLevel < WHEEL_LEVELS - 1 && (nDiff >> (WHEEL_BITS * (nLevel + 1))) != 0) {
+                nLevel++;
+            }
+            pSlotNew = &wheel[nLevel][(uint64_t(entry.nDeadline) >> (WHEEL_BITS * nLevel)) & (WHEEL_SLOTS - 1)];
+        }
+        pSlotNew->splice(pSlotNew->end(), *entry.pSlot, entry.itSlot);
+        entry.pSlot = pSlotNew;
+    }
+
+    /**
+     * Moves the wheel forward to nTarget and collects all entries from the slots
+     * which were passed into listPending. Entries in a level N slot all share the
+     * bits above level N with nCurrentTick, so a slot has to be collected once
+     * nCurrentTick reaches it, or once nCurrentTick leaves the window it belongs to.
+     */
+    void Advance(int64_t nTarget, slot_t& listPending)
+    {
+        const uint64_t nCur = uint64_t(nCurrentTick);
+        const uint64_t nTgt = uint64_t(nTarget);
+        for (int nLevel = 0; nLevel < WHEEL_LEVELS; nLevel++) {
+            const int nShift = WHEEL_BITS * nLevel;
+            bool fSameWindow = nLevel == WHEEL_LEVELS - 1 || ((nCur ^ nTgt) >> (nShift + WHEEL_BITS)) == 0;
+            size_t nFirst = ((nCur >> nShift) & (WHEEL_SLOTS - 1)) + 1;
+            size_t nLast = fSameWindow ? ((nTgt >> nShift) & (WHEEL_SLOTS - 1)) : WHEEL_SLOTS - 1;
+            for (size_t i = nFirst; i <= nLast; i++) {
+                listPending.splice(listPending.end(), wheel[nLevel][i]);
+            }
+            if (fSameWindow) break;
+        }
+        nCurrentTick = nTarget;
+    }
+};
+
+template<typename Key, typename Hasher = std::hash<Key>>
+using CExpiringSet = CExpiringMap<Key, CExpiringMapNoValue, Hasher>;
+
+#endif // EXPIRINGMAP_H_
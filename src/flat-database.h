@@ -10,6 +10,7 @@
 #include "clientversion.h"
 #include "hash.h"
 #include "streams.h"
+#include "tracing.h"
 #include "util.h"
 
 #include <boost/filesystem.hpp>
@@ -174,6 +175,7 @@ public:
 
     bool Load(T& objToLoad)
     {
+        TRACE_SPAN_ARG("CFlatDB::Load", strFilename);
         LogPrintf("Reading info from %s...\n", strFilename);
         ReadResult readResult = Read(objToLoad);
         if (readResult == FileError)
@@ -196,6 +198,7 @@ public:
 
     bool Dump(T& objToSave)
     {
+        TRACE_SPAN_ARG("CFlatDB::Dump", strFilename);
         int64_t nStart = GetTimeMillis();
 
         LogPrintf("Verifying %s format...\n", strFilename);
@@ -32,6 +32,13 @@ static const int GOVERNANCE_FILTER_PROTO_VERSION = 70211;
 
 static const double GOVERNANCE_FILTER_FP_RATE = 0.001;
 
+// vote set reconciliation: sketches are sized for 1 in GOVERNANCE_RECON_DIFF_RATIO votes (at least
+// GOVERNANCE_RECON_MIN_DIFF) to be missing on one of the sides, bigger differences fall back to a bloom filter
+static const size_t GOVERNANCE_RECON_MIN_DIFF = 64;
+static const size_t GOVERNANCE_RECON_DIFF_RATIO = 32;
+static const size_t GOVERNANCE_RECON_MAX_CELLS = 30000;
+static const int64_t GOVERNANCE_RECON_REQUEST_TIMEOUT = 5 * 60;
+
 static const int GOVERNANCE_OBJECT_UNKNOWN = 0;
 static const int GOVERNANCE_OBJECT_PROPOSAL = 1;
 static const int GOVERNANCE_OBJECT_TRIGGER = 2;
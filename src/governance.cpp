@@ -9,6 +9,7 @@
 #include "governance-object.h"
 #include "governance-validators.h"
 #include "governance-vote.h"
+#include "hash.h"
 #include "init.h"
 #include "masternode-sync.h"
 #include "masternode.h"
@@ -17,6 +18,7 @@
 #include "net_processing.h"
 #include "netfulfilledman.h"
 #include "netmessagemaker.h"
+#include "tracing.h"
 #include "util.h"
 #include "validationinterface.h"
 
@@ -124,6 +126,46 @@ void CGovernanceManager::ProcessMessage(CNode* pfrom, const std::string& strComm
         LogPrint("gobject", "MNGOVERNANCESYNC -- syncing governance objects to our peer at %s\n", pfrom->addr.ToString());
     }
 
+    // ANOTHER USER WANTS TO RECONCILE THE VOTES OF A SINGLE GOVERNANCE OBJECT WITH US
+    else if (strCommand == NetMsgType::MNGOVERNANCERECON) {
+        if (pfrom->nVersion < MIN_GOVERNANCE_PEER_PROTO_VERSION) {
+            LogPrint("gobject", "MNGOVERNANCERECON -- peer=%d using obsolete version %i\n", pfrom->id, pfrom->nVersion);
+            return;
+        }
+
+        uint256 nProp;
+        uint64_t nSalt0;
+        uint64_t nSalt1;
+        CIBLT sketch;
+
+        vRecv >> nProp >> nSalt0 >> nSalt1 >> sketch;
+
+        if (sketch.IsNull()) {
+            // the peer could not decode the sketch we sent, ask again using a bloom filter
+            bool fRequested;
+            {
+                LOCK(cs);
+                fRequested = mapSketchRequests.erase(std::make_pair(pfrom->GetId(), nProp)) != 0;
+            }
+            if (fRequested) {
+                LogPrint("gobject", "MNGOVERNANCERECON -- peer=%d could not decode sketch for %s, falling back to bloom filter\n", pfrom->id, nProp.ToString());
+                RequestGovernanceObjectByFilter(pfrom, nProp, connman, true);
+            }
+            return;
+        }
+
+        // Ignore such requests until we are fully synced.
+        if (!masternodeSync.IsSynced()) return;
+
+        if (nProp.IsNull() || !sketch.IsValid(GOVERNANCE_RECON_MAX_CELLS)) {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), 20);
+            return;
+        }
+
+        SyncSingleObjAndItsVotes(pfrom, nProp, nSalt0, nSalt1, sketch, connman);
+    }
+
     // A NEW GOVERNANCE OBJECT HAS ARRIVED
     else if (strCommand == NetMsgType::MNGOVERNANCEOBJECT) {
         // MAKE SURE WE HAVE A VALID REFERENCE TO THE TIP BEFORE CONTINUING
@@ -160,7 +202,7 @@ void CGovernanceManager::ProcessMessage(CNode* pfrom, const std::string& strComm
         LOCK2(cs_main, cs);
 
         if (mapObjects.count(nHash) || mapPostponedObjects.count(nHash) ||
-            mapErasedGovernanceObjects.count(nHash) || mapMasternodeOrphanObjects.count(nHash)) {
+            mapErasedGovernanceObjects.Has(nHash) || mapMasternodeOrphanObjects.count(nHash)) {
             // TODO - print error code? what if it's GOVOBJ_ERROR_IMMATURE?
             LogPrint("gobject", "MNGOVERNANCEOBJECT -- Received already seen object: %s\n", strHash);
             return;
@@ -300,6 +342,7 @@ void CGovernanceManager::CheckOrphanVotes(CGovernanceObject& govobj, CGovernance
 
 void CGovernanceManager::AddGovernanceObject(CGovernanceObject& govobj, CConnman& connman, CNode* pfrom)
 {
+    TRACE_SPAN("CGovernanceManager::AddGovernanceObject");
     DBG(std::cout << "CGovernanceManager::AddGovernanceObject START" << std::endl;);
 
     uint256 nHash = govobj.GetHash();
@@ -373,6 +416,7 @@ void CGovernanceManager::AddGovernanceObject(CGovernanceObject& govobj, CConnman
 
 void CGovernanceManager::UpdateCachesAndClean()
 {
+    TRACE_SPAN("CGovernanceManager::UpdateCachesAndClean");
     LogPrint("gobject", "CGovernanceManager::UpdateCachesAndClean\n");
 
     std::vector<uint256> vecDirtyHashes = mnodeman.GetAndClearDirtyGovernanceObjectHashes();
@@ -451,7 +495,7 @@ void CGovernanceManager::UpdateCachesAndClean()
                 nTimeExpired = pObj->GetCreationTime() + 2 * nSuperblockCycleSeconds + GOVERNANCE_DELETION_DELAY;
             }
 
-            mapErasedGovernanceObjects.insert(std::make_pair(nHash, nTimeExpired));
+            mapErasedGovernanceObjects.Insert(nHash, nTimeExpired);
             mapObjects.erase(it++);
         } else {
             // NOTE: triggers are handled via triggerman
@@ -470,14 +514,7 @@ void CGovernanceManager::UpdateCachesAndClean()
     }
 
     // forget about expired deleted objects
-    hash_time_m_it s_it = mapErasedGovernanceObjects.begin();
-    while (s_it != mapErasedGovernanceObjects.end()) {
-        if (s_it->second < nNow) {
-            mapErasedGovernanceObjects.erase(s_it++);
-        } else {
-            ++s_it;
-        }
-    }
+    mapErasedGovernanceObjects.Expire(nNow);
 
     LogPrintf("CGovernanceManager::UpdateCachesAndClean -- %s\n", ToString());
 }
@@ -515,11 +552,11 @@ std::vector<CGovernanceVote> CGovernanceManager::GetCurrentVotes(const uint256&
     const CGovernanceObject& govobj = it->second;
 
     CMasternode mn;
-    std::map<COutPoint, CMasternode> mapMasternodes;
+    CMasternodeMan::snapshot_t mapMasternodes;
     if (mnCollateralOutpointFilter.IsNull()) {
-        mapMasternodes = mnodeman.GetFullMasternodeMap();
+        mapMasternodes = mnodeman.GetMasternodeMapSnapshot();
     } else if (mnodeman.Get(mnCollateralOutpointFilter, mn)) {
-        mapMasternodes[mnCollateralOutpointFilter] = mn;
+        mapMasternodes = mapMasternodes.set(mnCollateralOutpointFilter, mn);
     }
 
     // Loop thru each MN collateral outpoint and get the votes for the `nParentHash` governance object
@@ -576,6 +613,7 @@ struct sortProposalsByVotes {
 
 void CGovernanceManager::DoMaintenance(CConnman& connman)
 {
+    TRACE_SPAN("CGovernanceManager::DoMaintenance");
     if (fLiteMode || !masternodeSync.IsSynced() || ShutdownRequested()) return;
 
     if (deterministicMNManager->IsDeterministicMNsSporkActive()) {
@@ -648,12 +686,55 @@ bool CGovernanceManager::ConfirmInventoryRequest(const CInv& inv)
 }
 
 void CGovernanceManager::SyncSingleObjAndItsVotes(CNode* pnode, const uint256& nProp, const CBloomFilter& filter, CConnman& connman)
+{
+    SyncSingleObjAndItsVotes(pnode, nProp, [&](std::vector<uint256>& vecVoteHashes) {
+        vecVoteHashes.erase(std::remove_if(vecVoteHashes.begin(), vecVoteHashes.end(), [&](const uint256& nVoteHash) {
+            return filter.contains(nVoteHash);
+        }), vecVoteHashes.end());
+        return true;
+    }, connman);
+}
+
+void CGovernanceManager::SyncSingleObjAndItsVotes(CNode* pnode, const uint256& nProp, uint64_t nSalt0, uint64_t nSalt1, const CIBLT& sketch, CConnman& connman)
+{
+    SyncSingleObjAndItsVotes(pnode, nProp, [&](std::vector<uint256>& vecVoteHashes) {
+        // remove our votes from the peer's sketch, what's left are the votes only one of us knows
+        CIBLT sketchDiff(sketch);
+        std::vector<uint64_t> vecShortIds;
+        vecShortIds.reserve(vecVoteHashes.size());
+        for (const auto& nVoteHash : vecVoteHashes) {
+            vecShortIds.emplace_back(SipHashUint256(nSalt0, nSalt1, nVoteHash));
+            sketchDiff.Erase(vecShortIds.back());
+        }
+
+        std::set<uint64_t> setPeerOnly;
+        std::set<uint64_t> setOursOnly;
+        if (!sketchDiff.Decode(setPeerOnly, setOursOnly)) {
+            LogPrint("gobject", "CGovernanceManager::%s -- could not decode sketch (%d cells, %d votes), peer=%d\n", __func__,
+                sketch.GetCellCount(), vecVoteHashes.size(), pnode->id);
+            // answer with an empty sketch, the peer will fall back to a bloom filter
+            CNetMsgMaker msgMaker(pnode->GetSendVersion());
+            connman.PushMessage(pnode, msgMaker.Make(NetMsgType::MNGOVERNANCERECON, nProp, nSalt0, nSalt1, CIBLT()));
+            return false;
+        }
+
+        std::vector<uint256> vecMissing;
+        vecMissing.reserve(setOursOnly.size());
+        for (size_t i = 0; i < vecVoteHashes.size(); i++) {
+            if (setOursOnly.count(vecShortIds[i])) {
+                vecMissing.emplace_back(vecVoteHashes[i]);
+            }
+        }
+        vecVoteHashes.swap(vecMissing);
+        return true;
+    }, connman);
+}
+
+void CGovernanceManager::SyncSingleObjAndItsVotes(CNode* pnode, const uint256& nProp, const std::function<bool(std::vector<uint256>&)>& fnSelectVotes, CConnman& connman)
 {
     // do not provide any data until our node is synced
     if (!masternodeSync.IsSynced()) return;
 
-    int nVoteCount = 0;
-
     // SYNC GOVERNANCE OBJECTS WITH OTHER CLIENT
 
     LogPrint("gobject", "CGovernanceManager::%s -- syncing single object to peer=%d, nProp = %s\n", __func__, pnode->id, nProp.ToString());
@@ -677,23 +758,29 @@ void CGovernanceManager::SyncSingleObjAndItsVotes(CNode* pnode, const uint256& n
         return;
     }
 
-    // Push the govobj inventory message over to the other client
-    LogPrint("gobject", "CGovernanceManager::%s -- syncing govobj: %s, peer=%d\n", __func__, strHash, pnode->id);
-    pnode->PushInventory(CInv(MSG_GOVERNANCE_OBJECT, it->first));
-
     auto fileVotes = govobj.GetVoteFile();
 
+    std::vector<uint256> vecVoteHashes;
     for (const auto& vote : fileVotes.GetVotes()) {
-        uint256 nVoteHash = vote.GetHash();
-
         bool onlyVotingKeyAllowed = govobj.GetObjectType() == GOVERNANCE_OBJECT_PROPOSAL && vote.GetSignal() == VOTE_SIGNAL_FUNDING;
 
-        if (filter.contains(nVoteHash) || !vote.IsValid(onlyVotingKeyAllowed)) {
-            continue;
+        if (vote.IsValid(onlyVotingKeyAllowed)) {
+            vecVoteHashes.emplace_back(vote.GetHash());
         }
+    }
+
+    if (!fnSelectVotes(vecVoteHashes)) {
+        return;
+    }
+
+    // Push the govobj inventory message over to the other client
+    LogPrint("gobject", "CGovernanceManager::%s -- syncing govobj: %s, peer=%d\n", __func__, strHash, pnode->id);
+    pnode->PushInventory(CInv(MSG_GOVERNANCE_OBJECT, it->first));
+
+    for (const auto& nVoteHash : vecVoteHashes) {
         pnode->PushInventory(CInv(MSG_GOVERNANCE_OBJECT_VOTE, nVoteHash));
-        ++nVoteCount;
     }
+    int nVoteCount = vecVoteHashes.size();
 
     CNetMsgMaker msgMaker(pnode->GetSendVersion());
     connman.PushMessage(pnode, msgMaker.Make(NetMsgType::SYNCSTATUSCOUNT, MASTERNODE_SYNC_GOVOBJ, 1));
@@ -844,6 +931,7 @@ bool CGovernanceManager::MasternodeRateCheck(const CGovernanceObject& govobj, bo
 
 bool CGovernanceManager::ProcessVote(CNode* pfrom, const CGovernanceVote& vote, CGovernanceException& exception, CConnman& connman)
 {
+    TRACE_SPAN("CGovernanceManager::ProcessVote");
     ENTER_CRITICAL_SECTION(cs);
     uint256 nHashVote = vote.GetHash();
     uint256 nHashGovobj = vote.GetParentHash();
@@ -944,6 +1032,7 @@ void CGovernanceManager::CheckMasternodeOrphanObjects(CConnman& connman)
 
 void CGovernanceManager::CheckPostponedObjects(CConnman& connman)
 {
+    TRACE_SPAN("CGovernanceManager::CheckPostponedObjects");
     if (!masternodeSync.IsSynced()) return;
 
     LOCK2(cs_main, cs);
@@ -1015,14 +1104,69 @@ void CGovernanceManager::RequestGovernanceObject(CNode* pfrom, const uint256& nH
 
     LogPrint("gobject", "CGovernanceManager::RequestGovernanceObject -- nHash %s peer=%d\n", nHash.ToString(), pfrom->GetId());
 
-    CNetMsgMaker msgMaker(pfrom->GetSendVersion());
-
     if (pfrom->nVersion < GOVERNANCE_FILTER_PROTO_VERSION) {
         // dont waste time with old nodes
         //connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MNGOVERNANCESYNC, nHash));
         return;
     }
 
+    if (fUseFilter && pfrom->fGovernanceRecon && RequestGovernanceObjectBySketch(pfrom, nHash, connman)) {
+        return;
+    }
+
+    RequestGovernanceObjectByFilter(pfrom, nHash, connman, fUseFilter);
+}
+
+bool CGovernanceManager::RequestGovernanceObjectBySketch(CNode* pfrom, const uint256& nHash, CConnman& connman)
+{
+    uint64_t nSalt0 = GetRand(std::numeric_limits<uint64_t>::max());
+    uint64_t nSalt1 = GetRand(std::numeric_limits<uint64_t>::max());
+    CIBLT sketch;
+    size_t nVoteCount;
+
+    {
+        LOCK(cs);
+        CGovernanceObject* pObj = FindGovernanceObject(nHash);
+        if (!pObj) {
+            return false;
+        }
+        std::vector<CGovernanceVote> vecVotes = pObj->GetVoteFile().GetVotes();
+        nVoteCount = vecVotes.size();
+        // without votes of our own there is nothing to reconcile, an empty bloom filter is smaller
+        if (vecVotes.empty()) {
+            return false;
+        }
+
+        // decoding needs about 1.5 cells per vote which only one of us knows, leave some headroom
+        size_t nExpectedDiff = std::max(GOVERNANCE_RECON_MIN_DIFF, nVoteCount / GOVERNANCE_RECON_DIFF_RATIO);
+        sketch = CIBLT(std::min(nExpectedDiff * 2, GOVERNANCE_RECON_MAX_CELLS));
+        for (const auto& vote : vecVotes) {
+            sketch.Insert(SipHashUint256(nSalt0, nSalt1, vote.GetHash()));
+        }
+
+        int64_t nNow = GetTime();
+        auto it = mapSketchRequests.begin();
+        while (it != mapSketchRequests.end()) {
+            if (it->second < nNow) {
+                mapSketchRequests.erase(it++);
+            } else {
+                ++it;
+            }
+        }
+        mapSketchRequests[std::make_pair(pfrom->GetId(), nHash)] = nNow + GOVERNANCE_RECON_REQUEST_TIMEOUT;
+    }
+
+    LogPrint("gobject", "CGovernanceManager::RequestGovernanceObjectBySketch -- nHash %s nVoteCount %d cells %d peer=%d\n",
+        nHash.ToString(), nVoteCount, sketch.GetCellCount(), pfrom->id);
+    CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MNGOVERNANCERECON, nHash, nSalt0, nSalt1, sketch));
+    return true;
+}
+
+void CGovernanceManager::RequestGovernanceObjectByFilter(CNode* pfrom, const uint256& nHash, CConnman& connman, bool fUseFilter)
+{
+    CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+
     CBloomFilter filter;
     filter.clear();
 
@@ -1228,6 +1372,12 @@ void CGovernanceManager::InitOnLoad()
     LogPrintf("     %s\n", ToString());
 }
 
+CExpiringMapStats CGovernanceManager::GetErasedObjectsStats() const
+{
+    LOCK(cs);
+    return mapErasedGovernanceObjects.GetStats();
+}
+
 std::string CGovernanceManager::ToString() const
 {
     LOCK(cs);
@@ -1252,7 +1402,7 @@ std::string CGovernanceManager::ToString() const
 
     return strprintf("Governance Objects: %d (Proposals: %d, Triggers: %d, Other: %d; Erased: %d), Votes: %d",
         (int)mapObjects.size(),
-        nProposalCount, nTriggerCount, nOtherCount, (int)mapErasedGovernanceObjects.size(),
+        nProposalCount, nTriggerCount, nOtherCount, (int)mapErasedGovernanceObjects.Size(),
         (int)cmapVoteToObject.GetSize());
 }
 
@@ -1283,7 +1433,7 @@ UniValue CGovernanceManager::ToJson() const
     jsonObj.push_back(Pair("proposals", nProposalCount));
     jsonObj.push_back(Pair("triggers", nTriggerCount));
     jsonObj.push_back(Pair("other", nOtherCount));
-    jsonObj.push_back(Pair("erased", (int)mapErasedGovernanceObjects.size()));
+    jsonObj.push_back(Pair("erased", (int)mapErasedGovernanceObjects.Size()));
     jsonObj.push_back(Pair("votes", (int)cmapVoteToObject.GetSize()));
     return jsonObj;
 }
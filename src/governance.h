@@ -11,10 +11,13 @@
 #include "cachemap.h"
 #include "cachemultimap.h"
 #include "chain.h"
+#include "expiringmap.h"
 #include "governance-exceptions.h"
 #include "governance-object.h"
 #include "governance-vote.h"
+#include "iblt.h"
 #include "net.h"
+#include "saltedhasher.h"
 #include "sync.h"
 #include "timedata.h"
 #include "util.h"
@@ -23,6 +26,8 @@
 
 #include <univalue.h>
 
+#include <functional>
+
 class CGovernanceManager;
 class CGovernanceTriggerManager;
 class CGovernanceObject;
@@ -216,11 +221,7 @@ public: // Types
 
     typedef object_info_m_t::const_iterator object_info_m_cit;
 
-    typedef std::map<uint256, int64_t> hash_time_m_t;
-
-    typedef hash_time_m_t::iterator hash_time_m_it;
-
-    typedef hash_time_m_t::const_iterator hash_time_m_cit;
+    typedef CExpiringSet<uint256, StaticSaltedHasher> hash_time_m_t;
 
 private:
     static const int MAX_CACHE_SIZE = 1000000;
@@ -238,9 +239,8 @@ private:
     // keep track of the scanning errors
     object_m_t mapObjects;
 
-    // mapErasedGovernanceObjects contains key-value pairs, where
-    //   key   - governance object's hash
-    //   value - expiration time for deleted objects
+    // mapErasedGovernanceObjects contains hashes of deleted governance objects,
+    // entries are dropped once their expiration time (the deadline) has passed
     hash_time_m_t mapErasedGovernanceObjects;
 
     object_info_m_t mapMasternodeOrphanObjects;
@@ -261,6 +261,9 @@ private:
 
     hash_s_t setRequestedVotes;
 
+    // sketches we sent, the peer may answer with an empty one if it can't decode it
+    std::map<std::pair<NodeId, uint256>, int64_t> mapSketchRequests;
+
     bool fRateChecksEnabled;
 
     // used to check for changed voting keys
@@ -302,6 +305,7 @@ public:
     bool ConfirmInventoryRequest(const CInv& inv);
 
     void SyncSingleObjAndItsVotes(CNode* pnode, const uint256& nProp, const CBloomFilter& filter, CConnman& connman);
+    void SyncSingleObjAndItsVotes(CNode* pnode, const uint256& nProp, uint64_t nSalt0, uint64_t nSalt1, const CIBLT& sketch, CConnman& connman);
     void SyncAll(CNode* pnode, CConnman& connman) const;
 
     void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman);
@@ -327,7 +331,7 @@ public:
 
         LogPrint("gobject", "Governance object manager was cleared\n");
         mapObjects.clear();
-        mapErasedGovernanceObjects.clear();
+        mapErasedGovernanceObjects.Clear();
         cmapVoteToObject.Clear();
         cmapInvalidVotes.Clear();
         cmmapOrphanVotes.Clear();
@@ -336,6 +340,7 @@ public:
 
     std::string ToString() const;
     UniValue ToJson() const;
+    CExpiringMapStats GetErasedObjectsStats() const;
 
     ADD_SERIALIZE_METHODS;
 
@@ -423,7 +428,16 @@ public:
     int RequestGovernanceObjectVotes(const std::vector<CNode*>& vNodesCopy, CConnman& connman);
 
 private:
+    /**
+     * Pushes the object and the hashes of its valid votes to the peer. fnSelectVotes gets the hashes of all
+     * valid votes and has to remove the ones the peer already knows, nothing is sent when it returns false.
+     */
+    void SyncSingleObjAndItsVotes(CNode* pnode, const uint256& nProp, const std::function<bool(std::vector<uint256>&)>& fnSelectVotes, CConnman& connman);
+
     void RequestGovernanceObject(CNode* pfrom, const uint256& nHash, CConnman& connman, bool fUseFilter = false);
+    /// Asks for the votes we miss with a sketch of the votes we have, returns false if a sketch makes no sense
+    bool RequestGovernanceObjectBySketch(CNode* pfrom, const uint256& nHash, CConnman& connman);
+    void RequestGovernanceObjectByFilter(CNode* pfrom, const uint256& nHash, CConnman& connman, bool fUseFilter);
 
     void AddInvalidVote(const CGovernanceVote& vote)
     {
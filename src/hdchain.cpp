@@ -148,15 +148,13 @@ uint256 CHDChain::GetSeedHash()
     return Hash(vchSeed.begin(), vchSeed.end());
 }
 
-void CHDChain::DeriveChildExtKey(uint32_t nAccountIndex, bool fInternal, uint32_t nChildIndex, CExtKey& extKeyRet)
+void CHDChain::DeriveChangeExtKey(uint32_t nAccountIndex, bool fInternal, CExtKey& extKeyRet)
 {
-    // Use BIP44 keypath scheme i.e. m / purpose' / coin_type' / account' / change / address_index
+    // Use BIP44 keypath scheme i.e. m / purpose' / coin_type' / account' / change
     CExtKey masterKey;              //hd master key
     CExtKey purposeKey;             //key at m/purpose'
     CExtKey cointypeKey;            //key at m/purpose'/coin_type'
     CExtKey accountKey;             //key at m/purpose'/coin_type'/account'
-    CExtKey changeKey;              //key at m/purpose'/coin_type'/account'/change
-    CExtKey childKey;               //key at m/purpose'/coin_type'/account'/change/address_index
 
     masterKey.SetMaster(&vchSeed[0], vchSeed.size());
 
@@ -170,7 +168,14 @@ void CHDChain::DeriveChildExtKey(uint32_t nAccountIndex, bool fInternal, uint32_
     // derive m/purpose'/coin_type'/account'
     cointypeKey.Derive(accountKey, nAccountIndex | 0x80000000);
     // derive m/purpose'/coin_type'/account'/change
-    accountKey.Derive(changeKey, fInternal ? 1 : 0);
+    accountKey.Derive(extKeyRet, fInternal ? 1 : 0);
+}
+
+void CHDChain::DeriveChildExtKey(uint32_t nAccountIndex, bool fInternal, uint32_t nChildIndex, CExtKey& extKeyRet)
+{
+    CExtKey changeKey;              //key at m/purpose'/coin_type'/account'/change
+
+    DeriveChangeExtKey(nAccountIndex, fInternal, changeKey);
     // derive m/purpose'/coin_type'/account'/change/address_index
     changeKey.Derive(extKeyRet, nChildIndex);
 }
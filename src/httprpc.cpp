@@ -7,6 +7,7 @@
 #include "base58.h"
 #include "chainparams.h"
 #include "httpserver.h"
+#include "rpc/jsonstream.h"
 #include "rpc/protocol.h"
 #include "rpc/server.h"
 #include "random.h"
@@ -176,6 +177,18 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         return false;
     }
 
+    // Replies are streamed: once the first chunk is out the status is fixed,
+    // until then an error can still be reported the usual way
+    bool fReplyStarted = false;
+    CJSONStreamWriter writer([req, &fReplyStarted](const std::string& strChunk) {
+        if (!fReplyStarted) {
+            req->WriteHeader("Content-Type", "application/json");
+            req->StartChunkedReply(HTTP_OK);
+            fReplyStarted = true;
+        }
+        req->WriteReplyChunk(strChunk);
+    });
+
     try {
         // Parse request
         UniValue valRequest;
@@ -185,28 +198,48 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         // Set the URI
         jreq.URI = req->GetURI();
 
-        std::string strReply;
         // singleton request
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
+            // Same layout as JSONRPCReply, with the result written in place
+            writer.BeginObject();
+            writer.Key("result");
+            jreq.pStreamWriter = &writer;
             UniValue result = tableRPC.execute(jreq);
-
-            // Send reply
-            strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+            if (writer.ExpectsValue())
+                writer.Value(result);
+            writer.Pair("error", NullUniValue);
+            writer.Pair("id", jreq.id);
+            writer.EndObject();
 
         // array of requests
         } else if (valRequest.isArray())
-            strReply = JSONRPCExecBatch(valRequest.get_array());
+            JSONRPCExecBatch(valRequest.get_array(), writer);
         else
             throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
 
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strReply);
+        if (fReplyStarted) {
+            req->WriteReplyChunk(writer.TakeBuffer() + "\n");
+            req->EndChunkedReply();
+        } else {
+            req->WriteHeader("Content-Type", "application/json");
+            req->WriteReply(HTTP_OK, writer.TakeBuffer() + "\n");
+        }
     } catch (const UniValue& objError) {
+        if (fReplyStarted) {
+            LogPrintf("ThreadRPCServer error after partial reply to %s: %s\n", jreq.strMethod, objError.write());
+            req->EndChunkedReply();
+            return false;
+        }
         JSONErrorReply(req, objError, jreq.id);
         return false;
     } catch (const std::exception& e) {
+        if (fReplyStarted) {
+            LogPrintf("ThreadRPCServer error after partial reply to %s: %s\n", jreq.strMethod, e.what());
+            req->EndChunkedReply();
+            return false;
+        }
         JSONErrorReply(req, JSONRPCError(RPC_PARSE_ERROR, e.what()), jreq.id);
         return false;
     }
@@ -546,12 +546,17 @@ void HTTPEvent::trigger(struct timeval* tv)
         evtimer_add(ev, tv); // trigger after timeval passed
 }
 HTTPRequest::HTTPRequest(struct evhttp_request* _req) : req(_req),
-                                                       replySent(false)
+                                                       replySent(false),
+                                                       replyStarted(false)
 {
 }
 HTTPRequest::~HTTPRequest()
 {
-    if (!replySent) {
+    if (replyStarted && !replySent) {
+        // Status and part of the body are out already, just terminate the reply
+        LogPrintf("%s: Unfinished chunked reply\n", __func__);
+        EndChunkedReply();
+    } else if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
         WriteReply(HTTP_INTERNAL, "Unhandled request");
@@ -603,12 +608,22 @@ void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
  * this cannot be done from worker threads.
  */
 void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
+{
+    WriteReplyData(nStatus, strReply.data(), strReply.size());
+}
+
+void HTTPRequest::WriteReply(int nStatus, const std::vector<unsigned char>& vchReply)
+{
+    WriteReplyData(nStatus, vchReply.data(), vchReply.size());
+}
+
+void HTTPRequest::WriteReplyData(int nStatus, const void* pdata, size_t nSize)
 {
     assert(!replySent && req);
     // Send event to main http thread to send reply message
     struct evbuffer* evb = evhttp_request_get_output_buffer(req);
     assert(evb);
-    evbuffer_add(evb, strReply.data(), strReply.size());
+    evbuffer_add(evb, pdata, nSize);
     HTTPEvent* ev = new HTTPEvent(eventBase, true,
         std::bind(evhttp_send_reply, req, nStatus, (const char*)NULL, (struct evbuffer *)NULL));
     ev->trigger(0);
@@ -616,6 +631,49 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     req = 0; // transferred back to main thread
 }
 
+/** Chunked replies are sent the same way, each piece is posted to the main
+ * http thread as its own event. Events are run in the order they were
+ * triggered, so the pieces go out in order.
+ */
+void HTTPRequest::StartChunkedReply(int nStatus)
+{
+    assert(!replySent && !replyStarted && req);
+    HTTPEvent* ev = new HTTPEvent(eventBase, true,
+        std::bind(evhttp_send_reply_start, req, nStatus, (const char*)NULL));
+    ev->trigger(0);
+    replyStarted = true;
+}
+
+static void http_send_reply_chunk(struct evhttp_request* req, const std::string& strChunk)
+{
+    struct evbuffer* evb = evbuffer_new();
+    if (!evb)
+        return;
+    evbuffer_add(evb, strChunk.data(), strChunk.size());
+    evhttp_send_reply_chunk(req, evb);
+    evbuffer_free(evb);
+}
+
+void HTTPRequest::WriteReplyChunk(const std::string& strChunk)
+{
+    assert(replyStarted && !replySent && req);
+    if (strChunk.empty())
+        return; // an empty chunk would terminate the reply
+    HTTPEvent* ev = new HTTPEvent(eventBase, true,
+        std::bind(http_send_reply_chunk, req, strChunk));
+    ev->trigger(0);
+}
+
+void HTTPRequest::EndChunkedReply()
+{
+    assert(replyStarted && !replySent && req);
+    HTTPEvent* ev = new HTTPEvent(eventBase, true,
+        std::bind(evhttp_send_reply_end, req));
+    ev->trigger(0);
+    replySent = true;
+    req = 0; // transferred back to main thread
+}
+
 CService HTTPRequest::GetPeer()
 {
     evhttp_connection* con = evhttp_request_get_connection(req);
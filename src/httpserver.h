@@ -8,6 +8,7 @@
 #include <string>
 #include <stdint.h>
 #include <functional>
+#include <vector>
 
 static const int DEFAULT_HTTP_THREADS=4;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
@@ -55,6 +56,9 @@ class HTTPRequest
 private:
     struct evhttp_request* req;
     bool replySent;
+    bool replyStarted;
+
+    void WriteReplyData(int nStatus, const void* pdata, size_t nSize);
 
 public:
     HTTPRequest(struct evhttp_request* req);
@@ -110,6 +114,28 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+    /** Same as above for binary replies, saves copying them into a string first */
+    void WriteReply(int nStatus, const std::vector<unsigned char>& vchReply);
+
+    /**
+     * Start a reply whose body is sent in pieces (chunked transfer encoding
+     * for HTTP/1.1 clients). nStatus is the HTTP status code to send.
+     *
+     * @note Call WriteHeader before this. Follow up with any number of
+     * WriteReplyChunk calls and finish with EndChunkedReply instead of WriteReply.
+     */
+    void StartChunkedReply(int nStatus);
+
+    /**
+     * Queue the next piece of a reply started with StartChunkedReply.
+     */
+    void WriteReplyChunk(const std::string& strChunk);
+
+    /**
+     * Finish a chunked reply. As with WriteReply, the request is given back
+     * to the main thread, do not call any other HTTPRequest methods after this.
+     */
+    void EndChunkedReply();
 };
 
 /** Event handler closure.
@@ -0,0 +1,79 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "iblt.h"
+
+#include <deque>
+
+CIBLT::CIBLT(size_t nCells) :
+    vecCells((nCells + NUM_HASHES - 1) / NUM_HASHES * NUM_HASHES)
+{
+}
+
+uint64_t CIBLT::Mix(uint64_t nKey, int nHash)
+{
+    // splitmix64 finalizer, with a different offset for every hash
+    uint64_t x = nKey + 0x9e3779b97f4a7c15ULL * (nHash + 1);
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+void CIBLT::Update(std::vector<Cell>& vecCellsIn, uint64_t nKey, int32_t nDelta)
+{
+    if (vecCellsIn.empty()) return;
+
+    // every hash has its own part of the table, so a key never hits the same cell twice
+    const size_t nPartSize = vecCellsIn.size() / NUM_HASHES;
+    const uint32_t nCheckSum = CheckSum(nKey);
+    for (int i = 0; i < NUM_HASHES; i++) {
+        Cell& cell = vecCellsIn[i * nPartSize + Mix(nKey, i) % nPartSize];
+        cell.nCount += nDelta;
+        cell.nKeySum ^= nKey;
+        cell.nCheckSum ^= nCheckSum;
+    }
+}
+
+bool CIBLT::Decode(std::set<uint64_t>& setInsertedRet, std::set<uint64_t>& setErasedRet) const
+{
+    setInsertedRet.clear();
+    setErasedRet.clear();
+
+    std::vector<Cell> vecWork(vecCells);
+    std::deque<size_t> queuePure;
+    for (size_t i = 0; i < vecWork.size(); i++) {
+        if (IsPure(vecWork[i])) {
+            queuePure.push_back(i);
+        }
+    }
+
+    const size_t nPartSize = vecWork.size() / NUM_HASHES;
+    while (!queuePure.empty()) {
+        const Cell& cell = vecWork[queuePure.front()];
+        queuePure.pop_front();
+        // might have been peeled already through another cell
+        if (!IsPure(cell)) continue;
+
+        uint64_t nKey = cell.nKeySum;
+        int32_t nCount = cell.nCount;
+        std::set<uint64_t>& setRet = nCount > 0 ? setInsertedRet : setErasedRet;
+        // a key can only be listed once, seeing it again means the table is corrupted
+        if (!setRet.insert(nKey).second) return false;
+        // no table can hold more decodable keys than it has cells, stop peeling garbage early
+        if (setInsertedRet.size() + setErasedRet.size() > vecWork.size()) return false;
+
+        Update(vecWork, nKey, -nCount);
+        for (int i = 0; i < NUM_HASHES; i++) {
+            size_t nIndex = i * nPartSize + Mix(nKey, i) % nPartSize;
+            if (IsPure(vecWork[nIndex])) {
+                queuePure.push_back(nIndex);
+            }
+        }
+    }
+
+    for (const auto& cell : vecWork) {
+        if (!cell.IsEmpty()) return false;
+    }
+    return true;
+}
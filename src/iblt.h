@@ -0,0 +1,89 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef IBLT_H
+#define IBLT_H
+
+#include "serialize.h"
+
+#include <set>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Invertible bloom lookup table over 64-bit keys, used for set reconciliation.
+ *
+ * One side inserts all of its keys, the other side erases all of its keys from the same table.
+ * Keys known to both sides cancel out, so the table only has to be big enough for the keys which
+ * are known to one side only. Those can be listed by Decode() as long as there are not more of
+ * them than about 2/3 of the number of cells, no matter how big both sets are.
+ *
+ * Keys must be uniformly distributed (e.g. salted short ids), they are used for the cell indexes as is.
+ */
+class CIBLT
+{
+public:
+    static const int NUM_HASHES = 3;
+    // 4 byte count + 8 byte key sum + 4 byte check sum
+    static const size_t CELL_SIZE = 16;
+
+    struct Cell
+    {
+        int32_t nCount;
+        uint64_t nKeySum;
+        uint32_t nCheckSum;
+
+        Cell() : nCount(0), nKeySum(0), nCheckSum(0) {}
+
+        bool IsEmpty() const { return nCount == 0 && nKeySum == 0 && nCheckSum == 0; }
+
+        ADD_SERIALIZE_METHODS;
+
+        template <typename Stream, typename Operation>
+        inline void SerializationOp(Stream& s, Operation ser_action)
+        {
+            READWRITE(nCount);
+            READWRITE(nKeySum);
+            READWRITE(nCheckSum);
+        }
+    };
+
+private:
+    std::vector<Cell> vecCells;
+
+    static uint64_t Mix(uint64_t nKey, int nHash);
+    static uint32_t CheckSum(uint64_t nKey) { return (uint32_t)Mix(nKey, NUM_HASHES); }
+    static bool IsPure(const Cell& cell) { return (cell.nCount == 1 || cell.nCount == -1) && cell.nCheckSum == CheckSum(cell.nKeySum); }
+
+    static void Update(std::vector<Cell>& vecCellsIn, uint64_t nKey, int32_t nDelta);
+
+public:
+    CIBLT() {}
+    /// The number of cells is rounded up to a multiple of NUM_HASHES
+    explicit CIBLT(size_t nCells);
+
+    size_t GetCellCount() const { return vecCells.size(); }
+    bool IsNull() const { return vecCells.empty(); }
+    /// Tables received from the network must have passed this before they are used
+    bool IsValid(size_t nMaxCells) const { return vecCells.size() <= nMaxCells && vecCells.size() % NUM_HASHES == 0; }
+
+    void Insert(uint64_t nKey) { Update(vecCells, nKey, 1); }
+    void Erase(uint64_t nKey) { Update(vecCells, nKey, -1); }
+
+    /**
+     * Lists the keys which were inserted but not erased (setInsertedRet) and the ones which were erased
+     * but not inserted (setErasedRet). Returns false if the table has too many of them to be decoded.
+     */
+    bool Decode(std::set<uint64_t>& setInsertedRet, std::set<uint64_t>& setErasedRet) const;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(vecCells);
+    }
+};
+
+#endif // IBLT_H
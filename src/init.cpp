@@ -14,9 +14,12 @@
 #include "addrman.h"
 #include "amount.h"
 #include "base58.h"
+#include "blockcache.h"
 #include "chain.h"
 #include "chainparams.h"
+#include "chainstaterebuild.h"
 #include "checkpoints.h"
+#include "coinsprefetch.h"
 #include "compat/sanity.h"
 #include "consensus/validation.h"
 #include "httpserver.h"
@@ -38,6 +41,7 @@
 #include "txdb.h"
 #include "txmempool.h"
 #include "torcontrol.h"
+#include "tracing.h"
 #include "ui_interface.h"
 #include "util.h"
 #include "utilmoneystr.h"
@@ -93,7 +97,9 @@
 #include <openssl/crypto.h>
 
 #if ENABLE_ZMQ
+#include "zmq/zmqabstractnotifier.h"
 #include "zmq/zmqnotificationinterface.h"
+#include "zmq/zmqrpc.h"
 #endif
 
 bool fFeeEstimatesInitialized = false;
@@ -106,10 +112,6 @@ static const bool DEFAULT_STOPAFTERBLOCKIMPORT = false;
 std::unique_ptr<CConnman> g_connman;
 std::unique_ptr<PeerLogicValidation> peerLogic;
 
-#if ENABLE_ZMQ
-static CZMQNotificationInterface* pzmqNotificationInterface = NULL;
-#endif
-
 static CDSNotificationInterface* pdsNotificationInterface = NULL;
 
 #ifdef WIN32
@@ -291,6 +293,10 @@ void PrepareShutdown()
         fFeeEstimatesInitialized = false;
     }
 
+    // these read from pcoinsdbview
+    chainStateRebuild.Stop();
+    coinsPrefetcher.Stop();
+
     {
         LOCK(cs_main);
         if (pcoinsTip != NULL) {
@@ -440,6 +446,11 @@ std::string HelpMessage(HelpMessageMode mode)
 #endif
     }
     strUsage += HelpMessageOpt("-datadir=<dir>", _("Specify data directory"));
+    strUsage += HelpMessageOpt("-blockcache=<n>", strprintf(_("Keep the most recently read or received blocks in up to <n> MiB of memory (0 to disable, default: %u)"), DEFAULT_BLOCK_CACHE_SIZE));
+#ifndef WIN32
+    strUsage += HelpMessageOpt("-blockmmap", strprintf(_("Read blocks from memory mapped block files instead of opening the file for every block (default: %u)"), DEFAULT_BLOCK_MMAP));
+#endif
+    strUsage += HelpMessageOpt("-coinsprefetch=<n>", strprintf(_("Set the number of threads looking up the coins spent by a block before it is connected (0 to disable, up to %d, default: %d)"), MAX_COINS_PREFETCH_THREADS, DEFAULT_COINS_PREFETCH_THREADS));
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file on startup"));
     strUsage += HelpMessageOpt("-maxorphantx=<n>", strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS));
@@ -454,7 +465,8 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-prune=<n>", strprintf(_("Reduce storage requirements by enabling pruning (deleting) of old blocks. This allows the pruneblockchain RPC to be called to delete specific blocks, and enables automatic pruning of old blocks if a target size in MiB is provided. This mode is incompatible with -txindex and -rescan. "
             "Warning: Reverting this setting requires re-downloading the entire blockchain. "
             "(default: 0 = disable pruning blocks, 1 = allow manual pruning via RPC, >%u = automatically prune block files to stay under the specified target size in MiB)"), MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024));
-    strUsage += HelpMessageOpt("-reindex-chainstate", _("Rebuild chain state from the currently indexed blocks"));
+    strUsage += HelpMessageOpt("-reindex-chainstate", _("Rebuild chain state from the currently indexed blocks, continues a rebuild which was stopped by a clean shutdown"));
+    strUsage += HelpMessageOpt("-reindexprefetch=<n>", strprintf(_("Number of blocks to read ahead while rebuilding the chain state, 0 to disable (default: %u)"), DEFAULT_REINDEX_PREFETCH));
     strUsage += HelpMessageOpt("-reindex", _("Rebuild chain state and block index from the blk*.dat files on disk"));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-sysperms", _("Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)"));
@@ -526,6 +538,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-zmqpubrawtx=<address>", _("Enable publish raw transaction in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtxlock=<address>", _("Enable publish raw transaction (locked via InstantSend) in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawinstantsenddoublespend=<address>", _("Enable publish raw transactions of attempted InstantSend double spend in <address>"));
+    strUsage += HelpMessageOpt("-zmqpub<type>hwm=<n>", strprintf(_("Set the outbound message high water mark for the <type> notifier, messages beyond it are dropped and counted in getzmqnotifications (default: %d)"), CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM));
 #endif
 
     strUsage += HelpMessageGroup(_("Debugging/Testing options:"));
@@ -564,9 +577,13 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-logtimemicros", strprintf("Add microsecond precision to debug timestamps (default: %u)", DEFAULT_LOGTIMEMICROS));
         strUsage += HelpMessageOpt("-logthreadnames", strprintf("Add thread names to debug messages (default: %u)", DEFAULT_LOGTHREADNAMES));
         strUsage += HelpMessageOpt("-mocktime=<n>", "Replace actual time with <n> seconds since epoch (default: 0)");
+        strUsage += HelpMessageOpt("-tracebuffer=<n>", strprintf("Keep the last <n> tracing spans of every thread in memory for dumptrace, 0 to disable tracing (default: %u)", DEFAULT_TRACE_BUFFER_SIZE));
+        strUsage += HelpMessageOpt("-profilelocks", strprintf("Record how long locks are waited for and held, see getlockstats (default: %u)", DEFAULT_PROFILE_LOCKS));
         strUsage += HelpMessageOpt("-limitfreerelay=<n>", strprintf("Continuously rate-limit free transactions to <n>*1000 bytes per minute (default: %u)", DEFAULT_LIMITFREERELAY));
         strUsage += HelpMessageOpt("-relaypriority", strprintf("Require high priority for relaying free or low-fee transactions (default: %u)", DEFAULT_RELAYPRIORITY));
         strUsage += HelpMessageOpt("-maxsigcachesize=<n>", strprintf("Limit size of signature cache to <n> MiB (default: %u)", DEFAULT_MAX_SIG_CACHE_SIZE));
+        strUsage += HelpMessageOpt("-dmnsnapshotinterval=<n>", strprintf("Write a full deterministic masternode list snapshot every <n> blocks (default: %u)", DEFAULT_DMN_SNAPSHOT_INTERVAL));
+        strUsage += HelpMessageOpt("-dmnlistscachesize=<n>", strprintf("Keep at most <n> deterministic masternode lists in memory (default: %u)", DEFAULT_DMN_LISTS_CACHE_SIZE));
         strUsage += HelpMessageOpt("-maxtipage=<n>", strprintf("Maximum tip age in seconds to consider node in initial block download (default: %u)", DEFAULT_MAX_TIP_AGE));
     }
     strUsage += HelpMessageOpt("-minrelaytxfee=<amt>", strprintf(_("Fees (in %s/kB) smaller than this are considered zero fee for relaying, mining and transaction creation (default: %s)"),
@@ -820,6 +837,16 @@ void ThreadImport(std::vector<boost::filesystem::path> vImportFiles)
         }
     }
 
+    // -reindex-chainstate, also set until a rebuild which was interrupted is finished
+    bool fRebuildChainState = false;
+    pblocktree->ReadFlag("reindexchainstate", fRebuildChainState);
+    if (fRebuildChainState) {
+        LOCK(cs_main);
+        int nThreads = std::max(1, std::min(GetNumCores(), MAX_REINDEX_PREFETCH_THREADS));
+        chainStateRebuild.Start(chainActive.Tip(), pindexBestHeader, pcoinsdbview, chainparams.GetConsensus(),
+                                std::max<int64_t>(0, GetArg("-reindexprefetch", DEFAULT_REINDEX_PREFETCH)), nThreads);
+    }
+
     // scan for better chains in the block chain database, that are not yet connected in the active best chain
     CValidationState state;
     if (!ActivateBestChain(state, chainparams)) {
@@ -827,6 +854,15 @@ void ThreadImport(std::vector<boost::filesystem::path> vImportFiles)
         StartShutdown();
     }
 
+    if (fRebuildChainState) {
+        chainStateRebuild.Stop();
+        // otherwise it continues after the restart
+        if (!ShutdownRequested()) {
+            pblocktree->WriteFlag("reindexchainstate", false);
+            LogPrintf("Rebuilding the chain state finished\n");
+        }
+    }
+
     if (GetBoolArg("-stopafterblockimport", DEFAULT_STOPAFTERBLOCKIMPORT)) {
         LogPrintf("Stopping after block import\n");
         StartShutdown();
@@ -1216,6 +1252,11 @@ bool AppInitParameterInteraction()
     else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
 
+    int64_t nBlockCacheSize = GetArg("-blockcache", DEFAULT_BLOCK_CACHE_SIZE);
+    if (nBlockCacheSize < 0)
+        return InitError(_("Block cache size cannot be configured with a negative value."));
+    blockCache.Init((size_t)nBlockCacheSize << 20, GetBoolArg("-blockmmap", DEFAULT_BLOCK_MMAP));
+
     // block pruning; get the amount of disk space (in MiB) to allot for block & undo files
     int64_t nPruneArg = GetArg("-prune", 0);
     if (nPruneArg < 0) {
@@ -1238,6 +1279,9 @@ bool AppInitParameterInteraction()
 #ifdef ENABLE_WALLET
     RegisterWalletRPCCommands(tableRPC);
 #endif
+#if ENABLE_ZMQ
+    RegisterZMQRPCCommands(tableRPC);
+#endif
 
     nConnectTimeout = GetArg("-timeout", DEFAULT_CONNECT_TIMEOUT);
     if (nConnectTimeout <= 0)
@@ -1298,6 +1342,9 @@ bool AppInitParameterInteraction()
     // Option to startup with mocktime set (used for regression testing):
     SetMockTime(GetArg("-mocktime", 0)); // SetMockTime(0) is a no-op
 
+    fLockProfiling = GetBoolArg("-profilelocks", DEFAULT_PROFILE_LOCKS);
+    tracer.Init(std::max<int64_t>(0, GetArg("-tracebuffer", DEFAULT_TRACE_BUFFER_SIZE)));
+
     if (GetBoolArg("-peerbloomfilters", DEFAULT_PEERBLOOMFILTERS))
         nLocalServices = ServiceFlags(nLocalServices | NODE_BLOOM);
 
@@ -1448,6 +1495,10 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
             threadGroup.create_thread(&ThreadScriptCheck);
     }
 
+    int nCoinsPrefetchThreads = std::max(0, std::min((int)GetArg("-coinsprefetch", DEFAULT_COINS_PREFETCH_THREADS), MAX_COINS_PREFETCH_THREADS));
+    LogPrintf("Using %u threads for coins prefetching\n", nCoinsPrefetchThreads);
+    coinsPrefetcher.Start(nCoinsPrefetchThreads);
+
     std::vector<std::string> vSporkAddresses;
     if (mapMultiArgs.count("-sporkaddr")) {
         vSporkAddresses = mapMultiArgs.at("-sporkaddr");
@@ -1758,10 +1809,22 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
                 delete deterministicMNManager;
                 delete evoDb;
 
-                evoDb = new CEvoDB(nEvoDbCache, false, fReindex || fReindexChainState);
-                deterministicMNManager = new CDeterministicMNManager(*evoDb);
                 pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReindex);
-                pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false, fReindex || fReindexChainState);
+                bool fWipeChainState = fReindex || fReindexChainState;
+                if (fReindexChainState && !fReindex) {
+                    if (CanResumeChainStateRebuild(*pblocktree)) {
+                        LogPrintf("Continuing the interrupted chain state rebuild\n");
+                        fWipeChainState = false;
+                    } else {
+                        pblocktree->WriteFlag("reindexchainstate", true);
+                    }
+                }
+
+                evoDb = new CEvoDB(nEvoDbCache, false, fWipeChainState);
+                // at least one list has to be cached, which also keeps negative values from wrapping around
+                deterministicMNManager = new CDeterministicMNManager(*evoDb, std::max<int64_t>(1, GetArg("-dmnsnapshotinterval", DEFAULT_DMN_SNAPSHOT_INTERVAL)),
+                                                                     std::max<int64_t>(1, GetArg("-dmnlistscachesize", DEFAULT_DMN_LISTS_CACHE_SIZE)));
+                pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false, fWipeChainState);
                 pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
                 pcoinsTip = new CCoinsViewCache(pcoinscatcher);
                 llmq::InitLLMQSystem(*evoDb);
@@ -17,6 +17,7 @@
 #include "protocol.h"
 #include "spork.h"
 #include "sync.h"
+#include "tracing.h"
 #include "txmempool.h"
 #include "util.h"
 #include "consensus/validation.h"
@@ -39,9 +40,10 @@ int nCompleteTXLocks;
 
 std::atomic<bool> CInstantSend::isAutoLockBip9Active{false};
 const double CInstantSend::AUTO_IX_MEMPOOL_THRESHOLD = 0.1;
+const size_t CInstantSend::MAX_MISSING_MASTERNODE_VOTES;
 
 CInstantSend instantsend;
-const std::string CInstantSend::SERIALIZATION_VERSION_STRING = "CInstantSend-Version-1";
+const std::string CInstantSend::SERIALIZATION_VERSION_STRING = "CInstantSend-Version-2";
 
 // Transaction Locks
 //
@@ -50,6 +52,114 @@ const std::string CInstantSend::SERIALIZATION_VERSION_STRING = "CInstantSend-Ver
 // step 3) Once there are COutPointLock::SIGNATURES_REQUIRED valid "txlockvote" messages (txlvote) per each spent outpoint
 //         for a corresponding "txlockrequest" message (ix), all outpoints from that tx are treated as locked
 
+//
+// CInstantSendLockIndex
+//
+
+bool CInstantSendLockIndex::LockOutpoint(const COutPoint& outpoint, const uint256& txHash)
+{
+    COutPointShard& shard = GetShard(outpoint);
+    LOCK(shard.cs);
+    return shard.mapLockedOutpoints.emplace(outpoint, txHash).second;
+}
+
+void CInstantSendLockIndex::UnlockOutpoint(const COutPoint& outpoint)
+{
+    COutPointShard& shard = GetShard(outpoint);
+    LOCK(shard.cs);
+    shard.mapLockedOutpoints.erase(outpoint);
+}
+
+bool CInstantSendLockIndex::GetLockedOutpointTxHash(const COutPoint& outpoint, uint256& hashRet) const
+{
+    const COutPointShard& shard = GetShard(outpoint);
+    LOCK(shard.cs);
+    auto it = shard.mapLockedOutpoints.find(outpoint);
+    if (it == shard.mapLockedOutpoints.end()) return false;
+    hashRet = it->second;
+    return true;
+}
+
+std::map<COutPoint, uint256> CInstantSendLockIndex::GetLockedOutpoints() const
+{
+    std::map<COutPoint, uint256> mapRet;
+    for (const auto& shard : outpointShards) {
+        LOCK(shard.cs);
+        mapRet.insert(shard.mapLockedOutpoints.begin(), shard.mapLockedOutpoints.end());
+    }
+    return mapRet;
+}
+
+void CInstantSendLockIndex::SetCandidateOutpoints(const uint256& txHash, const std::vector<COutPoint>& vecOutpoints)
+{
+    CCandidateShard& shard = GetShard(txHash);
+    LOCK(shard.cs);
+    shard.mapCandidates[txHash].vecOutpoints = vecOutpoints;
+}
+
+void CInstantSendLockIndex::SetCandidateVotes(const uint256& txHash, int nVotes)
+{
+    CCandidateShard& shard = GetShard(txHash);
+    LOCK(shard.cs);
+    auto it = shard.mapCandidates.find(txHash);
+    if (it != shard.mapCandidates.end()) {
+        it->second.nVotes = nVotes;
+    }
+}
+
+bool CInstantSendLockIndex::GetCandidateVotes(const uint256& txHash, int& nVotesRet) const
+{
+    const CCandidateShard& shard = GetShard(txHash);
+    LOCK(shard.cs);
+    auto it = shard.mapCandidates.find(txHash);
+    if (it == shard.mapCandidates.end()) return false;
+    nVotesRet = it->second.nVotes;
+    return true;
+}
+
+void CInstantSendLockIndex::RemoveCandidate(const uint256& txHash)
+{
+    CCandidateShard& shard = GetShard(txHash);
+    LOCK(shard.cs);
+    shard.mapCandidates.erase(txHash);
+}
+
+bool CInstantSendLockIndex::IsTxLocked(const uint256& txHash) const
+{
+    std::vector<COutPoint> vecOutpoints;
+    {
+        const CCandidateShard& shard = GetShard(txHash);
+        LOCK(shard.cs);
+        // there must be a lock candidate
+        auto it = shard.mapCandidates.find(txHash);
+        if (it == shard.mapCandidates.end()) return false;
+        vecOutpoints = it->second.vecOutpoints;
+    }
+
+    // which should have outpoints
+    if (vecOutpoints.empty()) return false;
+
+    // and all of these outputs must be locked with correct hash
+    for (const auto& outpoint : vecOutpoints) {
+        uint256 hashLocked;
+        if (!GetLockedOutpointTxHash(outpoint, hashLocked) || hashLocked != txHash) return false;
+    }
+
+    return true;
+}
+
+void CInstantSendLockIndex::Clear()
+{
+    for (auto& shard : outpointShards) {
+        LOCK(shard.cs);
+        shard.mapLockedOutpoints.clear();
+    }
+    for (auto& shard : candidateShards) {
+        LOCK(shard.cs);
+        shard.mapCandidates.clear();
+    }
+}
+
 //
 // CInstantSend
 //
@@ -83,8 +193,7 @@ void CInstantSend::ProcessMessage(CNode* pfrom, const std::string& strCommand, C
 
         {
             LOCK(cs_instantsend);
-            auto ret = mapTxLockVotes.emplace(nVoteHash, vote);
-            if (!ret.second) return;
+            if (!mapTxLockVotes.Insert(nVoteHash, vote, GetTime() + INSTANTSEND_FAILED_TIMEOUT_SECONDS)) return;
         }
 
         ProcessNewTxLockVote(pfrom, vote, connman);
@@ -95,6 +204,7 @@ void CInstantSend::ProcessMessage(CNode* pfrom, const std::string& strCommand, C
 
 bool CInstantSend::ProcessTxLockRequest(const CTxLockRequest& txLockRequest, CConnman& connman)
 {
+    TRACE_SPAN("CInstantSend::ProcessTxLockRequest");
     LOCK(cs_main);
 #ifdef ENABLE_WALLET
     LOCK(pwalletMain ? &pwalletMain->cs_wallet : NULL);
@@ -105,11 +215,11 @@ bool CInstantSend::ProcessTxLockRequest(const CTxLockRequest& txLockRequest, CCo
 
     // Check to see if we conflict with existing completed lock
     for (const auto& txin : txLockRequest.tx->vin) {
-        std::map<COutPoint, uint256>::iterator it = mapLockedOutpoints.find(txin.prevout);
-        if (it != mapLockedOutpoints.end() && it->second != txLockRequest.GetHash()) {
+        uint256 hashLocked;
+        if (lockIndex.GetLockedOutpointTxHash(txin.prevout, hashLocked) && hashLocked != txLockRequest.GetHash()) {
             // Conflicting with complete lock, proceed to see if we should cancel them both
             LogPrintf("CInstantSend::ProcessTxLockRequest -- WARNING: Found conflicting completed Transaction Lock, txid=%s, completed lock txid=%s\n",
-                    txLockRequest.GetHash().ToString(), it->second.ToString());
+                    txLockRequest.GetHash().ToString(), hashLocked.ToString());
         }
     }
 
@@ -144,7 +254,7 @@ bool CInstantSend::ProcessTxLockRequest(const CTxLockRequest& txLockRequest, CCo
     // Masternodes will sometimes propagate votes before the transaction is known to the client.
     // If this just happened - process orphan votes, lock inputs, resolve conflicting locks,
     // update transaction status forcing external script/zmq notifications.
-    ProcessOrphanTxLockVotes();
+    ProcessOrphanTxLockVotes(txHash);
     std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     TryToFinalizeLockCandidate(itLockCandidate->second);
 
@@ -169,6 +279,7 @@ bool CInstantSend::CreateTxLockCandidate(const CTxLockRequest& txLockRequest)
             txLockCandidate.AddOutPointLock(txin.prevout);
         }
         mapTxLockCandidates.insert(std::make_pair(txHash, txLockCandidate));
+        UpdateLockIndex(txHash, txLockCandidate);
     } else if (!itLockCandidate->second.txLockRequest) {
         // i.e. empty Transaction Lock Candidate was created earlier, let's update it with actual data
         itLockCandidate->second.txLockRequest = txLockRequest;
@@ -182,6 +293,7 @@ bool CInstantSend::CreateTxLockCandidate(const CTxLockRequest& txLockRequest)
         for (const auto& txin : txLockRequest.tx->vin) {
             itLockCandidate->second.AddOutPointLock(txin.prevout);
         }
+        UpdateLockIndex(txHash, itLockCandidate->second);
     } else {
         LogPrint("instantsend", "CInstantSend::CreateTxLockCandidate -- seen, txid=%s\n", txHash.ToString());
     }
@@ -196,6 +308,7 @@ void CInstantSend::CreateEmptyTxLockCandidate(const uint256& txHash)
     LogPrintf("CInstantSend::CreateEmptyTxLockCandidate -- new, txid=%s\n", txHash.ToString());
     const CTxLockRequest txLockRequest = CTxLockRequest();
     mapTxLockCandidates.insert(std::make_pair(txHash, CTxLockCandidate(txLockRequest)));
+    lockIndex.SetCandidateOutpoints(txHash, std::vector<COutPoint>());
 }
 
 void CInstantSend::Vote(const uint256& txHash, CConnman& connman)
@@ -299,7 +412,7 @@ void CInstantSend::Vote(CTxLockCandidate& txLockCandidate, CConnman& connman)
 
         // vote constructed sucessfully, let's store and relay it
         uint256 nVoteHash = vote.GetHash();
-        mapTxLockVotes.insert(std::make_pair(nVoteHash, vote));
+        mapTxLockVotes.Insert(nVoteHash, vote, GetTime() + INSTANTSEND_FAILED_TIMEOUT_SECONDS);
         if (outpointLockPair.second.AddVote(vote)) {
             LogPrintf("CInstantSend::Vote -- Vote created successfully, relaying: txHash=%s, outpoint=%s, vote=%s\n",
                     txHash.ToString(), outpointLockPair.first.ToStringShort(), nVoteHash.ToString());
@@ -324,11 +437,20 @@ void CInstantSend::Vote(CTxLockCandidate& txLockCandidate, CConnman& connman)
 
 bool CInstantSend::ProcessNewTxLockVote(CNode* pfrom, const CTxLockVote& vote, CConnman& connman)
 {
+    TRACE_SPAN("CInstantSend::ProcessNewTxLockVote");
     uint256 txHash = vote.GetTxHash();
     uint256 nVoteHash = vote.GetHash();
 
+    if (!mnodeman.Has(vote.GetMasternodeOutpoint())) {
+        // keep it until we know this masternode, see CheckMasternodeOrphanVotes
+        LogPrint("instantsend", "CInstantSend::%s -- Unknown masternode %s, txid=%s\n", __func__,
+                vote.GetMasternodeOutpoint().ToStringShort(), txHash.ToString());
+        mnodeman.AskForMN(pfrom, vote.GetMasternodeOutpoint(), connman);
+        AddMissingMasternodeVote(vote);
+        return false;
+    }
+
     if (!vote.IsValid(pfrom, connman)) {
-        // could be because of missing MN
         LogPrint("instantsend", "CInstantSend::%s -- Vote is invalid, txid=%s\n", __func__, txHash.ToString());
         return false;
     }
@@ -336,70 +458,86 @@ bool CInstantSend::ProcessNewTxLockVote(CNode* pfrom, const CTxLockVote& vote, C
     // relay valid vote asap
     vote.Relay(connman);
 
-    LOCK(cs_main);
-#ifdef ENABLE_WALLET
-    LOCK(pwalletMain ? &pwalletMain->cs_wallet : NULL);
-#endif
-    LOCK2(mempool.cs, cs_instantsend);
+    // Votes are counted under cs_instantsend only, cs_main and the rest of the locks
+    // are needed only once the lock candidate has enough votes to be finalized
+    {
+        LOCK(cs_instantsend);
 
-    // Masternodes will sometimes propagate votes before the transaction is known to the client,
-    // will actually process only after the lock request itself has arrived
+        // Masternodes will sometimes propagate votes before the transaction is known to the client,
+        // will actually process only after the lock request itself has arrived
 
-    std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
-    if (it == mapTxLockCandidates.end() || !it->second.txLockRequest) {
-        // no or empty tx lock candidate
-        if (it == mapTxLockCandidates.end()) {
-            // start timeout countdown after the very first vote
-            CreateEmptyTxLockCandidate(txHash);
-        }
-        bool fInserted = mapTxLockVotesOrphan.emplace(nVoteHash, vote).second;
-        LogPrint("instantsend", "CInstantSend::%s -- Orphan vote: txid=%s  masternode=%s %s\n",
-                __func__, txHash.ToString(), vote.GetMasternodeOutpoint().ToStringShort(), fInserted ? "new" : "seen");
+        std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
+        if (it == mapTxLockCandidates.end() || !it->second.txLockRequest) {
+            // no or empty tx lock candidate
+            if (it == mapTxLockCandidates.end()) {
+                // start timeout countdown after the very first vote
+                CreateEmptyTxLockCandidate(txHash);
+            }
+            bool fInserted = AddOrphanTxLockVote(nVoteHash, vote);
+            LogPrint("instantsend", "CInstantSend::%s -- Orphan vote: txid=%s  masternode=%s %s\n",
+                    __func__, txHash.ToString(), vote.GetMasternodeOutpoint().ToStringShort(), fInserted ? "new" : "seen");
 
-        // This tracks those messages and allows only the same rate as of the rest of the network
-        // TODO: make sure this works good enough for multi-quorum
+            // This tracks those messages and allows only the same rate as of the rest of the network
+            // TODO: make sure this works good enough for multi-quorum
 
-        int nMasternodeOrphanExpireTime = GetTime() + 60*10; // keep time data for 10 minutes
-        auto itMnOV = mapMasternodeOrphanVotes.find(vote.GetMasternodeOutpoint());
-        if (itMnOV == mapMasternodeOrphanVotes.end()) {
-            mapMasternodeOrphanVotes.emplace(vote.GetMasternodeOutpoint(), nMasternodeOrphanExpireTime);
-        } else {
-            if (itMnOV->second > GetTime() && itMnOV->second > GetAverageMasternodeOrphanVoteTime()) {
-                LogPrint("instantsend", "CInstantSend::%s -- masternode is spamming orphan Transaction Lock Votes: txid=%s  masternode=%s\n",
-                        __func__, txHash.ToString(), vote.GetMasternodeOutpoint().ToStringShort());
-                // Misbehaving(pfrom->id, 1);
-                return false;
+            int nMasternodeOrphanExpireTime = GetTime() + 60*10; // keep time data for 10 minutes
+            auto itMnOV = mapMasternodeOrphanVotes.find(vote.GetMasternodeOutpoint());
+            if (itMnOV == mapMasternodeOrphanVotes.end()) {
+                mapMasternodeOrphanVotes.emplace(vote.GetMasternodeOutpoint(), nMasternodeOrphanExpireTime);
+            } else {
+                if (itMnOV->second > GetTime() && itMnOV->second > GetAverageMasternodeOrphanVoteTime()) {
+                    LogPrint("instantsend", "CInstantSend::%s -- masternode is spamming orphan Transaction Lock Votes: txid=%s  masternode=%s\n",
+                            __func__, txHash.ToString(), vote.GetMasternodeOutpoint().ToStringShort());
+                    // Misbehaving(pfrom->id, 1);
+                    return false;
+                }
+                // not spamming, refresh
+                itMnOV->second = nMasternodeOrphanExpireTime;
             }
-            // not spamming, refresh
-            itMnOV->second = nMasternodeOrphanExpireTime;
+
+            return true;
         }
 
-        return true;
-    }
+        // We have a valid (non-empty) tx lock candidate
+        CTxLockCandidate& txLockCandidate = it->second;
 
-    // We have a valid (non-empty) tx lock candidate
-    CTxLockCandidate& txLockCandidate = it->second;
+        if (txLockCandidate.IsTimedOut()) {
+            LogPrint("instantsend", "CInstantSend::%s -- too late, Transaction Lock timed out, txid=%s\n", __func__, txHash.ToString());
+            return false;
+        }
 
-    if (txLockCandidate.IsTimedOut()) {
-        LogPrint("instantsend", "CInstantSend::%s -- too late, Transaction Lock timed out, txid=%s\n", __func__, txHash.ToString());
-        return false;
-    }
+        LogPrint("instantsend", "CInstantSend::%s -- Transaction Lock Vote, txid=%s\n", __func__, txHash.ToString());
 
-    LogPrint("instantsend", "CInstantSend::%s -- Transaction Lock Vote, txid=%s\n", __func__, txHash.ToString());
+        UpdateVotedOutpoints(vote, txLockCandidate);
 
-    UpdateVotedOutpoints(vote, txLockCandidate);
+        if (!txLockCandidate.AddVote(vote)) {
+            // this should never happen
+            return false;
+        }
 
-    if (!txLockCandidate.AddVote(vote)) {
-        // this should never happen
-        return false;
+        int nSignatures = txLockCandidate.CountVotes();
+        int nSignaturesMax = txLockCandidate.txLockRequest.GetMaxSignatures();
+        lockIndex.SetCandidateVotes(txHash, nSignatures);
+        LogPrint("instantsend", "CInstantSend::%s -- Transaction Lock signatures count: %d/%d, vote hash=%s\n", __func__,
+                nSignatures, nSignaturesMax, nVoteHash.ToString());
+
+        if (!txLockCandidate.IsAllOutPointsReady() || IsLockedInstantSendTransaction(txHash)) {
+            // not enough votes yet or already locked, nothing to finalize
+            return true;
+        }
     }
 
-    int nSignatures = txLockCandidate.CountVotes();
-    int nSignaturesMax = txLockCandidate.txLockRequest.GetMaxSignatures();
-    LogPrint("instantsend", "CInstantSend::%s -- Transaction Lock signatures count: %d/%d, vote hash=%s\n", __func__,
-            nSignatures, nSignaturesMax, nVoteHash.ToString());
+    LOCK(cs_main);
+#ifdef ENABLE_WALLET
+    LOCK(pwalletMain ? &pwalletMain->cs_wallet : NULL);
+#endif
+    LOCK2(mempool.cs, cs_instantsend);
 
-    TryToFinalizeLockCandidate(txLockCandidate);
+    // cs_instantsend was released in between, the candidate could have been removed already
+    std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
+    if (it == mapTxLockCandidates.end()) return false;
+
+    TryToFinalizeLockCandidate(it->second);
 
     return true;
 }
@@ -439,6 +577,7 @@ bool CInstantSend::ProcessOrphanTxLockVote(const CTxLockVote& vote)
 
     int nSignatures = txLockCandidate.CountVotes();
     int nSignaturesMax = txLockCandidate.txLockRequest.GetMaxSignatures();
+    lockIndex.SetCandidateVotes(txHash, nSignatures);
     LogPrint("instantsend", "CInstantSend::%s -- Transaction Lock signatures count: %d/%d, vote hash=%s\n",
             __func__, nSignatures, nSignaturesMax, vote.GetHash().ToString());
 
@@ -467,6 +606,8 @@ void CInstantSend::UpdateVotedOutpoints(const CTxLockVote& vote, CTxLockCandidat
                     // if the second one was already completed earlier
                     txLockCandidate.MarkOutpointAsAttacked(vote.GetOutpoint());
                     it2->second.MarkOutpointAsAttacked(vote.GetOutpoint());
+                    lockIndex.SetCandidateVotes(txHash, txLockCandidate.CountVotes());
+                    lockIndex.SetCandidateVotes(it2->first, it2->second.CountVotes());
                     // apply maximum PoSe ban score to this masternode i.e. PoSe-ban it instantly
                     mnodeman.PoSeBan(vote.GetMasternodeOutpoint());
                     // NOTE: This vote must be relayed further to let all other nodes know about such
@@ -482,19 +623,113 @@ void CInstantSend::UpdateVotedOutpoints(const CTxLockVote& vote, CTxLockCandidat
     }
 }
 
-void CInstantSend::ProcessOrphanTxLockVotes()
+bool CInstantSend::AddOrphanTxLockVote(const uint256& nVoteHash, const CTxLockVote& vote)
+{
+    AssertLockHeld(cs_instantsend);
+
+    if (!mapTxLockVotesOrphan.emplace(nVoteHash, vote).second) return false;
+    mapTxLockVotesOrphanByTx[vote.GetTxHash()].insert(nVoteHash);
+    return true;
+}
+
+void CInstantSend::EraseOrphanTxLockVote(std::map<uint256, CTxLockVote>::iterator it)
+{
+    AssertLockHeld(cs_instantsend);
+
+    auto itByTx = mapTxLockVotesOrphanByTx.find(it->second.GetTxHash());
+    if (itByTx != mapTxLockVotesOrphanByTx.end()) {
+        itByTx->second.erase(it->first);
+        if (itByTx->second.empty()) {
+            mapTxLockVotesOrphanByTx.erase(itByTx);
+        }
+    }
+    mapTxLockVotesOrphan.erase(it);
+}
+
+void CInstantSend::RebuildOrphanVoteIndex()
 {
+    LOCK(cs_instantsend);
+
+    mapTxLockVotesOrphanByTx.clear();
+    for (const auto& pair : mapTxLockVotesOrphan) {
+        mapTxLockVotesOrphanByTx[pair.second.GetTxHash()].insert(pair.first);
+    }
+}
+
+void CInstantSend::ProcessOrphanTxLockVotes(const uint256& txHash)
+{
+    TRACE_SPAN("CInstantSend::ProcessOrphanTxLockVotes");
     AssertLockHeld(cs_main);
     AssertLockHeld(cs_instantsend);
 
-    std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.begin();
-    while (it != mapTxLockVotesOrphan.end()) {
+    auto itByTx = mapTxLockVotesOrphanByTx.find(txHash);
+    if (itByTx == mapTxLockVotesOrphanByTx.end()) return;
+
+    // copy, EraseOrphanTxLockVote modifies the set
+    std::set<uint256> setVoteHashes = itByTx->second;
+    LogPrint("instantsend", "CInstantSend::%s -- txid=%s, %d orphan votes\n", __func__, txHash.ToString(), setVoteHashes.size());
+
+    for (const auto& nVoteHash : setVoteHashes) {
+        auto it = mapTxLockVotesOrphan.find(nVoteHash);
+        if (it == mapTxLockVotesOrphan.end()) continue;
         if (ProcessOrphanTxLockVote(it->second)) {
-            mapTxLockVotesOrphan.erase(it++);
-        } else {
-            ++it;
+            UpdateOrphanVoteStats(it->second);
+            EraseOrphanTxLockVote(it);
+        }
+    }
+}
+
+void CInstantSend::AddMissingMasternodeVote(const CTxLockVote& vote)
+{
+    LOCK(cs_instantsend);
+
+    if (nMissingMasternodeVotes >= MAX_MISSING_MASTERNODE_VOTES) {
+        LogPrint("instantsend", "CInstantSend::%s -- too many votes of unknown masternodes, dropping vote for txid=%s\n",
+                __func__, vote.GetTxHash().ToString());
+        return;
+    }
+    mapTxLockVotesMissingMasternode[vote.GetMasternodeOutpoint()].push_back(vote);
+    nMissingMasternodeVotes++;
+}
+
+void CInstantSend::UpdateOrphanVoteStats(const CTxLockVote& vote)
+{
+    AssertLockHeld(cs_instantsend);
+
+    int64_t nWait = std::max(GetTime() - vote.GetTimeCreated(), int64_t(0));
+    nOrphanVotesProcessed++;
+    nOrphanVotesWaitTotal += nWait;
+    nOrphanVotesWaitMax = std::max(nOrphanVotesWaitMax, nWait);
+}
+
+void CInstantSend::CheckMasternodeOrphanVotes(CConnman& connman)
+{
+    if (fLiteMode || !sporkManager.IsSporkActive(SPORK_2_INSTANTSEND_ENABLED)) return;
+
+    std::vector<CTxLockVote> vecVotes;
+    {
+        LOCK(cs_instantsend);
+        auto it = mapTxLockVotesMissingMasternode.begin();
+        while (it != mapTxLockVotesMissingMasternode.end()) {
+            if (!mnodeman.Has(it->first)) {
+                ++it;
+                continue;
+            }
+            for (const auto& vote : it->second) {
+                UpdateOrphanVoteStats(vote);
+                vecVotes.push_back(vote);
+            }
+            nMissingMasternodeVotes -= it->second.size();
+            mapTxLockVotesMissingMasternode.erase(it++);
         }
     }
+
+    if (vecVotes.empty()) return;
+
+    LogPrint("instantsend", "CInstantSend::%s -- processing %d votes of new masternodes\n", __func__, vecVotes.size());
+    for (const auto& vote : vecVotes) {
+        ProcessNewTxLockVote(nullptr, vote, connman);
+    }
 }
 
 void CInstantSend::TryToFinalizeLockCandidate(const CTxLockCandidate& txLockCandidate)
@@ -559,18 +794,40 @@ void CInstantSend::LockTransactionInputs(const CTxLockCandidate& txLockCandidate
     if (!txLockCandidate.IsAllOutPointsReady()) return;
 
     for (const auto& pair : txLockCandidate.mapOutPointLocks) {
-        mapLockedOutpoints.insert(std::make_pair(pair.first, txHash));
+        lockIndex.LockOutpoint(pair.first, txHash);
     }
     LogPrint("instantsend", "CInstantSend::LockTransactionInputs -- done, txid=%s\n", txHash.ToString());
 }
 
 bool CInstantSend::GetLockedOutPointTxHash(const COutPoint& outpoint, uint256& hashRet)
+{
+    return lockIndex.GetLockedOutpointTxHash(outpoint, hashRet);
+}
+
+void CInstantSend::UpdateLockIndex(const uint256& txHash, const CTxLockCandidate& txLockCandidate)
+{
+    AssertLockHeld(cs_instantsend);
+
+    std::vector<COutPoint> vecOutpoints;
+    vecOutpoints.reserve(txLockCandidate.mapOutPointLocks.size());
+    for (const auto& pair : txLockCandidate.mapOutPointLocks) {
+        vecOutpoints.push_back(pair.first);
+    }
+    lockIndex.SetCandidateOutpoints(txHash, vecOutpoints);
+    lockIndex.SetCandidateVotes(txHash, txLockCandidate.CountVotes());
+}
+
+void CInstantSend::RebuildLockIndex(const std::map<COutPoint, uint256>& mapLockedOutpoints)
 {
     LOCK(cs_instantsend);
-    std::map<COutPoint, uint256>::iterator it = mapLockedOutpoints.find(outpoint);
-    if (it == mapLockedOutpoints.end()) return false;
-    hashRet = it->second;
-    return true;
+
+    lockIndex.Clear();
+    for (const auto& pair : mapLockedOutpoints) {
+        lockIndex.LockOutpoint(pair.first, pair.second);
+    }
+    for (const auto& pair : mapTxLockCandidates) {
+        UpdateLockIndex(pair.first, pair.second);
+    }
 }
 
 bool CInstantSend::ResolveConflicts(const CTxLockCandidate& txLockCandidate)
@@ -665,6 +922,7 @@ int64_t CInstantSend::GetAverageMasternodeOrphanVoteTime()
 
 void CInstantSend::CheckAndRemove()
 {
+    TRACE_SPAN("CInstantSend::CheckAndRemove");
     if (!masternodeSync.IsMasternodeListSynced()) return;
 
     LOCK(cs_instantsend);
@@ -679,9 +937,10 @@ void CInstantSend::CheckAndRemove()
             LogPrintf("CInstantSend::CheckAndRemove -- Removing expired Transaction Lock Candidate: txid=%s\n", txHash.ToString());
 
             for (const auto& pair : txLockCandidate.mapOutPointLocks) {
-                mapLockedOutpoints.erase(pair.first);
+                lockIndex.UnlockOutpoint(pair.first);
                 mapVotedOutpoints.erase(pair.first);
             }
+            lockIndex.RemoveCandidate(itLockCandidate->first);
             mapLockRequestAccepted.erase(txHash);
             mapLockRequestRejected.erase(txHash);
             mapTxLockCandidates.erase(itLockCandidate++);
@@ -690,43 +949,52 @@ void CInstantSend::CheckAndRemove()
         }
     }
 
-    // remove expired votes
-    std::map<uint256, CTxLockVote>::iterator itVote = mapTxLockVotes.begin();
-    while (itVote != mapTxLockVotes.end()) {
-        if (itVote->second.IsExpired(nCachedBlockHeight)) {
-            LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing expired vote: txid=%s  masternode=%s\n",
-                    itVote->second.GetTxHash().ToString(), itVote->second.GetMasternodeOutpoint().ToStringShort());
-            mapTxLockVotes.erase(itVote++);
-        } else {
-            ++itVote;
-        }
-    }
-
     // remove timed out orphan votes
     std::map<uint256, CTxLockVote>::iterator itOrphanVote = mapTxLockVotesOrphan.begin();
     while (itOrphanVote != mapTxLockVotesOrphan.end()) {
         if (itOrphanVote->second.IsTimedOut()) {
             LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing timed out orphan vote: txid=%s  masternode=%s\n",
                     itOrphanVote->second.GetTxHash().ToString(), itOrphanVote->second.GetMasternodeOutpoint().ToStringShort());
-            mapTxLockVotes.erase(itOrphanVote->first);
-            mapTxLockVotesOrphan.erase(itOrphanVote++);
+            mapTxLockVotes.Erase(itOrphanVote->first);
+            EraseOrphanTxLockVote(itOrphanVote++);
         } else {
             ++itOrphanVote;
         }
     }
 
-    // remove invalid votes and votes for failed lock attempts
-    itVote = mapTxLockVotes.begin();
-    while (itVote != mapTxLockVotes.end()) {
-        if (itVote->second.IsFailed()) {
-            LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing vote for failed lock attempt: txid=%s  masternode=%s\n",
-                    itVote->second.GetTxHash().ToString(), itVote->second.GetMasternodeOutpoint().ToStringShort());
-            mapTxLockVotes.erase(itVote++);
+    // remove timed out votes of unknown masternodes, there is no point in processing them anymore
+    auto itMissing = mapTxLockVotesMissingMasternode.begin();
+    while (itMissing != mapTxLockVotesMissingMasternode.end()) {
+        std::vector<CTxLockVote>& vecVotes = itMissing->second;
+        size_t nSizeBefore = vecVotes.size();
+        vecVotes.erase(std::remove_if(vecVotes.begin(), vecVotes.end(), [](const CTxLockVote& vote) {
+            return vote.IsTimedOut();
+        }), vecVotes.end());
+        nMissingMasternodeVotes -= nSizeBefore - vecVotes.size();
+        if (vecVotes.empty()) {
+            LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing timed out votes of unknown masternode=%s\n",
+                    itMissing->first.ToStringShort());
+            mapTxLockVotesMissingMasternode.erase(itMissing++);
         } else {
-            ++itVote;
+            ++itMissing;
         }
     }
 
+    // remove expired votes, invalid votes and votes for failed lock attempts,
+    // votes can only fail after INSTANTSEND_FAILED_TIMEOUT_SECONDS so the rest is rechecked that often
+    int64_t nNow = GetTime();
+    mapTxLockVotes.Expire(nNow, [&](const uint256& nVoteHash, CTxLockVote& vote, int64_t& nDeadline) {
+        if (vote.IsExpired(nCachedBlockHeight)) {
+            LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing expired vote: txid=%s  masternode=%s\n",
+                    vote.GetTxHash().ToString(), vote.GetMasternodeOutpoint().ToStringShort());
+        } else if (vote.IsFailed()) {
+            LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing vote for failed lock attempt: txid=%s  masternode=%s\n",
+                    vote.GetTxHash().ToString(), vote.GetMasternodeOutpoint().ToStringShort());
+        } else {
+            nDeadline = nNow + INSTANTSEND_FAILED_TIMEOUT_SECONDS;
+        }
+    });
+
     // remove timed out masternode orphan votes (DOS protection)
     std::map<COutPoint, int64_t>::iterator itMasternodeOrphan = mapMasternodeOrphanVotes.begin();
     while (itMasternodeOrphan != mapMasternodeOrphanVotes.end()) {
@@ -746,7 +1014,7 @@ bool CInstantSend::AlreadyHave(const uint256& hash)
     LOCK(cs_instantsend);
     return mapLockRequestAccepted.count(hash) ||
             mapLockRequestRejected.count(hash) ||
-            mapTxLockVotes.count(hash);
+            mapTxLockVotes.Has(hash);
 }
 
 void CInstantSend::AcceptLockRequest(const CTxLockRequest& txLockRequest)
@@ -782,11 +1050,7 @@ bool CInstantSend::GetTxLockVote(const uint256& hash, CTxLockVote& txLockVoteRet
 {
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotes.find(hash);
-    if (it == mapTxLockVotes.end()) return false;
-    txLockVoteRet = it->second;
-
-    return true;
+    return mapTxLockVotes.Get(hash, txLockVoteRet);
 }
 
 void CInstantSend::Clear()
@@ -795,11 +1059,14 @@ void CInstantSend::Clear()
 
     mapLockRequestAccepted.clear();
     mapLockRequestRejected.clear();
-    mapTxLockVotes.clear();
+    mapTxLockVotes.Clear();
     mapTxLockVotesOrphan.clear();
+    mapTxLockVotesOrphanByTx.clear();
+    mapTxLockVotesMissingMasternode.clear();
+    nMissingMasternodeVotes = 0;
     mapTxLockCandidates.clear();
     mapVotedOutpoints.clear();
-    mapLockedOutpoints.clear();
+    lockIndex.Clear();
     mapMasternodeOrphanVotes.clear();
     nCachedBlockHeight = 0;
 }
@@ -809,22 +1076,8 @@ bool CInstantSend::IsLockedInstantSendTransaction(const uint256& txHash)
     if (!fEnableInstantSend || GetfLargeWorkForkFound() || GetfLargeWorkInvalidChainFound() ||
         !sporkManager.IsSporkActive(SPORK_3_INSTANTSEND_BLOCK_FILTERING)) return false;
 
-    LOCK(cs_instantsend);
-
-    // there must be a lock candidate
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
-    if (itLockCandidate == mapTxLockCandidates.end()) return false;
-
-    // which should have outpoints
-    if (itLockCandidate->second.mapOutPointLocks.empty()) return false;
-
-    // and all of these outputs must be included in mapLockedOutpoints with correct hash
-    for (const auto& pair : itLockCandidate->second.mapOutPointLocks) {
-        uint256 hashLocked;
-        if (!GetLockedOutPointTxHash(pair.first, hashLocked) || hashLocked != txHash) return false;
-    }
-
-    return true;
+    // NOTE: no cs_instantsend here, this is called by the wallet and the mempool a lot
+    return lockIndex.IsTxLocked(txHash);
 }
 
 int CInstantSend::GetTransactionLockSignatures(const uint256& txHash)
@@ -833,11 +1086,9 @@ int CInstantSend::GetTransactionLockSignatures(const uint256& txHash)
     if (GetfLargeWorkForkFound() || GetfLargeWorkInvalidChainFound()) return -2;
     if (!sporkManager.IsSporkActive(SPORK_2_INSTANTSEND_ENABLED)) return -3;
 
-    LOCK(cs_instantsend);
-
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
-    if (itLockCandidate != mapTxLockCandidates.end()) {
-        return itLockCandidate->second.CountVotes();
+    int nVotes;
+    if (lockIndex.GetCandidateVotes(txHash, nVotes)) {
+        return nVotes;
     }
 
     return -1;
@@ -870,6 +1121,7 @@ void CInstantSend::Relay(const uint256& txHash, CConnman& connman)
 
 void CInstantSend::UpdatedBlockTip(const CBlockIndex *pindex)
 {
+    TRACE_SPAN("CInstantSend::UpdatedBlockTip");
     nCachedBlockHeight = pindex->nHeight;
 }
 
@@ -902,20 +1154,24 @@ void CInstantSend::SyncTransaction(const CTransaction& tx, const CBlockIndex *pi
                 uint256 nVoteHash = vote.GetHash();
                 LogPrint("instantsend", "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d vote %s updated\n",
                         txHash.ToString(), nHeightNew, nVoteHash.ToString());
-                const auto& it = mapTxLockVotes.find(nVoteHash);
-                if (it != mapTxLockVotes.end()) {
-                    it->second.SetConfirmedHeight(nHeightNew);
+                CTxLockVote* pvote = mapTxLockVotes.Find(nVoteHash);
+                if (pvote) {
+                    pvote->SetConfirmedHeight(nHeightNew);
                 }
             }
         }
     }
 
     // check orphan votes
-    for (const auto& pair : mapTxLockVotesOrphan) {
-        if (pair.second.GetTxHash() == txHash) {
+    auto itOrphanVotes = mapTxLockVotesOrphanByTx.find(txHash);
+    if (itOrphanVotes != mapTxLockVotesOrphanByTx.end()) {
+        for (const auto& nVoteHash : itOrphanVotes->second) {
             LogPrint("instantsend", "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d vote %s updated\n",
-                    txHash.ToString(), nHeightNew, pair.first.ToString());
-            mapTxLockVotes[pair.first].SetConfirmedHeight(nHeightNew);
+                    txHash.ToString(), nHeightNew, nVoteHash.ToString());
+            CTxLockVote* pvote = mapTxLockVotes.Find(nVoteHash);
+            if (pvote) {
+                pvote->SetConfirmedHeight(nHeightNew);
+            }
         }
     }
 }
@@ -923,7 +1179,28 @@ void CInstantSend::SyncTransaction(const CTransaction& tx, const CBlockIndex *pi
 std::string CInstantSend::ToString() const
 {
     LOCK(cs_instantsend);
-    return strprintf("Lock Candidates: %llu, Votes %llu", mapTxLockCandidates.size(), mapTxLockVotes.size());
+    return strprintf("Lock Candidates: %llu, Votes %llu, Orphan votes %llu (missing masternode %llu), processed %llu, average wait %llds, max wait %llds",
+            mapTxLockCandidates.size(), mapTxLockVotes.Size(), mapTxLockVotesOrphan.size(), nMissingMasternodeVotes,
+            nOrphanVotesProcessed, nOrphanVotesProcessed ? nOrphanVotesWaitTotal / (int64_t)nOrphanVotesProcessed : 0, nOrphanVotesWaitMax);
+}
+
+CExpiringMapStats CInstantSend::GetTxLockVotesStats() const
+{
+    LOCK(cs_instantsend);
+    return mapTxLockVotes.GetStats();
+}
+
+size_t CInstantSend::GetMissingMasternodeVoteCount() const
+{
+    LOCK(cs_instantsend);
+    return nMissingMasternodeVotes;
+}
+
+size_t CInstantSend::GetOrphanTxLockVoteCount(const uint256& txHash) const
+{
+    LOCK(cs_instantsend);
+    auto it = mapTxLockVotesOrphanByTx.find(txHash);
+    return it == mapTxLockVotesOrphanByTx.end() ? 0 : it->second.size();
 }
 
 void CInstantSend::DoMaintenance()
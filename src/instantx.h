@@ -7,8 +7,14 @@
 #define INSTANTX_H
 
 #include "chain.h"
+#include "coins.h"
+#include "expiringmap.h"
 #include "net.h"
 #include "primitives/transaction.h"
+#include "saltedhasher.h"
+#include "sync.h"
+
+#include <unordered_map>
 
 #include "evo/deterministicmns.h"
 
@@ -42,6 +48,62 @@ static const int INSTANTSEND_FAILED_TIMEOUT_SECONDS = 60;
 extern bool fEnableInstantSend;
 extern int nCompleteTXLocks;
 
+/**
+ * Lock state which is queried from outside of InstantSend (wallet, mempool, validation):
+ * outpoints of completed locks, and outpoints plus vote counts of lock candidates.
+ * Both indexes are split into shards with their own locks, so these queries never
+ * wait for cs_instantsend or cs_main while votes are being processed.
+ */
+class CInstantSendLockIndex
+{
+private:
+    static const size_t SHARDS_COUNT = 16;
+
+    struct COutPointShard
+    {
+        mutable CCriticalSection cs;
+        std::unordered_map<COutPoint, uint256, SaltedOutpointHasher> mapLockedOutpoints; ///< UTXO - Tx hash
+    };
+
+    struct CCandidateInfo
+    {
+        std::vector<COutPoint> vecOutpoints;
+        int nVotes{0};
+    };
+
+    struct CCandidateShard
+    {
+        mutable CCriticalSection cs;
+        std::unordered_map<uint256, CCandidateInfo, StaticSaltedHasher> mapCandidates; ///< Tx hash - outpoints and vote count
+    };
+
+    COutPointShard outpointShards[SHARDS_COUNT];
+    CCandidateShard candidateShards[SHARDS_COUNT];
+
+    COutPointShard& GetShard(const COutPoint& outpoint) { return outpointShards[(outpoint.hash.GetCheapHash() + outpoint.n) % SHARDS_COUNT]; }
+    const COutPointShard& GetShard(const COutPoint& outpoint) const { return outpointShards[(outpoint.hash.GetCheapHash() + outpoint.n) % SHARDS_COUNT]; }
+    CCandidateShard& GetShard(const uint256& txHash) { return candidateShards[txHash.GetCheapHash() % SHARDS_COUNT]; }
+    const CCandidateShard& GetShard(const uint256& txHash) const { return candidateShards[txHash.GetCheapHash() % SHARDS_COUNT]; }
+
+public:
+    /// Returns false and keeps the existing lock if the outpoint is already locked
+    bool LockOutpoint(const COutPoint& outpoint, const uint256& txHash);
+    void UnlockOutpoint(const COutPoint& outpoint);
+    bool GetLockedOutpointTxHash(const COutPoint& outpoint, uint256& hashRet) const;
+    std::map<COutPoint, uint256> GetLockedOutpoints() const;
+
+    /// Adds a candidate or replaces the outpoints of an existing one
+    void SetCandidateOutpoints(const uint256& txHash, const std::vector<COutPoint>& vecOutpoints);
+    void SetCandidateVotes(const uint256& txHash, int nVotes);
+    bool GetCandidateVotes(const uint256& txHash, int& nVotesRet) const;
+    void RemoveCandidate(const uint256& txHash);
+
+    /// All outpoints of the candidate are locked by this very transaction
+    bool IsTxLocked(const uint256& txHash) const;
+
+    void Clear();
+};
+
 /**
  * Manages InstantSend. Processes lock requests, candidates, and votes.
  */
@@ -59,13 +121,22 @@ private:
     // maps for AlreadyHave
     std::map<uint256, CTxLockRequest> mapLockRequestAccepted; ///< Tx hash - Tx
     std::map<uint256, CTxLockRequest> mapLockRequestRejected; ///< Tx hash - Tx
-    std::map<uint256, CTxLockVote> mapTxLockVotes; ///< Vote hash - Vote
+    CExpiringMap<uint256, CTxLockVote, StaticSaltedHasher> mapTxLockVotes; ///< Vote hash - Vote, rechecked once the deadline passes
     std::map<uint256, CTxLockVote> mapTxLockVotesOrphan; ///< Vote hash - Vote
+    std::map<uint256, std::set<uint256> > mapTxLockVotesOrphanByTx; ///< Tx hash - orphan vote hashes, not serialized
+    /// Votes of masternodes we don't know yet, re-processed by CheckMasternodeOrphanVotes
+    std::map<COutPoint, std::vector<CTxLockVote> > mapTxLockVotesMissingMasternode; ///< MN outpoint - Votes
+    size_t nMissingMasternodeVotes = 0;
+
+    /// Orphan vote queue statistics
+    uint64_t nOrphanVotesProcessed = 0;
+    int64_t nOrphanVotesWaitTotal = 0; ///< Seconds
+    int64_t nOrphanVotesWaitMax = 0; ///< Seconds
 
     std::map<uint256, CTxLockCandidate> mapTxLockCandidates; ///< Tx hash - Lock candidate
 
     std::map<COutPoint, std::set<uint256> > mapVotedOutpoints; ///< UTXO - Tx hash set
-    std::map<COutPoint, uint256> mapLockedOutpoints; ///< UTXO - Tx hash
+    CInstantSendLockIndex lockIndex;
 
     /// Track masternodes who voted with no txlockrequest (for DOS protection)
     std::map<COutPoint, int64_t> mapMasternodeOrphanVotes; ///< MN outpoint - Time
@@ -78,8 +149,13 @@ private:
     bool ProcessNewTxLockVote(CNode* pfrom, const CTxLockVote& vote, CConnman& connman);
 
     void UpdateVotedOutpoints(const CTxLockVote& vote, CTxLockCandidate& txLockCandidate);
+    bool AddOrphanTxLockVote(const uint256& nVoteHash, const CTxLockVote& vote);
+    void EraseOrphanTxLockVote(std::map<uint256, CTxLockVote>::iterator it);
     bool ProcessOrphanTxLockVote(const CTxLockVote& vote);
-    void ProcessOrphanTxLockVotes();
+    /// Process all orphan votes waiting for this lock request in one batch
+    void ProcessOrphanTxLockVotes(const uint256& txHash);
+    void AddMissingMasternodeVote(const CTxLockVote& vote);
+    void UpdateOrphanVoteStats(const CTxLockVote& vote);
     int64_t GetAverageMasternodeOrphanVoteTime();
 
     void TryToFinalizeLockCandidate(const CTxLockCandidate& txLockCandidate);
@@ -88,7 +164,14 @@ private:
     void UpdateLockedTransaction(const CTxLockCandidate& txLockCandidate);
     bool ResolveConflicts(const CTxLockCandidate& txLockCandidate);
 
+    void UpdateLockIndex(const uint256& txHash, const CTxLockCandidate& txLockCandidate);
+    void RebuildLockIndex(const std::map<COutPoint, uint256>& mapLockedOutpoints);
+    void RebuildOrphanVoteIndex();
+
 public:
+    /// Maximum number of votes waiting for their masternode to become known
+    static const size_t MAX_MISSING_MASTERNODE_VOTES = 1000;
+
     mutable CCriticalSection cs_instantsend;
 
     ADD_SERIALIZE_METHODS;
@@ -110,10 +193,19 @@ public:
         READWRITE(mapTxLockVotesOrphan);
         READWRITE(mapTxLockCandidates);
         READWRITE(mapVotedOutpoints);
+        std::map<COutPoint, uint256> mapLockedOutpoints;
+        if (!ser_action.ForRead()) {
+            mapLockedOutpoints = lockIndex.GetLockedOutpoints();
+        }
         READWRITE(mapLockedOutpoints);
         READWRITE(mapMasternodeOrphanVotes);
         READWRITE(nCachedBlockHeight);
 
+        if (ser_action.ForRead()) {
+            RebuildLockIndex(mapLockedOutpoints);
+            RebuildOrphanVoteIndex();
+        }
+
         if(ser_action.ForRead() && (strVersion != SERIALIZATION_VERSION_STRING)) {
             Clear();
         }
@@ -144,6 +236,8 @@ public:
 
     /// Remove expired entries from maps
     void CheckAndRemove();
+    /// Re-process votes of masternodes which became known since they were received
+    void CheckMasternodeOrphanVotes(CConnman& connman);
     /// Verify if transaction lock timed out
     bool IsTxLockCandidateTimedOut(const uint256& txHash);
 
@@ -153,6 +247,11 @@ public:
     void SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, int posInBlock);
 
     std::string ToString() const;
+    CExpiringMapStats GetTxLockVotesStats() const;
+    /// Number of votes waiting for their masternode to become known
+    size_t GetMissingMasternodeVoteCount() const;
+    /// Number of votes waiting for the lock request of this transaction
+    size_t GetOrphanTxLockVoteCount(const uint256& txHash) const;
 
     void DoMaintenance();
 
@@ -297,6 +396,7 @@ public:
     bool IsExpired(int nHeight) const;
     bool IsTimedOut() const;
     bool IsFailed() const;
+    int64_t GetTimeCreated() const { return nTimeCreated; }
 
     bool Sign();
     bool CheckSignature() const;
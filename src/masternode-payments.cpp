@@ -14,6 +14,7 @@
 #include "netfulfilledman.h"
 #include "netmessagemaker.h"
 #include "spork.h"
+#include "txdb.h"
 #include "util.h"
 
 #include "evo/deterministicmns.h"
@@ -22,6 +23,7 @@
 
 /** Object for who's going to get paid on which blocks */
 CMasternodePayments mnpayments;
+CMasternodePayeeIndex mnpayeeindex;
 
 CCriticalSection cs_vecPayees;
 CCriticalSection cs_mapMasternodeBlocks;
@@ -330,11 +332,189 @@ std::map<int, std::string> GetRequiredPaymentsStrings(int nStartHeight, int nEnd
     return mapPayments;
 }
 
+std::vector<CScript> CMasternodePayeeIndex::GetBlockPayees(const CBlock& block, int nHeight)
+{
+    std::vector<CScript> vPayees;
+    if (block.vtx.empty())
+        return vPayees;
+
+    const CTransaction& txCoinbase = *block.vtx[0];
+    CAmount nMasternodePayment = GetMasternodePayment(nHeight, txCoinbase.GetValueOut());
+    for (const auto& txout : txCoinbase.vout) {
+        if (txout.nValue == nMasternodePayment) {
+            vPayees.push_back(txout.scriptPubKey);
+        }
+    }
+    return vPayees;
+}
+
+void CMasternodePayeeIndex::AddEntry(int nHeight, const std::vector<CScript>& vPayees)
+{
+    mapHeightPayees[nHeight] = vPayees;
+    for (const auto& payee : vPayees) {
+        mapPayeeHeights[payee].insert(nHeight);
+    }
+}
+
+void CMasternodePayeeIndex::RemoveEntry(int nHeight)
+{
+    auto it = mapHeightPayees.find(nHeight);
+    if (it == mapHeightPayees.end())
+        return;
+
+    for (const auto& payee : it->second) {
+        auto itPayee = mapPayeeHeights.find(payee);
+        if (itPayee == mapPayeeHeights.end())
+            continue;
+        itPayee->second.erase(nHeight);
+        if (itPayee->second.empty())
+            mapPayeeHeights.erase(itPayee);
+    }
+    mapHeightPayees.erase(it);
+}
+
+void CMasternodePayeeIndex::Clear()
+{
+    mapPayeeHeights.clear();
+    mapHeightPayees.clear();
+}
+
+void CMasternodePayeeIndex::BlockConnected(int nHeight, const std::vector<CScript>& vPayees, int nBlocks)
+{
+    LOCK(cs);
+    // Only extend a contiguous window, anything else gets reloaded by the next LoadWindow
+    if (!mapHeightPayees.empty() && mapHeightPayees.rbegin()->first != nHeight - 1) {
+        Clear();
+        return;
+    }
+    AddEntry(nHeight, vPayees);
+
+    int nFirstHeight = nHeight - nBlocks + 1;
+    while (!mapHeightPayees.empty() && mapHeightPayees.begin()->first < nFirstHeight) {
+        RemoveEntry(mapHeightPayees.begin()->first);
+    }
+}
+
+void CMasternodePayeeIndex::BlockDisconnected(int nHeight)
+{
+    LOCK(cs);
+    if (mapHeightPayees.empty())
+        return;
+    if (mapHeightPayees.rbegin()->first != nHeight) {
+        Clear();
+        return;
+    }
+    RemoveEntry(nHeight);
+}
+
+bool CMasternodePayeeIndex::LoadWindow(const CBlockIndex* pindexTip, int nBlocks)
+{
+    AssertLockHeld(cs_main);
+
+    if (!pindexTip)
+        return false;
+
+    LOCK(cs);
+
+    int nFirstHeight = std::max(0, pindexTip->nHeight - nBlocks + 1);
+
+    if (!mapHeightPayees.empty() && mapHeightPayees.rbegin()->first != pindexTip->nHeight) {
+        Clear();
+    }
+    while (!mapHeightPayees.empty() && mapHeightPayees.begin()->first < nFirstHeight) {
+        RemoveEntry(mapHeightPayees.begin()->first);
+    }
+
+    int nLastHeight = mapHeightPayees.empty() ? pindexTip->nHeight : mapHeightPayees.begin()->first - 1;
+    if (nLastHeight < nFirstHeight)
+        return true;
+
+    std::vector<std::pair<int, CPayeeIndexValue> > vEntries;
+    if (!pblocktree->ReadPayeeIndex(nFirstHeight, nLastHeight, vEntries))
+        return error("CMasternodePayeeIndex::%s -- failed to read payee index", __func__);
+
+    size_t nEntry = 0;
+    int nBuilt = 0;
+    for (int nHeight = nFirstHeight; nHeight <= nLastHeight; nHeight++) {
+        const CBlockIndex* pindex = pindexTip->GetAncestor(nHeight);
+        while (nEntry < vEntries.size() && vEntries[nEntry].first < nHeight) {
+            nEntry++;
+        }
+        if (nEntry < vEntries.size() && vEntries[nEntry].first == nHeight &&
+            vEntries[nEntry].second.blockHash == pindex->GetBlockHash()) {
+            AddEntry(nHeight, vEntries[nEntry].second.vPayees);
+            continue;
+        }
+
+        // Not indexed yet (or indexed for a block which is not in our chain anymore),
+        // build the entry from disk once, without pushing the blocks peers ask for out of the block cache
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus(), false))
+            continue; // pruned
+        std::vector<CScript> vPayees = GetBlockPayees(block, nHeight);
+        if (!pblocktree->WritePayeeIndex(nHeight, CPayeeIndexValue(pindex->GetBlockHash(), vPayees)))
+            return error("CMasternodePayeeIndex::%s -- failed to write payee index", __func__);
+        AddEntry(nHeight, vPayees);
+        nBuilt++;
+    }
+
+    LogPrint("mnpayments", "CMasternodePayeeIndex::%s -- loaded heights %d-%d, built %d entries from disk\n", __func__, nFirstHeight, nLastHeight, nBuilt);
+
+    return true;
+}
+
+std::vector<int> CMasternodePayeeIndex::GetPaidHeights(const CScript& payee, int nMinHeight, int nMaxHeight) const
+{
+    LOCK(cs);
+    std::vector<int> vHeights;
+
+    auto it = mapPayeeHeights.find(payee);
+    if (it == mapPayeeHeights.end())
+        return vHeights;
+
+    auto itHeight = it->second.upper_bound(nMaxHeight);
+    while (itHeight != it->second.begin()) {
+        --itHeight;
+        if (*itHeight < nMinHeight)
+            break;
+        vHeights.push_back(*itHeight);
+    }
+    return vHeights;
+}
+
 void CMasternodePayments::Clear()
 {
     LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePaymentVotes);
     mapMasternodeBlocks.clear();
     mapMasternodePaymentVotes.clear();
+    mapVoteHashesByHeight.clear();
+}
+
+void CMasternodePayments::AddVoteHashByHeight(const uint256& nVoteHash, int nBlockHeight)
+{
+    AssertLockHeld(cs_mapMasternodePaymentVotes);
+    mapVoteHashesByHeight[nBlockHeight].push_back(nVoteHash);
+}
+
+void CMasternodePayments::RebuildIndexes()
+{
+    LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePaymentVotes);
+
+    mapVoteHashesByHeight.clear();
+    for (const auto& votePair : mapMasternodePaymentVotes) {
+        AddVoteHashByHeight(votePair.first, votePair.second.nBlockHeight);
+    }
+
+    for (auto& blockPair : mapMasternodeBlocks) {
+        for (const auto& payee : blockPair.second.vecPayees) {
+            for (const auto& voteHash : payee.GetVoteHashes()) {
+                const auto itVote = mapMasternodePaymentVotes.find(voteHash);
+                if (itVote != mapMasternodePaymentVotes.end()) {
+                    blockPair.second.AddVoter(itVote->second.masternodeOutpoint, payee.GetPayee());
+                }
+            }
+        }
+    }
 }
 
 bool CMasternodePayments::UpdateLastVote(const CMasternodePaymentVote& vote)
@@ -468,6 +648,9 @@ void CMasternodePayments::ProcessMessage(CNode* pfrom, const std::string& strCom
             LOCK(cs_mapMasternodePaymentVotes);
 
             auto res = mapMasternodePaymentVotes.emplace(nHash, vote);
+            if (res.second) {
+                AddVoteHashByHeight(nHash, vote.nBlockHeight);
+            }
 
             // Avoid processing same vote multiple times if it was already verified earlier
             if(!res.second && res.first->second.IsVerified()) {
@@ -689,7 +872,12 @@ bool CMasternodePayments::AddOrUpdatePaymentVote(const CMasternodePaymentVote& v
 
     LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePaymentVotes);
 
-    mapMasternodePaymentVotes[nVoteHash] = vote;
+    auto res = mapMasternodePaymentVotes.emplace(nVoteHash, vote);
+    if (res.second) {
+        AddVoteHashByHeight(nVoteHash, vote.nBlockHeight);
+    } else {
+        res.first->second = vote;
+    }
 
     auto it = mapMasternodeBlocks.emplace(vote.nBlockHeight, CMasternodeBlockPayees(vote.nBlockHeight)).first;
     it->second.AddPayee(vote);
@@ -706,52 +894,80 @@ bool CMasternodePayments::HasVerifiedPaymentVote(const uint256& hashIn) const
     return it != mapMasternodePaymentVotes.end() && it->second.IsVerified();
 }
 
+void CMasternodeBlockPayees::RebuildTally()
+{
+    mapPayeeIndexes.clear();
+    nBestPayeeIndex = -1;
+    for (size_t i = 0; i < vecPayees.size(); i++) {
+        mapPayeeIndexes.emplace(vecPayees[i].GetPayee(), i);
+        if (nBestPayeeIndex == -1 || vecPayees[i].GetVoteCount() > vecPayees[nBestPayeeIndex].GetVoteCount()) {
+            nBestPayeeIndex = i;
+        }
+    }
+}
+
 void CMasternodeBlockPayees::AddPayee(const CMasternodePaymentVote& vote)
 {
     LOCK(cs_vecPayees);
 
     uint256 nVoteHash = vote.GetHash();
 
-    for (auto& payee : vecPayees) {
-        if (payee.GetPayee() == vote.payee) {
-            payee.AddVoteHash(nVoteHash);
-            return;
-        }
+    mapVoterPayees[vote.masternodeOutpoint] = vote.payee;
+
+    size_t nIndex;
+    auto it = mapPayeeIndexes.find(vote.payee);
+    if (it != mapPayeeIndexes.end()) {
+        nIndex = it->second;
+        vecPayees[nIndex].AddVoteHash(nVoteHash);
+    } else {
+        nIndex = vecPayees.size();
+        vecPayees.emplace_back(vote.payee, nVoteHash);
+        mapPayeeIndexes.emplace(vote.payee, nIndex);
+    }
+
+    // Vote counts only ever grow, so the leader can only be replaced by the payee which just got a vote
+    if (nBestPayeeIndex == -1) {
+        nBestPayeeIndex = nIndex;
+        return;
     }
-    CMasternodePayee payeeNew(vote.payee, nVoteHash);
-    vecPayees.push_back(payeeNew);
+    int nVotes = vecPayees[nIndex].GetVoteCount();
+    int nBestVotes = vecPayees[nBestPayeeIndex].GetVoteCount();
+    if (nVotes > nBestVotes || (nVotes == nBestVotes && (int)nIndex < nBestPayeeIndex)) {
+        nBestPayeeIndex = nIndex;
+    }
+}
+
+void CMasternodeBlockPayees::AddVoter(const COutPoint& outpoint, const CScript& payee)
+{
+    LOCK(cs_vecPayees);
+    mapVoterPayees[outpoint] = payee;
 }
 
 bool CMasternodeBlockPayees::GetBestPayee(CScript& payeeRet) const
 {
     LOCK(cs_vecPayees);
 
-    if(vecPayees.empty()) {
+    if(nBestPayeeIndex == -1) {
         LogPrint("mnpayments", "CMasternodeBlockPayees::%s -- ERROR: couldn't find any payee\n", __func__);
         return false;
     }
 
-    int nVotes = -1;
-    for (const auto& payee : vecPayees) {
-        if (payee.GetVoteCount() > nVotes) {
-            payeeRet = payee.GetPayee();
-            nVotes = payee.GetVoteCount();
-        }
-    }
+    const CMasternodePayee& payee = vecPayees[nBestPayeeIndex];
+    payeeRet = payee.GetPayee();
 
-    LogPrint("mnpayments", "CMasternodeBlockPayees::GetBestPayee -- nVotes=%d\n", nVotes);
-    return (nVotes > -1);
+    LogPrint("mnpayments", "CMasternodeBlockPayees::GetBestPayee -- nVotes=%d\n", payee.GetVoteCount());
+    return true;
 }
 
 bool CMasternodeBlockPayees::HasPayeeWithVotes(const CScript& payeeIn, int nVotesReq) const
 {
     LOCK(cs_vecPayees);
 
-    int i = (int)vecPayees.size();
-    for (const auto& payee : vecPayees) {
-        int v = payee.GetVoteCount();
-        if (v >= nVotesReq && payee.GetPayee() == payeeIn) {
-            LogPrint("mnpayments", "CMasternodeBlockPayees::HasPayeeWithVotes -- found payee with %d votes of %d+ required from %d\n", v, nVotesReq, i);
+    const auto it = mapPayeeIndexes.find(payeeIn);
+    if (it != mapPayeeIndexes.end()) {
+        int v = vecPayees[it->second].GetVoteCount();
+        if (v >= nVotesReq) {
+            LogPrint("mnpayments", "CMasternodeBlockPayees::HasPayeeWithVotes -- found payee with %d votes of %d+ required from %d\n", v, nVotesReq, (int)vecPayees.size());
             return true;
         }
     }
@@ -760,6 +976,18 @@ bool CMasternodeBlockPayees::HasPayeeWithVotes(const CScript& payeeIn, int nVote
     return false;
 }
 
+bool CMasternodeBlockPayees::GetVotedPayee(const COutPoint& outpoint, CScript& payeeRet) const
+{
+    LOCK(cs_vecPayees);
+
+    const auto it = mapVoterPayees.find(outpoint);
+    if (it == mapVoterPayees.end())
+        return false;
+
+    payeeRet = it->second;
+    return true;
+}
+
 bool CMasternodeBlockPayees::IsTransactionValid(const CTransaction& txNew) const
 {
     LOCK(cs_vecPayees);
@@ -771,10 +999,8 @@ bool CMasternodeBlockPayees::IsTransactionValid(const CTransaction& txNew) const
 
     //require at least MNPAYMENTS_SIGNATURES_REQUIRED signatures
 
-    for (const auto& payee : vecPayees) {
-        if (payee.GetVoteCount() >= nMaxSignatures) {
-            nMaxSignatures = payee.GetVoteCount();
-        }
+    if (nBestPayeeIndex != -1) {
+        nMaxSignatures = vecPayees[nBestPayeeIndex].GetVoteCount();
     }
 
     // if we don't have at least MNPAYMENTS_SIGNATURES_REQUIRED signatures on a payee, approve whichever is the longest chain
@@ -885,17 +1111,15 @@ void CMasternodePayments::CheckAndRemove()
 
     int nLimit = GetStorageLimit();
 
-    std::map<uint256, CMasternodePaymentVote>::iterator it = mapMasternodePaymentVotes.begin();
-    while(it != mapMasternodePaymentVotes.end()) {
-        CMasternodePaymentVote vote = (*it).second;
-
-        if(nCachedBlockHeight - vote.nBlockHeight > nLimit) {
-            LogPrint("mnpayments", "CMasternodePayments::%s -- Removing old Masternode payment: nBlockHeight=%d\n", __func__, vote.nBlockHeight);
-            mapMasternodePaymentVotes.erase(it++);
-            mapMasternodeBlocks.erase(vote.nBlockHeight);
-        } else {
-            ++it;
+    // Drop whole heights at once, votes are bucketed by the height they vote for
+    auto it = mapVoteHashesByHeight.begin();
+    while(it != mapVoteHashesByHeight.end() && nCachedBlockHeight - it->first > nLimit) {
+        LogPrint("mnpayments", "CMasternodePayments::%s -- Removing %d old Masternode payments: nBlockHeight=%d\n", __func__, (int)it->second.size(), it->first);
+        for (const auto& nVoteHash : it->second) {
+            mapMasternodePaymentVotes.erase(nVoteHash);
         }
+        mapMasternodeBlocks.erase(it->first);
+        it = mapVoteHashesByHeight.erase(it);
     }
     LogPrintf("CMasternodePayments::%s -- %s\n", __func__, ToString());
 }
@@ -1052,21 +1276,7 @@ void CMasternodePayments::CheckBlockVotes(int nBlockHeight)
 
         const auto it = mapMasternodeBlocks.find(nBlockHeight);
         if (it != mapMasternodeBlocks.end()) {
-            for (const auto& p : it->second.vecPayees) {
-                for (const auto& voteHash : p.GetVoteHashes()) {
-                    const auto itVote = mapMasternodePaymentVotes.find(voteHash);
-                    if (itVote == mapMasternodePaymentVotes.end()) {
-                        debugStr += strprintf("    - could not find vote %s\n",
-                                              voteHash.ToString());
-                        continue;
-                    }
-                    if (itVote->second.masternodeOutpoint == mn.second.outpoint) {
-                        payee = itVote->second.payee;
-                        found = true;
-                        break;
-                    }
-                }
-            }
+            found = it->second.GetVotedPayee(mn.second.outpoint, payee);
         }
 
         if (found) {
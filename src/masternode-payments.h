@@ -13,6 +13,7 @@
 #include "net_processing.h"
 #include "utilstrencodings.h"
 
+class CMasternodePayeeIndex;
 class CMasternodePayments;
 class CMasternodePaymentVote;
 class CMasternodeBlockPayees;
@@ -32,6 +33,7 @@ extern CCriticalSection cs_vecPayees;
 extern CCriticalSection cs_mapMasternodeBlocks;
 
 extern CMasternodePayments mnpayments;
+extern CMasternodePayeeIndex mnpayeeindex;
 
 /// TODO: all 4 functions do not belong here really, they should be refactored/moved somewhere (main.cpp ?)
 bool IsBlockValueValid(const CBlock& block, int nBlockHeight, CAmount blockReward, std::string& strErrorRet);
@@ -76,15 +78,27 @@ public:
 // Keep track of votes for payees from masternodes
 class CMasternodeBlockPayees
 {
+private:
+    // Tally index over vecPayees, not serialized but rebuilt on load
+    std::map<CScript, size_t> mapPayeeIndexes;
+    // the payee with most votes, the first one in vecPayees on a tie (-1 if none)
+    int nBestPayeeIndex;
+    // what each masternode voted for, rebuilt by CMasternodePayments on load
+    std::map<COutPoint, CScript> mapVoterPayees;
+
+    void RebuildTally();
+
 public:
     int nBlockHeight;
     std::vector<CMasternodePayee> vecPayees;
 
     CMasternodeBlockPayees() :
+        nBestPayeeIndex(-1),
         nBlockHeight(0),
         vecPayees()
         {}
     CMasternodeBlockPayees(int nBlockHeightIn) :
+        nBestPayeeIndex(-1),
         nBlockHeight(nBlockHeightIn),
         vecPayees()
         {}
@@ -95,11 +109,16 @@ public:
     inline void SerializationOp(Stream& s, Operation ser_action) {
         READWRITE(nBlockHeight);
         READWRITE(vecPayees);
+        if (ser_action.ForRead()) {
+            RebuildTally();
+        }
     }
 
     void AddPayee(const CMasternodePaymentVote& vote);
+    void AddVoter(const COutPoint& outpoint, const CScript& payee);
     bool GetBestPayee(CScript& payeeRet) const;
     bool HasPayeeWithVotes(const CScript& payeeIn, int nVotesReq) const;
+    bool GetVotedPayee(const COutPoint& outpoint, CScript& payeeRet) const;
 
     bool IsTransactionValid(const CTransaction& txNew) const;
 
@@ -157,6 +176,50 @@ public:
     std::string ToString() const;
 };
 
+//
+// Masternode Payee Index Class
+// Maps payee scripts to the heights of the recent active chain blocks whose
+// coinbase paid them the masternode reward. Entries are kept on disk in the
+// block tree db (written on ConnectTip/DisconnectTip), this class holds a
+// window of recent heights in memory so that last paid lookups don't need to
+// read blocks.
+//
+
+class CMasternodePayeeIndex
+{
+public:
+    /// Db entries behind the window are erased once every that many blocks
+    static const int DB_PRUNE_INTERVAL = 1000;
+
+private:
+    mutable CCriticalSection cs;
+
+    std::map<CScript, std::set<int> > mapPayeeHeights;
+    std::map<int, std::vector<CScript> > mapHeightPayees;
+
+    void AddEntry(int nHeight, const std::vector<CScript>& vPayees);
+    void RemoveEntry(int nHeight);
+    void Clear();
+
+public:
+    /// Coinbase outputs of block at nHeight which pay the masternode reward
+    static std::vector<CScript> GetBlockPayees(const CBlock& block, int nHeight);
+
+    /// Append the block at the tip of the window and drop the ones which are more than nBlocks behind it
+    void BlockConnected(int nHeight, const std::vector<CScript>& vPayees, int nBlocks);
+    /// Remove the block at the tip of the window
+    void BlockDisconnected(int nHeight);
+
+    /// Make sure the last nBlocks blocks up to pindexTip are in memory and drop older ones.
+    /// Missing db entries (e.g. from before the index existed) are built from disk once.
+    bool LoadWindow(const CBlockIndex* pindexTip, int nBlocks);
+
+    /// Heights in [nMinHeight, nMaxHeight] at which payee was paid, highest first
+    std::vector<int> GetPaidHeights(const CScript& payee, int nMinHeight, int nMaxHeight) const;
+
+    size_t size() const { LOCK(cs); return mapHeightPayees.size(); }
+};
+
 //
 // Masternode Payments Class
 // Keeps track of who should get paid for which blocks
@@ -173,6 +236,13 @@ private:
     // Keep track of current block height
     int nCachedBlockHeight;
 
+    // Hashes of mapMasternodePaymentVotes entries by vote height, so that old
+    // heights can be expired without walking all votes
+    std::map<int, std::vector<uint256> > mapVoteHashesByHeight;
+
+    void AddVoteHashByHeight(const uint256& nVoteHash, int nBlockHeight);
+    void RebuildIndexes();
+
 public:
     std::map<uint256, CMasternodePaymentVote> mapMasternodePaymentVotes;
     std::map<int, CMasternodeBlockPayees> mapMasternodeBlocks;
@@ -187,6 +257,9 @@ public:
     inline void SerializationOp(Stream& s, Operation ser_action) {
         READWRITE(mapMasternodePaymentVotes);
         READWRITE(mapMasternodeBlocks);
+        if (ser_action.ForRead()) {
+            RebuildIndexes();
+        }
     }
 
     void Clear();
@@ -79,7 +79,7 @@ bool CMasternode::UpdateFromNewBroadcast(CMasternodeBroadcast& mnb, CConnman& co
     int nDos = 0;
     if(!mnb.lastPing || (mnb.lastPing && mnb.lastPing.CheckAndUpdate(this, true, nDos, connman))) {
         lastPing = mnb.lastPing;
-        mnodeman.mapSeenMasternodePing.insert(std::make_pair(lastPing.GetHash(), lastPing));
+        mnodeman.mapSeenMasternodePing.Insert(lastPing.GetHash(), lastPing, lastPing.GetExpirationTime());
     }
     // if it matches our Masternode privkey...
     if(fMasternodeMode && legacyKeyIDOperator == activeMasternodeInfo.legacyKeyIDOperator) {
@@ -343,34 +343,23 @@ void CMasternode::UpdateLastPaid(const CBlockIndex *pindex, int nMaxBlocksToScan
         return;
     }
 
-    const CBlockIndex *BlockReading = pindex;
-
     CScript mnpayee = GetScriptForDestination(keyIDCollateralAddress);
     // LogPrint("mnpayments", "CMasternode::UpdateLastPaidBlock -- searching for block with payment to %s\n", outpoint.ToStringShort());
 
+    int nMinHeight = std::max(nBlockLastPaid + 1, pindex->nHeight - nMaxBlocksToScanBack + 1);
+
     LOCK(cs_mapMasternodeBlocks);
 
-    for (int i = 0; BlockReading && BlockReading->nHeight > nBlockLastPaid && i < nMaxBlocksToScanBack; i++) {
-        if(mnpayments.mapMasternodeBlocks.count(BlockReading->nHeight) &&
-            mnpayments.mapMasternodeBlocks[BlockReading->nHeight].HasPayeeWithVotes(mnpayee, 2))
+    // mnpayeeindex only returns heights where the coinbase actually paid mnpayee
+    for (int nHeight : mnpayeeindex.GetPaidHeights(mnpayee, nMinHeight, pindex->nHeight)) {
+        if(mnpayments.mapMasternodeBlocks.count(nHeight) &&
+            mnpayments.mapMasternodeBlocks[nHeight].HasPayeeWithVotes(mnpayee, 2))
         {
-            CBlock block;
-            if(!ReadBlockFromDisk(block, BlockReading, Params().GetConsensus()))
-                continue; // shouldn't really happen
-
-            CAmount nMasternodePayment = GetMasternodePayment(BlockReading->nHeight, block.vtx[0]->GetValueOut());
-
-            for (const auto& txout : block.vtx[0]->vout)
-                if(mnpayee == txout.scriptPubKey && nMasternodePayment == txout.nValue) {
-                    nBlockLastPaid = BlockReading->nHeight;
-                    nTimeLastPaid = BlockReading->nTime;
-                    LogPrint("mnpayments", "CMasternode::UpdateLastPaidBlock -- searching for block with payment to %s -- found new %d\n", outpoint.ToStringShort(), nBlockLastPaid);
-                    return;
-                }
+            nBlockLastPaid = nHeight;
+            nTimeLastPaid = pindex->GetAncestor(nHeight)->nTime;
+            LogPrint("mnpayments", "CMasternode::UpdateLastPaidBlock -- searching for block with payment to %s -- found new %d\n", outpoint.ToStringShort(), nBlockLastPaid);
+            return;
         }
-
-        if (BlockReading->pprev == nullptr) { assert(BlockReading); break; }
-        BlockReading = BlockReading->pprev;
     }
 
     // Last payment for this masternode wasn't found in latest mnpayments blocks
@@ -70,7 +70,9 @@ public:
     uint256 GetHash() const;
     uint256 GetSignatureHash() const;
 
-    bool IsExpired() const { return GetAdjustedTime() - sigTime > MASTERNODE_NEW_START_REQUIRED_SECONDS; }
+    /// Last second at which this ping is not expired yet
+    int64_t GetExpirationTime() const { return sigTime + MASTERNODE_NEW_START_REQUIRED_SECONDS; }
+    bool IsExpired() const { return GetAdjustedTime() > GetExpirationTime(); }
 
     bool Sign(const CKey& keyMasternode, const CKeyID& keyIDOperator);
     bool CheckSignature(CKeyID& keyIDOperator, int &nDos) const;
@@ -8,6 +8,7 @@
 #include "clientversion.h"
 #include "init.h"
 #include "governance.h"
+#include "instantx.h"
 #include "masternode-payments.h"
 #include "masternode-sync.h"
 #include "masternodeman.h"
@@ -31,7 +32,7 @@
 /** Masternode manager */
 CMasternodeMan mnodeman;
 
-const std::string CMasternodeMan::SERIALIZATION_VERSION_STRING = "CMasternodeMan-Version-12";
+const std::string CMasternodeMan::SERIALIZATION_VERSION_STRING = "CMasternodeMan-Version-13";
 const int CMasternodeMan::LAST_PAID_SCAN_BLOCKS = 100;
 
 struct CompareLastPaidBlock
@@ -103,12 +104,14 @@ CMasternodeMan::CMasternodeMan():
     mMnbRecoveryRequests(),
     mMnbRecoveryGoodReplies(),
     listScheduledMnbRequestConnections(),
+    mapMasternodesSnapshot(),
     fMasternodesAdded(false),
     fMasternodesRemoved(false),
     vecDirtyGovernanceObjectHashes(),
     nLastSentinelPingTime(0),
     mapSeenMasternodeBroadcast(),
     mapSeenMasternodePing(),
+    mapSeenMasternodeVerification(),
     nDsqCount(0)
 {}
 
@@ -125,6 +128,7 @@ bool CMasternodeMan::Add(CMasternode &mn)
     LogPrint("masternode", "CMasternodeMan::Add -- Adding new Masternode: addr=%s, %i now\n", mn.addr.ToString(), size() + 1);
     mapMasternodes[mn.outpoint] = mn;
     fMasternodesAdded = true;
+    UpdateSnapshot(mn.outpoint);
     return true;
 }
 
@@ -191,6 +195,7 @@ bool CMasternodeMan::AllowMixing(const COutPoint &outpoint)
     nDsqCount++;
     pmn->nLastDsq = nDsqCount;
     pmn->nMixingTxCount = 0;
+    UpdateSnapshot(outpoint);
 
     return true;
 }
@@ -203,6 +208,7 @@ bool CMasternodeMan::DisallowMixing(const COutPoint &outpoint)
         return false;
     }
     pmn->nMixingTxCount++;
+    UpdateSnapshot(outpoint);
 
     return true;
 }
@@ -217,6 +223,7 @@ bool CMasternodeMan::IncreasePoSeBanScore(const COutPoint &outpoint)
         return false;
     }
     pmn->IncreasePoSeBanScore();
+    UpdateSnapshot(outpoint);
 
     return true;
 }
@@ -231,6 +238,7 @@ bool CMasternodeMan::DecreasePoSeBanScore(const COutPoint &outpoint)
         return false;
     }
     pmn->DecreasePoSeBanScore();
+    UpdateSnapshot(outpoint);
 
     return true;
 }
@@ -249,6 +257,7 @@ bool CMasternodeMan::PoSeBan(const COutPoint &outpoint)
         return false;
     }
     pmn->PoSeBan();
+    UpdateSnapshot(outpoint);
 
     return true;
 }
@@ -299,10 +308,17 @@ void CMasternodeMan::Check()
     if (deterministicMNManager->IsDeterministicMNsSporkActive())
         return;
 
+    auto pmnList = GetSnapshotFilter();
     for (auto& mnpair : mapMasternodes) {
+        const CMasternode& mn = mnpair.second;
+        int nActiveStatePrev = mn.nActiveState;
+        int nPoSeBanScorePrev = mn.nPoSeBanScore;
         // NOTE: internally it checks only every MASTERNODE_CHECK_SECONDS seconds
         // since the last time, so expect some MNs to skip this
         mnpair.second.Check();
+        if (mn.nActiveState != nActiveStatePrev || mn.nPoSeBanScore != nPoSeBanScorePrev) {
+            UpdateSnapshot(mnpair.first, pmnList.get());
+        }
     }
 }
 
@@ -326,6 +342,7 @@ void CMasternodeMan::CheckAndRemove(CConnman& connman)
         rank_pair_vec_t vecMasternodeRanks;
         // ask for up to MNB_RECOVERY_MAX_ASK_ENTRIES masternode entries at a time
         int nAskForMnbRecovery = MNB_RECOVERY_MAX_ASK_ENTRIES;
+        auto pmnList = GetSnapshotFilter();
         std::map<COutPoint, CMasternode>::iterator it = mapMasternodes.begin();
         while (it != mapMasternodes.end()) {
             CMasternodeBroadcast mnb = CMasternodeBroadcast(it->second);
@@ -340,8 +357,10 @@ void CMasternodeMan::CheckAndRemove(CConnman& connman)
 
                 // and finally remove it from the list
                 it->second.FlagGovernanceItemsAsDirty();
+                COutPoint outpoint = it->first;
                 mapMasternodes.erase(it++);
                 fMasternodesRemoved = true;
+                UpdateSnapshot(outpoint, pmnList.get());
             } else {
                 bool fAsk = (nAskForMnbRecovery > 0) &&
                             masternodeSync.IsSynced() &&
@@ -464,26 +483,14 @@ void CMasternodeMan::CheckAndRemove(CConnman& connman)
         // NOTE: do not expire mapSeenMasternodeBroadcast entries here, clean them on mnb updates!
 
         // remove expired mapSeenMasternodePing
-        std::map<uint256, CMasternodePing>::iterator it4 = mapSeenMasternodePing.begin();
-        while(it4 != mapSeenMasternodePing.end()){
-            if((*it4).second.IsExpired()) {
-                LogPrint("masternode", "CMasternodeMan::CheckAndRemove -- Removing expired Masternode ping: hash=%s\n", (*it4).second.GetHash().ToString());
-                mapSeenMasternodePing.erase(it4++);
-            } else {
-                ++it4;
-            }
-        }
+        mapSeenMasternodePing.Expire(GetAdjustedTime(), [](const uint256& hash, CMasternodePing& mnp, int64_t& nDeadline) {
+            LogPrint("masternode", "CMasternodeMan::CheckAndRemove -- Removing expired Masternode ping: hash=%s\n", hash.ToString());
+        });
 
         // remove expired mapSeenMasternodeVerification
-        std::map<uint256, CMasternodeVerification>::iterator itv2 = mapSeenMasternodeVerification.begin();
-        while(itv2 != mapSeenMasternodeVerification.end()){
-            if((*itv2).second.nBlockHeight < nCachedBlockHeight - MAX_POSE_BLOCKS){
-                LogPrint("masternode", "CMasternodeMan::CheckAndRemove -- Removing expired Masternode verification: hash=%s\n", (*itv2).first.ToString());
-                mapSeenMasternodeVerification.erase(itv2++);
-            } else {
-                ++itv2;
-            }
-        }
+        mapSeenMasternodeVerification.Expire(nCachedBlockHeight, [](const uint256& hash, CMasternodeVerification& mnv, int64_t& nDeadline) {
+            LogPrint("masternode", "CMasternodeMan::CheckAndRemove -- Removing expired Masternode verification: hash=%s\n", hash.ToString());
+        });
 
         LogPrintf("CMasternodeMan::CheckAndRemove -- %s\n", ToString());
     }
@@ -504,11 +511,19 @@ void CMasternodeMan::AddDeterministicMasternodes()
         unsigned int oldMnCount = mapMasternodes.size();
 
         auto mnList = deterministicMNManager->GetListAtChainTip();
-        mnList.ForEachMN(true, [this](const CDeterministicMNCPtr& dmn) {
+        mnList.ForEachMN(true, [&](const CDeterministicMNCPtr& dmn) {
             // call Find() on each deterministic MN to force creation of CMasternode object
             auto mn = Find(dmn->collateralOutpoint);
             assert(mn);
 
+            // this runs for every block, only republish the ones which actually changed
+            bool fChanged = mn->keyIDOwner != dmn->pdmnState->keyIDOwner ||
+                            mn->blsPubKeyOperator != dmn->pdmnState->pubKeyOperator ||
+                            mn->keyIDVoting != dmn->pdmnState->keyIDVoting ||
+                            mn->addr != dmn->pdmnState->addr ||
+                            mn->nProtocolVersion != DMN_PROTO_VERSION ||
+                            mn->nActiveState != CMasternode::MASTERNODE_ENABLED;
+
             // make sure we use the splitted keys from now on
             mn->keyIDOwner = dmn->pdmnState->keyIDOwner;
             mn->blsPubKeyOperator = dmn->pdmnState->pubKeyOperator;
@@ -518,6 +533,10 @@ void CMasternodeMan::AddDeterministicMasternodes()
 
             // If it appeared in the valid list, it is enabled no matter what
             mn->nActiveState = CMasternode::MASTERNODE_ENABLED;
+
+            if (fChanged) {
+                UpdateSnapshot(dmn->collateralOutpoint, &mnList);
+            }
         });
 
         added = oldMnCount != mapMasternodes.size();
@@ -544,8 +563,10 @@ void CMasternodeMan::RemoveNonDeterministicMasternodes()
         auto it = mapMasternodes.begin();
         while (it != mapMasternodes.end()) {
             if (!mnSet.count(it->second.outpoint)) {
+                COutPoint outpoint = it->first;
                 mapMasternodes.erase(it++);
                 erased = true;
+                UpdateSnapshot(outpoint, &mnList);
             } else {
                 ++it;
             }
@@ -560,11 +581,13 @@ void CMasternodeMan::Clear()
 {
     LOCK(cs);
     mapMasternodes.clear();
+    mapMasternodesSnapshot = snapshot_t();
     mAskedUsForMasternodeList.clear();
     mWeAskedForMasternodeList.clear();
     mWeAskedForMasternodeListEntry.clear();
     mapSeenMasternodeBroadcast.clear();
-    mapSeenMasternodePing.clear();
+    mapSeenMasternodePing.Clear();
+    mapSeenMasternodeVerification.Clear();
     nDsqCount = 0;
     nLastSentinelPingTime = 0;
 }
@@ -672,6 +695,7 @@ CMasternode* CMasternodeMan::Find(const COutPoint &outpoint)
             // MN is not in mapMasternodes but in the deterministic list. Create an entry in mapMasternodes for compatibility with legacy code
             CMasternode mn(outpoint.hash, dmn);
             it = mapMasternodes.emplace(outpoint, mn).first;
+            UpdateSnapshot(outpoint, &mnList);
             return &(it->second);
         }
     } else {
@@ -859,8 +883,6 @@ bool CMasternodeMan::GetNextMasternodeInQueueForPayment(int nBlockHeight, bool f
 
 masternode_info_t CMasternodeMan::FindRandomNotInVec(const std::vector<COutPoint> &vecToExclude, int nProtocolVersion)
 {
-    LOCK(cs);
-
     nProtocolVersion = nProtocolVersion == -1 ? mnpayments.GetMinMasternodePaymentsProto() : nProtocolVersion;
 
     int nCountEnabled = CountEnabled(nProtocolVersion);
@@ -869,28 +891,23 @@ masternode_info_t CMasternodeMan::FindRandomNotInVec(const std::vector<COutPoint
     LogPrintf("CMasternodeMan::FindRandomNotInVec -- %d enabled masternodes, %d masternodes to choose from\n", nCountEnabled, nCountNotExcluded);
     if(nCountNotExcluded < 1) return masternode_info_t();
 
-    // fill a vector of pointers
+    // fill a vector of pointers, the snapshot keeps them valid without holding cs
+    snapshot_t snapshot = GetMasternodeMapSnapshot();
     std::vector<const CMasternode*> vpMasternodesShuffled;
-    for (const auto& mnpair : mapMasternodes) {
+    vpMasternodesShuffled.reserve(snapshot.size());
+    for (const auto& mnpair : snapshot) {
         vpMasternodesShuffled.push_back(&mnpair.second);
     }
 
     FastRandomContext insecure_rand;
     // shuffle pointers
     std::random_shuffle(vpMasternodesShuffled.begin(), vpMasternodesShuffled.end(), insecure_rand);
-    bool fExclude;
+    std::set<COutPoint> setToExclude(vecToExclude.begin(), vecToExclude.end());
 
     // loop through
     for (const auto& pmn : vpMasternodesShuffled) {
         if(pmn->nProtocolVersion < nProtocolVersion || !pmn->IsEnabled()) continue;
-        fExclude = false;
-        for (const auto& outpointToExclude : vecToExclude) {
-            if(pmn->outpoint == outpointToExclude) {
-                fExclude = true;
-                break;
-            }
-        }
-        if(fExclude) continue;
+        if(setToExclude.count(pmn->outpoint)) continue;
         if (deterministicMNManager->IsDeterministicMNsSporkActive() && !deterministicMNManager->HasValidMNCollateralAtChainTip(pmn->outpoint))
             continue;
         // found the one not in vecToExclude
@@ -902,23 +919,61 @@ masternode_info_t CMasternodeMan::FindRandomNotInVec(const std::vector<COutPoint
     return masternode_info_t();
 }
 
-std::map<COutPoint, CMasternode> CMasternodeMan::GetFullMasternodeMap()
+CMasternodeMan::snapshot_t CMasternodeMan::GetMasternodeMapSnapshot()
 {
     LOCK(cs);
+    return mapMasternodesSnapshot;
+}
+
+// only the valid masternodes are published once DIP3 is active
+static bool IsSnapshotEntry(const COutPoint& outpoint, const CDeterministicMNList* pmnList)
+{
+    if (!pmnList) return true;
+    auto dmn = pmnList->GetMNByCollateral(outpoint);
+    return dmn && pmnList->IsMNValid(dmn);
+}
 
+std::unique_ptr<CDeterministicMNList> CMasternodeMan::GetSnapshotFilter() const
+{
+    std::unique_ptr<CDeterministicMNList> pmnList;
     if (deterministicMNManager->IsDeterministicMNsSporkActive()) {
-        std::map<COutPoint, CMasternode> result;
-        auto mnList = deterministicMNManager->GetListAtChainTip();
-        for (const auto &p : mapMasternodes) {
-            auto dmn = mnList.GetMNByCollateral(p.first);
-            if (dmn && mnList.IsMNValid(dmn)) {
-                result.emplace(p.first, p.second);
-            }
+        pmnList.reset(new CDeterministicMNList(deterministicMNManager->GetListAtChainTip()));
+    }
+    return pmnList;
+}
+
+void CMasternodeMan::UpdateSnapshot(const COutPoint& outpoint)
+{
+    UpdateSnapshot(outpoint, GetSnapshotFilter().get());
+}
+
+void CMasternodeMan::UpdateSnapshot(const COutPoint& outpoint, const CDeterministicMNList* pmnList)
+{
+    AssertLockHeld(cs);
+
+    auto it = mapMasternodes.find(outpoint);
+    if (it != mapMasternodes.end() && IsSnapshotEntry(outpoint, pmnList)) {
+        mapMasternodesSnapshot = mapMasternodesSnapshot.set(outpoint, it->second);
+    } else if (mapMasternodesSnapshot.count(outpoint)) {
+        mapMasternodesSnapshot = mapMasternodesSnapshot.erase(outpoint);
+    }
+}
+
+void CMasternodeMan::RebuildSnapshot()
+{
+    AssertLockHeld(cs);
+
+    auto pmnList = GetSnapshotFilter();
+
+    snapshot_t snapshot;
+    for (const auto& mnpair : mapMasternodes) {
+        if (IsSnapshotEntry(mnpair.first, pmnList.get())) {
+            snapshot = snapshot.set(mnpair.first, mnpair.second);
         }
-        return result;
-    } else {
-        return mapMasternodes;
     }
+    mapMasternodesSnapshot = snapshot;
+
+    LogPrint("masternode", "CMasternodeMan::%s -- %d masternodes\n", __func__, mapMasternodesSnapshot.size());
 }
 
 bool CMasternodeMan::GetMasternodeScores(const uint256& nBlockHash, CMasternodeMan::score_pair_vec_t& vecMasternodeScoresRet, int nMinProtocol)
@@ -1177,8 +1232,8 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, const std::string& strCommand,
         // Need LOCK2 here to ensure consistent locking order because the CheckAndUpdate call below locks cs_main
         LOCK2(cs_main, cs);
 
-        if(mapSeenMasternodePing.count(nHash)) return; //seen
-        mapSeenMasternodePing.insert(std::make_pair(nHash, mnp));
+        if(mapSeenMasternodePing.Has(nHash)) return; //seen
+        mapSeenMasternodePing.Insert(nHash, mnp, mnp.GetExpirationTime());
 
         LogPrint("masternode", "MNPING -- Masternode ping, masternode=%s new\n", mnp.masternodeOutpoint.ToStringShort());
 
@@ -1192,7 +1247,14 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, const std::string& strCommand,
         if(pmn && pmn->IsNewStartRequired()) return;
 
         int nDos = 0;
-        if(mnp.CheckAndUpdate(pmn, false, nDos, connman)) return;
+        bool fUpdated = mnp.CheckAndUpdate(pmn, false, nDos, connman);
+        // it can change the masternode (ping, state) and still fail, e.g. when relaying
+        if(pmn) {
+            UpdateSnapshot(mnp.masternodeOutpoint);
+        }
+        if(fUpdated) {
+            return;
+        }
 
         if(nDos > 0) {
             // if anything significant failed, mark that node
@@ -1320,7 +1382,7 @@ void CMasternodeMan::PushDsegInvs(CNode* pnode, const CMasternode& mn)
     pnode->PushInventory(CInv(MSG_MASTERNODE_ANNOUNCE, hashMNB));
     pnode->PushInventory(CInv(MSG_MASTERNODE_PING, hashMNP));
     mapSeenMasternodeBroadcast.insert(std::make_pair(hashMNB, std::make_pair(GetTime(), mnb)));
-    mapSeenMasternodePing.insert(std::make_pair(hashMNP, mnp));
+    mapSeenMasternodePing.Insert(hashMNP, mnp, mnp.GetExpirationTime());
 }
 
 // Requires cs_main.
@@ -1484,6 +1546,7 @@ void CMasternodeMan::CheckSameAddr()
     std::vector<CMasternode*> vSortedByAddr;
     std::vector<CMasternode*> vSortedByPoSe;
     std::map< CNetAddr, CMasternode*> mapAskForMnv;
+    auto pmnList = GetSnapshotFilter();
 
     {
         LOCK(cs);
@@ -1501,6 +1564,7 @@ void CMasternodeMan::CheckSameAddr()
                     LogPrintf("CMasternodeMan::CheckSameAddr -- Ban masternode %s, at my addr %s\n",
                         mnpair.second.outpoint.ToStringShort(),mnpair.second.addr.ToString());
                     mnpair.second.PoSeBan();
+                    UpdateSnapshot(mnpair.first, pmnList.get());
                     continue;
                 } else {
                     vSortedByAddr.push_back(&mnpair.second);
@@ -1571,6 +1635,13 @@ void CMasternodeMan::CheckSameAddr()
         }
     }
 
+    LOCK(cs);
+    for (const auto& pmn : vBan) {
+        UpdateSnapshot(pmn->outpoint, pmnList.get());
+    }
+    for (const auto& pmn : mapAskForMnv) {
+        UpdateSnapshot(pmn.second->outpoint, pmnList.get());
+    }
 }
 
 void CMasternodeMan::CheckMissingMasternodes()
@@ -1580,6 +1651,7 @@ void CMasternodeMan::CheckMissingMasternodes()
     int mncount = 0;
     std::vector<CMasternode*> vBan;
     std::vector<CMasternode*> vSortedByAddr;
+    auto pmnList = GetSnapshotFilter();
 
     {
         LOCK(cs);
@@ -1594,6 +1666,7 @@ void CMasternodeMan::CheckMissingMasternodes()
                     LogPrintf("CMasternodeMan::CheckMissingMasternodes -- Ban masternode %s, at my addr %s\n",
                         mnpair.second.outpoint.ToStringShort(),mnpair.second.addr.ToString());
                     mnpair.second.PoSeBan();
+                    UpdateSnapshot(mnpair.first, pmnList.get());
                     continue;
                 } else vSortedByAddr.push_back(&mnpair.second);
             }
@@ -1625,6 +1698,11 @@ void CMasternodeMan::CheckMissingMasternodes()
         LogPrintf("CMasternodeMan::CheckMissingMasternodes -- Increase PoSe Ban Score for masternode %s\n", pmn->outpoint.ToStringShort());
         pmn->IncreasePoSeBanScore();
     }
+
+    LOCK(cs);
+    for (const auto& pmn : vBan) {
+        UpdateSnapshot(pmn->outpoint, pmnList.get());
+    }
 }
 
 bool CMasternodeMan::CheckVerifyRequestAddr(const CAddress& addr, CConnman& connman)
@@ -1884,6 +1962,7 @@ void CMasternodeMan::ProcessVerifyReply(CNode* pnode, CMasternodeVerification& m
                     prealMasternode = &mnpair.second;
                     if(!mnpair.second.IsPoSeVerified()) {
                         mnpair.second.DecreasePoSeBanScore();
+                        UpdateSnapshot(mnpair.first);
                     }
                     netfulfilledman.AddFulfilledRequest(pnode->addr, strprintf("%s", NetMsgType::MNVERIFY)+"-done");
 
@@ -1924,7 +2003,7 @@ void CMasternodeMan::ProcessVerifyReply(CNode* pnode, CMasternodeVerification& m
                     }
 
                     mWeAskedForVerification[pnode->addr] = mnv;
-                    mapSeenMasternodeVerification.insert(std::make_pair(mnv.GetHash(), mnv));
+                    mapSeenMasternodeVerification.Insert(mnv.GetHash(), mnv, mnv.nBlockHeight + MAX_POSE_BLOCKS);
                     mnv.Relay();
 
                 } else {
@@ -1949,6 +2028,7 @@ void CMasternodeMan::ProcessVerifyReply(CNode* pnode, CMasternodeVerification& m
         // increase ban score for everyone else found to be fake
         for (const auto& pmn : vpMasternodesToBan) {
             pmn->IncreasePoSeBanScore();
+            UpdateSnapshot(pmn->outpoint);
             LogPrintf("CMasternodeMan::ProcessVerifyReply -- increased PoSe ban score for %s addr %s, new score %d\n",
                         pmn->outpoint.ToStringShort(), pmn->addr.ToString(), pmn->nPoSeBanScore);
         }
@@ -1967,11 +2047,10 @@ void CMasternodeMan::ProcessVerifyBroadcast(CNode* pnode, const CMasternodeVerif
 
     std::string strError;
 
-    if(mapSeenMasternodeVerification.find(mnv.GetHash()) != mapSeenMasternodeVerification.end()) {
+    if(!mapSeenMasternodeVerification.Insert(mnv.GetHash(), mnv, mnv.nBlockHeight + MAX_POSE_BLOCKS)) {
         // we already have this
         return;
     }
-    mapSeenMasternodeVerification[mnv.GetHash()] = mnv;
 
     // we don't care about history
     if(mnv.nBlockHeight < nCachedBlockHeight - MAX_POSE_BLOCKS) {
@@ -2076,6 +2155,7 @@ void CMasternodeMan::ProcessVerifyBroadcast(CNode* pnode, const CMasternodeVerif
 
         if(!pmn1->IsPoSeVerified()) {
             pmn1->DecreasePoSeBanScore();
+            UpdateSnapshot(mnv.masternodeOutpoint1);
         }
         mnv.Relay();
 
@@ -2084,9 +2164,11 @@ void CMasternodeMan::ProcessVerifyBroadcast(CNode* pnode, const CMasternodeVerif
 
         // increase ban score for everyone else with the same addr
         int nCount = 0;
+        auto pmnList = GetSnapshotFilter();
         for (auto& mnpair : mapMasternodes) {
             if(mnpair.second.addr != mnv.addr || mnpair.first == mnv.masternodeOutpoint1) continue;
             mnpair.second.IncreasePoSeBanScore();
+            UpdateSnapshot(mnpair.first, pmnList.get());
             nCount++;
             LogPrintf("CMasternodeMan::ProcessVerifyBroadcast -- increased PoSe ban score for %s addr %s, new score %d\n",
                         mnpair.first.ToStringShort(), mnpair.second.addr.ToString(), mnpair.second.nPoSeBanScore);
@@ -2097,6 +2179,18 @@ void CMasternodeMan::ProcessVerifyBroadcast(CNode* pnode, const CMasternodeVerif
     }
 }
 
+CExpiringMapStats CMasternodeMan::GetSeenPingsStats() const
+{
+    LOCK(cs);
+    return mapSeenMasternodePing.GetStats();
+}
+
+CExpiringMapStats CMasternodeMan::GetSeenVerificationsStats() const
+{
+    LOCK(cs);
+    return mapSeenMasternodeVerification.GetStats();
+}
+
 std::string CMasternodeMan::ToString() const
 {
     std::ostringstream info;
@@ -2173,7 +2267,10 @@ bool CMasternodeMan::CheckMnbAndUpdateMasternodeList(CNode* pfrom, CMasternodeBr
         CMasternode* pmn = Find(mnb.outpoint);
         if(pmn) {
             CMasternodeBroadcast mnbOld = mapSeenMasternodeBroadcast[CMasternodeBroadcast(*pmn).GetHash()].second;
-            if(!mnb.Update(pmn, nDos, connman)) {
+            bool fUpdated = mnb.Update(pmn, nDos, connman);
+            // a failed update may have changed the masternode as well (Check, lastPing)
+            UpdateSnapshot(mnb.outpoint);
+            if(!fUpdated) {
                 LogPrintf("CMasternodeMan::CheckMnbAndUpdateMasternodeList -- Update() failed, masternode=%s\n", mnb.outpoint.ToStringShort());
                 return false;
             }
@@ -2229,8 +2326,18 @@ void CMasternodeMan::UpdateLastPaid(const CBlockIndex* pindex)
     LogPrint("masternode", "CMasternodeMan::UpdateLastPaid -- nCachedBlockHeight=%d, nLastRunBlockHeight=%d, nMaxBlocksToScanBack=%d\n",
                             nCachedBlockHeight, nLastRunBlockHeight, nMaxBlocksToScanBack);
 
+    if (!mnpayeeindex.LoadWindow(pindex, mnpayments.GetStorageLimit())) {
+        LogPrintf("CMasternodeMan::UpdateLastPaid -- failed to load masternode payee index\n");
+        return;
+    }
+
+    auto pmnList = GetSnapshotFilter();
     for (auto& mnpair : mapMasternodes) {
+        int nBlockLastPaidPrev = mnpair.second.nBlockLastPaid;
         mnpair.second.UpdateLastPaid(pindex, nMaxBlocksToScanBack);
+        if (mnpair.second.nBlockLastPaid != nBlockLastPaidPrev) {
+            UpdateSnapshot(mnpair.first, pmnList.get());
+        }
     }
 
     nLastRunBlockHeight = nCachedBlockHeight;
@@ -2259,14 +2366,18 @@ bool CMasternodeMan::AddGovernanceVote(const COutPoint& outpoint, uint256 nGover
         return false;
     }
     pmn->AddGovernanceVote(nGovernanceObjectHash);
+    UpdateSnapshot(outpoint);
     return true;
 }
 
 void CMasternodeMan::RemoveGovernanceObject(uint256 nGovernanceObjectHash)
 {
     LOCK(cs);
+    auto pmnList = GetSnapshotFilter();
     for(auto& mnpair : mapMasternodes) {
+        if (!mnpair.second.mapGovernanceObjectsVotedOn.count(nGovernanceObjectHash)) continue;
         mnpair.second.RemoveGovernanceObject(nGovernanceObjectHash);
+        UpdateSnapshot(mnpair.first, pmnList.get());
     }
 }
 
@@ -2278,6 +2389,7 @@ void CMasternodeMan::CheckMasternode(const CKeyID& keyIDOperator, bool fForce)
     for (auto& mnpair : mapMasternodes) {
         if (mnpair.second.legacyKeyIDOperator == keyIDOperator) {
             mnpair.second.Check(fForce);
+            UpdateSnapshot(mnpair.first);
             return;
         }
     }
@@ -2300,10 +2412,11 @@ void CMasternodeMan::SetMasternodeLastPing(const COutPoint& outpoint, const CMas
         return;
     }
     pmn->lastPing = mnp;
+    UpdateSnapshot(outpoint);
     if(mnp.fSentinelIsCurrent) {
         UpdateLastSentinelPingTime();
     }
-    mapSeenMasternodePing.insert(std::make_pair(mnp.GetHash(), mnp));
+    mapSeenMasternodePing.Insert(mnp.GetHash(), mnp, mnp.GetExpirationTime());
 
     CMasternodeBroadcast mnb(*pmn);
     uint256 hash = mnb.GetHash();
@@ -2317,6 +2430,7 @@ void CMasternodeMan::UpdatedBlockTip(const CBlockIndex *pindex)
     nCachedBlockHeight = pindex->nHeight;
     LogPrint("masternode", "CMasternodeMan::UpdatedBlockTip -- nCachedBlockHeight=%d\n", nCachedBlockHeight);
 
+
     AddDeterministicMasternodes();
     RemoveNonDeterministicMasternodes();
 
@@ -2462,6 +2576,7 @@ void CMasternodeMan::NotifyMasternodeUpdates(CConnman& connman, bool forceAddedC
     if(fMasternodesAddedLocal || forceAddedChecks) {
         governance.CheckMasternodeOrphanObjects(connman);
         governance.CheckMasternodeOrphanVotes(connman);
+        instantsend.CheckMasternodeOrphanVotes(connman);
     }
     if(fMasternodesRemovedLocal || forceRemovedChecks) {
         governance.UpdateCachesAndClean();
@@ -6,14 +6,28 @@
 #ifndef MASTERNODEMAN_H
 #define MASTERNODEMAN_H
 
+#include "expiringmap.h"
 #include "masternode.h"
+#include "saltedhasher.h"
 #include "sync.h"
 
+#include "immer/map.hpp"
+
 class CMasternodeMan;
 class CConnman;
+class CDeterministicMNList;
 
 extern CMasternodeMan mnodeman;
 
+template<>
+struct SaltedHasherImpl<COutPoint>
+{
+    static std::size_t CalcHash(const COutPoint& v, uint64_t k0, uint64_t k1)
+    {
+        return SipHashUint256Extra(k0, k1, v.hash, v.n);
+    }
+};
+
 class CMasternodeMan
 {
 public:
@@ -21,6 +35,8 @@ public:
     typedef std::vector<score_pair_t> score_pair_vec_t;
     typedef std::pair<int, const CMasternode> rank_pair_t;
     typedef std::vector<rank_pair_t> rank_pair_vec_t;
+    // immer creates a new hasher for every lookup, so the salt has to be a static one
+    typedef immer::map<COutPoint, CMasternode, StaticSaltedHasher> snapshot_t;
 
 private:
     static const std::string SERIALIZATION_VERSION_STRING;
@@ -49,6 +65,8 @@ private:
 
     // map to hold all MNs
     std::map<COutPoint, CMasternode> mapMasternodes;
+    // immutable copy of mapMasternodes handed out to readers, every change is applied to it right away
+    snapshot_t mapMasternodesSnapshot;
     // who's asked for the Masternode list and the last time
     std::map<CService, int64_t> mAskedUsForMasternodeList;
     // who we asked for the Masternode list and the last time
@@ -92,13 +110,22 @@ private:
     void PunishNode(const CService& addr, int howmuch, CConnman& connman);
     bool MnCheckConnect(CMasternode* pmn);
 
+    /// Decides which masternodes are published once DIP3 is active, null before. Loops take it once
+    /// and pass it to UpdateSnapshot instead of copying the list for every masternode.
+    std::unique_ptr<CDeterministicMNList> GetSnapshotFilter() const;
+    /// Must be called after the masternode was added, changed or removed
+    void UpdateSnapshot(const COutPoint& outpoint);
+    void UpdateSnapshot(const COutPoint& outpoint, const CDeterministicMNList* pmnList);
+    /// Same as above for all of them, only needed after mapMasternodes was replaced as a whole
+    void RebuildSnapshot();
+
 public:
     // Keep track of all broadcasts I've seen
     std::map<uint256, std::pair<int64_t, CMasternodeBroadcast> > mapSeenMasternodeBroadcast;
-    // Keep track of all pings I've seen
-    std::map<uint256, CMasternodePing> mapSeenMasternodePing;
-    // Keep track of all verifications I've seen
-    std::map<uint256, CMasternodeVerification> mapSeenMasternodeVerification;
+    // Keep track of all pings I've seen, expire with the ping itself
+    CExpiringMap<uint256, CMasternodePing, StaticSaltedHasher> mapSeenMasternodePing;
+    // Keep track of all verifications I've seen, deadlines are block heights
+    CExpiringMap<uint256, CMasternodeVerification, StaticSaltedHasher> mapSeenMasternodeVerification;
     // keep track of dsq count to prevent masternodes from gaming privatesend queue
     int64_t nDsqCount;
 
@@ -131,6 +158,9 @@ public:
         if(ser_action.ForRead() && (strVersion != SERIALIZATION_VERSION_STRING)) {
             Clear();
         }
+        if(ser_action.ForRead()) {
+            RebuildSnapshot();
+        }
     }
 
     CMasternodeMan();
@@ -195,7 +225,9 @@ public:
     /// Find a random entry
     masternode_info_t FindRandomNotInVec(const std::vector<COutPoint> &vecToExclude, int nProtocolVersion = -1);
 
-    std::map<COutPoint, CMasternode> GetFullMasternodeMap();
+    /// Immutable snapshot of all masternodes (only the valid ones once DIP3 is active), taking it is O(1)
+    /// and it can be iterated without holding cs, changes made after it was taken are not reflected
+    snapshot_t GetMasternodeMapSnapshot();
 
     bool GetMasternodeRanks(rank_pair_vec_t& vecMasternodeRanksRet, int nBlockHeight = -1, int nMinProtocol = 0);
     bool GetMasternodeRank(const COutPoint &outpoint, int& nRankRet, int nBlockHeight = -1, int nMinProtocol = 0);
@@ -222,6 +254,9 @@ public:
 
     std::string ToString() const;
 
+    CExpiringMapStats GetSeenPingsStats() const;
+    CExpiringMapStats GetSeenVerificationsStats() const;
+
     /// Perform complete check and only then update masternode list and maps using provided CMasternodeBroadcast
     bool CheckMnbAndUpdateMasternodeList(CNode* pfrom, CMasternodeBroadcast mnb, int& nDos, CConnman& connman);
     bool IsMnbRecoveryRequested(const uint256& hash) { return mMnbRecoveryRequests.count(hash); }
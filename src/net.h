@@ -746,6 +746,8 @@ public:
     bool fSentAddr;
     // If 'true' this node will be disconnected on CMasternodeMan::ProcessMasternodeConnections()
     bool fMasternode;
+    // If 'true' this node told us it understands governance vote set reconciliation (sendgovrecon)
+    std::atomic_bool fGovernanceRecon;
     CSemaphoreGrant grantOutbound;
     CSemaphoreGrant grantMasternodeOutbound;
     CCriticalSection cs_filter;
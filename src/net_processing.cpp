@@ -24,6 +24,7 @@
 #include "primitives/transaction.h"
 #include "random.h"
 #include "tinyformat.h"
+#include "tracing.h"
 #include "txmempool.h"
 #include "ui_interface.h"
 #include "util.h"
@@ -953,7 +954,7 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
         return mnodeman.mapSeenMasternodeBroadcast.count(inv.hash) && !mnodeman.IsMnbRecoveryRequested(inv.hash);
 
     case MSG_MASTERNODE_PING:
-        return mnodeman.mapSeenMasternodePing.count(inv.hash);
+        return mnodeman.mapSeenMasternodePing.Has(inv.hash);
 
     case MSG_DSTX: {
         return static_cast<bool>(CPrivateSend::GetDSTX(inv.hash));
@@ -964,7 +965,7 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
         return ! governance.ConfirmInventoryRequest(inv);
 
     case MSG_MASTERNODE_VERIFY:
-        return mnodeman.mapSeenMasternodeVerification.count(inv.hash);
+        return mnodeman.mapSeenMasternodeVerification.Has(inv.hash);
 
     case MSG_QUORUM_FINAL_COMMITMENT:
         return llmq::quorumBlockProcessor->HasMinableCommitment(inv.hash);
@@ -1084,49 +1085,58 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                 // Pruned nodes may have deleted the block, so check whether
                 // it's available before trying to send.
                 if (send && (mi->second->nStatus & BLOCK_HAVE_DATA)) {
-                    // Send block from disk
-                    CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second, consensusParams))
-                        assert(!"cannot load block from disk");
-                    if (inv.type == MSG_BLOCK)
-                        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, block));
-                    else if (inv.type == MSG_FILTERED_BLOCK)
-                    {
-                        bool sendMerkleBlock = false;
-                        CMerkleBlock merkleBlock;
+                    // If a peer is asking for old blocks, we're almost guaranteed
+                    // they won't have a useful mempool to match against a compact block,
+                    // and we don't feel like constructing the object for them, so
+                    // instead we respond with the full, non-compact block.
+                    bool fSendCmpct = inv.type == MSG_CMPCT_BLOCK && CanDirectFetch(consensusParams) && mi->second->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH;
+                    // Full blocks are serialized from the block cache or sent as they are stored on disk, without parsing them
+                    CSerializedNetMsg msgRawBlock;
+                    if ((inv.type == MSG_BLOCK || (inv.type == MSG_CMPCT_BLOCK && !fSendCmpct)) &&
+                        ReadRawBlockFromDisk(msgRawBlock.data, mi->second, Params().MessageStart())) {
+                        msgRawBlock.command = NetMsgType::BLOCK;
+                        connman.PushMessage(pfrom, std::move(msgRawBlock));
+                    } else {
+                        // Send block from disk
+                        CBlock block;
+                        if (!ReadBlockFromDisk(block, (*mi).second, consensusParams))
+                            assert(!"cannot load block from disk");
+                        if (inv.type == MSG_BLOCK)
+                            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, block));
+                        else if (inv.type == MSG_FILTERED_BLOCK)
                         {
-                            LOCK(pfrom->cs_filter);
-                            if (pfrom->pfilter) {
-                                sendMerkleBlock = true;
-                                merkleBlock = CMerkleBlock(block, *pfrom->pfilter);
+                            bool sendMerkleBlock = false;
+                            CMerkleBlock merkleBlock;
+                            {
+                                LOCK(pfrom->cs_filter);
+                                if (pfrom->pfilter) {
+                                    sendMerkleBlock = true;
+                                    merkleBlock = CMerkleBlock(block, *pfrom->pfilter);
+                                }
+                            }
+                            if (sendMerkleBlock) {
+                                connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MERKLEBLOCK, merkleBlock));
+                                // CMerkleBlock just contains hashes, so also push any transactions in the block the client did not see
+                                // This avoids hurting performance by pointlessly requiring a round-trip
+                                // Note that there is currently no way for a node to request any single transactions we didn't send here -
+                                // they must either disconnect and retry or request the full block.
+                                // Thus, the protocol spec specified allows for us to provide duplicate txn here,
+                                // however we MUST always provide at least what the remote peer needs
+                                typedef std::pair<unsigned int, uint256> PairType;
+                                BOOST_FOREACH(PairType& pair, merkleBlock.vMatchedTxn)
+                                    connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::TX, *block.vtx[pair.first]));
                             }
+                            // else
+                                // no response
                         }
-                        if (sendMerkleBlock) {
-                            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MERKLEBLOCK, merkleBlock));
-                            // CMerkleBlock just contains hashes, so also push any transactions in the block the client did not see
-                            // This avoids hurting performance by pointlessly requiring a round-trip
-                            // Note that there is currently no way for a node to request any single transactions we didn't send here -
-                            // they must either disconnect and retry or request the full block.
-                            // Thus, the protocol spec specified allows for us to provide duplicate txn here,
-                            // however we MUST always provide at least what the remote peer needs
-                            typedef std::pair<unsigned int, uint256> PairType;
-                            BOOST_FOREACH(PairType& pair, merkleBlock.vMatchedTxn)
-                                connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::TX, *block.vtx[pair.first]));
+                        else if (inv.type == MSG_CMPCT_BLOCK)
+                        {
+                             if (fSendCmpct) {
+                                CBlockHeaderAndShortTxIDs cmpctblock(block);
+                                connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::CMPCTBLOCK, cmpctblock));
+                            } else
+                                connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, block));
                         }
-                        // else
-                            // no response
-                    }
-                    else if (inv.type == MSG_CMPCT_BLOCK)
-                    {
-                        // If a peer is asking for old blocks, we're almost guaranteed
-                        // they won't have a useful mempool to match against a compact block,
-                        // and we don't feel like constructing the object for them, so
-                        // instead we respond with the full, non-compact block.
-                         if (CanDirectFetch(consensusParams) && mi->second->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH) {
-                            CBlockHeaderAndShortTxIDs cmpctblock(block);
-                            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::CMPCTBLOCK, cmpctblock));
-                        } else
-                            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, block));
                     }
 
                     // Trigger the peer node to send a getblocks request for the next batch of inventory
@@ -1226,8 +1236,9 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
 
                 if (!push && inv.type == MSG_MASTERNODE_PING) {
                     if (!deterministicMNManager->IsDeterministicMNsSporkActive()) {
-                        if (mnodeman.mapSeenMasternodePing.count(inv.hash)) {
-                            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MNPING, mnodeman.mapSeenMasternodePing[inv.hash]));
+                        const CMasternodePing* pmnp = mnodeman.mapSeenMasternodePing.Find(inv.hash);
+                        if (pmnp) {
+                            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MNPING, *pmnp));
                             push = true;
                         }
                     }
@@ -1279,8 +1290,9 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                 }
 
                 if (!push && inv.type == MSG_MASTERNODE_VERIFY) {
-                    if(mnodeman.mapSeenMasternodeVerification.count(inv.hash)) {
-                        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MNVERIFY, mnodeman.mapSeenMasternodeVerification[inv.hash]));
+                    const CMasternodeVerification* pmnv = mnodeman.mapSeenMasternodeVerification.Find(inv.hash);
+                    if(pmnv) {
+                        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MNVERIFY, *pmnv));
                         push = true;
                     }
                 }
@@ -1359,6 +1371,7 @@ inline void static SendBlockTransactions(const CBlock& block, const BlockTransac
 
 bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, int64_t nTimeReceived, const CChainParams& chainparams, CConnman& connman, const std::atomic<bool>& interruptMsgProc)
 {
+    TRACE_SPAN_ARG("ProcessMessage", strCommand);
     LogPrint("net", "received: %s (%u bytes) peer=%d\n", SanitizeString(strCommand), vRecv.size(), pfrom->id);
 
     if (IsArgSet("-dropmessagestest") && GetRand(GetArg("-dropmessagestest", 0)) == 0)
@@ -1645,6 +1658,12 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::SENDCMPCT, fAnnounceUsingCMPCTBLOCK, nCMPCTBLOCKVersion));
         }
 
+        if (!fLiteMode && pfrom->nVersion >= MIN_GOVERNANCE_PEER_PROTO_VERSION) {
+            // Tell our peer we can reconcile governance votes with sketches instead of bloom filters.
+            // Peers which don't know this message just ignore it and keep using bloom filters.
+            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MNGOVERNANCESENDRECON));
+        }
+
         pfrom->fSuccessfullyConnected = true;
     }
 
@@ -1708,6 +1727,11 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         State(pfrom->GetId())->fPreferHeaders = true;
     }
 
+    else if (strCommand == NetMsgType::MNGOVERNANCESENDRECON)
+    {
+        pfrom->fGovernanceRecon = true;
+    }
+
 
     else if (strCommand == NetMsgType::SENDCMPCT)
     {
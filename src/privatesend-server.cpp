@@ -16,6 +16,9 @@
 #include "txmempool.h"
 #include "util.h"
 #include "utilmoneystr.h"
+#include "validation.h"
+
+#include <algorithm>
 
 CPrivateSendServer privateSendServer;
 
@@ -203,6 +206,8 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, const std::string& strComm
                 }
             }
 
+            // look all inputs up under one lock
+            LOCK(cs_main);
             for (const auto& txin : entry.vecTxDSIn) {
                 tx.vin.push_back(txin);
 
@@ -253,6 +258,12 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, const std::string& strComm
         int nTxInIndex = 0;
         int nTxInsCount = (int)vecTxIn.size();
 
+        if (!AreInputScriptSigsValid(vecTxIn)) {
+            LogPrint("privatesend", "DSSIGNFINALTX -- AreInputScriptSigsValid() failed, session: %d\n", nSessionID);
+            RelayStatus(STATUS_REJECTED, connman);
+            return;
+        }
+
         for (const auto& txin : vecTxIn) {
             nTxInIndex++;
             if (!AddScriptSig(txin)) {
@@ -271,6 +282,9 @@ void CPrivateSendServer::SetNull()
 {
     // MN side
     vecSessionCollaterals.clear();
+    txSessionVerify = CMutableTransaction();
+    mapSessionInputs.clear();
+    fSessionVerifyCached = false;
 
     CPrivateSendBaseSession::SetNull();
     CPrivateSendBaseManager::SetNull();
@@ -521,45 +535,84 @@ void CPrivateSendServer::CheckForCompleteQueue(CConnman& connman)
     }
 }
 
-// Check to make sure a given input matches an input in the pool and its scriptSig is valid
-bool CPrivateSendServer::IsInputScriptSigValid(const CTxIn& txin)
+void CPrivateSendServer::UpdateSessionVerifyCache()
 {
-    CMutableTransaction txNew;
-    txNew.vin.clear();
-    txNew.vout.clear();
+    if (fSessionVerifyCached) return;
 
-    int i = 0;
-    int nTxInIndex = -1;
-    CScript sigPubKey = CScript();
+    txSessionVerify = CMutableTransaction();
+    mapSessionInputs.clear();
 
     for (const auto& entry : vecEntries) {
         for (const auto& txout : entry.vecTxOut)
-            txNew.vout.push_back(txout);
+            txSessionVerify.vout.push_back(txout);
 
         for (const auto& txdsin : entry.vecTxDSIn) {
-            txNew.vin.push_back(txdsin);
-
-            if (txdsin.prevout == txin.prevout) {
-                nTxInIndex = i;
-                sigPubKey = txdsin.prevPubKey;
-            }
-            i++;
+            mapSessionInputs[txdsin.prevout] = std::make_pair((unsigned int)txSessionVerify.vin.size(), txdsin.prevPubKey);
+            txSessionVerify.vin.push_back(txdsin);
         }
     }
 
-    if (nTxInIndex >= 0) { //might have to do this one input at a time?
-        txNew.vin[nTxInIndex].scriptSig = txin.scriptSig;
-        LogPrint("privatesend", "CPrivateSendServer::IsInputScriptSigValid -- verifying scriptSig %s\n", ScriptToAsmStr(txin.scriptSig).substr(0, 24));
-        if (!VerifyScript(txNew.vin[nTxInIndex].scriptSig, sigPubKey, SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC, MutableTransactionSignatureChecker(&txNew, nTxInIndex))) {
-            LogPrint("privatesend", "CPrivateSendServer::IsInputScriptSigValid -- VerifyScript() failed on input %d\n", nTxInIndex);
+    fSessionVerifyCached = true;
+}
+
+// Check to make sure given inputs match inputs in the pool and their scriptSigs are valid
+bool CPrivateSendServer::AreInputScriptSigsValid(const std::vector<CTxIn>& vecTxIn)
+{
+    UpdateSessionVerifyCache();
+
+    CMutableTransaction txNew = txSessionVerify;
+    std::vector<std::pair<unsigned int, CScript> > vecToVerify;
+    vecToVerify.reserve(vecTxIn.size());
+
+    for (const auto& txin : vecTxIn) {
+        auto it = mapSessionInputs.find(txin.prevout);
+        if (it == mapSessionInputs.end()) {
+            LogPrint("privatesend", "CPrivateSendServer::AreInputScriptSigsValid -- Failed to find matching input in pool, %s\n", txin.ToString());
             return false;
         }
-    } else {
-        LogPrint("privatesend", "CPrivateSendServer::IsInputScriptSigValid -- Failed to find matching input in pool, %s\n", txin.ToString());
+        // signatures never commit to scriptSigs of other inputs, so all of them can be set at once
+        txNew.vin[it->second.first].scriptSig = txin.scriptSig;
+        vecToVerify.push_back(it->second);
+        LogPrint("privatesend", "CPrivateSendServer::AreInputScriptSigsValid -- verifying scriptSig %s\n", ScriptToAsmStr(txin.scriptSig).substr(0, 24));
+    }
+
+    // every check refers to this one instance, no per input copies
+    const CTransaction txVerify(txNew);
+    const PrecomputedTransactionData txdata(txVerify);
+    std::vector<CScriptCheck> vChecks;
+    vChecks.reserve(vecToVerify.size());
+    for (const auto& pair : vecToVerify) {
+        vChecks.emplace_back(pair.second, 0, txVerify, pair.first, SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC, false, &txdata);
+    }
+
+    if (!RunScriptChecks(vChecks)) {
+        LogPrint("privatesend", "CPrivateSendServer::AreInputScriptSigsValid -- VerifyScript() failed\n");
         return false;
     }
 
-    LogPrint("privatesend", "CPrivateSendServer::IsInputScriptSigValid -- Successfully validated input and scriptSig\n");
+    LogPrint("privatesend", "CPrivateSendServer::AreInputScriptSigsValid -- Successfully validated %d inputs and scriptSigs\n", vecTxIn.size());
+    return true;
+}
+
+// Collaterals of users accepted via dsa passed CPrivateSend::IsCollateralValid in IsAcceptableDSA already.
+// Scripts and amounts of the very same transaction can't change, only its inputs can get spent meanwhile,
+// so don't run another AcceptToMemoryPool test pass for them.
+bool CPrivateSendServer::IsEntryCollateralValid(const CTransaction& txCollateral)
+{
+    const uint256 hash = txCollateral.GetHash();
+    bool fKnown = !fUnitTest && std::any_of(vecSessionCollaterals.begin(), vecSessionCollaterals.end(), [&hash](const CTransactionRef& tx) {
+        return tx->GetHash() == hash;
+    });
+    if (!fKnown) return CPrivateSend::IsCollateralValid(txCollateral);
+
+    LOCK(cs_main);
+    for (const auto& txin : txCollateral.vin) {
+        Coin coin;
+        if (!GetUTXOCoin(txin.prevout, coin) || mempool.isSpent(txin.prevout)) {
+            LogPrint("privatesend", "CPrivateSendServer::IsEntryCollateralValid -- collateral input spent, txCollateral=%s", txCollateral.ToString());
+            return false;
+        }
+    }
     return true;
 }
 
@@ -578,12 +631,6 @@ bool CPrivateSendServer::AddEntry(const CPrivateSendEntry& entryNew, PoolMessage
         }
     }
 
-    if (!CPrivateSend::IsCollateralValid(*entryNew.txCollateral)) {
-        LogPrint("privatesend", "CPrivateSendServer::AddEntry -- collateral not valid!\n");
-        nMessageIDRet = ERR_INVALID_COLLATERAL;
-        return false;
-    }
-
     if (GetEntriesCount() >= CPrivateSend::GetMaxPoolTransactions()) {
         LogPrint("privatesend", "CPrivateSendServer::AddEntry -- entries is full!\n");
         nMessageIDRet = ERR_ENTRIES_FULL;
@@ -603,7 +650,15 @@ bool CPrivateSendServer::AddEntry(const CPrivateSendEntry& entryNew, PoolMessage
         }
     }
 
+    // the expensive part goes last
+    if (!IsEntryCollateralValid(*entryNew.txCollateral)) {
+        LogPrint("privatesend", "CPrivateSendServer::AddEntry -- collateral not valid!\n");
+        nMessageIDRet = ERR_INVALID_COLLATERAL;
+        return false;
+    }
+
     vecEntries.push_back(entryNew);
+    fSessionVerifyCached = false;
 
     LogPrint("privatesend", "CPrivateSendServer::AddEntry -- adding entry\n");
     nMessageIDRet = MSG_ENTRIES_ADDED;
@@ -625,11 +680,6 @@ bool CPrivateSendServer::AddScriptSig(const CTxIn& txinNew)
         }
     }
 
-    if (!IsInputScriptSigValid(txinNew)) {
-        LogPrint("privatesend", "CPrivateSendServer::AddScriptSig -- Invalid scriptSig\n");
-        return false;
-    }
-
     LogPrint("privatesend", "CPrivateSendServer::AddScriptSig -- scriptSig=%s new\n", ScriptToAsmStr(txinNew.scriptSig).substr(0, 24));
 
     for (auto& txin : finalMutableTransaction.vin) {
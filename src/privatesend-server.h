@@ -22,11 +22,18 @@ private:
     // to behave honestly. If they don't it takes their money.
     std::vector<CTransactionRef> vecSessionCollaterals;
 
+    // Unsigned session transaction scriptSigs are verified against and the position and
+    // prevPubKey of every session input in it. Built once per set of entries instead of
+    // once per verified input, reset whenever entries change.
+    CMutableTransaction txSessionVerify;
+    std::map<COutPoint, std::pair<unsigned int, CScript> > mapSessionInputs;
+    bool fSessionVerifyCached;
+
     bool fUnitTest;
 
     /// Add a clients entry to the pool
     bool AddEntry(const CPrivateSendEntry& entryNew, PoolMessage& nMessageIDRet);
-    /// Add signature to a txin
+    /// Add signature to a txin, scriptSig must be verified via AreInputScriptSigsValid first
     bool AddScriptSig(const CTxIn& txin);
 
     /// Charge fees to bad actors (Charge clients a fee if they're abusive)
@@ -42,6 +49,8 @@ private:
 
     /// Is this nDenom and txCollateral acceptable?
     bool IsAcceptableDSA(const CPrivateSendAccept& dsa, PoolMessage& nMessageIDRet);
+    /// Is this entry collateral still valid? Skips the full check for collaterals accepted in this session already
+    bool IsEntryCollateralValid(const CTransaction& txCollateral);
     bool CreateNewSession(const CPrivateSendAccept& dsa, PoolMessage& nMessageIDRet, CConnman& connman);
     bool AddUserToExistingSession(const CPrivateSendAccept& dsa, PoolMessage& nMessageIDRet);
     /// Do we have enough users to take entries?
@@ -49,8 +58,10 @@ private:
 
     /// Check that all inputs are signed. (Are all inputs signed?)
     bool IsSignaturesComplete();
-    /// Check to make sure a given input matches an input in the pool and its scriptSig is valid
-    bool IsInputScriptSigValid(const CTxIn& txin);
+    /// Check to make sure given inputs match inputs in the pool and their scriptSigs are valid,
+    /// all scripts are verified in parallel on the script check threads
+    bool AreInputScriptSigsValid(const std::vector<CTxIn>& vecTxIn);
+    void UpdateSessionVerifyCache();
     /// Are these outputs compatible with other client in the pool?
     bool IsOutputsCompatibleWithSessionDenom(const std::vector<CTxOut>& vecTxOut);
 
@@ -67,7 +78,7 @@ private:
 
 public:
     CPrivateSendServer() :
-        vecSessionCollaterals(), fUnitTest(false) {}
+        vecSessionCollaterals(), txSessionVerify(), mapSessionInputs(), fSessionVerifyCached(false), fUnitTest(false) {}
 
     void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman);
 
@@ -68,6 +68,8 @@ const char *SYNCSTATUSCOUNT="ssc";
 const char *MNGOVERNANCESYNC="govsync";
 const char *MNGOVERNANCEOBJECT="govobj";
 const char *MNGOVERNANCEOBJECTVOTE="govobjvote";
+const char *MNGOVERNANCESENDRECON="sendgovrecon";
+const char *MNGOVERNANCERECON="govrecon";
 const char *MNVERIFY="mnv";
 const char *GETMNLISTDIFF="getmnlistd";
 const char *MNLISTDIFF="mnlistdiff";
@@ -160,6 +162,8 @@ const static std::string allNetMessageTypes[] = {
     NetMsgType::MNGOVERNANCESYNC,
     NetMsgType::MNGOVERNANCEOBJECT,
     NetMsgType::MNGOVERNANCEOBJECTVOTE,
+    NetMsgType::MNGOVERNANCESENDRECON,
+    NetMsgType::MNGOVERNANCERECON,
     NetMsgType::MNVERIFY,
     NetMsgType::GETMNLISTDIFF,
     NetMsgType::MNLISTDIFF,
@@ -267,6 +267,8 @@ extern const char *SYNCSTATUSCOUNT;
 extern const char *MNGOVERNANCESYNC;
 extern const char *MNGOVERNANCEOBJECT;
 extern const char *MNGOVERNANCEOBJECTVOTE;
+extern const char *MNGOVERNANCESENDRECON;
+extern const char *MNGOVERNANCERECON;
 extern const char *MNVERIFY;
 extern const char *GETMNLISTDIFF;
 extern const char *MNLISTDIFF;
@@ -365,10 +365,10 @@ void MasternodeList::updateNodeList()
 
     int offsetFromUtc = GetOffsetFromUtc();
 
-    std::map<COutPoint, CMasternode> mapMasternodes = mnodeman.GetFullMasternodeMap();
+    CMasternodeMan::snapshot_t mapMasternodes = mnodeman.GetMasternodeMapSnapshot();
 
     for (const auto& mnpair : mapMasternodes) {
-        CMasternode mn = mnpair.second;
+        const CMasternode& mn = mnpair.second;
         // populate list
         // Address, Protocol, Status, Active Seconds, Last Seen, Pub Key
         QTableWidgetItem* addressItem = new QTableWidgetItem(QString::fromStdString(mn.addr.ToString()));
@@ -6,15 +6,19 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "amount.h"
+#include "blockcache.h"
 #include "chain.h"
 #include "chainparams.h"
+#include "chainstaterebuild.h"
 #include "checkpoints.h"
+#include "checkqueue.h"
 #include "coins.h"
 #include "consensus/validation.h"
 #include "instantx.h"
 #include "validation.h"
 #include "policy/policy.h"
 #include "primitives/transaction.h"
+#include "rpc/jsonstream.h"
 #include "rpc/server.h"
 #include "streams.h"
 #include "sync.h"
@@ -427,6 +431,34 @@ UniValue mempoolToJSON(bool fVerbose = false)
     }
 }
 
+/** Same output as mempoolToJSON, written entry by entry */
+void mempoolToJSON(CJSONStreamWriter& writer, bool fVerbose)
+{
+    if (fVerbose)
+    {
+        LOCK(mempool.cs);
+        writer.BeginObject();
+        BOOST_FOREACH(const CTxMemPoolEntry& e, mempool.mapTx)
+        {
+            const uint256& hash = e.GetTx().GetHash();
+            UniValue info(UniValue::VOBJ);
+            entryToJSON(info, e);
+            writer.Pair(hash.ToString(), info);
+        }
+        writer.EndObject();
+    }
+    else
+    {
+        std::vector<uint256> vtxid;
+        mempool.queryHashes(vtxid);
+
+        writer.BeginArray();
+        BOOST_FOREACH(const uint256& hash, vtxid)
+            writer.Value(hash.ToString());
+        writer.EndArray();
+    }
+}
+
 UniValue getrawmempool(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() > 1)
@@ -456,6 +488,11 @@ UniValue getrawmempool(const JSONRPCRequest& request)
     if (request.params.size() > 0)
         fVerbose = request.params[0].get_bool();
 
+    if (request.pStreamWriter) {
+        mempoolToJSON(*request.pStreamWriter, fVerbose);
+        return NullUniValue;
+    }
+
     return mempoolToJSON(fVerbose);
 }
 
@@ -897,17 +934,18 @@ UniValue getblock(const JSONRPCRequest& request)
     if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
 
-    if(!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
-
     if (verbosity <= 0)
     {
-        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-        ssBlock << block;
-        std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
-        return strHex;
+        // the serialized block is what is stored on disk, no need to parse it
+        std::vector<unsigned char> vchBlock;
+        if (!ReadRawBlockFromDisk(vchBlock, pblockindex, Params().MessageStart()))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+        return HexStr(vchBlock.begin(), vchBlock.end());
     }
 
+    if(!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+
     return blockToJSON(block, pblockindex, verbosity >= 2);
 }
 
@@ -1263,6 +1301,14 @@ UniValue getblockchaininfo(const JSONRPCRequest& request)
             "  \"chainwork\": \"xxxx\"     (string) total amount of work in active chain, in hexadecimal\n"
             "  \"pruned\": xx,             (boolean) if the blocks are subject to pruning\n"
             "  \"pruneheight\": xxxxxx,    (numeric) lowest-height complete block stored\n"
+            "  \"chainstaterebuild\": {     (object) progress of -reindex-chainstate, only while it is running\n"
+            "     \"startheight\": xxxxxx,  (numeric) the height the rebuild started or continued from\n"
+            "     \"height\": xxxxxx,       (numeric) the height of the rebuilt chain state\n"
+            "     \"targetheight\": xxxxxx, (numeric) the height the rebuild ends at\n"
+            "     \"progress\": xxxx,       (numeric) share of the transactions up to the target which are connected [0..1]\n"
+            "     \"blockspersecond\": xx,  (numeric) blocks connected per second since the start\n"
+            "     \"eta\": xxxx             (numeric) estimated seconds until the rebuild is finished, -1 if unknown\n"
+            "  },\n"
             "  \"softforks\": [            (array) status of softforks in progress\n"
             "     {\n"
             "        \"id\": \"xxxx\",        (string) name of softfork\n"
@@ -1327,6 +1373,18 @@ UniValue getblockchaininfo(const JSONRPCRequest& request)
 
         obj.push_back(Pair("pruneheight",        block->nHeight));
     }
+
+    CChainStateRebuildProgress progress;
+    if (chainStateRebuild.GetProgress(progress)) {
+        UniValue rebuild(UniValue::VOBJ);
+        rebuild.push_back(Pair("startheight",      progress.nStartHeight));
+        rebuild.push_back(Pair("height",           progress.nHeight));
+        rebuild.push_back(Pair("targetheight",     progress.nTargetHeight));
+        rebuild.push_back(Pair("progress",         progress.dProgress));
+        rebuild.push_back(Pair("blockspersecond",  progress.dBlocksPerSecond));
+        rebuild.push_back(Pair("eta",              progress.nETA));
+        obj.push_back(Pair("chainstaterebuild",    rebuild));
+    }
     return obj;
 }
 
@@ -1508,6 +1566,101 @@ UniValue getmempoolinfo(const JSONRPCRequest& request)
     return mempoolInfoToJSON();
 }
 
+UniValue getscriptcheckstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getscriptcheckstats\n"
+            "\nReturns counters of the script verification threads (see -par) since startup.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"queued\": xxxxx,              (numeric) Script checks waiting for a thread right now\n"
+            "  \"maxqueued\": xxxxx,           (numeric) Most script checks which were waiting at the same time\n"
+            "  \"checks\": xxxxx,              (numeric) Script checks done by all threads\n"
+            "  \"steals\": xxxxx,              (numeric) Batches threads took from the queues of other threads\n"
+            "  \"idletime\": xxxxx,            (numeric) Seconds all threads spent waiting for work\n"
+            "  \"threads\": [                  (array) One entry per thread, the first one is the validation thread\n"
+            "    {\n"
+            "      \"checks\": xxxxx,          (numeric) Script checks done by this thread\n"
+            "      \"batches\": xxxxx,         (numeric) Batches taken from its own queue\n"
+            "      \"steals\": xxxxx,          (numeric) Batches taken from the queues of other threads\n"
+            "      \"idletime\": xxxxx         (numeric) Seconds spent waiting for work, for the validation thread\n"
+            "                                  the time it waited for the other threads to finish a block\n"
+            "    }, ...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getscriptcheckstats", "")
+            + HelpExampleRpc("getscriptcheckstats", "")
+        );
+
+    CCheckQueueStats stats = GetScriptCheckQueueStats();
+
+    uint64_t nChecks = 0;
+    uint64_t nSteals = 0;
+    int64_t nIdleMicros = 0;
+    UniValue threads(UniValue::VARR);
+    for (const auto& worker : stats.workers) {
+        UniValue thread(UniValue::VOBJ);
+        thread.push_back(Pair("checks", worker.nChecks));
+        thread.push_back(Pair("batches", worker.nBatches));
+        thread.push_back(Pair("steals", worker.nSteals));
+        thread.push_back(Pair("idletime", worker.nIdleMicros * 0.000001));
+        threads.push_back(thread);
+        nChecks += worker.nChecks;
+        nSteals += worker.nSteals;
+        nIdleMicros += worker.nIdleMicros;
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("queued", stats.nQueued));
+    ret.push_back(Pair("maxqueued", stats.nMaxQueued));
+    ret.push_back(Pair("checks", nChecks));
+    ret.push_back(Pair("steals", nSteals));
+    ret.push_back(Pair("idletime", nIdleMicros * 0.000001));
+    ret.push_back(Pair("threads", threads));
+    return ret;
+}
+
+UniValue getblockcacheinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getblockcacheinfo\n"
+            "\nReturns counters of the cache of recently read and received blocks (see -blockcache and -blockmmap) since startup.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"blocks\": xxxxx,              (numeric) Blocks in the cache\n"
+            "  \"usage\": xxxxx,               (numeric) Memory used by the blocks in the cache in bytes\n"
+            "  \"maxusage\": xxxxx,            (numeric) Maximum memory used by the cache in bytes, 0 if it is disabled\n"
+            "  \"hits\": xxxxx,                (numeric) Block reads which were answered from the cache\n"
+            "  \"misses\": xxxxx,              (numeric) Block reads which had to go to disk\n"
+            "  \"hitrate\": x.xxx,             (numeric) hits / (hits + misses)\n"
+            "  \"mappedfiles\": xxxxx,         (numeric) Block files which are memory mapped right now\n"
+            "  \"mappedreads\": xxxxx,         (numeric) Blocks read from memory mapped block files\n"
+            "  \"filereads\": xxxxx            (numeric) Blocks read by opening the block file\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getblockcacheinfo", "")
+            + HelpExampleRpc("getblockcacheinfo", "")
+        );
+
+    CBlockCacheStats stats = blockCache.GetStats();
+    uint64_t nLookups = stats.nHits + stats.nMisses;
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("blocks", (uint64_t)stats.nBlocks));
+    ret.push_back(Pair("usage", (uint64_t)stats.nUsage));
+    ret.push_back(Pair("maxusage", (uint64_t)stats.nMaxUsage));
+    ret.push_back(Pair("hits", stats.nHits));
+    ret.push_back(Pair("misses", stats.nMisses));
+    ret.push_back(Pair("hitrate", nLookups ? (double)stats.nHits / nLookups : 0.0));
+    ret.push_back(Pair("mappedfiles", (uint64_t)stats.nMappedFiles));
+    ret.push_back(Pair("mappedreads", stats.nMappedReads));
+    ret.push_back(Pair("filereads", stats.nFileReads));
+    return ret;
+}
+
 UniValue preciousblock(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 1)
@@ -1639,6 +1792,8 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getmempoolentry",        &getmempoolentry,        true,  {"txid"} },
     { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true,  {} },
     { "blockchain",         "getrawmempool",          &getrawmempool,          true,  {"verbose"} },
+    { "blockchain",         "getscriptcheckstats",    &getscriptcheckstats,    true,  {} },
+    { "blockchain",         "getblockcacheinfo",      &getblockcacheinfo,      true,  {} },
     { "blockchain",         "gettxout",               &gettxout,               true,  {"txid","n","include_mempool"} },
     { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true,  {} },
     { "blockchain",         "pruneblockchain",        &pruneblockchain,        true,  {"height"} },
@@ -31,6 +31,10 @@ public:
 static const CRPCConvertParam vRPCConvertParams[] =
 {
     { "setmocktime", 0, "timestamp" },
+    { "getlockstats", 0, "verbose" },
+    { "getlockstats", 1, "reset" },
+    { "setlockprofiling", 0, "enabled" },
+    { "dumptrace", 1, "clear" },
     { "generate", 0, "nblocks" },
     { "generate", 1, "maxtries" },
     { "generatetoaddress", 0, "nblocks" },
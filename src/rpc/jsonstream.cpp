@@ -0,0 +1,125 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "rpc/jsonstream.h"
+
+#include <stdexcept>
+
+CJSONStreamWriter::CJSONStreamWriter(const FlushFunction& flushIn, size_t nFlushSizeIn) :
+    flush(flushIn),
+    nFlushSize(nFlushSizeIn),
+    fComplete(false),
+    fFlushed(false)
+{
+}
+
+bool CJSONStreamWriter::ExpectsValue() const
+{
+    if (vScopes.empty())
+        return !fComplete;
+    return vScopes.back().fAfterKey;
+}
+
+void CJSONStreamWriter::BeginValue()
+{
+    if (vScopes.empty()) {
+        if (fComplete)
+            throw std::runtime_error(std::string(__func__) + ": top level value already written");
+        return;
+    }
+
+    Scope& scope = vScopes.back();
+    if (scope.fObject) {
+        if (!scope.fAfterKey)
+            throw std::runtime_error(std::string(__func__) + ": object member without key");
+        scope.fAfterKey = false;
+    } else {
+        if (!scope.fEmpty)
+            strBuffer += ',';
+        scope.fEmpty = false;
+    }
+}
+
+void CJSONStreamWriter::EndValue()
+{
+    if (vScopes.empty())
+        fComplete = true;
+    MaybeFlush();
+}
+
+void CJSONStreamWriter::BeginObject()
+{
+    BeginValue();
+    strBuffer += '{';
+    vScopes.push_back({true, true, false});
+}
+
+void CJSONStreamWriter::EndObject()
+{
+    if (vScopes.empty() || !vScopes.back().fObject || vScopes.back().fAfterKey)
+        throw std::runtime_error(std::string(__func__) + ": no object to close");
+    vScopes.pop_back();
+    strBuffer += '}';
+    EndValue();
+}
+
+void CJSONStreamWriter::BeginArray()
+{
+    BeginValue();
+    strBuffer += '[';
+    vScopes.push_back({false, true, false});
+}
+
+void CJSONStreamWriter::EndArray()
+{
+    if (vScopes.empty() || vScopes.back().fObject)
+        throw std::runtime_error(std::string(__func__) + ": no array to close");
+    vScopes.pop_back();
+    strBuffer += ']';
+    EndValue();
+}
+
+void CJSONStreamWriter::Key(const std::string& key)
+{
+    if (vScopes.empty() || !vScopes.back().fObject || vScopes.back().fAfterKey)
+        throw std::runtime_error(std::string(__func__) + ": key outside of object");
+
+    Scope& scope = vScopes.back();
+    if (!scope.fEmpty)
+        strBuffer += ',';
+    scope.fEmpty = false;
+    scope.fAfterKey = true;
+
+    strBuffer += UniValue(key).write();
+    strBuffer += ':';
+}
+
+void CJSONStreamWriter::Value(const UniValue& value)
+{
+    BeginValue();
+    strBuffer += value.write();
+    EndValue();
+}
+
+void CJSONStreamWriter::MaybeFlush()
+{
+    if (strBuffer.size() >= nFlushSize)
+        Flush();
+}
+
+void CJSONStreamWriter::Flush()
+{
+    if (strBuffer.empty())
+        return;
+    fFlushed = true;
+    flush(strBuffer);
+    strBuffer.clear();
+}
+
+std::string CJSONStreamWriter::TakeBuffer()
+{
+    std::string ret;
+    ret.swap(strBuffer);
+    return ret;
+}
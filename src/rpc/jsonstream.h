@@ -0,0 +1,74 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RPC_JSONSTREAM_H
+#define BITCOIN_RPC_JSONSTREAM_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <univalue.h>
+
+/**
+ * Writes compact JSON (identical to UniValue::write() without indentation)
+ * piece by piece, so that large RPC results don't have to be built as one
+ * UniValue tree and one string first.
+ *
+ * Output is collected in a buffer and handed to the flush function whenever
+ * the buffer grows beyond nFlushSize. Values can still be pushed as (small)
+ * UniValue subtrees.
+ */
+class CJSONStreamWriter
+{
+public:
+    typedef std::function<void(const std::string&)> FlushFunction;
+
+    static const size_t DEFAULT_FLUSH_SIZE = 64 * 1024;
+
+    explicit CJSONStreamWriter(const FlushFunction& flushIn, size_t nFlushSizeIn = DEFAULT_FLUSH_SIZE);
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+
+    /** Start a member of the current object, must be followed by a value */
+    void Key(const std::string& key);
+    /** Write a complete value, either as a member value, array element or top level value */
+    void Value(const UniValue& value);
+    void Pair(const std::string& key, const UniValue& value) { Key(key); Value(value); }
+
+    /** True while the writer waits for a value (top level or after Key()) */
+    bool ExpectsValue() const;
+    /** True once a top level value has been fully written */
+    bool IsComplete() const { return fComplete; }
+    /** True if output has already been handed to the flush function */
+    bool HasFlushed() const { return fFlushed; }
+
+    /** Hand the buffered output to the flush function */
+    void Flush();
+    /** Return and clear the buffered output without flushing it */
+    std::string TakeBuffer();
+
+private:
+    struct Scope {
+        bool fObject;
+        bool fEmpty;
+        bool fAfterKey;
+    };
+
+    FlushFunction flush;
+    size_t nFlushSize;
+    std::string strBuffer;
+    std::vector<Scope> vScopes;
+    bool fComplete;
+    bool fFlushed;
+
+    void BeginValue();
+    void EndValue();
+    void MaybeFlush();
+};
+
+#endif // BITCOIN_RPC_JSONSTREAM_H
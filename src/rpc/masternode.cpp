@@ -885,9 +885,9 @@ UniValue masternodelist(const JSONRPCRequest& request)
             obj.push_back(Pair(strOutpoint, rankpair.first));
         }
     } else {
-        std::map<COutPoint, CMasternode> mapMasternodes = mnodeman.GetFullMasternodeMap();
+        CMasternodeMan::snapshot_t mapMasternodes = mnodeman.GetMasternodeMapSnapshot();
         for (const auto& mnpair : mapMasternodes) {
-            CMasternode mn = mnpair.second;
+            const CMasternode& mn = mnpair.second;
             std::string strOutpoint = mnpair.first.ToStringShort();
 
             CScript payeeScript;
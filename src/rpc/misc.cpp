@@ -10,8 +10,10 @@
 #include "init.h"
 #include "net.h"
 #include "netbase.h"
+#include "rpc/jsonstream.h"
 #include "rpc/server.h"
 #include "timedata.h"
+#include "tracing.h"
 #include "txmempool.h"
 #include "util.h"
 #include "utilstrencodings.h"
@@ -21,13 +23,19 @@
 #include "wallet/walletdb.h"
 #endif
 
+#include "governance.h"
+#include "instantx.h"
 #include "masternode-sync.h"
+#include "masternodeman.h"
 #include "spork.h"
 
+#include "evo/deterministicmns.h"
+
 #include <stdint.h>
 
 #include <boost/assign/list_of.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/filesystem/fstream.hpp>
 
 #include <univalue.h>
 
@@ -871,6 +879,8 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
     }
 
     UniValue result(UniValue::VARR);
+    if (request.pStreamWriter)
+        request.pStreamWriter->BeginArray();
 
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
         std::string address;
@@ -885,9 +895,15 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
         delta.push_back(Pair("blockindex", (int)it->first.txindex));
         delta.push_back(Pair("height", it->first.blockHeight));
         delta.push_back(Pair("address", address));
-        result.push_back(delta);
+        if (request.pStreamWriter)
+            request.pStreamWriter->Value(delta);
+        else
+            result.push_back(delta);
     }
 
+    if (request.pStreamWriter)
+        request.pStreamWriter->EndArray();
+
     return result;
 }
 
@@ -1090,6 +1106,38 @@ static UniValue RPCLockedMemoryInfo()
     return obj;
 }
 
+static UniValue RPCDeterministicMNListsInfo()
+{
+    CDeterministicMNListsCacheStats stats = deterministicMNManager->GetCacheStats();
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("lists", uint64_t(stats.nLists)));
+    obj.push_back(Pair("maxlists", uint64_t(stats.nMaxLists)));
+    obj.push_back(Pair("diffs", uint64_t(stats.nDiffs)));
+    obj.push_back(Pair("maxdiffs", uint64_t(stats.nMaxDiffs)));
+    obj.push_back(Pair("hits", stats.nHits));
+    obj.push_back(Pair("misses", stats.nMisses));
+    obj.push_back(Pair("diffs_applied", stats.nDiffsApplied));
+    return obj;
+}
+
+static UniValue RPCExpiringMapInfo(const CExpiringMapStats& stats)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("entries", uint64_t(stats.nEntries)));
+    obj.push_back(Pair("usage", uint64_t(stats.nUsage)));
+    return obj;
+}
+
+static UniValue RPCSeenMapsInfo()
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("mnpings", RPCExpiringMapInfo(mnodeman.GetSeenPingsStats())));
+    obj.push_back(Pair("mnverifications", RPCExpiringMapInfo(mnodeman.GetSeenVerificationsStats())));
+    obj.push_back(Pair("txlockvotes", RPCExpiringMapInfo(instantsend.GetTxLockVotesStats())));
+    obj.push_back(Pair("erasedgovobjects", RPCExpiringMapInfo(governance.GetErasedObjectsStats())));
+    return obj;
+}
+
 UniValue getmemoryinfo(const JSONRPCRequest& request)
 {
     /* Please, avoid using the word "pool" here in the RPC interface or help,
@@ -1108,6 +1156,24 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
             "    \"locked\": xxxxxx,       (numeric) Amount of bytes that succeeded locking. If this number is smaller than total, locking pages failed at some point and key data could be swapped to disk.\n"
             "    \"chunks_used\": xxxxx,   (numeric) Number allocated chunks\n"
             "    \"chunks_free\": xxxxx,   (numeric) Number unused chunks\n"
+            "  },\n"
+            "  \"mnlists\": {              (json object) Information about the deterministic masternode lists cache\n"
+            "    \"lists\": xxxxx,         (numeric) Number of cached masternode lists\n"
+            "    \"maxlists\": xxxxx,      (numeric) Maximum number of cached masternode lists\n"
+            "    \"diffs\": xxxxx,         (numeric) Number of cached masternode list diffs\n"
+            "    \"maxdiffs\": xxxxx,      (numeric) Maximum number of cached masternode list diffs\n"
+            "    \"hits\": xxxxx,          (numeric) Number of list lookups served from the cache\n"
+            "    \"misses\": xxxxx,        (numeric) Number of list lookups which had to be rebuilt from snapshots and diffs\n"
+            "    \"diffs_applied\": xxxxx, (numeric) Number of diffs applied while rebuilding lists\n"
+            "  },\n"
+            "  \"seenmaps\": {             (json object) Information about the expiring maps of seen network messages\n"
+            "    \"mnpings\": {            (json object) Masternode pings\n"
+            "      \"entries\": xxxxx,     (numeric) Number of entries\n"
+            "      \"usage\": xxxxx,       (numeric) Memory used by the index and the expiration wheel in bytes\n"
+            "    },\n"
+            "    \"mnverifications\": {...}, (json object) Masternode verifications, same fields as above\n"
+            "    \"txlockvotes\": {...},   (json object) InstantSend transaction lock votes, same fields as above\n"
+            "    \"erasedgovobjects\": {...} (json object) Hashes of deleted governance objects, same fields as above\n"
             "  }\n"
             "}\n"
             "\nExamples:\n"
@@ -1116,6 +1182,256 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
         );
     UniValue obj(UniValue::VOBJ);
     obj.push_back(Pair("locked", RPCLockedMemoryInfo()));
+    obj.push_back(Pair("mnlists", RPCDeterministicMNListsInfo()));
+    obj.push_back(Pair("seenmaps", RPCSeenMapsInfo()));
+    return obj;
+}
+
+struct CLockStats
+{
+    uint64_t nAcquired = 0;
+    uint64_t nContended = 0;
+    uint64_t nWaitNanos = 0;
+    uint64_t nMaxWaitNanos = 0;
+    uint64_t nHoldNanos = 0;
+    uint64_t nMaxHoldNanos = 0;
+    uint64_t vWaitBuckets[LOCK_PROFILE_BUCKETS] = {};
+    uint64_t vHoldBuckets[LOCK_PROFILE_BUCKETS] = {};
+
+    void Add(const CLockSite& site)
+    {
+        nAcquired += site.nAcquired.load(std::memory_order_relaxed);
+        nContended += site.nContended.load(std::memory_order_relaxed);
+        nWaitNanos += site.nWaitNanos.load(std::memory_order_relaxed);
+        nMaxWaitNanos = std::max<uint64_t>(nMaxWaitNanos, site.nMaxWaitNanos.load(std::memory_order_relaxed));
+        nHoldNanos += site.nHoldNanos.load(std::memory_order_relaxed);
+        nMaxHoldNanos = std::max<uint64_t>(nMaxHoldNanos, site.nMaxHoldNanos.load(std::memory_order_relaxed));
+        for (int i = 0; i < LOCK_PROFILE_BUCKETS; i++) {
+            vWaitBuckets[i] += site.vWaitBuckets[i].load(std::memory_order_relaxed);
+            vHoldBuckets[i] += site.vHoldBuckets[i].load(std::memory_order_relaxed);
+        }
+    }
+};
+
+static UniValue RPCLockHistogram(const uint64_t* vBuckets)
+{
+    // trailing empty buckets are left out
+    int nBuckets = LOCK_PROFILE_BUCKETS;
+    while (nBuckets > 0 && vBuckets[nBuckets - 1] == 0) {
+        nBuckets--;
+    }
+    UniValue arr(UniValue::VARR);
+    for (int i = 0; i < nBuckets; i++) {
+        arr.push_back(vBuckets[i]);
+    }
+    return arr;
+}
+
+static UniValue RPCLockStats(const CLockStats& stats)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("acquired", stats.nAcquired));
+    obj.push_back(Pair("contended", stats.nContended));
+    obj.push_back(Pair("wait_total_ms", stats.nWaitNanos / 1e6));
+    obj.push_back(Pair("wait_max_ms", stats.nMaxWaitNanos / 1e6));
+    obj.push_back(Pair("hold_total_ms", stats.nHoldNanos / 1e6));
+    obj.push_back(Pair("hold_max_ms", stats.nMaxHoldNanos / 1e6));
+    obj.push_back(Pair("wait_histogram", RPCLockHistogram(stats.vWaitBuckets)));
+    obj.push_back(Pair("hold_histogram", RPCLockHistogram(stats.vHoldBuckets)));
+    return obj;
+}
+
+UniValue getlockstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 2)
+        throw std::runtime_error(
+            "getlockstats ( verbose reset )\n"
+            "Returns how often and how long locks were waited for and held, grouped by the lock as it is\n"
+            "named where it is taken (e.g. \"cs_main\", \"mempool.cs\", \"cs_vNodes\"). Members which are\n"
+            "only taken by their bare name get the file they are taken in appended (e.g. \"cs (governance.cpp)\").\n"
+            "Statistics are only recorded while lock profiling is enabled, see -profilelocks and setlockprofiling.\n"
+            "\nArguments:\n"
+            "1. verbose    (boolean, optional, default=false) Also list the statistics of every place a lock is taken at\n"
+            "2. reset      (boolean, optional, default=false) Reset all statistics after returning them\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"enabled\": true|false,      (boolean) Whether lock profiling is enabled\n"
+            "  \"locks\": {                 (json object) Locks ordered by the total time they were held\n"
+            "    \"name\": {                (json object) The lock\n"
+            "      \"acquired\": n,          (numeric) Number of times the lock was acquired\n"
+            "      \"contended\": n,         (numeric) Number of times it was held by another thread already\n"
+            "      \"wait_total_ms\": x.xxx, (numeric) Total time spent waiting for the lock in milliseconds\n"
+            "      \"wait_max_ms\": x.xxx,   (numeric) Longest wait in milliseconds\n"
+            "      \"hold_total_ms\": x.xxx, (numeric) Total time the lock was held in milliseconds\n"
+            "      \"hold_max_ms\": x.xxx,   (numeric) Longest time the lock was held at once in milliseconds\n"
+            "      \"wait_histogram\": [n,...], (array) Number of waits below 1us, then below 2us, 4us, 8us and so on\n"
+            "      \"hold_histogram\": [n,...], (array) Same for the time the lock was held\n"
+            "      \"sites\": {              (json object, verbose only) Same fields for every place the lock is taken at\n"
+            "        \"file:line\": {...}\n"
+            "      }\n"
+            "    }, ...\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getlockstats", "")
+            + HelpExampleCli("getlockstats", "true")
+            + HelpExampleRpc("getlockstats", "")
+        );
+
+    bool fVerbose = request.params.size() > 0 && request.params[0].get_bool();
+    bool fReset = request.params.size() > 1 && request.params[1].get_bool();
+
+    std::map<std::string, std::pair<CLockStats, std::map<std::string, CLockStats> > > mapLocks;
+    for (const auto& lock : GetLockSitesByLock()) {
+        auto& entry = mapLocks[lock.first];
+        for (const CLockSite* psite : lock.second) {
+            entry.first.Add(*psite);
+            if (fVerbose) {
+                entry.second[strprintf("%s:%d", psite->pszFile, psite->nLine)].Add(*psite);
+            }
+        }
+    }
+    if (fReset) {
+        ResetLockSites();
+    }
+
+    std::vector<std::pair<uint64_t, std::string> > vSorted;
+    for (const auto& p : mapLocks) {
+        if (p.second.first.nAcquired > 0) {
+            vSorted.emplace_back(p.second.first.nHoldNanos, p.first);
+        }
+    }
+    std::sort(vSorted.rbegin(), vSorted.rend());
+
+    UniValue locks(UniValue::VOBJ);
+    for (const auto& p : vSorted) {
+        const auto& entry = mapLocks[p.second];
+        UniValue obj = RPCLockStats(entry.first);
+        if (fVerbose) {
+            UniValue sites(UniValue::VOBJ);
+            for (const auto& site : entry.second) {
+                if (site.second.nAcquired > 0) {
+                    sites.push_back(Pair(site.first, RPCLockStats(site.second)));
+                }
+            }
+            obj.push_back(Pair("sites", sites));
+        }
+        locks.push_back(Pair(p.second, obj));
+    }
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("enabled", fLockProfiling.load()));
+    obj.push_back(Pair("locks", locks));
+    return obj;
+}
+
+UniValue setlockprofiling(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            "setlockprofiling enabled\n"
+            "Enables or disables recording lock statistics for getlockstats. Statistics recorded so far are kept.\n"
+            "\nArguments:\n"
+            "1. enabled    (boolean, required) Whether to record lock statistics\n"
+            "\nExamples:\n"
+            + HelpExampleCli("setlockprofiling", "true")
+            + HelpExampleRpc("setlockprofiling", "true")
+        );
+
+    fLockProfiling = request.params[0].get_bool();
+    return NullUniValue;
+}
+
+UniValue dumptrace(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw std::runtime_error(
+            "dumptrace \"filename\" ( clear )\n"
+            "Writes the most recent tracing spans of all threads to a file in the Chrome trace event format,\n"
+            "which can be opened with chrome://tracing or Perfetto. See -tracebuffer.\n"
+            "\nArguments:\n"
+            "1. \"filename\"  (string, required) The file to write to, relative paths are relative to the data directory.\n"
+            "                Existing files are not overwritten.\n"
+            "2. clear       (boolean, optional, default=false) Clear the spans after writing them\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"filename\": \"xxxx\",   (string) The absolute path of the file\n"
+            "  \"threads\": n,          (numeric) Number of threads which recorded spans\n"
+            "  \"events\": n,           (numeric) Number of spans written\n"
+            "  \"dropped\": n           (numeric) Number of older spans which were overwritten already\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("dumptrace", "\"trace.json\"")
+            + HelpExampleRpc("dumptrace", "\"trace.json\"")
+        );
+
+    boost::filesystem::path path = boost::filesystem::absolute(request.params[0].get_str(), GetDataDir());
+    bool fClear = request.params.size() > 1 && request.params[1].get_bool();
+
+    // Prevent arbitrary files from being overwritten, e.g. wallet.dat or the config of the node
+    if (boost::filesystem::exists(path))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, path.string() + " already exists. If you are sure this is what you want, move it out of the way first");
+
+    boost::filesystem::ofstream file(path);
+    if (!file.is_open())
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Cannot open trace file");
+
+    std::vector<CTraceThread> vThreads = tracer.GetThreads();
+    if (fClear) {
+        tracer.Clear();
+    }
+
+    // spans are timed with the steady clock, the file uses wall clock microseconds to match the log
+    double nOffsetMicros = GetTimeMicros() - TraceNanos() / 1000.0;
+    uint64_t nEvents = 0;
+    uint64_t nDropped = 0;
+
+    CJSONStreamWriter writer([&file](const std::string& str) { file.write(str.data(), str.size()); });
+    writer.BeginObject();
+    writer.Pair("displayTimeUnit", "ms");
+    writer.Key("traceEvents");
+    writer.BeginArray();
+    for (const auto& thread : vThreads) {
+        UniValue args(UniValue::VOBJ);
+        args.push_back(Pair("name", thread.strName));
+        UniValue meta(UniValue::VOBJ);
+        meta.push_back(Pair("name", "thread_name"));
+        meta.push_back(Pair("ph", "M"));
+        meta.push_back(Pair("pid", 1));
+        meta.push_back(Pair("tid", thread.nId));
+        meta.push_back(Pair("args", args));
+        writer.Value(meta);
+
+        for (const auto& event : thread.vEvents) {
+            UniValue obj(UniValue::VOBJ);
+            obj.push_back(Pair("name", event.pszName));
+            obj.push_back(Pair("ph", "X"));
+            obj.push_back(Pair("pid", 1));
+            obj.push_back(Pair("tid", thread.nId));
+            obj.push_back(Pair("ts", event.nStart / 1000.0 + nOffsetMicros));
+            obj.push_back(Pair("dur", event.nDuration / 1000.0));
+            if (event.szArg[0]) {
+                UniValue eventArgs(UniValue::VOBJ);
+                eventArgs.push_back(Pair("arg", std::string(event.szArg)));
+                obj.push_back(Pair("args", eventArgs));
+            }
+            writer.Value(obj);
+        }
+        nEvents += thread.vEvents.size();
+        nDropped += thread.nTotal - thread.vEvents.size();
+    }
+    writer.EndArray();
+    writer.EndObject();
+    writer.Flush();
+    file.close();
+    if (file.fail())
+        throw JSONRPCError(RPC_MISC_ERROR, "Failed to write trace file");
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("filename", path.string()));
+    obj.push_back(Pair("threads", (uint64_t)vThreads.size()));
+    obj.push_back(Pair("events", nEvents));
+    obj.push_back(Pair("dropped", nDropped));
     return obj;
 }
 
@@ -1138,6 +1454,9 @@ static const CRPCCommand commands[] =
     { "control",            "debug",                  &debug,                  true,  {} },
     { "control",            "getinfo",                &getinfo,                true,  {} }, /* uses wallet if enabled */
     { "control",            "getmemoryinfo",          &getmemoryinfo,          true,  {} },
+    { "control",            "getlockstats",           &getlockstats,           true,  {"verbose","reset"} },
+    { "control",            "setlockprofiling",       &setlockprofiling,       true,  {"enabled"} },
+    { "control",            "dumptrace",              &dumptrace,              true,  {"filename","clear"} },
     { "util",               "validateaddress",        &validateaddress,        true,  {"address"} }, /* uses wallet if enabled */
     { "util",               "createmultisig",         &createmultisig,         true,  {"nrequired","keys"} },
     { "util",               "verifymessage",          &verifymessage,          true,  {"address","signature","message"} },
@@ -6,6 +6,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "rpc/server.h"
+#include "rpc/jsonstream.h"
 
 #include "base58.h"
 #include "init.h"
@@ -473,11 +474,20 @@ static UniValue JSONRPCExecOne(const UniValue& req)
 
 std::string JSONRPCExecBatch(const UniValue& vReq)
 {
-    UniValue ret(UniValue::VARR);
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
+    std::string strReply;
+    CJSONStreamWriter writer([&strReply](const std::string& strChunk) { strReply += strChunk; });
+    JSONRPCExecBatch(vReq, writer);
+    writer.Flush();
+
+    return strReply + "\n";
+}
 
-    return ret.write() + "\n";
+void JSONRPCExecBatch(const UniValue& vReq, CJSONStreamWriter& writer)
+{
+    writer.BeginArray();
+    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
+        writer.Value(JSONRPCExecOne(vReq[reqIdx]));
+    writer.EndArray();
 }
 
 /**
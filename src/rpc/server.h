@@ -30,6 +30,7 @@ namespace RPCServer
 }
 
 class CBlockIndex;
+class CJSONStreamWriter;
 class CNetAddr;
 
 /** Wrapper for UniValue::VType, which includes typeAny:
@@ -50,8 +51,12 @@ public:
     bool fHelp;
     std::string URI;
     std::string authUser;
+    /** When set, the handler may write its result into this writer instead of
+     *  returning it (the returned value is then ignored). Handlers with large
+     *  results use this to avoid building the whole result in memory. */
+    CJSONStreamWriter* pStreamWriter;
 
-    JSONRPCRequest() { id = NullUniValue; params = NullUniValue; fHelp = false; }
+    JSONRPCRequest() { id = NullUniValue; params = NullUniValue; fHelp = false; pStreamWriter = NULL; }
     void parse(const UniValue& valRequest);
 };
 
@@ -206,6 +211,8 @@ bool StartRPC();
 void InterruptRPC();
 void StopRPC();
 std::string JSONRPCExecBatch(const UniValue& vReq);
+/** Execute a batch of requests, writing the array of replies into writer one reply at a time */
+void JSONRPCExecBatch(const UniValue& vReq, CJSONStreamWriter& writer);
 void RPCNotifyBlockChange(bool ibd, const CBlockIndex *);
 
 #endif // BITCOIN_RPCSERVER_H
@@ -11,6 +11,7 @@
 #include "crypto/sha256.h"
 #include "pubkey.h"
 #include "script/script.h"
+#include "streams.h"
 #include "uint256.h"
 
 typedef std::vector<unsigned char> valtype;
@@ -1117,9 +1118,57 @@ public:
     }
 };
 
+/** Stream which feeds everything serialized into it to a CHash256 */
+class CHash256Stream
+{
+private:
+    CHash256& hasher;
+
+public:
+    explicit CHash256Stream(CHash256& hasherIn) : hasher(hasherIn) {}
+
+    int GetType() const { return SER_GETHASH; }
+    int GetVersion() const { return 0; }
+
+    void write(const char* pch, size_t nSize)
+    {
+        hasher.Write((const unsigned char*)pch, nSize);
+    }
+
+    void write(const std::vector<unsigned char>& vch, size_t nBegin)
+    {
+        hasher.Write(vch.data() + nBegin, vch.size() - nBegin);
+    }
+};
+
 } // anon namespace
 
-uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType)
+PrecomputedTransactionData::PrecomputedTransactionData(const CTransaction& txTo)
+{
+    // an input index past the end blanks out all input scripts
+    static const CScript scriptEmpty;
+    CTransactionSignatureSerializer txTmp(txTo, scriptEmpty, txTo.vin.size(), SIGHASH_ALL);
+    CVectorWriter(SER_GETHASH, 0, vchBlanked, 0, txTmp);
+
+    // blanked inputs all have the same size: prevout, empty script and nSequence
+    static const size_t BLANKED_INPUT_SIZE = 32 + 4 + 1 + 4;
+    size_t nOffset = 4 + GetSizeOfCompactSize(txTo.vin.size());
+    vecOffsets.reserve(txTo.vin.size() + 1);
+    vecMidstates.reserve(txTo.vin.size());
+    CHash256 hasher;
+    size_t nHashed = 0;
+    for (size_t i = 0; i < txTo.vin.size(); i++) {
+        hasher.Write(vchBlanked.data() + nHashed, nOffset - nHashed);
+        nHashed = nOffset;
+        vecOffsets.push_back(nOffset);
+        vecMidstates.push_back(hasher);
+        nOffset += BLANKED_INPUT_SIZE;
+    }
+    vecOffsets.push_back(nOffset);
+    assert(nOffset <= vchBlanked.size());
+}
+
+uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType, const PrecomputedTransactionData* cache)
 {
     static const uint256 one(uint256S("0000000000000000000000000000000000000000000000000000000000000001"));
     if (nIn >= txTo.vin.size()) {
@@ -1138,6 +1187,31 @@ uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsig
     // Wrapper to serialize only the necessary parts of the transaction being signed
     CTransactionSignatureSerializer txTmp(txTo, scriptCode, nIn, nHashType);
 
+    // With SIGHASH_ALL everything but the input being signed is the same for all inputs, so only that
+    // one has to be serialized, the rest is hashed from the cache. The other hash types are rare.
+    const int nBaseType = nHashType & 0x1f;
+    if (cache && nBaseType != SIGHASH_NONE && nBaseType != SIGHASH_SINGLE) {
+        CHash256 hasher;
+        CHash256Stream ss(hasher);
+        if (nHashType & SIGHASH_ANYONECANPAY) {
+            // nVersion, a single input and then the outputs
+            hasher.Write(cache->vchBlanked.data(), 4);
+            ::WriteCompactSize(ss, 1);
+            txTmp.SerializeInput(ss, nIn);
+            ss.write(cache->vchBlanked, cache->vecOffsets.back());
+        } else {
+            // everything before this input was hashed already, the inputs after it are blanked out
+            hasher = cache->vecMidstates[nIn];
+            txTmp.SerializeInput(ss, nIn);
+            ss.write(cache->vchBlanked, cache->vecOffsets[nIn + 1]);
+        }
+        ::Serialize(ss, nHashType);
+
+        uint256 result;
+        hasher.Finalize(result.begin());
+        return result;
+    }
+
     // Serialize and hash
     CHashWriter ss(SER_GETHASH, 0);
     ss << txTmp << nHashType;
@@ -1162,7 +1236,7 @@ bool TransactionSignatureChecker::CheckSig(const std::vector<unsigned char>& vch
     int nHashType = vchSig.back();
     vchSig.pop_back();
 
-    uint256 sighash = SignatureHash(scriptCode, *txTo, nIn, nHashType);
+    uint256 sighash = SignatureHash(scriptCode, *txTo, nIn, nHashType, txdata);
 
     if (!VerifySignature(vchSig, pubkey, sighash))
         return false;
@@ -6,6 +6,7 @@
 #ifndef BITCOIN_SCRIPT_INTERPRETER_H
 #define BITCOIN_SCRIPT_INTERPRETER_H
 
+#include "hash.h"
 #include "script_error.h"
 #include "primitives/transaction.h"
 
@@ -94,7 +95,23 @@ enum
 
 bool CheckSignatureEncoding(const std::vector<unsigned char> &vchSig, unsigned int flags, ScriptError* serror);
 
-uint256 SignatureHash(const CScript &scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType);
+/**
+ * Parts of the signature hash which are shared by all inputs of a transaction. Without it SignatureHash
+ * serializes the whole transaction again for every input, which is quadratic in the number of inputs.
+ */
+struct PrecomputedTransactionData
+{
+    /** The transaction as hashed for SIGHASH_ALL with all input scripts blanked out, without the hash type */
+    std::vector<unsigned char> vchBlanked;
+    /** Offset of every input in vchBlanked, followed by the offset of the outputs */
+    std::vector<size_t> vecOffsets;
+    /** Hasher state after the part of vchBlanked which precedes the respective input */
+    std::vector<CHash256> vecMidstates;
+
+    explicit PrecomputedTransactionData(const CTransaction& tx);
+};
+
+uint256 SignatureHash(const CScript &scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType, const PrecomputedTransactionData* cache = NULL);
 
 class BaseSignatureChecker
 {
@@ -122,12 +139,13 @@ class TransactionSignatureChecker : public BaseSignatureChecker
 private:
     const CTransaction* txTo;
     unsigned int nIn;
+    const PrecomputedTransactionData* txdata;
 
 protected:
     virtual bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const;
 
 public:
-    TransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn) : txTo(txToIn), nIn(nInIn) {}
+    TransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn, const PrecomputedTransactionData* txdataIn = NULL) : txTo(txToIn), nIn(nInIn), txdata(txdataIn) {}
     bool CheckSig(const std::vector<unsigned char>& scriptSig, const std::vector<unsigned char>& vchPubKey, const CScript& scriptCode) const override;
     bool CheckLockTime(const CScriptNum& nLockTime) const override;
     bool CheckSequence(const CScriptNum& nSequence) const override;
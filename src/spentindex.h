@@ -370,4 +370,67 @@ struct CAddressIndexIteratorHeightKey {
 };
 
 
+struct CPayeeIndexKey {
+    int blockHeight;
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 4;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        // Heights are stored big endian to keep entries ordered by height
+        ser_writedata32be(s, blockHeight);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        blockHeight = ser_readdata32be(s);
+    }
+
+    CPayeeIndexKey(int height) {
+        blockHeight = height;
+    }
+
+    CPayeeIndexKey() {
+        SetNull();
+    }
+
+    void SetNull() {
+        blockHeight = 0;
+    }
+};
+
+struct CPayeeIndexValue {
+    uint256 blockHash;
+    std::vector<CScript> vPayees;
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        blockHash.Serialize(s);
+        WriteCompactSize(s, vPayees.size());
+        for (const auto& payee : vPayees)
+            s << *(const CScriptBase*)(&payee);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        blockHash.Unserialize(s);
+        vPayees.resize(ReadCompactSize(s));
+        for (auto& payee : vPayees)
+            s >> *(CScriptBase*)(&payee);
+    }
+
+    CPayeeIndexValue(const uint256& hash, const std::vector<CScript>& payees) {
+        blockHash = hash;
+        vPayees = payees;
+    }
+
+    CPayeeIndexValue() {
+        SetNull();
+    }
+
+    void SetNull() {
+        blockHash.SetNull();
+        vPayees.clear();
+    }
+};
+
 #endif // BITCOIN_SPENTINDEX_H
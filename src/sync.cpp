@@ -4,10 +4,17 @@
 
 #include "sync.h"
 
+#include "tinyformat.h"
 #include "util.h"
 #include "utilstrencodings.h"
 
+#include <algorithm>
+#include <ctype.h>
+#include <mutex>
+#include <set>
 #include <stdio.h>
+#include <string.h>
+#include <vector>
 
 #include <boost/foreach.hpp>
 #include <boost/thread.hpp>
@@ -19,6 +26,172 @@ void PrintLockContention(const char* pszName, const char* pszFile, int nLine)
 }
 #endif /* DEBUG_LOCKCONTENTION */
 
+std::atomic<bool> fLockProfiling(DEFAULT_PROFILE_LOCKS);
+
+struct LockSiteRegistry {
+    std::mutex mutex;
+    std::vector<CLockSite*> vSites;
+};
+
+static LockSiteRegistry& GetLockSiteRegistry()
+{
+    // never destroyed, lock sites register themselves whenever they are executed first
+    static LockSiteRegistry* registry = new LockSiteRegistry();
+    return *registry;
+}
+
+static int LockProfileBucket(int64_t nNanos)
+{
+    uint64_t nMicros = nNanos > 0 ? (uint64_t)nNanos / 1000 : 0;
+    int nBucket = 0;
+    while (nMicros > 0 && nBucket < LOCK_PROFILE_BUCKETS - 1) {
+        nMicros >>= 1;
+        nBucket++;
+    }
+    return nBucket;
+}
+
+static void UpdateMax(std::atomic<uint64_t>& nMax, uint64_t nValue)
+{
+    uint64_t nPrev = nMax.load(std::memory_order_relaxed);
+    while (nValue > nPrev && !nMax.compare_exchange_weak(nPrev, nValue, std::memory_order_relaxed)) {
+    }
+}
+
+CLockSite::CLockSite(const char* pszNameIn, const char* pszFileIn, int nLineIn) :
+    pszName(pszNameIn),
+    pszFile(pszFileIn),
+    nLine(nLineIn),
+    pmutex(nullptr)
+{
+    Reset();
+    LockSiteRegistry& registry = GetLockSiteRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.vSites.push_back(this);
+}
+
+void CLockSite::RecordWait(const void* pmutexIn, int64_t nNanos, bool fContended)
+{
+    if (!pmutex.load(std::memory_order_relaxed)) {
+        const void* pnull = nullptr;
+        pmutex.compare_exchange_strong(pnull, pmutexIn, std::memory_order_relaxed);
+    }
+    uint64_t n = nNanos > 0 ? nNanos : 0;
+    nAcquired.fetch_add(1, std::memory_order_relaxed);
+    if (fContended)
+        nContended.fetch_add(1, std::memory_order_relaxed);
+    nWaitNanos.fetch_add(n, std::memory_order_relaxed);
+    UpdateMax(nMaxWaitNanos, n);
+    vWaitBuckets[LockProfileBucket(nNanos)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void CLockSite::RecordHold(int64_t nNanos)
+{
+    uint64_t n = nNanos > 0 ? nNanos : 0;
+    nHoldNanos.fetch_add(n, std::memory_order_relaxed);
+    UpdateMax(nMaxHoldNanos, n);
+    vHoldBuckets[LockProfileBucket(nNanos)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void CLockSite::Reset()
+{
+    nAcquired = 0;
+    nContended = 0;
+    nWaitNanos = 0;
+    nMaxWaitNanos = 0;
+    nHoldNanos = 0;
+    nMaxHoldNanos = 0;
+    for (int i = 0; i < LOCK_PROFILE_BUCKETS; i++) {
+        vWaitBuckets[i] = 0;
+        vHoldBuckets[i] = 0;
+    }
+}
+
+void ForEachLockSite(const std::function<void(const CLockSite&)>& f)
+{
+    LockSiteRegistry& registry = GetLockSiteRegistry();
+    std::vector<CLockSite*> vSites;
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        vSites = registry.vSites;
+    }
+    // f may lock (and so register) other sites itself
+    for (const CLockSite* psite : vSites) {
+        f(*psite);
+    }
+}
+
+void ResetLockSites()
+{
+    LockSiteRegistry& registry = GetLockSiteRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (CLockSite* psite : registry.vSites) {
+        psite->Reset();
+    }
+}
+
+static bool IsBareLockName(const char* pszName)
+{
+    for (const char* p = pszName; *p; p++) {
+        if (!isalnum((unsigned char)*p) && *p != '_') return false;
+    }
+    return true;
+}
+
+std::map<std::string, std::vector<const CLockSite*> > GetLockSitesByLock()
+{
+    std::vector<const CLockSite*> vSites;
+    ForEachLockSite([&](const CLockSite& site) {
+        if (site.pmutex.load(std::memory_order_relaxed)) vSites.push_back(&site);
+    });
+    // in source order, so that names don't depend on which site was executed first
+    std::sort(vSites.begin(), vSites.end(), [](const CLockSite* a, const CLockSite* b) {
+        int nCmp = strcmp(a->pszFile, b->pszFile);
+        return nCmp != 0 ? nCmp < 0 : a->nLine < b->nLine;
+    });
+
+    std::map<std::string, std::vector<const CLockSite*> > mapLocks;
+    std::map<const void*, std::set<std::string> > mapQualifiedNames;
+    for (const CLockSite* psite : vSites) {
+        if (IsBareLockName(psite->pszName)) continue;
+        mapLocks[psite->pszName].push_back(psite);
+        mapQualifiedNames[psite->pmutex.load(std::memory_order_relaxed)].insert(psite->pszName);
+    }
+
+    std::vector<std::vector<const CLockSite*> > vBareLocks;
+    std::map<const void*, size_t> mapBareLockIndex;
+    for (const CLockSite* psite : vSites) {
+        if (!IsBareLockName(psite->pszName)) continue;
+        const void* pmutex = psite->pmutex.load(std::memory_order_relaxed);
+        // e.g. "cs" in masternodeman.cpp is "mnodeman.cs" elsewhere
+        auto itQualified = mapQualifiedNames.find(pmutex);
+        if (itQualified != mapQualifiedNames.end() && itQualified->second.size() == 1) {
+            mapLocks[*itQualified->second.begin()].push_back(psite);
+            continue;
+        }
+        auto it = mapBareLockIndex.emplace(pmutex, vBareLocks.size()).first;
+        if (it->second == vBareLocks.size()) vBareLocks.emplace_back();
+        vBareLocks[it->second].push_back(psite);
+    }
+
+    std::map<std::string, int> mapBareNameCount;
+    for (const auto& vLockSites : vBareLocks) {
+        mapBareNameCount[vLockSites[0]->pszName]++;
+    }
+    for (const auto& vLockSites : vBareLocks) {
+        const CLockSite* pfirst = vLockSites[0];
+        std::string strName = pfirst->pszName;
+        if (mapBareNameCount[strName] > 1 || mapLocks.count(strName)) {
+            strName = strprintf("%s (%s)", pfirst->pszName, pfirst->pszFile);
+            if (mapLocks.count(strName)) {
+                strName = strprintf("%s (%s:%d)", pfirst->pszName, pfirst->pszFile, pfirst->nLine);
+            }
+        }
+        mapLocks[strName] = vLockSites;
+    }
+    return mapLocks;
+}
+
 #ifdef DEBUG_LOCKORDER
 //
 // Early deadlock detection.
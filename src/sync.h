@@ -8,6 +8,14 @@
 
 #include "threadsafety.h"
 
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/locks.hpp>
 #include <boost/thread/mutex.hpp>
@@ -108,16 +116,90 @@ typedef boost::condition_variable CConditionVariable;
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine);
 #endif
 
+/** Default for -profilelocks */
+static const bool DEFAULT_PROFILE_LOCKS = false;
+/** Histogram buckets of the lock profiler: below 1us, [2^(i-1), 2^i) us for bucket i, and the rest in the last one */
+static const int LOCK_PROFILE_BUCKETS = 24;
+
+/** Whether LOCK and TRY_LOCK record the time spent waiting for and holding locks, see CLockSite */
+extern std::atomic<bool> fLockProfiling;
+
+static inline int64_t LockProfileNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Statistics of a single LOCK/TRY_LOCK statement. Every statement has its own static instance
+ * which registers itself when it's executed for the first time. Recording only uses relaxed
+ * atomics (and mostly happens while the lock is held), so the profiler is cheap enough to stay
+ * enabled, and costs a single atomic load per lock while it's disabled.
+ */
+class CLockSite
+{
+public:
+    const char* const pszName;
+    const char* const pszFile;
+    const int nLine;
+
+    std::atomic<uint64_t> nAcquired;
+    std::atomic<uint64_t> nContended;
+    std::atomic<uint64_t> nWaitNanos;
+    std::atomic<uint64_t> nMaxWaitNanos;
+    std::atomic<uint64_t> nHoldNanos;
+    std::atomic<uint64_t> nMaxHoldNanos;
+    std::atomic<uint64_t> vWaitBuckets[LOCK_PROFILE_BUCKETS];
+    std::atomic<uint64_t> vHoldBuckets[LOCK_PROFILE_BUCKETS];
+    // the mutex locked here first, which tells apart locks with the same name (e.g. the "cs" members)
+    std::atomic<const void*> pmutex;
+
+    CLockSite(const char* pszNameIn, const char* pszFileIn, int nLineIn);
+    CLockSite(const CLockSite&) = delete;
+    CLockSite& operator=(const CLockSite&) = delete;
+
+    void RecordWait(const void* pmutexIn, int64_t nNanos, bool fContended);
+    void RecordHold(int64_t nNanos);
+    void Reset();
+};
+
+/** Calls f for every lock site which was executed so far */
+void ForEachLockSite(const std::function<void(const CLockSite&)>& f);
+void ResetLockSites();
+/**
+ * Groups the lock sites by the lock they take. Qualified names like "mnodeman.cs" or "pnode->cs_vSend"
+ * are the same lock wherever they are used, bare names like "cs" or "cs_main" are grouped by the mutex
+ * they locked, and get the file of their first site appended if the name is taken already
+ * (e.g. "cs (governance.cpp)"). Sites which never locked anything are left out.
+ */
+std::map<std::string, std::vector<const CLockSite*> > GetLockSitesByLock();
+
 /** Wrapper around boost::unique_lock<Mutex> */
 template <typename Mutex>
 class SCOPED_LOCKABLE CMutexLock
 {
 private:
     boost::unique_lock<Mutex> lock;
+    // only set while the lock is held and profiled
+    CLockSite* psite;
+    int64_t nLockedSince;
 
-    void Enter(const char* pszName, const char* pszFile, int nLine)
+    void Enter(const char* pszName, const char* pszFile, int nLine, CLockSite* psiteIn)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(lock.mutex()));
+        if (psiteIn && fLockProfiling.load(std::memory_order_relaxed)) {
+            int64_t nStart = LockProfileNanos();
+            bool fContended = !lock.try_lock();
+            if (fContended) {
+#ifdef DEBUG_LOCKCONTENTION
+                PrintLockContention(pszName, pszFile, nLine);
+#endif
+                lock.lock();
+            }
+            psite = psiteIn;
+            nLockedSince = fContended ? LockProfileNanos() : nStart;
+            psite->RecordWait(lock.mutex(), nLockedSince - nStart, fContended);
+            return;
+        }
 #ifdef DEBUG_LOCKCONTENTION
         if (!lock.try_lock()) {
             PrintLockContention(pszName, pszFile, nLine);
@@ -128,39 +210,47 @@ private:
 #endif
     }
 
-    bool TryEnter(const char* pszName, const char* pszFile, int nLine)
+    bool TryEnter(const char* pszName, const char* pszFile, int nLine, CLockSite* psiteIn)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(lock.mutex()), true);
         lock.try_lock();
-        if (!lock.owns_lock())
+        if (!lock.owns_lock()) {
             LeaveCritical();
+        } else if (psiteIn && fLockProfiling.load(std::memory_order_relaxed)) {
+            psite = psiteIn;
+            nLockedSince = LockProfileNanos();
+            psite->RecordWait(lock.mutex(), 0, false);
+        }
         return lock.owns_lock();
     }
 
 public:
-    CMutexLock(Mutex& mutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false) EXCLUSIVE_LOCK_FUNCTION(mutexIn) : lock(mutexIn, boost::defer_lock)
+    CMutexLock(Mutex& mutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false, CLockSite* psiteIn = nullptr) EXCLUSIVE_LOCK_FUNCTION(mutexIn) : lock(mutexIn, boost::defer_lock), psite(nullptr), nLockedSince(0)
     {
         if (fTry)
-            TryEnter(pszName, pszFile, nLine);
+            TryEnter(pszName, pszFile, nLine, psiteIn);
         else
-            Enter(pszName, pszFile, nLine);
+            Enter(pszName, pszFile, nLine, psiteIn);
     }
 
-    CMutexLock(Mutex* pmutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false) EXCLUSIVE_LOCK_FUNCTION(pmutexIn)
+    CMutexLock(Mutex* pmutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false, CLockSite* psiteIn = nullptr) EXCLUSIVE_LOCK_FUNCTION(pmutexIn) : psite(nullptr), nLockedSince(0)
     {
         if (!pmutexIn) return;
 
         lock = boost::unique_lock<Mutex>(*pmutexIn, boost::defer_lock);
         if (fTry)
-            TryEnter(pszName, pszFile, nLine);
+            TryEnter(pszName, pszFile, nLine, psiteIn);
         else
-            Enter(pszName, pszFile, nLine);
+            Enter(pszName, pszFile, nLine, psiteIn);
     }
 
     ~CMutexLock() UNLOCK_FUNCTION()
     {
-        if (lock.owns_lock())
+        if (lock.owns_lock()) {
+            if (psite)
+                psite->RecordHold(LockProfileNanos() - nLockedSince);
             LeaveCritical();
+        }
     }
 
     operator bool()
@@ -174,9 +264,15 @@ typedef CMutexLock<CCriticalSection> CCriticalBlock;
 #define PASTE(x, y) x ## y
 #define PASTE2(x, y) PASTE(x, y)
 
-#define LOCK(cs) CCriticalBlock PASTE2(criticalblock, __COUNTER__)(cs, #cs, __FILE__, __LINE__)
-#define LOCK2(cs1, cs2) CCriticalBlock criticalblock1(cs1, #cs1, __FILE__, __LINE__), criticalblock2(cs2, #cs2, __FILE__, __LINE__)
-#define TRY_LOCK(cs, name) CCriticalBlock name(cs, #cs, __FILE__, __LINE__, true)
+#define LOCK_SITE(cs, n) static CLockSite PASTE2(locksite, n)(#cs, __FILE__, __LINE__)
+
+#define LOCK(cs) LOCK_IMPL(cs, __COUNTER__)
+#define LOCK_IMPL(cs, n) LOCK_SITE(cs, n); CCriticalBlock PASTE2(criticalblock, n)(cs, #cs, __FILE__, __LINE__, false, &PASTE2(locksite, n))
+#define LOCK2(cs1, cs2) LOCK2_IMPL(cs1, cs2, __COUNTER__, __COUNTER__)
+#define LOCK2_IMPL(cs1, cs2, n1, n2) LOCK_SITE(cs1, n1); LOCK_SITE(cs2, n2); \
+    CCriticalBlock criticalblock1(cs1, #cs1, __FILE__, __LINE__, false, &PASTE2(locksite, n1)), criticalblock2(cs2, #cs2, __FILE__, __LINE__, false, &PASTE2(locksite, n2))
+#define TRY_LOCK(cs, name) TRY_LOCK_IMPL(cs, name, __COUNTER__)
+#define TRY_LOCK_IMPL(cs, name, n) LOCK_SITE(cs, n); CCriticalBlock name(cs, #cs, __FILE__, __LINE__, true, &PASTE2(locksite, n))
 
 #define ENTER_CRITICAL_SECTION(cs)                            \
     {                                                         \
@@ -0,0 +1,173 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockcache.h"
+
+#include "clientversion.h"
+#include "random.h"
+#include "streams.h"
+#include "test/test_zeroone.h"
+#include "test/testutil.h"
+#include "tinyformat.h"
+#include "utilstrencodings.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockcache_tests, BasicTestingSetup)
+
+static std::shared_ptr<const CBlock> MakeBlock()
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(GetRandHash(), 0);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 42;
+
+    auto pblock = std::make_shared<CBlock>();
+    pblock->nVersion = 1;
+    pblock->hashPrevBlock = GetRandHash();
+    pblock->nTime = 1546300800;
+    pblock->vtx.push_back(MakeTransactionRef(tx));
+    return pblock;
+}
+
+BOOST_AUTO_TEST_CASE(blockcache_lru)
+{
+    CBlockCache cache;
+    CBlock block;
+
+    // disabled until Init
+    auto pblock1 = MakeBlock();
+    cache.Insert(pblock1->GetHash(), pblock1);
+    BOOST_CHECK(!cache.Get(pblock1->GetHash(), block));
+
+    // all blocks have the same size
+    cache.Init(1 << 20, false);
+    cache.Insert(pblock1->GetHash(), pblock1);
+    size_t nBlockUsage = cache.GetStats().nUsage;
+    BOOST_CHECK(nBlockUsage > 0);
+
+    // room for two of them
+    cache.Init(2 * nBlockUsage + nBlockUsage / 2, false);
+    auto pblock2 = MakeBlock();
+    auto pblock3 = MakeBlock();
+    cache.Insert(pblock2->GetHash(), pblock2);
+    BOOST_CHECK(cache.Get(pblock1->GetHash(), block));
+    BOOST_CHECK(block.GetHash() == pblock1->GetHash());
+    BOOST_CHECK(block.vtx[0] == pblock1->vtx[0]);
+
+    // pblock2 is the least recently used one now
+    cache.Insert(pblock3->GetHash(), pblock3);
+    BOOST_CHECK(!cache.Get(pblock2->GetHash(), block));
+    BOOST_CHECK(cache.Get(pblock1->GetHash(), block));
+    BOOST_CHECK(cache.Get(pblock3->GetHash(), block));
+
+    CBlockCacheStats stats = cache.GetStats();
+    BOOST_CHECK_EQUAL(stats.nBlocks, 2);
+    BOOST_CHECK_EQUAL(stats.nUsage, 2 * nBlockUsage);
+    BOOST_CHECK_EQUAL(stats.nMaxUsage, 2 * nBlockUsage + nBlockUsage / 2);
+    BOOST_CHECK_EQUAL(stats.nHits, 3);
+    BOOST_CHECK_EQUAL(stats.nMisses, 1);
+
+    // inserting a cached block again doesn't count it twice
+    cache.Insert(pblock1->GetHash(), pblock1);
+    BOOST_CHECK_EQUAL(cache.GetStats().nUsage, 2 * nBlockUsage);
+
+    // shrinking evicts the least recently used blocks
+    cache.Init(nBlockUsage, false);
+    BOOST_CHECK(cache.Get(pblock1->GetHash(), block));
+    BOOST_CHECK(!cache.Get(pblock3->GetHash(), block));
+
+    // a block which is larger than the whole cache isn't kept
+    cache.Init(nBlockUsage - 1, false);
+    cache.Insert(pblock1->GetHash(), pblock1);
+    BOOST_CHECK(!cache.Get(pblock1->GetHash(), block));
+    BOOST_CHECK_EQUAL(cache.GetStats().nUsage, 0);
+
+    cache.Init(1 << 20, false);
+    cache.Insert(pblock1->GetHash(), pblock1);
+    cache.Clear();
+    BOOST_CHECK(!cache.Get(pblock1->GetHash(), block));
+    BOOST_CHECK_EQUAL(cache.GetStats().nUsage, 0);
+
+    cache.Init(0, false);
+    cache.Insert(pblock1->GetHash(), pblock1);
+    BOOST_CHECK(!cache.Get(pblock1->GetHash(), block));
+    BOOST_CHECK_EQUAL(cache.GetStats().nMaxUsage, 0);
+}
+
+#ifndef WIN32
+BOOST_AUTO_TEST_CASE(blockcache_mapped_file)
+{
+    const CMessageHeader::MessageStartChars messageStart = {0xf9, 0xbe, 0xb4, 0xd9};
+    const CMessageHeader::MessageStartChars messageStartOther = {0xfa, 0xbf, 0xb5, 0xda};
+    boost::filesystem::path path = GetTempPath() / strprintf("test_zeroone_blockcache_%lu", (unsigned long)GetRand(1000000));
+
+    // lay out two blocks like WriteBlockToDisk does
+    auto pblock1 = MakeBlock();
+    auto pblock2 = MakeBlock();
+    std::vector<unsigned int> vPos;
+    {
+        CAutoFile file(fopen(path.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+        BOOST_REQUIRE(!file.IsNull());
+        for (const auto& pblock : {pblock1, pblock2}) {
+            unsigned int nSize = GetSerializeSize(file, *pblock);
+            file << FLATDATA(messageStart) << nSize;
+            vPos.push_back(ftell(file.Get()));
+            file << *pblock;
+        }
+    }
+    size_t nFileSize = boost::filesystem::file_size(path);
+
+    std::shared_ptr<CMappedBlockFile> mapped = CMappedBlockFile::Map(path, nFileSize);
+    BOOST_REQUIRE(mapped);
+    BOOST_CHECK_EQUAL(mapped->GetSize(), nFileSize);
+
+    CBlock block;
+    BOOST_CHECK(mapped->ReadBlock(vPos[0], messageStart, block));
+    BOOST_CHECK(block.GetHash() == pblock1->GetHash());
+    BOOST_CHECK(block.vtx[0]->GetHash() == pblock1->vtx[0]->GetHash());
+    BOOST_CHECK(mapped->ReadBlock(vPos[1], messageStart, block));
+    BOOST_CHECK(block.GetHash() == pblock2->GetHash());
+
+    // raw reads return the bytes as they were written
+    std::vector<unsigned char> vchBlock;
+    CDataStream ssBlock(SER_DISK, CLIENT_VERSION);
+    ssBlock << *pblock2;
+    BOOST_CHECK(mapped->ReadRawBlock(vPos[1], messageStart, vchBlock));
+    BOOST_CHECK(vchBlock == std::vector<unsigned char>(ssBlock.begin(), ssBlock.end()));
+
+    // not preceded by a valid index header
+    BOOST_CHECK(!mapped->ReadBlock(vPos[0], messageStartOther, block));
+    BOOST_CHECK(!mapped->ReadBlock(vPos[0] + 1, messageStart, block));
+    BOOST_CHECK(!mapped->ReadBlock(4, messageStart, block));
+    BOOST_CHECK(!mapped->ReadBlock(nFileSize + 8, messageStart, block));
+    BOOST_CHECK(!mapped->ReadRawBlock(vPos[0], messageStartOther, vchBlock));
+
+    // the second block doesn't fit into a shorter mapping
+    std::shared_ptr<CMappedBlockFile> mappedShort = CMappedBlockFile::Map(path, nFileSize - 1);
+    BOOST_REQUIRE(mappedShort);
+    BOOST_CHECK(mappedShort->ReadBlock(vPos[0], messageStart, block));
+    BOOST_CHECK(!mappedShort->ReadBlock(vPos[1], messageStart, block));
+    BOOST_CHECK(!mappedShort->ReadRawBlock(vPos[1], messageStart, vchBlock));
+
+    // can't map more than the file has
+    BOOST_CHECK(!CMappedBlockFile::Map(path, nFileSize + 1));
+
+    // mappings are reused until the file grows
+    CBlockCache cache;
+    cache.Init(1 << 20, true);
+    BOOST_CHECK(cache.GetMappedFile(0, nFileSize - 1, path) == cache.GetMappedFile(0, nFileSize - 1, path));
+    BOOST_CHECK_EQUAL(cache.GetMappedFile(0, nFileSize, path)->GetSize(), nFileSize);
+    BOOST_CHECK_EQUAL(cache.GetStats().nMappedFiles, 1);
+
+    mapped.reset();
+    mappedShort.reset();
+    cache.Clear();
+    boost::filesystem::remove(path);
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
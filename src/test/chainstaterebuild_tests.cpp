@@ -0,0 +1,61 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainstaterebuild.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "test/test_zeroone.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(chainstaterebuild_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(chainstaterebuild_progress)
+{
+    std::vector<CBlockIndex> vIndex(101);
+    for (size_t i = 0; i < vIndex.size(); i++) {
+        vIndex[i].nHeight = i;
+        vIndex[i].nChainTx = (i + 1) * 10;
+        vIndex[i].pprev = i > 0 ? &vIndex[i - 1] : nullptr;
+    }
+
+    CChainStateRebuild rebuild;
+    CChainStateRebuildProgress progress;
+    BOOST_CHECK(!rebuild.IsActive());
+    BOOST_CHECK(!rebuild.GetProgress(progress));
+
+    // nothing to read ahead, so no threads are started and the coins view isn't needed
+    rebuild.Start(&vIndex[20], &vIndex[100], nullptr, Params().GetConsensus(), 0, 2);
+    BOOST_CHECK(rebuild.IsActive());
+    BOOST_REQUIRE(rebuild.GetProgress(progress));
+    BOOST_CHECK_EQUAL(progress.nStartHeight, 20);
+    BOOST_CHECK_EQUAL(progress.nHeight, 20);
+    BOOST_CHECK_EQUAL(progress.nTargetHeight, 100);
+    BOOST_CHECK_CLOSE(progress.dProgress, 210.0 / 1010.0, 0.0001);
+
+    rebuild.UpdatedTip(&vIndex[50]);
+    BOOST_REQUIRE(rebuild.GetProgress(progress));
+    BOOST_CHECK_EQUAL(progress.nHeight, 50);
+    BOOST_CHECK_CLOSE(progress.dProgress, 510.0 / 1010.0, 0.0001);
+    BOOST_CHECK(progress.nETA >= -1);
+
+    rebuild.UpdatedTip(&vIndex[100]);
+    BOOST_REQUIRE(rebuild.GetProgress(progress));
+    BOOST_CHECK_EQUAL(progress.dProgress, 1.0);
+    BOOST_CHECK_EQUAL(progress.nETA, 0);
+
+    rebuild.Stop();
+    BOOST_CHECK(!rebuild.IsActive());
+    BOOST_CHECK(!rebuild.GetProgress(progress));
+
+    // a target behind the tip is ignored
+    rebuild.Start(&vIndex[60], &vIndex[40], nullptr, Params().GetConsensus(), 16, 2);
+    BOOST_REQUIRE(rebuild.GetProgress(progress));
+    BOOST_CHECK_EQUAL(progress.nTargetHeight, 60);
+    BOOST_CHECK_EQUAL(progress.nETA, 0);
+    rebuild.Stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
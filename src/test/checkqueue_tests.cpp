@@ -209,6 +209,35 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_Correct_Random)
     Correct_Queue_range(range);
 }
 
+/** Test that the counters account for every check exactly once */
+BOOST_AUTO_TEST_CASE(test_CheckQueue_Stats)
+{
+    auto queue = std::unique_ptr<Standard_Queue>(new Standard_Queue {QUEUE_BATCH_SIZE});
+    boost::thread_group tg;
+    for (auto x = 0; x < nScriptCheckThreads; ++x) {
+       tg.create_thread([&]{queue->Thread();});
+    }
+    size_t nTotal = 0;
+    for (size_t i = 0; i < 100; i++) {
+        CCheckQueueControl<FakeCheck> control(queue.get());
+        std::vector<FakeCheck> vChecks(GetRand(1000));
+        nTotal += vChecks.size();
+        control.Add(vChecks);
+        BOOST_REQUIRE(control.Wait());
+    }
+    tg.interrupt_all();
+    tg.join_all();
+
+    CCheckQueueStats stats = queue->GetStats();
+    BOOST_CHECK_EQUAL(stats.nQueued, 0U);
+    BOOST_CHECK(stats.nMaxQueued <= 1000);
+    BOOST_CHECK_EQUAL(stats.workers.size(), (size_t)nScriptCheckThreads + 1);
+    uint64_t nChecks = 0;
+    for (const auto& worker : stats.workers) {
+        nChecks += worker.nChecks;
+    }
+    BOOST_CHECK_EQUAL(nChecks, nTotal);
+}
 
 /** Test that failing checks are caught */
 BOOST_AUTO_TEST_CASE(test_CheckQueue_Catches_Failure)
@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "coins.h"
+#include "coinsprefetch.h"
 #include "script/standard.h"
 #include "uint256.h"
 #include "undo.h"
@@ -856,4 +857,103 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+void CheckAddFetchedCoin(CAmount cache_value, CAmount fetched_value, CAmount expected_value, char cache_flags, char expected_flags)
+{
+    SingleEntryCacheTest test(ABSENT, cache_value, cache_flags);
+
+    Coin coin;
+    SetCoinsValue(fetched_value, coin);
+    test.cache.AddFetchedCoin(OUTPOINT, std::move(coin));
+    test.cache.SelfTest();
+
+    CAmount result_value;
+    char result_flags;
+    GetCoinsMapEntry(test.cache.map(), result_value, result_flags);
+    BOOST_CHECK_EQUAL(result_value, expected_value);
+    BOOST_CHECK_EQUAL(result_flags, expected_flags);
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_add_fetched)
+{
+    /* Check AddFetchedCoin behavior, adding a coin which was read from the
+     * base view to a cache view and checking the resulting entry in the cache.
+     * Entries which are cached already are never replaced.
+     *
+     *                  Cache   Fetched Result  Cache        Result
+     *                  Value   Value   Value   Flags        Flags
+     */
+    CheckAddFetchedCoin(ABSENT, VALUE1, VALUE1, NO_ENTRY   , 0          );
+    CheckAddFetchedCoin(ABSENT, PRUNED, ABSENT, NO_ENTRY   , NO_ENTRY   );
+    for (char cache_flags : FLAGS) {
+        CheckAddFetchedCoin(PRUNED, VALUE1, PRUNED, cache_flags, cache_flags);
+        CheckAddFetchedCoin(VALUE2, VALUE1, VALUE2, cache_flags, cache_flags);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(coins_prefetch)
+{
+    CCoinsViewTest base;
+    std::vector<COutPoint> vOutpoints;
+    {
+        CCoinsMap map;
+        for (int i = 0; i < 100; i++) {
+            COutPoint outpoint(GetRandHash(), i);
+            CCoinsCacheEntry entry;
+            entry.flags = CCoinsCacheEntry::DIRTY;
+            entry.coin.out.nValue = i + 1;
+            entry.coin.nHeight = 1;
+            map.emplace(outpoint, std::move(entry));
+            vOutpoints.push_back(outpoint);
+        }
+        base.BatchWrite(map, uint256());
+    }
+    CCoinsViewCacheTest cache(&base);
+    // one of them is cached already and must not be replaced
+    cache.AccessCoin(vOutpoints[0]);
+
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vout.resize(1);
+    CMutableTransaction tx;
+    for (int i = 0; i < 60; i++) {
+        tx.vin.emplace_back(vOutpoints[i]);
+    }
+    // not in the base view
+    tx.vin.emplace_back(COutPoint(GetRandHash(), 0));
+    tx.vout.resize(1);
+    CMutableTransaction txChild;
+    txChild.vin.emplace_back(COutPoint(tx.GetHash(), 0));
+    txChild.vout.resize(1);
+    CBlock block;
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+    block.vtx.push_back(MakeTransactionRef(tx));
+    block.vtx.push_back(MakeTransactionRef(txChild));
+
+    CCoinsPrefetcher prefetcher;
+    // disabled until started
+    BOOST_CHECK_EQUAL(prefetcher.Prefetch(block, cache, base), 0);
+    BOOST_CHECK(!cache.HaveCoinInCache(vOutpoints[1]));
+
+    prefetcher.Start(3);
+    BOOST_CHECK_EQUAL(prefetcher.Prefetch(block, cache, base), 59);
+    cache.SelfTest();
+    for (int i = 0; i < 100; i++) {
+        BOOST_CHECK_EQUAL(cache.HaveCoinInCache(vOutpoints[i]), i < 60);
+        auto it = cache.map().find(vOutpoints[i]);
+        if (it != cache.map().end()) {
+            BOOST_CHECK_EQUAL(it->second.flags, 0);
+            BOOST_CHECK_EQUAL(it->second.coin.out.nValue, i + 1);
+        }
+    }
+    CCoinsPrefetchStats stats = prefetcher.GetStats();
+    BOOST_CHECK_EQUAL(stats.nThreads, 3);
+    BOOST_CHECK_EQUAL(stats.nBlocks, 1);
+    BOOST_CHECK_EQUAL(stats.nLookups, 60);
+    BOOST_CHECK_EQUAL(stats.nFound, 59);
+
+    // everything is cached now
+    BOOST_CHECK_EQUAL(prefetcher.Prefetch(block, cache, base), 0);
+    prefetcher.Stop();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -255,6 +255,23 @@ BOOST_AUTO_TEST_CASE(sha256_testvectors) {
     TestSHA256(test1, "a316d55510b49662420f49d145d42fb83f31ef8dc016aa4e32df049991a91e26");
 }
 
+BOOST_AUTO_TEST_CASE(sha256_batch64) {
+    // batched hashing of 64-byte inputs has to match the regular hasher
+    for (size_t nBlocks : {0, 1, 2, 7, 100}) {
+        std::vector<unsigned char> in(nBlocks * 64);
+        for (auto& c : in) {
+            c = insecure_rand();
+        }
+        std::vector<unsigned char> out(nBlocks * 32);
+        SHA256Batch64(out.data(), in.data(), nBlocks);
+        for (size_t i = 0; i < nBlocks; i++) {
+            unsigned char hash[CSHA256::OUTPUT_SIZE];
+            CSHA256().Write(&in[i * 64], 64).Finalize(hash);
+            BOOST_CHECK(std::equal(hash, hash + CSHA256::OUTPUT_SIZE, out.begin() + i * 32));
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(sha512_testvectors) {
     TestSHA512("",
                "cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce"
@@ -8,6 +8,7 @@
 #include "script/standard.h"
 #include "script/sign.h"
 #include "validation.h"
+#include "miner.h"
 #include "base58.h"
 #include "netbase.h"
 #include "messagesigner.h"
@@ -15,6 +16,7 @@
 #include "spork.h"
 
 #include "evo/specialtx.h"
+#include "evo/cbtx.h"
 #include "evo/providertx.h"
 #include "evo/deterministicmns.h"
 
@@ -399,4 +401,39 @@ BOOST_FIXTURE_TEST_CASE(dip3_protx, TestChainDIP3Setup)
     }
     BOOST_ASSERT(foundRevived);
 }
+
+BOOST_FIXTURE_TEST_CASE(dip3_template_keeps_mnlist_tree, TestChainDIP3Setup)
+{
+    auto utxos = BuildSimpleUtxoMap(coinbaseTxns);
+
+    CKey ownerKey;
+    CBLSSecretKey operatorKey;
+    auto tx = CreateProRegTx(utxos, 1, GenerateRandomAddress(), coinbaseKey, ownerKey, operatorKey);
+    CBlock block = CreateAndProcessBlock({tx}, coinbaseKey);
+    deterministicMNManager->UpdatedBlockTip(chainActive.Tip());
+    BOOST_ASSERT(deterministicMNManager->GetListAtChainTip().HasMN(tx.GetHash()));
+
+    CCbTx cbTx;
+    BOOST_ASSERT(GetTxPayload(*block.vtx[0], cbTx));
+
+    uint256 cachedBlockHash, cachedRoot;
+    BOOST_ASSERT(GetCachedMNListMerkleRoot(cachedBlockHash, cachedRoot));
+    BOOST_CHECK(cachedBlockHash == chainActive.Tip()->GetBlockHash());
+    BOOST_CHECK(cachedRoot == cbTx.merkleRootMNList);
+
+    // TestBlockValidity connects the template with a dummy index, that must neither crash nor replace the tree of the tip
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    std::unique_ptr<CBlockTemplate> pblocktemplate = BlockAssembler(Params()).CreateNewBlock(scriptPubKey);
+    BOOST_ASSERT(pblocktemplate);
+
+    BOOST_ASSERT(GetCachedMNListMerkleRoot(cachedBlockHash, cachedRoot));
+    BOOST_CHECK(cachedBlockHash == chainActive.Tip()->GetBlockHash());
+    BOOST_CHECK(cachedRoot == cbTx.merkleRootMNList);
+
+    // and the next block still builds on it
+    CreateAndProcessBlock({}, coinbaseKey);
+    deterministicMNManager->UpdatedBlockTip(chainActive.Tip());
+    BOOST_ASSERT(GetCachedMNListMerkleRoot(cachedBlockHash, cachedRoot));
+    BOOST_CHECK(cachedBlockHash == chainActive.Tip()->GetBlockHash());
+}
 BOOST_AUTO_TEST_SUITE_END()
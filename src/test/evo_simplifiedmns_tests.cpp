@@ -5,6 +5,8 @@
 #include "test/test_zeroone.h"
 
 #include "bls/bls.h"
+#include "consensus/merkle.h"
+#include "evo/deterministicmns.h"
 #include "evo/simplifiedmns.h"
 #include "netbase.h"
 
@@ -12,10 +14,10 @@
 
 BOOST_FIXTURE_TEST_SUITE(evo_simplifiedmns_tests, BasicTestingSetup)
 
-BOOST_AUTO_TEST_CASE(simplifiedmns_merkleroots)
+static std::vector<CSimplifiedMNListEntry> CreateEntries(size_t nCount)
 {
     std::vector<CSimplifiedMNListEntry> entries;
-    for (size_t i = 0; i < 15; i++) {
+    for (size_t i = 0; i < nCount; i++) {
         CSimplifiedMNListEntry smle;
         smle.proRegTxHash.SetHex(strprintf("%064x", i));
         smle.confirmedHash.SetHex(strprintf("%064x", i));
@@ -35,6 +37,56 @@ BOOST_AUTO_TEST_CASE(simplifiedmns_merkleroots)
 
         entries.emplace_back(smle);
     }
+    return entries;
+}
+
+static CDeterministicMNCPtr CreateDMN(const CSimplifiedMNListEntry& smle)
+{
+    auto dmnState = std::make_shared<CDeterministicMNState>();
+    dmnState->confirmedHash = smle.confirmedHash;
+    dmnState->addr = smle.service;
+    dmnState->pubKeyOperator = smle.pubKeyOperator;
+    dmnState->keyIDVoting = smle.keyIDVoting;
+    dmnState->keyIDOwner = smle.keyIDVoting;
+
+    auto dmn = std::make_shared<CDeterministicMN>();
+    dmn->proTxHash = smle.proRegTxHash;
+    dmn->collateralOutpoint = COutPoint(smle.proRegTxHash, 0);
+    dmn->nOperatorReward = 0;
+    dmn->pdmnState = dmnState;
+    return dmn;
+}
+
+static CDeterministicMNStatePtr CopyState(const CDeterministicMNList& mnList, const uint256& proTxHash)
+{
+    return std::make_shared<CDeterministicMNState>(*mnList.GetMN(proTxHash)->pdmnState);
+}
+
+// compares the root and all proofs of the tree with a full recalculation from mnList
+static void CheckMerkleTree(const CSimplifiedMNListMerkleTree& smlTree, const CDeterministicMNList& mnList)
+{
+    CSimplifiedMNList sml(mnList);
+    uint256 root = sml.CalcMerkleRoot(nullptr);
+    BOOST_CHECK_EQUAL(smlTree.GetLeafCount(), sml.mnList.size());
+    BOOST_CHECK(smlTree.GetRoot() == root);
+
+    std::vector<uint256> leaves;
+    for (const auto& e : sml.mnList) {
+        leaves.emplace_back(e.CalcHash());
+    }
+    for (size_t i = 0; i < sml.mnList.size(); i++) {
+        std::vector<uint256> branch;
+        uint32_t nPos;
+        BOOST_REQUIRE(smlTree.GetMerkleProof(sml.mnList[i].proRegTxHash, branch, nPos));
+        BOOST_CHECK_EQUAL(nPos, i);
+        BOOST_CHECK(branch == ComputeMerkleBranch(leaves, i));
+        BOOST_CHECK(ComputeMerkleRootFromBranch(leaves[i], branch, nPos) == root);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(simplifiedmns_merkleroots)
+{
+    std::vector<CSimplifiedMNListEntry> entries = CreateEntries(15);
 
     std::vector<std::string> expectedHashes = {
         "373b549f6380d8f7b04d7b04d7c58a749c5cbe3bf41536785ba819879c4870f1",
@@ -69,5 +121,131 @@ BOOST_AUTO_TEST_CASE(simplifiedmns_merkleroots)
     //printf("merkleRoot=\"%s\",\n", calculatedMerkleRoot.c_str());
 
     BOOST_CHECK(expectedMerkleRoot == calculatedMerkleRoot);
+
+    CSimplifiedMNListMerkleTree smlTree(sml);
+    BOOST_CHECK(smlTree.GetRoot().ToString() == expectedMerkleRoot);
+}
+
+BOOST_AUTO_TEST_CASE(simplifiedmns_merkletree)
+{
+    std::vector<CSimplifiedMNListEntry> entries = CreateEntries(15);
+    CSimplifiedMNList sml(entries);
+    CSimplifiedMNListMerkleTree smlTree(sml);
+
+    // every entry has a valid proof
+    for (const auto& e : entries) {
+        std::vector<uint256> branch;
+        uint32_t nPos;
+        BOOST_CHECK(smlTree.GetMerkleProof(e.proRegTxHash, branch, nPos));
+        BOOST_CHECK(ComputeMerkleRootFromBranch(e.CalcHash(), branch, nPos) == smlTree.GetRoot());
+    }
+    std::vector<uint256> branch;
+    uint32_t nPos;
+    BOOST_CHECK(!smlTree.GetMerkleProof(uint256S("ff"), branch, nPos));
+
+    // removing entries gives the same root as a full recalculation
+    CDeterministicMNListDiff diff;
+    diff.removedMns.insert(entries[3].proRegTxHash);
+    diff.removedMns.insert(entries[14].proRegTxHash);
+    smlTree.ApplyDiff(CDeterministicMNList(), diff);
+    entries.erase(entries.begin() + 14);
+    entries.erase(entries.begin() + 3);
+    BOOST_CHECK(smlTree.GetLeafCount() == entries.size());
+    BOOST_CHECK(smlTree.GetRoot() == CSimplifiedMNList(entries).CalcMerkleRoot(nullptr));
+
+    // and an empty list has a null root
+    CDeterministicMNListDiff diffAll;
+    for (const auto& e : entries) {
+        diffAll.removedMns.insert(e.proRegTxHash);
+    }
+    smlTree.ApplyDiff(CDeterministicMNList(), diffAll);
+    BOOST_CHECK(smlTree.GetRoot().IsNull());
+}
+
+BOOST_AUTO_TEST_CASE(simplifiedmns_merkletree_applydiff)
+{
+    std::vector<CSimplifiedMNListEntry> entries = CreateEntries(32);
+
+    CDeterministicMNList mnList;
+    for (size_t i = 3; i < 29; i += 2) {
+        mnList.AddMN(CreateDMN(entries[i]));
+    }
+    CSimplifiedMNListMerkleTree smlTree{CSimplifiedMNList(mnList)};
+    CheckMerkleTree(smlTree, mnList);
+
+    // new entries at the front, in the middle and at the end
+    CDeterministicMNListDiff diffAdd;
+    for (size_t i : {1, 14, 30}) {
+        auto dmn = CreateDMN(entries[i]);
+        mnList.AddMN(dmn);
+        diffAdd.addedMNs.emplace(dmn->proTxHash, dmn);
+    }
+    smlTree.ApplyDiff(mnList, diffAdd);
+    CheckMerkleTree(smlTree, mnList);
+
+    // an added entry which is in the tree already replaces its leaf
+    CDeterministicMNListDiff diffReAdd;
+    {
+        auto dmn = std::make_shared<CDeterministicMN>(*mnList.GetMN(entries[5].proRegTxHash));
+        auto dmnState = std::make_shared<CDeterministicMNState>(*dmn->pdmnState);
+        dmnState->addr = CService(dmnState->addr, 1000);
+        dmn->pdmnState = dmnState;
+        mnList.RemoveMN(dmn->proTxHash);
+        mnList.AddMN(dmn);
+        diffReAdd.addedMNs.emplace(dmn->proTxHash, dmn);
+    }
+    smlTree.ApplyDiff(mnList, diffReAdd);
+    CheckMerkleTree(smlTree, mnList);
+
+    // updates which don't touch the simplified entry keep the root
+    uint256 rootBefore = smlTree.GetRoot();
+    CDeterministicMNListDiff diffPaid;
+    {
+        auto dmnState = CopyState(mnList, entries[11].proRegTxHash);
+        dmnState->nLastPaidHeight = 50;
+        mnList.UpdateMN(entries[11].proRegTxHash, dmnState);
+        diffPaid.updatedMNs.emplace(entries[11].proRegTxHash, dmnState);
+    }
+    smlTree.ApplyDiff(mnList, diffPaid);
+    BOOST_CHECK(smlTree.GetRoot() == rootBefore);
+    CheckMerkleTree(smlTree, mnList);
+
+    // updates which change the hash, including the last (unpaired) leaf
+    CDeterministicMNListDiff diffUpdate;
+    {
+        auto dmnState = CopyState(mnList, entries[7].proRegTxHash);
+        dmnState->nPoSeBanHeight = 100;
+        mnList.UpdateMN(entries[7].proRegTxHash, dmnState);
+        diffUpdate.updatedMNs.emplace(entries[7].proRegTxHash, dmnState);
+    }
+    for (size_t i : {9, 30}) {
+        auto dmnState = CopyState(mnList, entries[i].proRegTxHash);
+        dmnState->addr = CService(dmnState->addr, 2000 + i);
+        mnList.UpdateMN(entries[i].proRegTxHash, dmnState);
+        diffUpdate.updatedMNs.emplace(entries[i].proRegTxHash, dmnState);
+    }
+    smlTree.ApplyDiff(mnList, diffUpdate);
+    BOOST_CHECK(smlTree.GetRoot() != rootBefore);
+    CheckMerkleTree(smlTree, mnList);
+
+    // removals, additions and updates in one diff
+    CDeterministicMNListDiff diffMixed;
+    for (size_t i : {1, 14, 27}) {
+        mnList.RemoveMN(entries[i].proRegTxHash);
+        diffMixed.removedMns.emplace(entries[i].proRegTxHash);
+    }
+    for (size_t i : {2, 29}) {
+        auto dmn = CreateDMN(entries[i]);
+        mnList.AddMN(dmn);
+        diffMixed.addedMNs.emplace(dmn->proTxHash, dmn);
+    }
+    {
+        auto dmnState = CopyState(mnList, entries[13].proRegTxHash);
+        dmnState->confirmedHash = uint256S("1234");
+        mnList.UpdateMN(entries[13].proRegTxHash, dmnState);
+        diffMixed.updatedMNs.emplace(entries[13].proRegTxHash, dmnState);
+    }
+    smlTree.ApplyDiff(mnList, diffMixed);
+    CheckMerkleTree(smlTree, mnList);
 }
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,137 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "expiringmap.h"
+#include "random.h"
+#include "streams.h"
+#include "version.h"
+
+#include "test/test_zeroone.h"
+
+#include <limits>
+#include <map>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(expiringmap_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(expiringmap_insert_expire)
+{
+    CExpiringMap<int, int> map;
+
+    BOOST_CHECK(map.Insert(1, 10, 100));
+    BOOST_CHECK(map.Insert(2, 20, 200));
+    BOOST_CHECK(!map.Insert(2, 21, 300));
+    BOOST_CHECK(map.Insert(3, 30, 5000000));
+    BOOST_CHECK_EQUAL(map.Size(), 3);
+    BOOST_CHECK_EQUAL(*map.Find(2), 20);
+    BOOST_CHECK(map.Find(4) == nullptr);
+
+    // nothing expires while the deadline is not in the past
+    BOOST_CHECK_EQUAL(map.Expire(100), 0);
+    BOOST_CHECK(map.Has(1));
+    BOOST_CHECK_EQUAL(map.Expire(101), 1);
+    BOOST_CHECK(!map.Has(1));
+
+    // jump far ahead, crossing several wheel levels at once
+    BOOST_CHECK_EQUAL(map.Expire(4999999), 1);
+    BOOST_CHECK(!map.Has(2));
+    BOOST_CHECK(map.Has(3));
+    BOOST_CHECK_EQUAL(map.Expire(5000001), 1);
+    BOOST_CHECK(map.Empty());
+
+    // deadlines before the current tick expire on the next call
+    BOOST_CHECK(map.Insert(4, 40, 7));
+    map.Erase(5);
+    BOOST_CHECK_EQUAL(map.Expire(1), 0);
+    BOOST_CHECK_EQUAL(map.Expire(5000001), 1);
+}
+
+BOOST_AUTO_TEST_CASE(expiringmap_matches_scan)
+{
+    // compare against a plain full scan over many random deadlines and steps
+    CExpiringMap<int, int> map;
+    std::map<int, int64_t> mapDeadlines;
+    FastRandomContext ctx(true);
+    int64_t nNow = 1000;
+    int nKey = 0;
+
+    for (int i = 0; i < 2000; i++) {
+        for (int j = ctx.rand32(8); j > 0; j--) {
+            int64_t nDeadline = nNow + ctx.rand32(i % 10 == 0 ? 1000000 : 500);
+            map.Insert(nKey, nKey, nDeadline);
+            mapDeadlines.emplace(nKey, nDeadline);
+            nKey++;
+        }
+        if (!mapDeadlines.empty() && ctx.rand32(4) == 0) {
+            auto it = mapDeadlines.begin();
+            map.Erase(it->first);
+            mapDeadlines.erase(it);
+        }
+        nNow += ctx.rand32(i % 100 == 0 ? 100000 : 100);
+
+        size_t nExpected = 0;
+        for (auto it = mapDeadlines.begin(); it != mapDeadlines.end(); ) {
+            if (it->second < nNow) {
+                mapDeadlines.erase(it++);
+                nExpected++;
+            } else {
+                ++it;
+            }
+        }
+        BOOST_CHECK_EQUAL(map.Expire(nNow), nExpected);
+        BOOST_CHECK_EQUAL(map.Size(), mapDeadlines.size());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(expiringmap_rearm)
+{
+    CExpiringMap<int, int> map;
+    map.Insert(1, 10, 50);
+    map.Insert(2, 20, 50);
+
+    // keep key 1 alive for another 100 ticks
+    size_t nRemoved = map.Expire(60, [](const int& key, int& value, int64_t& nDeadline) {
+        if (key == 1) {
+            value++;
+            nDeadline = 159;
+        }
+    });
+    BOOST_CHECK_EQUAL(nRemoved, 1);
+    BOOST_CHECK_EQUAL(*map.Find(1), 11);
+    int64_t nDeadline;
+    BOOST_CHECK(map.GetDeadline(1, nDeadline));
+    BOOST_CHECK_EQUAL(nDeadline, 159);
+
+    BOOST_CHECK(map.SetDeadline(1, 200));
+    BOOST_CHECK_EQUAL(map.Expire(200), 0);
+    BOOST_CHECK_EQUAL(map.Expire(201), 1);
+}
+
+BOOST_AUTO_TEST_CASE(expiringmap_serialization)
+{
+    CExpiringSet<uint256> set;
+    uint256 hash1 = uint256S("01");
+    uint256 hash2 = uint256S("02");
+    set.Insert(hash1, 100);
+    set.Insert(hash2, std::numeric_limits<int64_t>::max());
+
+    // a set serializes exactly like a map of deadlines
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << set;
+    std::map<uint256, int64_t> mapDeadlines;
+    CDataStream ss2(ss);
+    ss2 >> mapDeadlines;
+    BOOST_CHECK_EQUAL(mapDeadlines.size(), 2);
+    BOOST_CHECK_EQUAL(mapDeadlines[hash1], 100);
+
+    CExpiringSet<uint256> set2;
+    ss >> set2;
+    BOOST_CHECK_EQUAL(set2.Size(), 2);
+    BOOST_CHECK(set2.DynamicMemoryUsage() > 0);
+    BOOST_CHECK_EQUAL(set2.Expire(std::numeric_limits<int64_t>::max()), 1);
+    BOOST_CHECK(set2.Has(hash2));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,75 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "iblt.h"
+
+#include "clientversion.h"
+#include "streams.h"
+#include "test/test_random.h"
+#include "test/test_zeroone.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(iblt_tests, BasicTestingSetup)
+
+static uint64_t InsecureRand64()
+{
+    return ((uint64_t)insecure_rand() << 32) | insecure_rand();
+}
+
+BOOST_AUTO_TEST_CASE(iblt_reconcile)
+{
+    CIBLT sketch(100);
+    BOOST_CHECK_EQUAL(sketch.GetCellCount(), 102U);
+    BOOST_CHECK(sketch.IsValid(102));
+    BOOST_CHECK(!sketch.IsValid(99));
+
+    // keys on both sides cancel out no matter how many there are
+    for (int i = 0; i < 10000; i++) {
+        uint64_t nKey = InsecureRand64();
+        sketch.Insert(nKey);
+        sketch.Erase(nKey);
+    }
+
+    std::set<uint64_t> setInserted;
+    std::set<uint64_t> setErased;
+    for (int i = 0; i < 20; i++) {
+        uint64_t nKey = InsecureRand64();
+        sketch.Insert(nKey);
+        setInserted.insert(nKey);
+        nKey = InsecureRand64();
+        sketch.Erase(nKey);
+        setErased.insert(nKey);
+    }
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << sketch;
+    BOOST_CHECK_EQUAL(ss.size(), 1 + sketch.GetCellCount() * CIBLT::CELL_SIZE);
+    CIBLT sketch2;
+    ss >> sketch2;
+
+    std::set<uint64_t> setInsertedRet;
+    std::set<uint64_t> setErasedRet;
+    BOOST_CHECK(sketch2.Decode(setInsertedRet, setErasedRet));
+    BOOST_CHECK(setInsertedRet == setInserted);
+    BOOST_CHECK(setErasedRet == setErased);
+}
+
+BOOST_AUTO_TEST_CASE(iblt_overflow)
+{
+    // far more differences than cells can't be decoded, but must be detected
+    CIBLT sketch(30);
+    for (int i = 0; i < 100; i++) {
+        sketch.Insert(InsecureRand64());
+    }
+    std::set<uint64_t> setInsertedRet;
+    std::set<uint64_t> setErasedRet;
+    BOOST_CHECK(!sketch.Decode(setInsertedRet, setErasedRet));
+
+    // empty tables decode to nothing
+    BOOST_CHECK(CIBLT().Decode(setInsertedRet, setErasedRet));
+    BOOST_CHECK(setInsertedRet.empty() && setErasedRet.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
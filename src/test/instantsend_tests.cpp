@@ -0,0 +1,221 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "activemasternode.h"
+#include "chainparams.h"
+#include "instantx.h"
+#include "masternode-sync.h"
+#include "masternodeman.h"
+#include "net.h"
+#include "netbase.h"
+#include "random.h"
+#include "streams.h"
+#include "validation.h"
+
+#include "test/test_zeroone.h"
+
+#include <boost/test/unit_test.hpp>
+
+/**
+ * Regtest chain with SIGNATURES_TOTAL legacy masternode keys, all but the last one known to mnodeman,
+ * and masternodeSync past the masternode list, so that votes go through CInstantSend::ProcessMessage()
+ */
+struct InstantSendVotesSetup : public TestChain100Setup
+{
+    std::vector<CKey> vecKeys;
+    std::vector<COutPoint> vecOutpoints;
+    CNode node;
+
+    InstantSendVotesSetup() : node(0, NODE_NETWORK, 0, INVALID_SOCKET, CAddress(CService(), NODE_NETWORK), 0, 0, "", true)
+    {
+        node.nVersion = PROTOCOL_VERSION;
+        for (int i = 0; i < COutPointLock::SIGNATURES_TOTAL; i++) {
+            CKey key;
+            key.MakeNewKey(true);
+            vecKeys.push_back(key);
+            vecOutpoints.emplace_back(GetRandHash(), 0);
+        }
+        for (size_t i = 0; i < vecKeys.size() - 1; i++) {
+            AddMasternode(i);
+        }
+
+        masternodeSync.Reset();
+        while (!masternodeSync.IsMasternodeListSynced()) {
+            masternodeSync.SwitchToNextAsset(*connman);
+        }
+    }
+
+    ~InstantSendVotesSetup()
+    {
+        instantsend.Clear();
+        masternodeSync.Reset();
+        mnodeman.Clear();
+    }
+
+    void AddMasternode(size_t i)
+    {
+        CService addr = LookupNumeric(strprintf("10.0.0.%d", i + 1).c_str(), Params().GetDefaultPort());
+        CMasternode mn(addr, vecOutpoints[i], vecKeys[i].GetPubKey(), vecKeys[i].GetPubKey(), PROTOCOL_VERSION);
+        BOOST_CHECK(mnodeman.Add(mn));
+    }
+
+    // spends a coin which is confirmed just enough to be locked
+    CTxLockRequest CreateTxLockRequest()
+    {
+        COutPoint outpoint(GetRandHash(), 0);
+        {
+            LOCK(cs_main);
+            int nHeight = chainActive.Height() - Params().GetConsensus().nInstantSendConfirmationsRequired + 1;
+            pcoinsTip->AddCoin(outpoint, Coin(CTxOut(COIN, CScript() << OP_TRUE), nHeight, false), false);
+        }
+        CMutableTransaction mtx;
+        mtx.vin.emplace_back(outpoint);
+        mtx.vout.emplace_back(COIN - COIN / 100, CScript() << OP_TRUE);
+        return CTxLockRequest(mtx);
+    }
+
+    CTxLockVote CreateVote(const CTxLockRequest& txLockRequest, const COutPoint& outpointMasternode, const CKey& key)
+    {
+        CTxLockVote vote(txLockRequest.GetHash(), txLockRequest.tx->vin[0].prevout, outpointMasternode, uint256(), uint256());
+        activeMasternodeInfo.legacyKeyOperator = key;
+        activeMasternodeInfo.legacyKeyIDOperator = key.GetPubKey().GetID();
+        BOOST_CHECK(vote.Sign());
+        activeMasternodeInfo.legacyKeyOperator = CKey();
+        activeMasternodeInfo.legacyKeyIDOperator = CKeyID();
+        return vote;
+    }
+
+    void ProcessVote(const CTxLockVote& vote)
+    {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << vote;
+        instantsend.ProcessMessage(&node, NetMsgType::TXLOCKVOTE, ss, *connman);
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(instantsend_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(lockindex_tx_locked)
+{
+    CInstantSendLockIndex lockIndex;
+    uint256 txHash = uint256S("aa");
+    uint256 txHashConflicting = uint256S("bb");
+    std::vector<COutPoint> vecOutpoints;
+    for (uint32_t i = 0; i < 20; i++) {
+        vecOutpoints.emplace_back(uint256S("01"), i);
+    }
+
+    BOOST_CHECK(!lockIndex.IsTxLocked(txHash));
+
+    // empty candidates are never locked
+    lockIndex.SetCandidateOutpoints(txHash, std::vector<COutPoint>());
+    BOOST_CHECK(!lockIndex.IsTxLocked(txHash));
+
+    lockIndex.SetCandidateOutpoints(txHash, vecOutpoints);
+    for (size_t i = 0; i < vecOutpoints.size() - 1; i++) {
+        BOOST_CHECK(lockIndex.LockOutpoint(vecOutpoints[i], txHash));
+    }
+    BOOST_CHECK(!lockIndex.IsTxLocked(txHash));
+
+    // the last outpoint is locked by another tx already
+    BOOST_CHECK(lockIndex.LockOutpoint(vecOutpoints.back(), txHashConflicting));
+    BOOST_CHECK(!lockIndex.LockOutpoint(vecOutpoints.back(), txHash));
+    BOOST_CHECK(!lockIndex.IsTxLocked(txHash));
+    uint256 hashLocked;
+    BOOST_CHECK(lockIndex.GetLockedOutpointTxHash(vecOutpoints.back(), hashLocked));
+    BOOST_CHECK(hashLocked == txHashConflicting);
+
+    lockIndex.UnlockOutpoint(vecOutpoints.back());
+    BOOST_CHECK(lockIndex.LockOutpoint(vecOutpoints.back(), txHash));
+    BOOST_CHECK(lockIndex.IsTxLocked(txHash));
+    BOOST_CHECK_EQUAL(lockIndex.GetLockedOutpoints().size(), vecOutpoints.size());
+
+    lockIndex.RemoveCandidate(txHash);
+    BOOST_CHECK(!lockIndex.IsTxLocked(txHash));
+
+    lockIndex.Clear();
+    BOOST_CHECK(lockIndex.GetLockedOutpoints().empty());
+}
+
+BOOST_AUTO_TEST_CASE(lockindex_votes)
+{
+    CInstantSendLockIndex lockIndex;
+    uint256 txHash = uint256S("aa");
+    int nVotes;
+
+    // votes are only tracked for known candidates
+    lockIndex.SetCandidateVotes(txHash, 3);
+    BOOST_CHECK(!lockIndex.GetCandidateVotes(txHash, nVotes));
+
+    lockIndex.SetCandidateOutpoints(txHash, std::vector<COutPoint>());
+    BOOST_CHECK(lockIndex.GetCandidateVotes(txHash, nVotes));
+    BOOST_CHECK_EQUAL(nVotes, 0);
+    lockIndex.SetCandidateVotes(txHash, 3);
+    // updating the outpoints keeps the vote count
+    lockIndex.SetCandidateOutpoints(txHash, std::vector<COutPoint>(1, COutPoint(uint256S("01"), 0)));
+    BOOST_CHECK(lockIndex.GetCandidateVotes(txHash, nVotes));
+    BOOST_CHECK_EQUAL(nVotes, 3);
+}
+
+BOOST_FIXTURE_TEST_CASE(missing_masternode_votes_limit, InstantSendVotesSetup)
+{
+    CTxLockRequest txLockRequest = CreateTxLockRequest();
+
+    // votes of unknown masternodes aren't checked before their masternode is known, so they don't need to be signed
+    for (size_t i = 0; i < CInstantSend::MAX_MISSING_MASTERNODE_VOTES + 10; i++) {
+        ProcessVote(CTxLockVote(txLockRequest.GetHash(), txLockRequest.tx->vin[0].prevout, COutPoint(GetRandHash(), 0), uint256(), uint256()));
+    }
+    BOOST_CHECK_EQUAL(instantsend.GetMissingMasternodeVoteCount(), CInstantSend::MAX_MISSING_MASTERNODE_VOTES);
+    BOOST_CHECK_EQUAL(instantsend.GetOrphanTxLockVoteCount(txLockRequest.GetHash()), 0);
+
+    instantsend.Clear();
+    BOOST_CHECK_EQUAL(instantsend.GetMissingMasternodeVoteCount(), 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(missing_masternode_votes_reprocessed, InstantSendVotesSetup)
+{
+    CTxLockRequest txLockRequest = CreateTxLockRequest();
+    uint256 txHash = txLockRequest.GetHash();
+    CKey keyStillUnknown;
+    keyStillUnknown.MakeNewKey(true);
+    COutPoint outpointStillUnknown(GetRandHash(), 0);
+
+    ProcessVote(CreateVote(txLockRequest, vecOutpoints.back(), vecKeys.back()));
+    ProcessVote(CreateVote(txLockRequest, outpointStillUnknown, keyStillUnknown));
+    BOOST_CHECK_EQUAL(instantsend.GetMissingMasternodeVoteCount(), 2);
+
+    // nothing changes until the masternode is known
+    instantsend.CheckMasternodeOrphanVotes(*connman);
+    BOOST_CHECK_EQUAL(instantsend.GetMissingMasternodeVoteCount(), 2);
+    BOOST_CHECK_EQUAL(instantsend.GetOrphanTxLockVoteCount(txHash), 0);
+
+    // the vote is valid now, it waits for the lock request like any other vote
+    AddMasternode(vecKeys.size() - 1);
+    instantsend.CheckMasternodeOrphanVotes(*connman);
+    BOOST_CHECK_EQUAL(instantsend.GetMissingMasternodeVoteCount(), 1);
+    BOOST_CHECK_EQUAL(instantsend.GetOrphanTxLockVoteCount(txHash), 1);
+}
+
+BOOST_FIXTURE_TEST_CASE(orphan_votes_processed_with_lock_request, InstantSendVotesSetup)
+{
+    CTxLockRequest txLockRequest = CreateTxLockRequest();
+    CTxLockRequest txLockRequestOther = CreateTxLockRequest();
+    uint256 txHash = txLockRequest.GetHash();
+
+    for (size_t i = 0; i < 3; i++) {
+        ProcessVote(CreateVote(txLockRequest, vecOutpoints[i], vecKeys[i]));
+    }
+    ProcessVote(CreateVote(txLockRequestOther, vecOutpoints[3], vecKeys[3]));
+    BOOST_CHECK_EQUAL(instantsend.GetOrphanTxLockVoteCount(txHash), 3);
+    BOOST_CHECK_EQUAL(instantsend.GetOrphanTxLockVoteCount(txLockRequestOther.GetHash()), 1);
+    BOOST_CHECK_EQUAL(instantsend.GetTransactionLockSignatures(txHash), 0);
+
+    // all orphan votes of this transaction are counted and removed, the ones of other transactions stay
+    BOOST_CHECK(instantsend.ProcessTxLockRequest(txLockRequest, *connman));
+    BOOST_CHECK_EQUAL(instantsend.GetOrphanTxLockVoteCount(txHash), 0);
+    BOOST_CHECK_EQUAL(instantsend.GetOrphanTxLockVoteCount(txLockRequestOther.GetHash()), 1);
+    BOOST_CHECK_EQUAL(instantsend.GetTransactionLockSignatures(txHash), 3);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,134 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "masternode-payments.h"
+#include "spentindex.h"
+#include "streams.h"
+
+#include "test/test_zeroone.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(masternode_payments_tests, BasicTestingSetup)
+
+static CScript PayeeScript(unsigned char n)
+{
+    return CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, n) << OP_EQUALVERIFY << OP_CHECKSIG;
+}
+
+BOOST_AUTO_TEST_CASE(payeeindex_heights)
+{
+    CMasternodePayeeIndex index;
+    CScript payeeA = PayeeScript(1);
+    CScript payeeB = PayeeScript(2);
+
+    for (int nHeight = 10; nHeight < 20; nHeight++) {
+        index.BlockConnected(nHeight, {nHeight % 2 ? payeeA : payeeB}, 100);
+    }
+    BOOST_CHECK_EQUAL(index.size(), 10U);
+
+    std::vector<int> vHeights = index.GetPaidHeights(payeeA, 0, 100);
+    BOOST_CHECK(vHeights == std::vector<int>({19, 17, 15, 13, 11}));
+    vHeights = index.GetPaidHeights(payeeB, 12, 17);
+    BOOST_CHECK(vHeights == std::vector<int>({16, 14, 12}));
+    BOOST_CHECK(index.GetPaidHeights(PayeeScript(3), 0, 100).empty());
+
+    // disconnecting the tip removes its entry only
+    index.BlockDisconnected(19);
+    vHeights = index.GetPaidHeights(payeeA, 0, 100);
+    BOOST_CHECK(vHeights == std::vector<int>({17, 15, 13, 11}));
+
+    // a replacement block at the same height
+    index.BlockConnected(19, {payeeB}, 100);
+    BOOST_CHECK_EQUAL(index.GetPaidHeights(payeeB, 19, 19).size(), 1U);
+    BOOST_CHECK(index.GetPaidHeights(payeeA, 19, 19).empty());
+
+    // a gap drops the window, it gets reloaded on the next LoadWindow
+    index.BlockConnected(25, {payeeA}, 100);
+    BOOST_CHECK_EQUAL(index.size(), 0U);
+    index.BlockConnected(30, {payeeA}, 100);
+    index.BlockDisconnected(29);
+    BOOST_CHECK_EQUAL(index.size(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(payeeindex_window_trim)
+{
+    CMasternodePayeeIndex index;
+    CScript payeeA = PayeeScript(1);
+    CScript payeeB = PayeeScript(2);
+
+    // the window stays bounded even if it's never reloaded
+    for (int nHeight = 1; nHeight <= 50; nHeight++) {
+        index.BlockConnected(nHeight, {nHeight == 5 ? payeeB : payeeA}, 10);
+        BOOST_CHECK_EQUAL(index.size(), (size_t)std::min(nHeight, 10));
+    }
+    std::vector<int> vHeights = index.GetPaidHeights(payeeA, 0, 100);
+    BOOST_CHECK_EQUAL(vHeights.size(), 10U);
+    BOOST_CHECK_EQUAL(vHeights.back(), 41);
+    // payees which only had entries behind the window are gone completely
+    BOOST_CHECK(index.GetPaidHeights(payeeB, 0, 100).empty());
+
+    // a smaller limit trims the window on the next block
+    index.BlockConnected(51, {payeeB}, 3);
+    BOOST_CHECK_EQUAL(index.size(), 3U);
+    BOOST_CHECK(index.GetPaidHeights(payeeA, 0, 100) == std::vector<int>({50, 49}));
+}
+
+BOOST_AUTO_TEST_CASE(payeeindex_value_serialization)
+{
+    CPayeeIndexValue value(uint256S("0x01"), {PayeeScript(1), CScript(), PayeeScript(2)});
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << value;
+    CPayeeIndexValue value2;
+    ss >> value2;
+
+    BOOST_CHECK(value2.blockHash == value.blockHash);
+    BOOST_CHECK(value2.vPayees == value.vPayees);
+}
+
+static CMasternodePaymentVote PaymentVote(unsigned char nVoter, int nHeight, const CScript& payee)
+{
+    return CMasternodePaymentVote(COutPoint(uint256S(strprintf("%02x", nVoter)), 0), nHeight, payee);
+}
+
+BOOST_AUTO_TEST_CASE(blockpayees_tally)
+{
+    CMasternodeBlockPayees blockPayees(100);
+    CScript payeeA = PayeeScript(1);
+    CScript payeeB = PayeeScript(2);
+    CScript payee;
+
+    BOOST_CHECK(!blockPayees.GetBestPayee(payee));
+
+    blockPayees.AddPayee(PaymentVote(1, 100, payeeB));
+    blockPayees.AddPayee(PaymentVote(2, 100, payeeA));
+    blockPayees.AddPayee(PaymentVote(3, 100, payeeA));
+    BOOST_CHECK(blockPayees.GetBestPayee(payee));
+    BOOST_CHECK(payee == payeeA);
+    BOOST_CHECK(blockPayees.HasPayeeWithVotes(payeeA, 2));
+    BOOST_CHECK(!blockPayees.HasPayeeWithVotes(payeeB, 2));
+    BOOST_CHECK(!blockPayees.HasPayeeWithVotes(PayeeScript(3), 1));
+
+    // on a tie the payee which was voted for first wins, as with a linear scan
+    blockPayees.AddPayee(PaymentVote(4, 100, payeeB));
+    BOOST_CHECK(blockPayees.GetBestPayee(payee));
+    BOOST_CHECK(payee == payeeB);
+    BOOST_CHECK_EQUAL(blockPayees.vecPayees.size(), 2U);
+
+    BOOST_CHECK(blockPayees.GetVotedPayee(PaymentVote(2, 100, payeeA).masternodeOutpoint, payee));
+    BOOST_CHECK(payee == payeeA);
+    BOOST_CHECK(!blockPayees.GetVotedPayee(PaymentVote(5, 100, payeeA).masternodeOutpoint, payee));
+
+    // the tally is rebuilt after a serialization roundtrip
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << blockPayees;
+    CMasternodeBlockPayees blockPayees2;
+    ss >> blockPayees2;
+    BOOST_CHECK(blockPayees2.GetBestPayee(payee));
+    BOOST_CHECK(payee == payeeB);
+    BOOST_CHECK(blockPayees2.HasPayeeWithVotes(payeeA, 2));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -4,6 +4,7 @@
 
 #include "rpc/server.h"
 #include "rpc/client.h"
+#include "rpc/jsonstream.h"
 
 #include "base58.h"
 #include "netbase.h"
@@ -350,4 +351,77 @@ BOOST_AUTO_TEST_CASE(rpc_sentinel_ping)
     BOOST_CHECK_THROW(CallRPC("sentinelping 2"), std::bad_cast);
 }
 
+BOOST_AUTO_TEST_CASE(rpc_json_stream_writer)
+{
+    UniValue nested(UniValue::VOBJ);
+    nested.push_back(Pair("a", 1));
+    nested.push_back(Pair("b\"\n", UniValue(UniValue::VARR)));
+
+    UniValue expected(UniValue::VOBJ);
+    UniValue arr(UniValue::VARR);
+    arr.push_back("x");
+    arr.push_back(nested);
+    arr.push_back(UniValue(UniValue::VOBJ));
+    expected.push_back(Pair("arr", arr));
+    expected.push_back(Pair("null", NullUniValue));
+    expected.push_back(Pair("num", 1.5));
+
+    // a tiny flush size forces a flush after every value
+    std::string strOut;
+    int nFlushes = 0;
+    CJSONStreamWriter writer([&](const std::string& strChunk) { strOut += strChunk; nFlushes++; }, 1);
+    BOOST_CHECK(writer.ExpectsValue());
+    writer.BeginObject();
+    writer.Key("arr");
+    BOOST_CHECK(writer.ExpectsValue());
+    writer.BeginArray();
+    writer.Value("x");
+    writer.Value(nested);
+    writer.BeginObject();
+    writer.EndObject();
+    writer.EndArray();
+    BOOST_CHECK(!writer.ExpectsValue());
+    writer.Pair("null", NullUniValue);
+    writer.Pair("num", 1.5);
+    BOOST_CHECK(!writer.IsComplete());
+    writer.EndObject();
+    BOOST_CHECK(writer.IsComplete());
+    BOOST_CHECK(writer.HasFlushed());
+    BOOST_CHECK(writer.TakeBuffer().empty());
+
+    BOOST_CHECK_EQUAL(strOut, expected.write());
+    BOOST_CHECK(nFlushes > 1);
+
+    // misuse
+    BOOST_CHECK_THROW(writer.Value(1), std::runtime_error);
+    CJSONStreamWriter writer2([](const std::string&) {});
+    BOOST_CHECK_THROW(writer2.Key("k"), std::runtime_error);
+    writer2.BeginObject();
+    BOOST_CHECK_THROW(writer2.Value(1), std::runtime_error);
+    BOOST_CHECK_THROW(writer2.EndArray(), std::runtime_error);
+    writer2.Key("k");
+    BOOST_CHECK_THROW(writer2.EndObject(), std::runtime_error);
+    writer2.Value(1);
+    writer2.EndObject();
+    BOOST_CHECK_EQUAL(writer2.TakeBuffer(), "{\"k\":1}");
+    BOOST_CHECK(!writer2.HasFlushed());
+}
+
+BOOST_AUTO_TEST_CASE(rpc_exec_batch_stream)
+{
+    UniValue batch(UniValue::VARR);
+    UniValue req(UniValue::VOBJ);
+    req.push_back(Pair("method", "nonexistingmethod"));
+    req.push_back(Pair("params", UniValue(UniValue::VARR)));
+    req.push_back(Pair("id", 1));
+    batch.push_back(req);
+    batch.push_back(req);
+
+    UniValue reply;
+    BOOST_CHECK(reply.read(JSONRPCExecBatch(batch)));
+    BOOST_CHECK(reply.isArray());
+    BOOST_CHECK_EQUAL(reply.size(), 2U);
+    BOOST_CHECK_EQUAL(find_value(find_value(reply[1], "error"), "code").get_int(), RPC_METHOD_NOT_FOUND);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
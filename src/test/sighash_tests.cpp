@@ -161,6 +161,11 @@ BOOST_AUTO_TEST_CASE(sighash_test)
         std::cout << "\n";
         #endif
         BOOST_CHECK(sh == sho);
+
+        // the precomputed data must not change the result for any hash type
+        const CTransaction tx(txTo);
+        const PrecomputedTransactionData txdata(tx);
+        BOOST_CHECK(SignatureHash(scriptCode, tx, nIn, nHashType, &txdata) == sho);
     }
     #if defined(PRINT_SIGHASH_JSON)
     std::cout << "]\n";
@@ -213,6 +218,9 @@ BOOST_AUTO_TEST_CASE(sighash_from_data)
 
         sh = SignatureHash(scriptCode, *tx, nIn, nHashType);
         BOOST_CHECK_MESSAGE(sh.GetHex() == sigHashHex, strTest);
+
+        const PrecomputedTransactionData txdata(*tx);
+        BOOST_CHECK_MESSAGE(SignatureHash(scriptCode, *tx, nIn, nHashType, &txdata) == sh, strTest);
     }
 }
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,140 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "sync.h"
+
+#include "test/test_zeroone.h"
+#include "utiltime.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(sync_tests, BasicTestingSetup)
+
+static uint64_t CountAcquired(const std::string& strName, uint64_t* pnContended = nullptr, uint64_t* pnHoldBuckets = nullptr)
+{
+    uint64_t nAcquired = 0;
+    ForEachLockSite([&](const CLockSite& site) {
+        if (strName != site.pszName) return;
+        nAcquired += site.nAcquired;
+        if (pnContended) *pnContended += site.nContended;
+        if (pnHoldBuckets) {
+            for (int i = 0; i < LOCK_PROFILE_BUCKETS; i++) {
+                *pnHoldBuckets += site.vHoldBuckets[i];
+            }
+        }
+    });
+    return nAcquired;
+}
+
+BOOST_AUTO_TEST_CASE(lock_profiling)
+{
+    CCriticalSection cs_profiled;
+    CCriticalSection cs_profiled2;
+    bool fWasEnabled = fLockProfiling;
+
+    fLockProfiling = false;
+    {
+        LOCK(cs_profiled);
+    }
+    BOOST_CHECK_EQUAL(CountAcquired("cs_profiled"), 0);
+
+    fLockProfiling = true;
+    for (int i = 0; i < 3; i++) {
+        LOCK(cs_profiled);
+    }
+    {
+        LOCK2(cs_profiled, cs_profiled2);
+        TRY_LOCK(cs_profiled2, lockProfiled2);
+        BOOST_CHECK(bool(lockProfiled2));
+    }
+    uint64_t nHoldBuckets = 0;
+    BOOST_CHECK_EQUAL(CountAcquired("cs_profiled", nullptr, &nHoldBuckets), 4);
+    BOOST_CHECK_EQUAL(nHoldBuckets, 4);
+    BOOST_CHECK_EQUAL(CountAcquired("cs_profiled2"), 2);
+
+    // a thread waiting for the lock counts as contended, it may take a few tries until the thread
+    // is waiting already when the lock is released
+    uint64_t nContended = 0;
+    int nTries = 0;
+    while (nContended == 0) {
+        BOOST_REQUIRE(nTries < 1000);
+        nTries++;
+        std::thread thread;
+        {
+            LOCK(cs_profiled2);
+            std::atomic<bool> fStarted(false);
+            thread = std::thread([&] {
+                fStarted = true;
+                LOCK(cs_profiled2);
+            });
+            while (!fStarted) {
+                std::this_thread::yield();
+            }
+            MilliSleep(1);
+        }
+        thread.join();
+        CountAcquired("cs_profiled2", &nContended);
+    }
+    BOOST_CHECK_EQUAL(CountAcquired("cs_profiled2"), 2 + 2 * nTries);
+    BOOST_CHECK_EQUAL(nContended, 1);
+
+    ResetLockSites();
+    BOOST_CHECK_EQUAL(CountAcquired("cs_profiled"), 0);
+    BOOST_CHECK_EQUAL(CountAcquired("cs_profiled2"), 0);
+
+    fLockProfiling = fWasEnabled;
+}
+
+struct CLockOwnerA
+{
+    CCriticalSection cs;
+    void Lock() { LOCK(cs); }
+};
+
+struct CLockOwnerB
+{
+    CCriticalSection cs;
+    void Lock() { LOCK(cs); }
+};
+
+BOOST_AUTO_TEST_CASE(lock_profiling_groups)
+{
+    // static, so that no other lock site can have seen the same addresses
+    static CLockOwnerA ownerA;
+    static CLockOwnerB ownerB;
+    bool fWasEnabled = fLockProfiling;
+
+    fLockProfiling = true;
+    ownerA.Lock();
+    ownerB.Lock();
+    CLockOwnerA* powner = &ownerA;
+    {
+        LOCK(powner->cs);
+    }
+
+    std::string strNameA;
+    std::string strNameB;
+    uint64_t nAcquiredA = 0;
+    for (const auto& lock : GetLockSitesByLock()) {
+        for (const CLockSite* psite : lock.second) {
+            if (psite->pmutex == (const void*)&ownerA.cs) {
+                strNameA = lock.first;
+                nAcquiredA += psite->nAcquired;
+            }
+            if (psite->pmutex == (const void*)&ownerB.cs) strNameB = lock.first;
+        }
+    }
+    // the bare "cs" of ownerA is the same lock as "powner->cs", the one of ownerB is a different one
+    BOOST_CHECK_EQUAL(strNameA, "powner->cs");
+    BOOST_CHECK_EQUAL(nAcquiredA, 2);
+    BOOST_CHECK(strNameB == "cs" || strNameB.compare(0, 4, "cs (") == 0);
+
+    fLockProfiling = fWasEnabled;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,69 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "tracing.h"
+
+#include "test/test_zeroone.h"
+#include "tinyformat.h"
+
+#include <string.h>
+#include <thread>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(tracing_tests, BasicTestingSetup)
+
+static const CTraceThread* FindThread(const std::vector<CTraceThread>& vThreads, const char* pszName)
+{
+    for (const auto& thread : vThreads) {
+        for (const auto& event : thread.vEvents) {
+            if (strcmp(event.pszName, pszName) == 0) return &thread;
+        }
+    }
+    return nullptr;
+}
+
+BOOST_AUTO_TEST_CASE(tracing_flight_recorder)
+{
+    {
+        TRACE_SPAN("tracing_disabled");
+    }
+    BOOST_CHECK(!FindThread(tracer.GetThreads(), "tracing_disabled"));
+
+    // buffers get the size which was set when their thread recorded its first span
+    tracer.Init(4);
+    std::thread thread([] {
+        TRACE_SPAN("tracing_outer");
+        for (int i = 0; i < 5; i++) {
+            TRACE_SPAN_ARG("tracing_span", strprintf("%d", i));
+        }
+        TRACE_SPAN_ARG("tracing_long", std::string(40, 'x'));
+    });
+    thread.join();
+    tracer.Init(0);
+
+    std::vector<CTraceThread> vThreads = tracer.GetThreads();
+    const CTraceThread* pthread = FindThread(vThreads, "tracing_span");
+    BOOST_REQUIRE(pthread);
+    BOOST_CHECK_EQUAL(pthread->nTotal, 7);
+    // oldest first, spans are recorded when they end
+    BOOST_REQUIRE_EQUAL(pthread->vEvents.size(), 4);
+    BOOST_CHECK_EQUAL(pthread->vEvents[0].pszName, "tracing_span");
+    BOOST_CHECK_EQUAL(pthread->vEvents[0].szArg, "3");
+    BOOST_CHECK_EQUAL(pthread->vEvents[1].szArg, "4");
+    BOOST_CHECK_EQUAL(pthread->vEvents[2].pszName, "tracing_long");
+    BOOST_CHECK_EQUAL(std::string(pthread->vEvents[2].szArg), std::string(TRACE_ARG_SIZE, 'x'));
+    BOOST_CHECK_EQUAL(pthread->vEvents[3].pszName, "tracing_outer");
+    BOOST_CHECK_EQUAL(pthread->vEvents[3].szArg, "");
+    for (const auto& event : pthread->vEvents) {
+        BOOST_CHECK(event.nDuration >= 0);
+        BOOST_CHECK(event.nStart >= pthread->vEvents[3].nStart);
+        BOOST_CHECK(event.nStart + event.nDuration <= pthread->vEvents[3].nStart + pthread->vEvents[3].nDuration);
+    }
+
+    tracer.Clear();
+    BOOST_CHECK(!FindThread(tracer.GetThreads(), "tracing_span"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
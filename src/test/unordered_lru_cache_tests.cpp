@@ -0,0 +1,58 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "unordered_lru_cache.h"
+
+#include "test/test_zeroone.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(unordered_lru_cache_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(unordered_lru_cache_test)
+{
+    // create a cache limited to 3 items
+    unordered_lru_cache<int, int> cache(3);
+    BOOST_CHECK(cache.max_size() == 3);
+    BOOST_CHECK(cache.size() == 0);
+
+    cache.insert(1, 10);
+    cache.insert(2, 20);
+    cache.insert(3, 30);
+    BOOST_CHECK(cache.size() == 3);
+
+    // looking up 1 makes 2 the least recently used item
+    int val = 0;
+    BOOST_CHECK(cache.get(1, val));
+    BOOST_CHECK(val == 10);
+
+    cache.insert(4, 40);
+    BOOST_CHECK(cache.size() == 3);
+    BOOST_CHECK(!cache.exists(2));
+    BOOST_CHECK(!cache.get(2, val));
+    BOOST_CHECK(cache.exists(1));
+    BOOST_CHECK(cache.exists(3));
+    BOOST_CHECK(cache.exists(4));
+
+    // re-inserting an existing key updates the value and its position
+    cache.insert(3, 31);
+    cache.insert(5, 50);
+    BOOST_CHECK(!cache.exists(1));
+    BOOST_CHECK(cache.get(3, val));
+    BOOST_CHECK(val == 31);
+
+    cache.erase(3);
+    BOOST_CHECK(!cache.exists(3));
+    BOOST_CHECK(cache.size() == 2);
+
+    // shrinking evicts the least recently used items
+    cache.set_max_size(1);
+    BOOST_CHECK(cache.size() == 1);
+    BOOST_CHECK(cache.exists(5));
+
+    cache.clear();
+    BOOST_CHECK(cache.size() == 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,128 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "tracing.h"
+
+#include "util.h"
+
+#include <algorithm>
+#include <string.h>
+
+#include <boost/thread/tss.hpp>
+
+CTracer tracer;
+
+struct CTraceBuffer
+{
+    const int nId;
+    const std::string strName;
+
+    std::mutex mutex;
+    // grows up to nCapacity, then the oldest span is overwritten
+    std::vector<CTraceEvent> vEvents;
+    size_t nCapacity;
+    uint64_t nTotal;
+
+    CTraceBuffer(int nIdIn, const std::string& strNameIn, size_t nCapacityIn) : nId(nIdIn), strName(strNameIn), nCapacity(nCapacityIn), nTotal(0) {}
+};
+
+// owned by the thread and the tracer, so that the spans of threads which exited can still be dumped
+static boost::thread_specific_ptr<std::shared_ptr<CTraceBuffer> > threadBuffer;
+
+CTracer::CTracer() :
+    fEnabled(false),
+    nBufferSize(0),
+    nNextThreadId(1)
+{
+}
+
+void CTracer::Init(size_t nBufferSizeIn)
+{
+    nBufferSize = nBufferSizeIn;
+    fEnabled = nBufferSizeIn > 0;
+}
+
+CTraceBuffer* CTracer::GetThreadBuffer()
+{
+    std::shared_ptr<CTraceBuffer>* ppbuffer = threadBuffer.get();
+    if (ppbuffer) {
+        return ppbuffer->get();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (vBuffers.size() >= MAX_TRACE_THREADS) {
+        auto it = std::find_if(vBuffers.begin(), vBuffers.end(), [](const std::shared_ptr<CTraceBuffer>& pbuffer) {
+            return pbuffer.use_count() == 1;
+        });
+        if (it == vBuffers.end()) {
+            return nullptr;
+        }
+        vBuffers.erase(it);
+    }
+    auto pbuffer = std::make_shared<CTraceBuffer>(nNextThreadId++, GetThreadName(), nBufferSize);
+    vBuffers.push_back(pbuffer);
+    threadBuffer.reset(new std::shared_ptr<CTraceBuffer>(pbuffer));
+    return pbuffer.get();
+}
+
+void CTracer::Record(const char* pszName, const char* pszArg, int64_t nStart, int64_t nEnd)
+{
+    CTraceBuffer* pbuffer = GetThreadBuffer();
+    if (!pbuffer || pbuffer->nCapacity == 0) {
+        return;
+    }
+
+    CTraceEvent event;
+    event.pszName = pszName;
+    strncpy(event.szArg, pszArg ? pszArg : "", TRACE_ARG_SIZE);
+    event.szArg[TRACE_ARG_SIZE] = 0;
+    event.nStart = nStart;
+    event.nDuration = nEnd - nStart;
+
+    // only contended while the spans are copied
+    std::lock_guard<std::mutex> lock(pbuffer->mutex);
+    if (pbuffer->vEvents.size() < pbuffer->nCapacity) {
+        pbuffer->vEvents.push_back(event);
+    } else {
+        pbuffer->vEvents[pbuffer->nTotal % pbuffer->nCapacity] = event;
+    }
+    pbuffer->nTotal++;
+}
+
+std::vector<CTraceThread> CTracer::GetThreads() const
+{
+    std::vector<std::shared_ptr<CTraceBuffer> > vBuffersCopy;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        vBuffersCopy = vBuffers;
+    }
+
+    std::vector<CTraceThread> vThreads;
+    vThreads.reserve(vBuffersCopy.size());
+    for (const auto& pbuffer : vBuffersCopy) {
+        vThreads.emplace_back();
+        CTraceThread& thread = vThreads.back();
+        thread.nId = pbuffer->nId;
+        thread.strName = pbuffer->strName;
+
+        std::lock_guard<std::mutex> lock(pbuffer->mutex);
+        thread.nTotal = pbuffer->nTotal;
+        thread.vEvents.reserve(pbuffer->vEvents.size());
+        // once the buffer is full, the oldest span is the next one to be overwritten
+        size_t nOldest = pbuffer->vEvents.size() < pbuffer->nCapacity ? 0 : pbuffer->nTotal % pbuffer->nCapacity;
+        thread.vEvents.insert(thread.vEvents.end(), pbuffer->vEvents.begin() + nOldest, pbuffer->vEvents.end());
+        thread.vEvents.insert(thread.vEvents.end(), pbuffer->vEvents.begin(), pbuffer->vEvents.begin() + nOldest);
+    }
+    return vThreads;
+}
+
+void CTracer::Clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& pbuffer : vBuffers) {
+        std::lock_guard<std::mutex> lockBuffer(pbuffer->mutex);
+        pbuffer->vEvents.clear();
+        pbuffer->nTotal = 0;
+    }
+}
@@ -0,0 +1,122 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef TRACING_H
+#define TRACING_H
+
+#include "sync.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/** Default for -tracebuffer, the number of spans kept per thread */
+static const unsigned int DEFAULT_TRACE_BUFFER_SIZE = 4096;
+/** Maximum number of buffers, the ones of threads which exited are dropped first */
+static const size_t MAX_TRACE_THREADS = 64;
+/** Maximum number of characters of a span's argument which are kept */
+static const size_t TRACE_ARG_SIZE = 23;
+
+struct CTraceEvent
+{
+    // static string, usually the function name
+    const char* pszName;
+    // optional detail, e.g. the message command
+    char szArg[TRACE_ARG_SIZE + 1];
+    // steady clock nanoseconds
+    int64_t nStart;
+    int64_t nDuration;
+};
+
+struct CTraceThread
+{
+    int nId;
+    std::string strName;
+    // oldest first
+    std::vector<CTraceEvent> vEvents;
+    // including the ones which were overwritten already
+    uint64_t nTotal;
+};
+
+static inline int64_t TraceNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct CTraceBuffer;
+
+/**
+ * Flight recorder for hot paths. Every thread keeps its most recent spans in its own ring buffer,
+ * so that a latency spike can still be looked at after it happened (see dumptrace). Buffers are
+ * only allocated for threads which actually record spans, they are kept after the thread exits.
+ */
+class CTracer
+{
+private:
+    std::atomic<bool> fEnabled;
+    std::atomic<size_t> nBufferSize;
+
+    mutable std::mutex mutex;
+    std::vector<std::shared_ptr<CTraceBuffer> > vBuffers;
+    int nNextThreadId;
+
+    CTraceBuffer* GetThreadBuffer();
+
+public:
+    CTracer();
+
+    /** nBufferSizeIn == 0 disables tracing, buffers which exist already keep their size */
+    void Init(size_t nBufferSizeIn);
+    bool IsEnabled() const { return fEnabled.load(std::memory_order_relaxed); }
+
+    /** pszArg is truncated to TRACE_ARG_SIZE characters */
+    void Record(const char* pszName, const char* pszArg, int64_t nStart, int64_t nEnd);
+
+    /** Copies the spans of all threads, which are kept nevertheless */
+    std::vector<CTraceThread> GetThreads() const;
+    void Clear();
+};
+
+extern CTracer tracer;
+
+/** Records the time from its construction to its destruction as a span if tracing is enabled */
+class CTraceSpan
+{
+private:
+    const char* pszName;
+    // copied, the argument is often a temporary
+    char szArg[TRACE_ARG_SIZE + 1];
+    int64_t nStart;
+
+public:
+    explicit CTraceSpan(const char* pszNameIn) : pszName(tracer.IsEnabled() ? pszNameIn : nullptr), nStart(0)
+    {
+        if (!pszName) return;
+        szArg[0] = 0;
+        nStart = TraceNanos();
+    }
+    CTraceSpan(const char* pszNameIn, const std::string& strArg) : pszName(tracer.IsEnabled() ? pszNameIn : nullptr), nStart(0)
+    {
+        if (!pszName) return;
+        size_t nArgSize = strArg.copy(szArg, TRACE_ARG_SIZE);
+        szArg[nArgSize] = 0;
+        nStart = TraceNanos();
+    }
+    ~CTraceSpan()
+    {
+        if (pszName)
+            tracer.Record(pszName, szArg, nStart, TraceNanos());
+    }
+    CTraceSpan(const CTraceSpan&) = delete;
+    CTraceSpan& operator=(const CTraceSpan&) = delete;
+};
+
+#define TRACE_SPAN(name) CTraceSpan PASTE2(tracespan, __COUNTER__)(name)
+#define TRACE_SPAN_ARG(name, arg) CTraceSpan PASTE2(tracespan, __COUNTER__)(name, arg)
+
+#endif // TRACING_H
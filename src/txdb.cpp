@@ -24,6 +24,7 @@ static const char DB_ADDRESSINDEX = 'a';
 static const char DB_ADDRESSUNSPENTINDEX = 'u';
 static const char DB_TIMESTAMPINDEX = 's';
 static const char DB_SPENTINDEX = 'p';
+static const char DB_PAYEEINDEX = 'P';
 static const char DB_BLOCK_INDEX = 'b';
 
 static const char DB_BEST_BLOCK = 'B';
@@ -306,6 +307,62 @@ bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
     return true;
 }
 
+bool CBlockTreeDB::WritePayeeIndex(int nHeight, const CPayeeIndexValue &value) {
+    return Write(std::make_pair(DB_PAYEEINDEX, CPayeeIndexKey(nHeight)), value);
+}
+
+bool CBlockTreeDB::ErasePayeeIndex(int nHeight) {
+    return Erase(std::make_pair(DB_PAYEEINDEX, CPayeeIndexKey(nHeight)));
+}
+
+bool CBlockTreeDB::ErasePayeeIndexBelow(int nHeight) {
+    if (nHeight <= 0)
+        return true;
+
+    CDBBatch batch(*this);
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(std::make_pair(DB_PAYEEINDEX, CPayeeIndexKey(0)));
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, CPayeeIndexKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_PAYEEINDEX && key.second.blockHeight < nHeight) {
+            batch.Erase(key);
+            pcursor->Next();
+        } else {
+            break;
+        }
+    }
+
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadPayeeIndex(int nStartHeight, int nEndHeight, std::vector<std::pair<int, CPayeeIndexValue> > &vEntries) {
+
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(std::make_pair(DB_PAYEEINDEX, CPayeeIndexKey(nStartHeight)));
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, CPayeeIndexKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_PAYEEINDEX && key.second.blockHeight <= nEndHeight) {
+            CPayeeIndexValue value;
+            if (pcursor->GetValue(value)) {
+                vEntries.push_back(std::make_pair(key.second.blockHeight, value));
+                pcursor->Next();
+            } else {
+                return error("failed to get payee index value");
+            }
+        } else {
+            break;
+        }
+    }
+
+    return true;
+}
+
 bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex) {
     CDBBatch batch(*this);
     batch.Write(std::make_pair(DB_TIMESTAMPINDEX, timestampIndex), 0);
@@ -134,6 +134,10 @@ public:
     bool ReadAddressIndex(uint160 addressHash, int type,
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                           int start = 0, int end = 0);
+    bool WritePayeeIndex(int nHeight, const CPayeeIndexValue &value);
+    bool ErasePayeeIndex(int nHeight);
+    bool ErasePayeeIndexBelow(int nHeight);
+    bool ReadPayeeIndex(int nStartHeight, int nEndHeight, std::vector<std::pair<int, CPayeeIndexValue> > &vEntries);
     bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
     bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &vect);
     bool WriteFlag(const std::string &name, bool fValue);
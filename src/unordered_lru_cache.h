@@ -0,0 +1,100 @@
+// Copyright (c) 2018-2019 The ZeroOne Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef UNORDERED_LRU_CACHE_H_
+#define UNORDERED_LRU_CACHE_H_
+
+#include <cassert>
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+/**
+ * Hash map like container that keeps the N most recently used items.
+ * Both lookups (get) and insertions mark an item as most recently used,
+ * the least recently used item is evicted when the cache is full.
+ */
+template<typename Key, typename Value, typename Hasher = std::hash<Key>>
+class unordered_lru_cache
+{
+private:
+    typedef std::list<std::pair<Key, Value>> list_t;
+    typedef std::unordered_map<Key, typename list_t::iterator, Hasher> map_t;
+
+    size_t maxSize;
+    list_t items; // most recently used item at the front
+    map_t index;
+
+public:
+    explicit unordered_lru_cache(size_t _maxSize) :
+        maxSize(_maxSize)
+    {
+        assert(maxSize != 0);
+    }
+
+    template<typename Value2>
+    void insert(const Key& key, Value2&& v)
+    {
+        auto it = index.find(key);
+        if (it != index.end()) {
+            it->second->second = std::forward<Value2>(v);
+            items.splice(items.begin(), items, it->second);
+            return;
+        }
+        if (items.size() == maxSize) {
+            index.erase(items.back().first);
+            items.pop_back();
+        }
+        items.emplace_front(key, std::forward<Value2>(v));
+        index.emplace(key, items.begin());
+    }
+
+    bool get(const Key& key, Value& value)
+    {
+        auto it = index.find(key);
+        if (it == index.end()) {
+            return false;
+        }
+        items.splice(items.begin(), items, it->second);
+        value = it->second->second;
+        return true;
+    }
+
+    bool exists(const Key& key) const
+    {
+        return index.count(key) != 0;
+    }
+
+    void erase(const Key& key)
+    {
+        auto it = index.find(key);
+        if (it == index.end()) {
+            return;
+        }
+        items.erase(it->second);
+        index.erase(it);
+    }
+
+    void clear()
+    {
+        index.clear();
+        items.clear();
+    }
+
+    void set_max_size(size_t _maxSize)
+    {
+        assert(_maxSize != 0);
+        maxSize = _maxSize;
+        while (items.size() > maxSize) {
+            index.erase(items.back().first);
+            items.pop_back();
+        }
+    }
+
+    size_t size() const { return items.size(); }
+    size_t max_size() const { return maxSize; }
+};
+
+#endif // UNORDERED_LRU_CACHE_H_
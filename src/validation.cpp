@@ -9,10 +9,13 @@
 
 #include "addrman.h"
 #include "arith_uint256.h"
+#include "blockcache.h"
 #include "blockencodings.h"
 #include "chainparams.h"
+#include "chainstaterebuild.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
+#include "coinsprefetch.h"
 #include "consensus/consensus.h"
 #include "consensus/merkle.h"
 #include "consensus/validation.h"
@@ -27,6 +30,7 @@
 #include "script/standard.h"
 #include "timedata.h"
 #include "tinyformat.h"
+#include "tracing.h"
 #include "txdb.h"
 #include "txmempool.h"
 #include "ui_interface.h"
@@ -893,7 +897,8 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state, const C
 
         // Check against previous transactions
         // This is done last to help prevent CPU exhaustion denial-of-service attacks.
-        if (!CheckInputs(tx, state, view, true, STANDARD_SCRIPT_VERIFY_FLAGS, true))
+        PrecomputedTransactionData txdata(tx);
+        if (!CheckInputs(tx, state, view, true, STANDARD_SCRIPT_VERIFY_FLAGS, true, txdata))
             return false; // state filled in by CheckInputs
 
         // Check again against just the consensus-critical mandatory script
@@ -905,7 +910,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state, const C
         // There is a similar check in CreateNewBlock() to prevent creating
         // invalid blocks, however allowing such transactions into the mempool
         // can be exploited as a DoS attack.
-        if (!CheckInputs(tx, state, view, true, MANDATORY_SCRIPT_VERIFY_FLAGS, true))
+        if (!CheckInputs(tx, state, view, true, MANDATORY_SCRIPT_VERIFY_FLAGS, true, txdata))
         {
             return error("%s: BUG! PLEASE REPORT THIS! ConnectInputs failed against MANDATORY but not STANDARD flags %s, %s",
                          __func__, hash.ToString(), FormatStateMessage(state));
@@ -947,6 +952,7 @@ bool AcceptToMemoryPoolWithTime(CTxMemPool& pool, CValidationState &state, const
                         bool* pfMissingInputs, int64_t nAcceptTime, bool fOverrideMempoolLimit,
                         const CAmount nAbsurdFee, bool fDryRun)
 {
+    TRACE_SPAN("AcceptToMemoryPool");
     std::vector<COutPoint> coins_to_uncache;
     bool res = AcceptToMemoryPoolWorker(pool, state, tx, fLimitFree, pfMissingInputs, nAcceptTime, fOverrideMempoolLimit, nAbsurdFee, coins_to_uncache, fDryRun);
     if (!res || fDryRun) {
@@ -1105,22 +1111,52 @@ bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHea
     return true;
 }
 
+/** Returns the mapping of the block file if -blockmmap is enabled and nothing is appended to that file anymore */
+static std::shared_ptr<CMappedBlockFile> GetMappedBlockFile(const CDiskBlockPos& pos)
+{
+    if (!blockCache.IsMmapEnabled())
+        return nullptr;
+
+    size_t nFileSize;
+    {
+        LOCK(cs_LastBlockFile);
+        // the last file is still written to and gets truncated when the next one is started
+        if ((int)pos.nFile >= nLastBlockFile || pos.nFile >= vinfoBlockFile.size())
+            return nullptr;
+        nFileSize = vinfoBlockFile[pos.nFile].nSize;
+    }
+
+    return blockCache.GetMappedFile(pos.nFile, nFileSize, GetBlockPosFilename(pos, "blk"));
+}
+
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
 {
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
-
-    // Read block
+    bool fMapped = false;
     try {
-        filein >> block;
+        std::shared_ptr<CMappedBlockFile> file = GetMappedBlockFile(pos);
+        fMapped = file && file->ReadBlock(pos.nPos, Params().MessageStart(), block);
     }
     catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        return error("%s: Deserialize error - %s at %s", __func__, e.what(), pos.ToString());
+    }
+
+    if (!fMapped) {
+        // Open history file to read
+        CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+
+        // Read block
+        try {
+            filein >> block;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        }
     }
+    blockCache.RecordRead(fMapped);
 
     // Check the header
     if (!CheckProofOfWork(block.GetHash(), block.nBits, consensusParams))
@@ -1129,13 +1165,73 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus:
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
+bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams, bool fCache)
 {
+    // blocks in the cache passed the checks below when they were read or accepted
+    if (blockCache.Get(pindex->GetBlockHash(), block))
+        return true;
     if (!ReadBlockFromDisk(block, pindex->GetBlockPos(), consensusParams))
         return false;
     if (block.GetHash() != pindex->GetBlockHash())
         return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): GetHash() doesn't match index for %s at %s",
                      pindex->ToString(), pindex->GetBlockPos().ToString());
+    if (fCache)
+        blockCache.Insert(pindex->GetBlockHash(), std::make_shared<const CBlock>(block));
+    return true;
+}
+
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& vchBlock, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart)
+{
+    vchBlock.clear();
+
+    // serializing a cached block is cheaper than reading it, blocks in the cache passed the checks when they were read or accepted
+    std::shared_ptr<const CBlock> pblock = blockCache.Get(pindex->GetBlockHash());
+    if (pblock) {
+        CVectorWriter(SER_NETWORK, PROTOCOL_VERSION, vchBlock, 0, *pblock);
+        return true;
+    }
+
+    CDiskBlockPos pos = pindex->GetBlockPos();
+    std::shared_ptr<CMappedBlockFile> file = GetMappedBlockFile(pos);
+    bool fMapped = file && file->ReadRawBlock(pos.nPos, messageStart, vchBlock);
+
+    if (!fMapped) {
+        if (pos.nPos < CMessageHeader::MESSAGE_START_SIZE + sizeof(uint32_t))
+            return error("%s: Invalid block position %s", __func__, pos.ToString());
+        // Open history file at the index header written by WriteBlockToDisk
+        CDiskBlockPos posHeader(pos.nFile, pos.nPos - CMessageHeader::MESSAGE_START_SIZE - sizeof(uint32_t));
+        CAutoFile filein(OpenBlockFile(posHeader, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("%s: OpenBlockFile failed for %s", __func__, pos.ToString());
+
+        try {
+            CMessageHeader::MessageStartChars blockMessageStart;
+            uint32_t nBlockSize;
+            filein >> FLATDATA(blockMessageStart) >> nBlockSize;
+            if (memcmp(blockMessageStart, messageStart, CMessageHeader::MESSAGE_START_SIZE) != 0)
+                return error("%s: Block magic mismatch at %s", __func__, pos.ToString());
+            if (nBlockSize > MaxBlockSize(true))
+                return error("%s: Block size %u too large at %s", __func__, nBlockSize, pos.ToString());
+
+            vchBlock.resize(nBlockSize);
+            filein.read((char*)vchBlock.data(), nBlockSize);
+        }
+        catch (const std::exception& e) {
+            return error("%s: Read from block file failed - %s at %s", __func__, e.what(), pos.ToString());
+        }
+    }
+    blockCache.RecordRead(fMapped);
+
+    // Nothing was parsed, so make sure these bytes are the block of the index entry: the header on disk
+    // has to be the one in the index, which also makes sure it passed the proof of work check before.
+    // This catches wrong positions, but not damaged transactions, peers reject those by the merkle root.
+    CDataStream ssHeader(SER_DISK, CLIENT_VERSION);
+    ssHeader << pindex->GetBlockHeader();
+    if (vchBlock.size() <= ssHeader.size() || memcmp(vchBlock.data(), ssHeader.data(), ssHeader.size()) != 0) {
+        vchBlock.clear();
+        return error("%s: Block header doesn't match index for %s at %s", __func__, pindex->ToString(), pos.ToString());
+    }
+
     return true;
 }
 
@@ -1364,7 +1460,7 @@ void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, int nHeight)
 
 bool CScriptCheck::operator()() {
     const CScript &scriptSig = ptxTo->vin[nIn].scriptSig;
-    if (!VerifyScript(scriptSig, scriptPubKey, nFlags, CachingTransactionSignatureChecker(ptxTo, nIn, cacheStore), &error)) {
+    if (!VerifyScript(scriptSig, scriptPubKey, nFlags, CachingTransactionSignatureChecker(ptxTo, nIn, cacheStore, txdata), &error)) {
         return false;
     }
     return true;
@@ -1450,7 +1546,7 @@ namespace Consensus {
     }
 }// namespace Consensus
 
-bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheStore, std::vector<CScriptCheck> *pvChecks)
+bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks)
 {
     if (!tx.IsCoinBase())
     {
@@ -1484,7 +1580,7 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
                 const CAmount amount = coin.out.nValue;
 
                 // Verify signature
-                CScriptCheck check(scriptPubKey, amount, tx, i, flags, cacheStore);
+                CScriptCheck check(scriptPubKey, amount, tx, i, flags, cacheStore, &txdata);
                 if (pvChecks) {
                     pvChecks->push_back(CScriptCheck());
                     check.swap(pvChecks->back());
@@ -1497,7 +1593,7 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
                         // avoid splitting the network between upgraded and
                         // non-upgraded nodes.
                         CScriptCheck check2(scriptPubKey, amount, tx, i,
-                                            flags & ~STANDARD_NOT_MANDATORY_VERIFY_FLAGS, cacheStore);
+                                            flags & ~STANDARD_NOT_MANDATORY_VERIFY_FLAGS, cacheStore, &txdata);
                         if (check2())
                             return state.Invalid(false, REJECT_NONSTANDARD, strprintf("non-mandatory-script-verify-flag (%s)", ScriptErrorString(check.GetScriptError())));
                     }
@@ -1836,6 +1932,26 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+CCheckQueueStats GetScriptCheckQueueStats()
+{
+    return scriptcheckqueue.GetStats();
+}
+
+bool RunScriptChecks(std::vector<CScriptCheck>& vChecks)
+{
+    if (nScriptCheckThreads == 0) {
+        for (auto& check : vChecks) {
+            if (!check()) return false;
+        }
+        vChecks.clear();
+        return true;
+    }
+
+    CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+    control.Add(vChecks);
+    return control.Wait();
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -2087,8 +2203,22 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
 
     CBlockUndo blockundo;
 
+    // the script checks refer to these until the queue is done, so they have to outlive the control
+    std::vector<PrecomputedTransactionData> txdata;
+    if (fScriptChecks)
+        txdata.reserve(block.vtx.size()); // no reallocation, the checks keep pointers into it
+
     CCheckQueueControl<CScriptCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : NULL);
 
+    // Script checks are handed to the queue in batches sized for this block: small blocks start verifying
+    // right away, big ones don't wake up all the workers for every single transaction.
+    size_t nBlockInputs = 0;
+    for (const auto& ptx : block.vtx) {
+        nBlockInputs += ptx->vin.size();
+    }
+    const size_t nCheckBatch = std::max<size_t>(1, std::min<size_t>(SCRIPTCHECK_MAX_ADD_BATCH, nBlockInputs / (std::max(nScriptCheckThreads, 1) * 8)));
+    std::vector<CScriptCheck> vChecks;
+
     std::vector<int> prevheights;
     CAmount nFees = 0;
     int nInputs = 0;
@@ -2186,12 +2316,21 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
 
             nFees += view.GetValueIn(tx)-tx.GetValueOut();
 
-            std::vector<CScriptCheck> vChecks;
-            bool fCacheResults = fJustCheck; /* Don't cache results if we're actually connecting blocks (still consult the cache, though) */
-            if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, nScriptCheckThreads ? &vChecks : NULL))
-                return error("ConnectBlock(): CheckInputs on %s failed with %s",
+            if (fScriptChecks) {
+                bool fCacheResults = fJustCheck; /* Don't cache results if we're actually connecting blocks (still consult the cache, though) */
+                txdata.emplace_back(tx);
+                if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, txdata.back(), nScriptCheckThreads ? &vChecks : NULL))
+                    return error("ConnectBlock(): CheckInputs on %s failed with %s",
+                                 tx.GetHash().ToString(), FormatStateMessage(state));
+            } else if (!Consensus::CheckTxInputs(tx, state, view, GetSpendHeight(view))) {
+                // all CheckInputs does without script checks, there's no point in precomputing the signature hash data
+                return error("ConnectBlock(): CheckTxInputs on %s failed with %s",
                              tx.GetHash().ToString(), FormatStateMessage(state));
-            control.Add(vChecks);
+            }
+            if (vChecks.size() >= nCheckBatch) {
+                control.Add(vChecks);
+                vChecks.clear();
+            }
         }
 
         if (fAddressIndex) {
@@ -2236,10 +2375,11 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
         vPos.push_back(std::make_pair(tx.GetHash(), pos));
         pos.nTxOffset += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
     }
+    control.Add(vChecks);
     int64_t nTime3 = GetTimeMicros(); nTimeConnect += nTime3 - nTime2;
     LogPrint("bench", "      - Connect %u transactions: %.2fms (%.3fms/tx, %.3fms/txin) [%.2fs]\n", (unsigned)block.vtx.size(), 0.001 * (nTime3 - nTime2), 0.001 * (nTime3 - nTime2) / block.vtx.size(), nInputs <= 1 ? 0 : 0.001 * (nTime3 - nTime2) / (nInputs-1), nTimeConnect * 0.000001);
 
-    if (!ProcessSpecialTxsInBlock(block, pindex, state)) {
+    if (!ProcessSpecialTxsInBlock(block, pindex, state, fJustCheck)) {
         return error("ConnectBlock(): ProcessSpecialTxsInBlock for block %s failed with %s",
                      pindex->GetBlockHash().ToString(), FormatStateMessage(state));
     }
@@ -2465,6 +2605,7 @@ void PruneAndFlush() {
 /** Update chainActive and related internal data structures. */
 void static UpdateTip(CBlockIndex *pindexNew, const CChainParams& chainParams) {
     chainActive.SetTip(pindexNew);
+    chainStateRebuild.UpdatedTip(pindexNew);
 
     // New best block
     mempool.AddTransactionsUpdated(1);
@@ -2546,6 +2687,9 @@ bool static DisconnectTip(CValidationState& state, const CChainParams& chainpara
         bool committed = dbTx->Commit();
         assert(committed);
     }
+    if (!pblocktree->ErasePayeeIndex(pindexDelete->nHeight))
+        return AbortNode(state, "Failed to erase masternode payee index");
+    mnpayeeindex.BlockDisconnected(pindexDelete->nHeight);
     LogPrint("bench", "- Disconnect block: %.2fms\n", (GetTimeMicros() - nStart) * 0.001);
     // Write the chain state to disk, if necessary.
     if (!FlushStateToDisk(state, IsInitialBlockDownload() ? FLUSH_STATE_IF_NEEDED : FLUSH_STATE_ALWAYS))
@@ -2602,6 +2746,7 @@ struct ConnectTrace {
  */
 bool static ConnectTip(CValidationState& state, const CChainParams& chainparams, CBlockIndex* pindexNew, const std::shared_ptr<const CBlock>& pblock, ConnectTrace& connectTrace)
 {
+    TRACE_SPAN("ConnectTip");
     assert(pindexNew->pprev == chainActive.Tip());
     // Read block from disk.
     int64_t nTime1 = GetTimeMicros();
@@ -2618,6 +2763,8 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
     int64_t nTime2 = GetTimeMicros(); nTimeReadFromDisk += nTime2 - nTime1;
     int64_t nTime3;
     LogPrint("bench", "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * 0.001, nTimeReadFromDisk * 0.000001);
+    // Look up the coins the block spends in parallel, ConnectBlock would read them one after another
+    coinsPrefetcher.Prefetch(blockConnecting, *pcoinsTip, *pcoinsdbview);
     {
         auto dbTx = evoDb->BeginTransaction();
 
@@ -2636,6 +2783,17 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
         bool committed = dbTx->Commit();
         assert(committed);
     }
+    {
+        std::vector<CScript> vPayees = CMasternodePayeeIndex::GetBlockPayees(blockConnecting, pindexNew->nHeight);
+        if (!pblocktree->WritePayeeIndex(pindexNew->nHeight, CPayeeIndexValue(pindexNew->GetBlockHash(), vPayees)))
+            return AbortNode(state, "Failed to write masternode payee index");
+        int nPayeeIndexBlocks = mnpayments.GetStorageLimit();
+        mnpayeeindex.BlockConnected(pindexNew->nHeight, vPayees, nPayeeIndexBlocks);
+        // entries behind the window are only needed again if the storage limit grows, LoadWindow rebuilds them then
+        if (pindexNew->nHeight % CMasternodePayeeIndex::DB_PRUNE_INTERVAL == 0 &&
+            !pblocktree->ErasePayeeIndexBelow(pindexNew->nHeight - nPayeeIndexBlocks + 1))
+            return AbortNode(state, "Failed to prune masternode payee index");
+    }
     int64_t nTime4 = GetTimeMicros(); nTimeFlush += nTime4 - nTime3;
     LogPrint("bench", "  - Flush: %.2fms [%.2fs]\n", (nTime4 - nTime3) * 0.001, nTimeFlush * 0.000001);
     // Write the chain state to disk, if necessary.
@@ -2873,6 +3031,7 @@ static void NotifyHeaderTip() {
  * that is already loaded (to avoid loading it again from disk).
  */
 bool ActivateBestChain(CValidationState &state, const CChainParams& chainparams, std::shared_ptr<const CBlock> pblock) {
+    TRACE_SPAN("ActivateBestChain");
     // Note that while we're often called here from ProcessNewBlock, this is
     // far from a guarantee. Things in the P2P/RPC will often end up calling
     // us in the middle of ProcessNewBlock - do not assume pblock is set
@@ -2930,6 +3089,7 @@ bool ActivateBestChain(CValidationState &state, const CChainParams& chainparams,
                 const CBlock& block = *(pair.second);
                 for (unsigned int i = 0; i < block.vtx.size(); i++)
                     GetMainSignals().SyncTransaction(*block.vtx[i], pair.first, i);
+                GetMainSignals().BlockConnected(pair.second, pair.first);
             }
         }
         // When we reach this point, we switched to a new tip (stored in pindexNewTip).
@@ -3597,6 +3757,9 @@ static bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidation
                 AbortNode(state, "Failed to write block");
         if (!ReceivedBlockTransactions(block, state, pindex, blockPos))
             return error("AcceptBlock(): ReceivedBlockTransactions failed");
+        // peers will ask for a new block right away, reindexed ones would only push out the interesting blocks
+        if (dbp == NULL)
+            blockCache.Insert(pindex->GetBlockHash(), pblock);
     } catch (const std::runtime_error& e) {
         return AbortNode(state, std::string("System error: ") + e.what());
     }
@@ -3718,6 +3881,8 @@ void PruneOneBlockFile(const int fileNumber)
 
 void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune)
 {
+    // drops the mappings of the files as well
+    blockCache.Clear();
     for (std::set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         CDiskBlockPos pos(*it, 0);
         boost::filesystem::remove(GetBlockPosFilename(pos, "blk"));
@@ -9,10 +9,14 @@
 #include <utility>
 #include <vector>
 
+#include "privatesend.h"
 #include "rpc/server.h"
+#include "script/interpreter.h"
+#include "script/standard.h"
 #include "test/test_zeroone.h"
 #include "validation.h"
 #include "wallet/test/wallet_test_fixture.h"
+#include "wallet/walletdb.h"
 
 #include <boost/foreach.hpp>
 #include <boost/test/unit_test.hpp>
@@ -488,4 +492,137 @@ BOOST_FIXTURE_TEST_CASE(importwallet_rescan, TestChain100Setup)
     ::pwalletMain = pwalletMainBackup;
 }
 
+static CMutableTransaction CreateSpend(const std::vector<COutPoint>& vPrevouts, const CScript& scriptPubKey, CAmount nValue)
+{
+    CMutableTransaction tx;
+    for (const auto& prevout : vPrevouts) {
+        tx.vin.emplace_back(prevout);
+    }
+    tx.vout.emplace_back(nValue, scriptPubKey);
+    return tx;
+}
+
+static void SignSpend(CMutableTransaction& tx, const CScript& scriptPubKey, const CKey& key)
+{
+    for (unsigned int i = 0; i < tx.vin.size(); i++) {
+        std::vector<unsigned char> vchSig;
+        uint256 hash = SignatureHash(scriptPubKey, tx, i, SIGHASH_ALL);
+        BOOST_CHECK(key.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        tx.vin[i].scriptSig = CScript() << vchSig;
+    }
+}
+
+static bool HasDenominatedCoin(const CWallet& wallet, const COutPoint& outpoint, CAmount nDenom)
+{
+    std::vector<COutput> vCoins;
+    wallet.AvailableDenominatedCoins(vCoins, {nDenom}, false);
+    for (const auto& out : vCoins) {
+        if (COutPoint(out.tx->GetHash(), out.i) == outpoint) return true;
+    }
+    return false;
+}
+
+// Outputs spent by a transaction which gets abandoned or conflicted are available for mixing again
+BOOST_FIXTURE_TEST_CASE(denominated_utxos_unspent_again, TestChain100Setup)
+{
+    LOCK(cs_main);
+    CPrivateSend::InitStandardDenominations();
+    const CAmount nDenom = COIN + 1000;
+    const CScript scriptPubKey = GetScriptForRawPubKey(coinbaseKey.GetPubKey());
+
+    // fund three denominated outputs from a mature coinbase
+    CMutableTransaction txFund;
+    txFund.vin.emplace_back(COutPoint(coinbaseTxns[0].GetHash(), 0));
+    for (int i = 0; i < 3; i++) {
+        txFund.vout.emplace_back(nDenom, scriptPubKey);
+    }
+    txFund.vout.emplace_back(coinbaseTxns[0].vout[0].nValue - 3 * nDenom - 10000, scriptPubKey);
+    SignSpend(txFund, scriptPubKey, coinbaseKey);
+    CreateAndProcessBlock({txFund}, scriptPubKey);
+    const uint256 hashFund = txFund.GetHash();
+    const COutPoint outX(hashFund, 0), outY(hashFund, 1), outZ(hashFund, 2);
+
+    CWallet wallet;
+    LOCK(wallet.cs_wallet);
+    wallet.AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey());
+    wallet.ScanForWalletTransactions(chainActive.Tip());
+    BOOST_CHECK(HasDenominatedCoin(wallet, outX, nDenom));
+    BOOST_CHECK(HasDenominatedCoin(wallet, outY, nDenom));
+    BOOST_CHECK(HasDenominatedCoin(wallet, outZ, nDenom));
+
+    // an abandoned spend gives its input back
+    CWalletTx wtxAbandoned(&wallet, MakeTransactionRef(CreateSpend({outZ}, scriptPubKey, nDenom - 1000)));
+    BOOST_CHECK(wallet.AddToWallet(wtxAbandoned));
+    BOOST_CHECK(!HasDenominatedCoin(wallet, outZ, nDenom));
+    BOOST_CHECK(wallet.AbandonTransaction(wtxAbandoned.GetHash()));
+    BOOST_CHECK(HasDenominatedCoin(wallet, outZ, nDenom));
+
+    // a spend which conflicts with a mined transaction gives back the inputs which weren't double spent
+    CWalletTx wtxConflicted(&wallet, MakeTransactionRef(CreateSpend({outX, outY}, scriptPubKey, 2 * nDenom - 1000)));
+    BOOST_CHECK(wallet.AddToWallet(wtxConflicted));
+    BOOST_CHECK(!HasDenominatedCoin(wallet, outX, nDenom));
+    BOOST_CHECK(!HasDenominatedCoin(wallet, outY, nDenom));
+
+    CMutableTransaction txDoubleSpend = CreateSpend({outX}, GetScriptForDestination(CKeyID()), nDenom - 1000);
+    SignSpend(txDoubleSpend, scriptPubKey, coinbaseKey);
+    CreateAndProcessBlock({txDoubleSpend}, scriptPubKey);
+    wallet.SyncTransaction(txDoubleSpend, chainActive.Tip(), 1);
+    BOOST_CHECK(wallet.mapWallet.at(wtxConflicted.GetHash()).GetDepthInMainChain() < 0);
+    BOOST_CHECK(!HasDenominatedCoin(wallet, outX, nDenom));
+    BOOST_CHECK(HasDenominatedCoin(wallet, outY, nDenom));
+}
+
+BOOST_AUTO_TEST_CASE(keypool_topup_batch_derivation)
+{
+    const unsigned int nKeys = 5;
+    const unsigned int nSingleKeys = 2;
+
+    LOCK(pwalletMain->cs_wallet);
+    pwalletMain->GenerateNewHDChain();
+    BOOST_REQUIRE(pwalletMain->IsHDEnabled());
+    CHDChain hdChain;
+    BOOST_REQUIRE(pwalletMain->GetHDChain(hdChain));
+
+    // a second wallet with the same seed derives one key at a time
+    CWallet walletSingle("wallet_test_single.dat");
+    bool fFirstRun;
+    walletSingle.LoadWallet(fFirstRun);
+    LOCK(walletSingle.cs_wallet);
+    BOOST_REQUIRE(walletSingle.SetHDChain(hdChain, false));
+
+    // advance the chain counters before the batch starts
+    for (unsigned int i = 0; i < nSingleKeys; i++) {
+        BOOST_CHECK(pwalletMain->GenerateNewKey(0, false) == walletSingle.GenerateNewKey(0, false));
+        BOOST_CHECK(pwalletMain->GenerateNewKey(0, true) == walletSingle.GenerateNewKey(0, true));
+    }
+
+    // the external keys go into the pool first, then the internal ones
+    BOOST_REQUIRE(pwalletMain->TopUpKeyPool(nKeys));
+    BOOST_CHECK_EQUAL(pwalletMain->KeypoolCountExternalKeys(), (size_t)nKeys);
+    BOOST_CHECK_EQUAL(pwalletMain->KeypoolCountInternalKeys(), (size_t)nKeys);
+
+    CWalletDB walletdb(pwalletMain->strWalletFile);
+    int64_t nIndex = 1;
+    for (bool fInternal : {false, true}) {
+        for (unsigned int i = 0; i < nKeys; i++) {
+            CKeyPool keypool;
+            BOOST_REQUIRE(walletdb.ReadPool(nIndex++, keypool));
+            BOOST_CHECK_EQUAL(keypool.fInternal, fInternal);
+            BOOST_CHECK(keypool.vchPubKey == walletSingle.GenerateNewKey(0, fInternal));
+        }
+    }
+
+    // both leave the chain at the same counters
+    CHDChain hdChainBatch, hdChainSingle;
+    CHDAccount accBatch, accSingle;
+    BOOST_REQUIRE(pwalletMain->GetHDChain(hdChainBatch));
+    BOOST_REQUIRE(walletSingle.GetHDChain(hdChainSingle));
+    BOOST_REQUIRE(hdChainBatch.GetAccount(0, accBatch));
+    BOOST_REQUIRE(hdChainSingle.GetAccount(0, accSingle));
+    BOOST_CHECK_EQUAL(accBatch.nExternalChainCounter, nSingleKeys + nKeys);
+    BOOST_CHECK_EQUAL(accBatch.nExternalChainCounter, accSingle.nExternalChainCounter);
+    BOOST_CHECK_EQUAL(accBatch.nInternalChainCounter, accSingle.nInternalChainCounter);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
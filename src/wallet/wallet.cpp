@@ -37,6 +37,7 @@
 #include "evo/providertx.h"
 
 #include <assert.h>
+#include <thread>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/filesystem.hpp>
@@ -203,6 +204,135 @@ void CWallet::DeriveNewChildKey(const CKeyMetadata& metadata, CKey& secretRet, u
         throw std::runtime_error(std::string(__func__) + ": AddHDPubKey failed");
 }
 
+bool CWallet::GetHDChangePubKey(const CHDChain& hdChain, uint32_t nAccountIndex, bool fInternal, CExtPubKey& extPubKeyRet)
+{
+    AssertLockHeld(cs_wallet); // mapHdChangePubKeys
+
+    auto key = std::make_tuple(hdChain.GetID(), nAccountIndex, fInternal ? 1U : 0U);
+    auto it = mapHdChangePubKeys.find(key);
+    if (it != mapHdChangePubKeys.end()) {
+        extPubKeyRet = it->second;
+        return true;
+    }
+
+    CHDChain hdChainTmp(hdChain);
+    if (!DecryptHDChain(hdChainTmp))
+        return false;
+    // make sure seed matches this chain
+    if (hdChainTmp.GetID() != hdChainTmp.GetSeedHash())
+        return false;
+
+    CExtKey changeKey;
+    hdChainTmp.DeriveChangeExtKey(nAccountIndex, fInternal, changeKey);
+    extPubKeyRet = changeKey.Neuter();
+    mapHdChangePubKeys.emplace(key, extPubKeyRet);
+    return true;
+}
+
+// Derive the non-hardened children [nFirstIndex, nFirstIndex + nCount) of changePubKey, spreading the work over all cores
+static void DeriveChildExtPubKeys(const CExtPubKey& changePubKey, uint32_t nFirstIndex, size_t nCount, std::vector<CExtPubKey>& vecExtPubKeysRet)
+{
+    vecExtPubKeysRet.assign(nCount, CExtPubKey());
+
+    // don't bother spawning threads for a handful of keys
+    size_t nThreads = std::min((size_t)std::max(GetNumCores(), 1), (nCount + 63) / 64);
+    std::atomic<bool> fFailed(false);
+
+    auto derive = [&](size_t nThread) {
+        for (size_t i = nThread; i < nCount && !fFailed; i += nThreads) {
+            if (!changePubKey.Derive(vecExtPubKeysRet[i], nFirstIndex + i)) {
+                fFailed = true;
+            }
+        }
+    };
+
+    std::vector<std::thread> vecThreads;
+    for (size_t i = 1; i < nThreads; i++) {
+        vecThreads.emplace_back(derive, i);
+    }
+    derive(0);
+    for (auto& thread : vecThreads) {
+        thread.join();
+    }
+
+    if (fFailed)
+        throw std::runtime_error(std::string(__func__) + ": Derive failed");
+}
+
+void CWallet::DeriveNewChildPubKeys(CWalletDB& walletdb, uint32_t nAccountIndex, bool fInternal, size_t nCount, std::vector<CPubKey>& vecPubKeysRet)
+{
+    AssertLockHeld(cs_wallet); // mapKeyMetadata, mapHdPubKeys
+
+    CHDChain hdChainCurrent;
+    if (!GetHDChain(hdChainCurrent))
+        throw std::runtime_error(std::string(__func__) + ": GetHDChain failed");
+
+    CHDAccount acc;
+    if (!hdChainCurrent.GetAccount(nAccountIndex, acc))
+        throw std::runtime_error(std::string(__func__) + ": Wrong HD account!");
+
+    // public derivation from the cached change level key, so the seed is only decrypted once per chain
+    CExtPubKey changePubKey;
+    if (!GetHDChangePubKey(hdChainCurrent, nAccountIndex, fInternal, changePubKey))
+        throw std::runtime_error(std::string(__func__) + ": GetHDChangePubKey failed");
+
+    CKeyMetadata metadata(GetTime());
+    UpdateTimeFirstKey(metadata.nCreateTime);
+
+    // derive child keys starting at next index, skip keys already known to the wallet
+    uint32_t nChildIndex = fInternal ? acc.nInternalChainCounter : acc.nExternalChainCounter;
+    std::vector<CExtPubKey> vecExtPubKeys;
+    vecPubKeysRet.clear();
+    vecPubKeysRet.reserve(nCount);
+    while (vecPubKeysRet.size() < nCount) {
+        DeriveChildExtPubKeys(changePubKey, nChildIndex, nCount - vecPubKeysRet.size(), vecExtPubKeys);
+        nChildIndex += vecExtPubKeys.size();
+
+        for (const auto& extPubKey : vecExtPubKeys) {
+            CKeyID keyID = extPubKey.pubkey.GetID();
+            if (HaveKey(keyID))
+                continue;
+
+            CHDPubKey hdPubKey;
+            hdPubKey.extPubKey = extPubKey;
+            hdPubKey.hdchainID = hdChainCurrent.GetID();
+            hdPubKey.nAccountIndex = nAccountIndex;
+            hdPubKey.nChangeIndex = fInternal ? 1 : 0;
+
+            mapKeyMetadata[keyID] = metadata;
+            mapHdPubKeys[keyID] = hdPubKey;
+            if (fFileBacked && !walletdb.WriteHDPubKey(hdPubKey, metadata))
+                throw std::runtime_error(std::string(__func__) + ": WriteHDPubKey failed");
+
+            vecPubKeysRet.push_back(extPubKey.pubkey);
+        }
+    }
+
+    // update the chain model once for the whole batch
+    if (fInternal) {
+        acc.nInternalChainCounter = nChildIndex;
+    }
+    else {
+        acc.nExternalChainCounter = nChildIndex;
+    }
+
+    if (!hdChainCurrent.SetAccount(nAccountIndex, acc))
+        throw std::runtime_error(std::string(__func__) + ": SetAccount failed");
+
+    if (IsCrypted()) {
+        if (!SetCryptedHDChain(hdChainCurrent, true))
+            throw std::runtime_error(std::string(__func__) + ": SetCryptedHDChain failed");
+        if (fFileBacked && !walletdb.WriteCryptedHDChain(hdChainCurrent))
+            throw std::runtime_error(std::string(__func__) + ": WriteCryptedHDChain failed");
+    }
+    else {
+        if (!SetHDChain(hdChainCurrent, true))
+            throw std::runtime_error(std::string(__func__) + ": SetHDChain failed");
+        if (fFileBacked && !walletdb.WriteHDChain(hdChainCurrent))
+            throw std::runtime_error(std::string(__func__) + ": WriteHDChain failed");
+    }
+}
+
 bool CWallet::GetPubKey(const CKeyID &address, CPubKey& vchPubKeyOut) const
 {
     LOCK(cs_wallet);
@@ -731,10 +861,46 @@ bool CWallet::IsSpent(const uint256& hash, unsigned int n) const
     return false;
 }
 
+void CWallet::AddWalletUTXO(const COutPoint& outpoint, CAmount nValue)
+{
+    setWalletUTXO.insert(outpoint);
+    if (CPrivateSend::IsDenominatedAmount(nValue)) {
+        mapDenominatedWalletUTXO[nValue].insert(outpoint);
+    }
+}
+
+void CWallet::EraseWalletUTXO(const COutPoint& outpoint)
+{
+    if (!setWalletUTXO.erase(outpoint)) return;
+
+    std::map<uint256, CWalletTx>::const_iterator mit = mapWallet.find(outpoint.hash);
+    if (mit == mapWallet.end() || outpoint.n >= mit->second.tx->vout.size()) return;
+
+    auto itBucket = mapDenominatedWalletUTXO.find(mit->second.tx->vout[outpoint.n].nValue);
+    if (itBucket == mapDenominatedWalletUTXO.end()) return;
+    itBucket->second.erase(outpoint);
+    if (itBucket->second.empty()) {
+        mapDenominatedWalletUTXO.erase(itBucket);
+    }
+}
+
+void CWallet::RestoreWalletUTXOs(const CWalletTx& wtx)
+{
+    for (const auto& txin : wtx.tx->vin) {
+        std::map<uint256, CWalletTx>::const_iterator mit = mapWallet.find(txin.prevout.hash);
+        if (mit == mapWallet.end() || txin.prevout.n >= mit->second.tx->vout.size()) continue;
+
+        const CTxOut& txout = mit->second.tx->vout[txin.prevout.n];
+        if (IsMine(txout) && !IsSpent(txin.prevout.hash, txin.prevout.n)) {
+            AddWalletUTXO(txin.prevout, txout.nValue);
+        }
+    }
+}
+
 void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
 {
     mapTxSpends.insert(std::make_pair(outpoint, wtxid));
-    setWalletUTXO.erase(outpoint);
+    EraseWalletUTXO(outpoint);
 
     std::pair<TxSpends::iterator, TxSpends::iterator> range;
     range = mapTxSpends.equal_range(outpoint);
@@ -1124,7 +1290,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
 
         for(unsigned int i = 0; i < wtx.tx->vout.size(); ++i) {
             if (IsMine(wtx.tx->vout[i]) && !IsSpent(hash, i)) {
-                setWalletUTXO.insert(COutPoint(hash, i));
+                AddWalletUTXO(COutPoint(hash, i), wtx.tx->vout[i].nValue);
                 if (deterministicMNManager->IsProTxWithCollateral(wtx.tx, i) || deterministicMNManager->HasMNCollateralAtChainTip(COutPoint(hash, i))) {
                     LockCoin(COutPoint(hash, i));
                 }
@@ -1307,6 +1473,7 @@ bool CWallet::AbandonTransaction(const uint256& hashTx)
                 if (mapWallet.count(txin.prevout.hash))
                     mapWallet[txin.prevout.hash].MarkDirty();
             }
+            RestoreWalletUTXOs(wtx);
         }
     }
 
@@ -1371,6 +1538,7 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
                 if (mapWallet.count(txin.prevout.hash))
                     mapWallet[txin.prevout.hash].MarkDirty();
             }
+            RestoreWalletUTXOs(wtx);
         }
     }
 
@@ -2641,6 +2809,39 @@ void CWallet::AvailableCoins(std::vector<COutput>& vCoins, bool fOnlyConfirmed,
     }
 }
 
+void CWallet::AvailableDenominatedCoins(std::vector<COutput>& vCoins, const std::vector<CAmount>& vecAmounts, bool fOnlyConfirmed) const
+{
+    vCoins.clear();
+
+    LOCK2(cs_main, cs_wallet);
+
+    for (const auto& nAmount : vecAmounts) {
+        auto itBucket = mapDenominatedWalletUTXO.find(nAmount);
+        if (itBucket == mapDenominatedWalletUTXO.end()) continue;
+
+        for (const auto& outpoint : itBucket->second) {
+            std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
+            if (it == mapWallet.end()) continue;
+            const CWalletTx* pcoin = &it->second;
+
+            // same checks as in AvailableCoins
+            if (!CheckFinalTx(*pcoin)) continue;
+            if (fOnlyConfirmed && !pcoin->IsTrusted()) continue;
+            if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0) continue;
+
+            int nDepth = pcoin->GetDepthInMainChain();
+            if (nDepth == 0 && !pcoin->InMempool()) continue;
+
+            isminetype mine = IsMine(pcoin->tx->vout[outpoint.n]);
+            if (mine == ISMINE_NO || IsSpent(outpoint.hash, outpoint.n) || IsLockedCoin(outpoint.hash, outpoint.n)) continue;
+
+            vCoins.push_back(COutput(pcoin, outpoint.n, nDepth,
+                                     (mine & ISMINE_SPENDABLE) != ISMINE_NO,
+                                     (mine & (ISMINE_SPENDABLE | ISMINE_WATCH_SOLVABLE)) != ISMINE_NO));
+        }
+    }
+}
+
 static void ApproximateBestSubset(std::vector<std::pair<CAmount, std::pair<const CWalletTx*,unsigned int> > >vValue, const CAmount& nTotalLower, const CAmount& nTargetValue,
                                   std::vector<char>& vfBest, CAmount& nBest, bool fUseInstantSend = false, int iterations = 1000)
 {
@@ -3033,12 +3234,17 @@ bool CWallet::SelectPSInOutPairsByDenominations(int nDenom, CAmount nValueMin, C
         return false;
     }
 
-    AvailableCoins(vCoins, true, NULL, false, ONLY_DENOMINATED);
+    std::vector<CAmount> vecPrivateSendDenominations = CPrivateSend::GetStandardDenominations();
+    std::vector<CAmount> vecAmounts;
+    for (const auto& nBit : vecBits) {
+        vecAmounts.push_back(vecPrivateSendDenominations[nBit]);
+    }
+
+    AvailableDenominatedCoins(vCoins, vecAmounts);
     LogPrintf("CWallet::%s -- vCoins.size(): %d\n", __func__, vCoins.size());
 
     std::random_shuffle(vCoins.rbegin(), vCoins.rend(), GetRandInt);
 
-    std::vector<CAmount> vecPrivateSendDenominations = CPrivateSend::GetStandardDenominations();
     for (const auto& out : vCoins) {
         uint256 txHash = out.tx->GetHash();
         int nValue = out.tx->tx->vout[out.i].nValue;
@@ -3176,7 +3382,11 @@ bool CWallet::SelectPrivateCoins(CAmount nValueMin, CAmount nValueMax, std::vect
     nValueRet = 0;
 
     std::vector<COutput> vCoins;
-    AvailableCoins(vCoins, true, coinControl, false, nPrivateSendRoundsMin < 0 ? ONLY_NONDENOMINATED : ONLY_DENOMINATED);
+    if (nPrivateSendRoundsMin < 0) {
+        AvailableCoins(vCoins, true, coinControl, false, ONLY_NONDENOMINATED);
+    } else {
+        AvailableDenominatedCoins(vCoins, CPrivateSend::GetStandardDenominations());
+    }
 
     //order the array so largest nondenom are first, then denominations, then very small inputs.
     std::sort(vCoins.rbegin(), vCoins.rend(), CompareByPriority());
@@ -3287,23 +3497,19 @@ int CWallet::CountInputsWithAmount(CAmount nInputAmount)
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted()){
-                int nDepth = pcoin->GetDepthInMainChain();
+        // only denominated amounts are counted, so the matching bucket is all there is to look at
+        auto itBucket = mapDenominatedWalletUTXO.find(nInputAmount);
+        if (itBucket == mapDenominatedWalletUTXO.end()) return 0;
 
-                for (unsigned int i = 0; i < pcoin->tx->vout.size(); i++) {
-                    COutput out = COutput(pcoin, i, nDepth, true, true);
-                    COutPoint outpoint = COutPoint(out.tx->GetHash(), out.i);
+        for (const auto& outpoint : itBucket->second) {
+            std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
+            if (it == mapWallet.end()) continue;
+            const CWalletTx* pcoin = &(*it).second;
 
-                    if(out.tx->tx->vout[out.i].nValue != nInputAmount) continue;
-                    if(!CPrivateSend::IsDenominatedAmount(pcoin->tx->vout[i].nValue)) continue;
-                    if(IsSpent(out.tx->GetHash(), i) || IsMine(pcoin->tx->vout[i]) != ISMINE_SPENDABLE || !IsDenominated(outpoint)) continue;
+            if (!pcoin->IsTrusted()) continue;
+            if (IsSpent(outpoint.hash, outpoint.n) || IsMine(pcoin->tx->vout[outpoint.n]) != ISMINE_SPENDABLE) continue;
 
-                    nTotal++;
-                }
-            }
+            nTotal++;
         }
     }
 
@@ -3971,7 +4177,7 @@ DBErrors CWallet::LoadWallet(bool& fFirstRunRet)
         for (auto& pair : mapWallet) {
             for(unsigned int i = 0; i < pair.second.tx->vout.size(); ++i) {
                 if (IsMine(pair.second.tx->vout[i]) && !IsSpent(pair.first, i)) {
-                    setWalletUTXO.insert(COutPoint(pair.first, i));
+                    AddWalletUTXO(COutPoint(pair.first, i), pair.second.tx->vout[i].nValue);
                 }
             }
         }
@@ -4180,34 +4386,81 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
         } else {
             nTargetSize *= 2;
         }
-        bool fInternal = false;
         CWalletDB walletdb(strWalletFile);
-        for (int64_t i = missingInternal + missingExternal; i--;)
-        {
-            int64_t nEnd = 1;
-            if (i < missingInternal) {
-                fInternal = true;
-            }
-            if (!setInternalKeyPool.empty()) {
-                nEnd = *(--setInternalKeyPool.end()) + 1;
-            }
-            if (!setExternalKeyPool.empty()) {
-                nEnd = std::max(nEnd, *(--setExternalKeyPool.end()) + 1);
+        int64_t nEnd = 1;
+        if (!setInternalKeyPool.empty()) {
+            nEnd = *(--setInternalKeyPool.end()) + 1;
+        }
+        if (!setExternalKeyPool.empty()) {
+            nEnd = std::max(nEnd, *(--setExternalKeyPool.end()) + 1);
+        }
+
+        if (IsHDEnabled()) {
+            // derive HD keys in parallel batches and write each batch in a single database transaction
+            for (bool fInternal : {false, true}) {
+                int64_t nMissing = fInternal ? missingInternal : missingExternal;
+                while (nMissing > 0) {
+                    size_t nBatchSize = std::min(nMissing, (int64_t)KEYPOOL_TOPUP_BATCH_SIZE);
+                    std::vector<CPubKey> vecPubKeys;
+
+                    if (!walletdb.TxnBegin())
+                        throw std::runtime_error(std::string(__func__) + ": TxnBegin failed");
+                    int64_t nBatchEnd = nEnd;
+                    try {
+                        // TODO: implement keypools for all accounts?
+                        DeriveNewChildPubKeys(walletdb, 0, fInternal, nBatchSize, vecPubKeys);
+                        for (const auto& pubkey : vecPubKeys) {
+                            if (!walletdb.WritePool(nBatchEnd++, CKeyPool(pubkey, fInternal)))
+                                throw std::runtime_error(std::string(__func__) + ": writing generated key failed");
+                        }
+                        if (!walletdb.TxnCommit())
+                            throw std::runtime_error(std::string(__func__) + ": TxnCommit failed");
+                    } catch (...) {
+                        // no-op if the commit itself failed
+                        walletdb.TxnAbort();
+                        throw;
+                    }
+
+                    // only keys which made it to disk are handed out
+                    std::set<int64_t>& setKeyPool = fInternal ? setInternalKeyPool : setExternalKeyPool;
+                    while (nEnd < nBatchEnd) {
+                        setKeyPool.insert(nEnd++);
+                    }
+
+                    // check if we need to remove from watch-only, this writes through its own db handle
+                    // so it must happen outside of the transaction above
+                    for (const auto& pubkey : vecPubKeys) {
+                        CScript script = GetScriptForDestination(pubkey.GetID());
+                        if (HaveWatchOnly(script))
+                            RemoveWatchOnly(script);
+                        script = GetScriptForRawPubKey(pubkey);
+                        if (HaveWatchOnly(script))
+                            RemoveWatchOnly(script);
+                    }
+
+                    nMissing -= nBatchSize;
+                    LogPrintf("keypool added %d keys, size=%u, internal=%d\n", vecPubKeys.size(), setInternalKeyPool.size() + setExternalKeyPool.size(), fInternal);
+
+                    double dProgress = 100.f * nEnd / (nTargetSize + 1);
+                    std::string strMsg = strprintf(_("Loading wallet... (%3.2f %%)"), dProgress);
+                    uiInterface.InitMessage(strMsg);
+                }
             }
-            // TODO: implement keypools for all accounts?
-            if (!walletdb.WritePool(nEnd, CKeyPool(GenerateNewKey(0, fInternal), fInternal)))
-                throw std::runtime_error(std::string(__func__) + ": writing generated key failed");
+        } else {
+            // non-HD wallets only have an external keypool
+            for (int64_t i = missingExternal; i--;)
+            {
+                if (!walletdb.WritePool(nEnd, CKeyPool(GenerateNewKey(0, false), false)))
+                    throw std::runtime_error(std::string(__func__) + ": writing generated key failed");
 
-            if (fInternal) {
-                setInternalKeyPool.insert(nEnd);
-            } else {
                 setExternalKeyPool.insert(nEnd);
-            }
-            LogPrintf("keypool added key %d, size=%u, internal=%d\n", nEnd, setInternalKeyPool.size() + setExternalKeyPool.size(), fInternal);
+                LogPrintf("keypool added key %d, size=%u, internal=%d\n", nEnd, setInternalKeyPool.size() + setExternalKeyPool.size(), false);
 
-            double dProgress = 100.f * nEnd / (nTargetSize + 1);
-            std::string strMsg = strprintf(_("Loading wallet... (%3.2f %%)"), dProgress);
-            uiInterface.InitMessage(strMsg);
+                double dProgress = 100.f * nEnd / (nTargetSize + 1);
+                std::string strMsg = strprintf(_("Loading wallet... (%3.2f %%)"), dProgress);
+                uiInterface.InitMessage(strMsg);
+                nEnd++;
+            }
         }
     }
     return true;
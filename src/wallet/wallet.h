@@ -30,6 +30,7 @@
 #include <stdexcept>
 #include <stdint.h>
 #include <string>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -48,6 +49,8 @@ extern bool fSendFreeTransactions;
 extern bool bBIP69Enabled;
 
 static const unsigned int DEFAULT_KEYPOOL_SIZE = 1000;
+//! Number of HD keys derived and written to the wallet database in one transaction by TopUpKeyPool
+static const unsigned int KEYPOOL_TOPUP_BATCH_SIZE = 1000;
 //! -paytxfee default
 static const CAmount DEFAULT_TRANSACTION_FEE = 0;
 //! -fallbackfee default
@@ -668,6 +671,14 @@ private:
     void AddToSpends(const uint256& wtxid);
 
     std::set<COutPoint> setWalletUTXO;
+    // denominated subset of setWalletUTXO bucketed by denomination, lets mixing pick its inputs
+    // from the right buckets directly instead of walking the whole wallet on every attempt
+    std::map<CAmount, std::set<COutPoint> > mapDenominatedWalletUTXO;
+
+    void AddWalletUTXO(const COutPoint& outpoint, CAmount nValue);
+    void EraseWalletUTXO(const COutPoint& outpoint);
+    /* Re-add the outputs spent by wtx which are unspent again, after it was abandoned or conflicted */
+    void RestoreWalletUTXOs(const CWalletTx& wtx);
 
     /* Mark a transaction (and its in-wallet descendants) as conflicting with a particular block. */
     void MarkConflicted(const uint256& hashBlock, const uint256& hashTx);
@@ -676,6 +687,13 @@ private:
 
     /* HD derive new child key (on internal or external chain) */
     void DeriveNewChildKey(const CKeyMetadata& metadata, CKey& secretRet, uint32_t nAccountIndex, bool fInternal /*= false*/);
+    /* HD derive nCount new child pubkeys in parallel and write them using walletdb (on internal or external chain) */
+    void DeriveNewChildPubKeys(CWalletDB& walletdb, uint32_t nAccountIndex, bool fInternal, size_t nCount, std::vector<CPubKey>& vecPubKeysRet);
+    /* Get the (cached) extended pubkey at m/purpose'/coin_type'/account'/change for an HD chain */
+    bool GetHDChangePubKey(const CHDChain& hdChain, uint32_t nAccountIndex, bool fInternal, CExtPubKey& extPubKeyRet);
+
+    /* Extended pubkeys of HD chains, keyed by chain id, account index and change index */
+    std::map<std::tuple<uint256, uint32_t, uint32_t>, CExtPubKey> mapHdChangePubKeys;
 
     bool fFileBacked;
 
@@ -797,6 +815,11 @@ public:
      * populate vCoins with vector of available COutputs.
      */
     void AvailableCoins(std::vector<COutput>& vCoins, bool fOnlyConfirmed=true, const CCoinControl *coinControl = NULL, bool fIncludeZeroValue=false, AvailableCoinsType nCoinType=ALL_COINS, bool fUseInstantSend = false) const;
+    /**
+     * Same as AvailableCoins with ONLY_DENOMINATED but restricted to the given denominations,
+     * only the matching buckets of the denominated UTXO index are looked at.
+     */
+    void AvailableDenominatedCoins(std::vector<COutput>& vCoins, const std::vector<CAmount>& vecAmounts, bool fOnlyConfirmed=true) const;
 
     /**
      * Shuffle and select coins until nTargetValue is reached while avoiding
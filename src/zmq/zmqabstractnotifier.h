@@ -7,6 +7,9 @@
 
 #include "zmqconfig.h"
 
+#include <atomic>
+#include <memory>
+
 class CBlockIndex;
 class CGovernanceObject;
 class CGovernanceVote;
@@ -17,7 +20,10 @@ typedef CZMQAbstractNotifier* (*CZMQNotifierFactory)();
 class CZMQAbstractNotifier
 {
 public:
-    CZMQAbstractNotifier() : psocket(0) { }
+    /** Default per-socket outbound queue limit (ZMQ_SNDHWM), in messages */
+    static const int DEFAULT_ZMQ_SNDHWM = 1000;
+
+    CZMQAbstractNotifier() : psocket(0), nSendHighWaterMark(DEFAULT_ZMQ_SNDHWM), nDropped(0) { }
     virtual ~CZMQAbstractNotifier();
 
     template <typename T>
@@ -30,11 +36,16 @@ public:
     void SetType(const std::string &t) { type = t; }
     std::string GetAddress() const { return address; }
     void SetAddress(const std::string &a) { address = a; }
+    int GetSendHighWaterMark() const { return nSendHighWaterMark; }
+    void SetSendHighWaterMark(int hwm) { nSendHighWaterMark = hwm; }
+    /** Number of messages not published because the outbound queue was at its high-water mark */
+    uint64_t GetDroppedMessages() const { return nDropped; }
 
     virtual bool Initialize(void *pcontext) = 0;
     virtual void Shutdown() = 0;
 
-    virtual bool NotifyBlock(const CBlockIndex *pindex);
+    /** pblock is the block connected at pindex if it is still in memory, or null */
+    virtual bool NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock> &pblock);
     virtual bool NotifyTransaction(const CTransaction &transaction);
     virtual bool NotifyTransactionLock(const CTransaction &transaction);
     virtual bool NotifyGovernanceVote(const CGovernanceVote &vote);
@@ -46,6 +57,8 @@ protected:
     void *psocket;
     std::string type;
     std::string address;
+    int nSendHighWaterMark;
+    std::atomic<uint64_t> nDropped;
 };
 
 #endif // BITCOIN_ZMQ_ZMQABSTRACTNOTIFIER_H
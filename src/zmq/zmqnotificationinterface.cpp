@@ -10,12 +10,14 @@
 #include "streams.h"
 #include "util.h"
 
+CZMQNotificationInterface* pzmqNotificationInterface = NULL;
+
 void zmqError(const char *str)
 {
     LogPrint("zmq", "zmq: Error: %s, errno=%s\n", str, zmq_strerror(errno));
 }
 
-CZMQNotificationInterface::CZMQNotificationInterface() : pcontext(NULL)
+CZMQNotificationInterface::CZMQNotificationInterface() : pcontext(NULL), pindexLastBlockConnected(NULL)
 {
 }
 
@@ -29,6 +31,15 @@ CZMQNotificationInterface::~CZMQNotificationInterface()
     }
 }
 
+std::list<const CZMQAbstractNotifier*> CZMQNotificationInterface::GetActiveNotifiers() const
+{
+    std::list<const CZMQAbstractNotifier*> result;
+    for (const auto* n : notifiers) {
+        result.push_back(n);
+    }
+    return result;
+}
+
 CZMQNotificationInterface* CZMQNotificationInterface::Create()
 {
     CZMQNotificationInterface* notificationInterface = NULL;
@@ -58,6 +69,7 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
             CZMQAbstractNotifier *notifier = factory();
             notifier->SetType(i->first);
             notifier->SetAddress(address);
+            notifier->SetSendHighWaterMark(GetArg(arg + "hwm", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM));
             notifiers.push_back(notifier);
         }
     }
@@ -134,13 +146,26 @@ void CZMQNotificationInterface::Shutdown()
 
 void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
 {
+    std::shared_ptr<const CBlock> pblock;
+    const CBlockIndex* pindexBlock;
+    {
+        LOCK(cs_lastBlock);
+        pblock.swap(pLastBlockConnected);
+        pindexBlock = pindexLastBlockConnected;
+        pindexLastBlockConnected = nullptr;
+    }
+
     if (fInitialDownload || pindexNew == pindexFork) // In IBD or blocks were disconnected without any new ones
         return;
 
+    // Only hand over the block if it actually is the new tip
+    if (pindexBlock != pindexNew)
+        pblock.reset();
+
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
         CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyBlock(pindexNew))
+        if (notifier->NotifyBlock(pindexNew, pblock))
         {
             i++;
         }
@@ -169,6 +194,13 @@ void CZMQNotificationInterface::SyncTransaction(const CTransaction& tx, const CB
     }
 }
 
+void CZMQNotificationInterface::BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex)
+{
+    LOCK(cs_lastBlock);
+    pLastBlockConnected = block;
+    pindexLastBlockConnected = pindex;
+}
+
 void CZMQNotificationInterface::NotifyTransactionLock(const CTransaction &tx)
 {
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
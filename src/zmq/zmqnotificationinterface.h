@@ -5,9 +5,12 @@
 #ifndef BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
 #define BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
 
+#include "sync.h"
 #include "validationinterface.h"
-#include <string>
+#include <list>
 #include <map>
+#include <memory>
+#include <string>
 
 class CBlockIndex;
 class CZMQAbstractNotifier;
@@ -19,12 +22,15 @@ public:
 
     static CZMQNotificationInterface* Create();
 
+    std::list<const CZMQAbstractNotifier*> GetActiveNotifiers() const;
+
 protected:
     bool Initialize();
     void Shutdown();
 
     // CValidationInterface
     void SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, int posInBlock) override;
+    void BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex *pindex) override;
     void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
     void NotifyTransactionLock(const CTransaction &tx) override;
     void NotifyGovernanceVote(const CGovernanceVote& vote) override;
@@ -37,6 +43,15 @@ private:
 
     void *pcontext;
     std::list<CZMQAbstractNotifier*> notifiers;
+
+    // Last block connected to the active chain, handed to the block notifiers
+    // on the next tip update so they don't need to read it back from disk
+    CCriticalSection cs_lastBlock;
+    std::shared_ptr<const CBlock> pLastBlockConnected;
+    // the index it was connected at, compared instead of hashing the block again
+    const CBlockIndex* pindexLastBlockConnected;
 };
 
+extern CZMQNotificationInterface* pzmqNotificationInterface;
+
 #endif // BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
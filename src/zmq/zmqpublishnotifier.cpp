@@ -23,46 +23,26 @@ static const char *MSG_RAWGVOTE   = "rawgovernancevote";
 static const char *MSG_RAWGOBJ    = "rawgovernanceobject";
 static const char *MSG_RAWISCON   = "rawinstantsenddoublespend";
 
-// Internal function to send multipart message
-static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
+// Internal function to initialize a message part holding a copy of data
+static int zmq_msg_init_copy(zmq_msg_t *msg, const void* data, size_t size)
 {
-    va_list args;
-    va_start(args, size);
-
-    while (1)
+    int rc = zmq_msg_init_size(msg, size);
+    if (rc != 0)
     {
-        zmq_msg_t msg;
-
-        int rc = zmq_msg_init_size(&msg, size);
-        if (rc != 0)
-        {
-            zmqError("Unable to initialize ZMQ msg");
-            return -1;
-        }
-
-        void *buf = zmq_msg_data(&msg);
-        memcpy(buf, data, size);
-
-        data = va_arg(args, const void*);
-
-        rc = zmq_msg_send(&msg, sock, data ? ZMQ_SNDMORE : 0);
-        if (rc == -1)
-        {
-            zmqError("Unable to send ZMQ msg");
-            zmq_msg_close(&msg);
-            return -1;
-        }
-
-        zmq_msg_close(&msg);
-
-        if (!data)
-            break;
-
-        size = va_arg(args, size_t);
+        zmqError("Unable to initialize ZMQ msg");
+        return -1;
     }
+
+    memcpy(zmq_msg_data(msg), data, size);
     return 0;
 }
 
+// Called by zmq once it has sent (or discarded) a zero-copy message part
+static void zmq_release_stream(void * /*data*/, void *hint)
+{
+    delete static_cast<std::shared_ptr<const CDataStream>*>(hint);
+}
+
 bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
 {
     assert(!psocket);
@@ -79,7 +59,24 @@ bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
             return false;
         }
 
-        int rc = zmq_bind(psocket, address.c_str());
+        LogPrint("zmq", "zmq: Outbound message high water mark for %s at %s is %d\n", type, address, nSendHighWaterMark);
+
+        int rc = zmq_setsockopt(psocket, ZMQ_SNDHWM, &nSendHighWaterMark, sizeof(nSendHighWaterMark));
+        if (rc != 0)
+        {
+            zmqError("Failed to set outbound message high water mark");
+            zmq_close(psocket);
+            return false;
+        }
+
+#ifdef ZMQ_XPUB_NODROP
+        // Make zmq report a full queue instead of silently discarding the
+        // message, so that dropped notifications can be counted
+        int nodrop = 1;
+        zmq_setsockopt(psocket, ZMQ_XPUB_NODROP, &nodrop, sizeof(nodrop));
+#endif
+
+        rc = zmq_bind(psocket, address.c_str());
         if (rc!=0)
         {
             zmqError("Failed to bind address");
@@ -132,16 +129,64 @@ void CZMQAbstractPublishNotifier::Shutdown()
     psocket = 0;
 }
 
-bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* data, size_t size)
+bool CZMQAbstractPublishNotifier::SendParts(const char *command, zmq_msg_t &msgData)
 {
     assert(psocket);
 
     /* send three parts, command & data & a LE 4byte sequence number */
     unsigned char msgseq[sizeof(uint32_t)];
     WriteLE32(&msgseq[0], nSequence);
-    int rc = zmq_send_multipart(psocket, command, strlen(command), data, size, msgseq, (size_t)sizeof(uint32_t), (void*)0);
+
+    zmq_msg_t msgCommand, msgSeq;
+    if (zmq_msg_init_copy(&msgCommand, command, strlen(command)) != 0)
+    {
+        zmq_msg_close(&msgData);
+        return false;
+    }
+    if (zmq_msg_init_copy(&msgSeq, msgseq, sizeof(msgseq)) != 0)
+    {
+        zmq_msg_close(&msgCommand);
+        zmq_msg_close(&msgData);
+        return false;
+    }
+
+    /* the first part decides whether the whole message gets queued, later parts of an
+       accepted multipart message never hit the high water mark */
+    int rc = zmq_msg_send(&msgCommand, psocket, ZMQ_SNDMORE | ZMQ_DONTWAIT);
     if (rc == -1)
+    {
+        bool fDropped = zmq_errno() == EAGAIN;
+        if (!fDropped)
+            zmqError("Unable to send ZMQ msg");
+        zmq_msg_close(&msgCommand);
+        zmq_msg_close(&msgData);
+        zmq_msg_close(&msgSeq);
+        if (!fDropped)
+            return false;
+
+        /* subscribers see the gap in the sequence numbers */
+        LogPrint("zmq", "zmq: Outbound queue full, dropped %s message at %s\n", command, address);
+        nDropped++;
+        nSequence++;
+        return true;
+    }
+
+    rc = zmq_msg_send(&msgData, psocket, ZMQ_SNDMORE);
+    if (rc == -1)
+    {
+        zmqError("Unable to send ZMQ msg");
+        zmq_msg_close(&msgData);
+        zmq_msg_close(&msgSeq);
         return false;
+    }
+
+    rc = zmq_msg_send(&msgSeq, psocket, 0);
+    if (rc == -1)
+    {
+        zmqError("Unable to send ZMQ msg");
+        zmq_msg_close(&msgSeq);
+        return false;
+    }
 
     /* increment memory only sequence number after sending */
     nSequence++;
@@ -149,7 +194,33 @@ bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* d
     return true;
 }
 
-bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
+bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* data, size_t size)
+{
+    zmq_msg_t msgData;
+    if (zmq_msg_init_copy(&msgData, data, size) != 0)
+        return false;
+
+    return SendParts(command, msgData);
+}
+
+bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const std::shared_ptr<const CDataStream> &data)
+{
+    // zmq keeps its own reference to the stream until the message part is gone
+    std::shared_ptr<const CDataStream>* hint = new std::shared_ptr<const CDataStream>(data);
+
+    zmq_msg_t msgData;
+    int rc = zmq_msg_init_data(&msgData, const_cast<char*>(data->data()), data->size(), zmq_release_stream, hint);
+    if (rc != 0)
+    {
+        zmqError("Unable to initialize ZMQ msg");
+        delete hint;
+        return false;
+    }
+
+    return SendParts(command, msgData);
+}
+
+bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock> & /*pblock*/)
 {
     uint256 hash = pindex->GetBlockHash();
     LogPrint("zmq", "zmq: Publish hashblock %s\n", hash.GetHex());
@@ -213,13 +284,18 @@ bool CZMQPublishHashInstantSendDoubleSpendNotifier::NotifyInstantSendDoubleSpend
 }
 
 
-bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
+bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock> &pblock)
 {
     LogPrint("zmq", "zmq: Publish rawblock %s\n", pindex->GetBlockHash().GetHex());
 
-    const Consensus::Params& consensusParams = Params().GetConsensus();
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    std::shared_ptr<CDataStream> ss = std::make_shared<CDataStream>(SER_NETWORK, PROTOCOL_VERSION);
+    if (pblock)
+    {
+        *ss << *pblock;
+    }
+    else
     {
+        const Consensus::Params& consensusParams = Params().GetConsensus();
         LOCK(cs_main);
         CBlock block;
         if(!ReadBlockFromDisk(block, pindex, consensusParams))
@@ -228,28 +304,28 @@ bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
             return false;
         }
 
-        ss << block;
+        *ss << block;
     }
 
-    return SendMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
+    return SendMessage(MSG_RAWBLOCK, ss);
 }
 
 bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &transaction)
 {
     uint256 hash = transaction.GetHash();
     LogPrint("zmq", "zmq: Publish rawtx %s\n", hash.GetHex());
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-    ss << transaction;
-    return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
+    std::shared_ptr<CDataStream> ss = std::make_shared<CDataStream>(SER_NETWORK, PROTOCOL_VERSION);
+    *ss << transaction;
+    return SendMessage(MSG_RAWTX, ss);
 }
 
 bool CZMQPublishRawTransactionLockNotifier::NotifyTransactionLock(const CTransaction &transaction)
 {
     uint256 hash = transaction.GetHash();
     LogPrint("zmq", "zmq: Publish rawtxlock %s\n", hash.GetHex());
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-    ss << transaction;
-    return SendMessage(MSG_RAWTXLOCK, &(*ss.begin()), ss.size());
+    std::shared_ptr<CDataStream> ss = std::make_shared<CDataStream>(SER_NETWORK, PROTOCOL_VERSION);
+    *ss << transaction;
+    return SendMessage(MSG_RAWTXLOCK, ss);
 }
 
 bool CZMQPublishRawGovernanceVoteNotifier::NotifyGovernanceVote(const CGovernanceVote &vote)
@@ -8,6 +8,7 @@
 #include "zmqabstractnotifier.h"
 
 class CBlockIndex;
+class CDataStream;
 class CGovernanceVote;
 class CGovernanceObject;
 
@@ -25,15 +26,21 @@ public:
           * message sequence number
     */
     bool SendMessage(const char *command, const void* data, size_t size);
+    /* same as above, but hands the serialized payload to zmq without copying it;
+       the stream is released once zmq is done with it */
+    bool SendMessage(const char *command, const std::shared_ptr<const CDataStream> &data);
 
     bool Initialize(void *pcontext) override;
     void Shutdown() override;
+
+private:
+    bool SendParts(const char *command, zmq_msg_t &msgData);
 };
 
 class CZMQPublishHashBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
-    bool NotifyBlock(const CBlockIndex *pindex) override;
+    bool NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock> &pblock) override;
 };
 
 class CZMQPublishHashTransactionNotifier : public CZMQAbstractPublishNotifier
@@ -69,7 +76,7 @@ public:
 class CZMQPublishRawBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
-    bool NotifyBlock(const CBlockIndex *pindex) override;
+    bool NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock> &pblock) override;
 };
 
 class CZMQPublishRawTransactionNotifier : public CZMQAbstractPublishNotifier